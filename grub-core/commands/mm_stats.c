@@ -0,0 +1,116 @@
+/* mm_stats.c - command to display heap allocator statistics.  */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2020  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/dl.h>
+#include <grub/misc.h>
+#include <grub/command.h>
+#include <grub/i18n.h>
+#include <grub/mm.h>
+#include <grub/mm_private.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+static grub_err_t
+grub_cmd_mm_stats (grub_command_t cmd __attribute__ ((unused)),
+		   int argc __attribute__ ((unused)),
+		   char **args __attribute__ ((unused)))
+{
+  struct grub_mm_stats st;
+  grub_mm_region_t r;
+  grub_size_t total = 0, total_free = 0, largest = 0, nfree = 0;
+  grub_size_t cached = 0;
+  unsigned i, nregions = 0;
+
+  /* Take a snapshot first: printing allocates.  */
+  st = grub_mm_stats;
+
+  for (r = grub_mm_base; r; r = r->next)
+    {
+      grub_mm_header_t p;
+
+      nregions++;
+      total += r->size;
+
+      p = r->first;
+      if (p->magic == GRUB_MM_ALLOC_MAGIC)
+	continue;
+      do
+	{
+	  grub_size_t sz = p->size << GRUB_MM_ALIGN_LOG2;
+
+	  nfree++;
+	  total_free += sz;
+	  if (sz > largest)
+	    largest = sz;
+	  p = p->next;
+	}
+      while (p != r->first);
+    }
+
+  grub_printf_ (N_("Heap: %u regions, %" PRIuGRUB_SIZE " KiB total, "
+		   "%" PRIuGRUB_SIZE " KiB free in %" PRIuGRUB_SIZE
+		   " blocks\n"),
+		nregions, total >> 10, total_free >> 10, nfree);
+  grub_printf_ (N_("Largest free block: %" PRIuGRUB_SIZE " KiB, "
+		   "fragmentation: %u%%\n"),
+		largest >> 10,
+		total_free ? (unsigned) (100 - (grub_uint64_t) largest * 100
+					 / total_free) : 0);
+  grub_printf_ (N_("Region scans: %llu, blocks visited: %llu, "
+		   "average: %llu, longest: %" PRIuGRUB_SIZE "\n"),
+		(unsigned long long) st.scans,
+		(unsigned long long) st.scan_steps,
+		st.scans ? (unsigned long long) (st.scan_steps / st.scans) : 0ULL,
+		st.max_scan);
+  grub_printf_ (N_("Large allocations: %llu, class list flushes: %llu\n"),
+		(unsigned long long) st.large_allocs,
+		(unsigned long long) st.flushes);
+
+  grub_printf_ (N_("  size       allocs         hits        frees   cached\n"));
+  for (i = 0; i < GRUB_MM_NUM_CLASSES; i++)
+    {
+      struct grub_mm_class_stats *c = &st.classes[i];
+
+      cached += c->cached * (i + 1);
+      if (!c->allocs && !c->frees)
+	continue;
+      grub_printf ("%6u %12llu %12llu %12llu %8" PRIuGRUB_SIZE "\n",
+		   (unsigned) ((i + 1) << GRUB_MM_ALIGN_LOG2),
+		   (unsigned long long) c->allocs,
+		   (unsigned long long) c->hits,
+		   (unsigned long long) c->frees, c->cached);
+    }
+  grub_printf_ (N_("Cached in class lists: %" PRIuGRUB_SIZE " bytes\n"),
+		cached << GRUB_MM_ALIGN_LOG2);
+
+  return 0;
+}
+
+static grub_command_t cmd;
+
+GRUB_MOD_INIT(mm_stats)
+{
+  cmd = grub_register_command ("mm_stats", grub_cmd_mm_stats,
+			       0, N_("Show heap allocator statistics."));
+}
+
+GRUB_MOD_FINI(mm_stats)
+{
+  grub_unregister_command (cmd);
+}
@@ -0,0 +1,119 @@
+/* raidtest.c - time the RAID parity block operations.  */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2020  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/dl.h>
+#include <grub/mm.h>
+#include <grub/misc.h>
+#include <grub/time.h>
+#include <grub/extcmd.h>
+#include <grub/i18n.h>
+#include <grub/normal.h>
+#include <grub/diskfilter.h>
+#include <grub/raid_ref.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+#define DEFAULT_BLOCK_SIZE	65536
+#define DEFAULT_ITERATIONS	256
+
+static const struct grub_arg_option options[] =
+  {
+    {"size", 's', 0, N_("Size of the block to process."), 0, ARG_TYPE_INT},
+    {"count", 'c', 0, N_("Number of passes over the block."), 0, ARG_TYPE_INT},
+    {0, 0, 0, 0, 0, 0}
+  };
+
+static void
+print_speed (const char *name, grub_uint64_t bytes, grub_uint64_t ms)
+{
+  grub_printf ("%-10s %6u ms", name, (unsigned) ms);
+  if (ms)
+    grub_printf ("  %s", grub_get_human_size (grub_divmod64 (bytes * 100ULL
+							     * 1000ULL, ms, 0),
+					      GRUB_HUMAN_SIZE_SPEED));
+  grub_printf ("\n");
+}
+
+static grub_err_t
+grub_cmd_raidtest (grub_extcmd_context_t ctxt,
+		   int argc __attribute__ ((unused)),
+		   char **args __attribute__ ((unused)))
+{
+  struct grub_arg_list *state = ctxt->state;
+  grub_size_t size = DEFAULT_BLOCK_SIZE;
+  unsigned long count = DEFAULT_ITERATIONS, i;
+  grub_uint8_t *a = NULL, *b = NULL;
+  grub_uint64_t start, bytes;
+  grub_uint32_t seed = 1;
+
+  if (state[0].set)
+    size = grub_strtoul (state[0].arg, 0, 0);
+  if (state[1].set)
+    count = grub_strtoul (state[1].arg, 0, 0);
+  if (grub_errno)
+    return grub_errno;
+  if (size == 0 || count == 0)
+    return grub_error (GRUB_ERR_BAD_ARGUMENT, N_("invalid argument"));
+
+  a = grub_malloc (size);
+  b = grub_malloc (size);
+  if (!a || !b)
+    goto quit;
+
+  grub_raid_ref_fill (a, size, &seed);
+  grub_raid_ref_fill (b, size, &seed);
+  bytes = (grub_uint64_t) size * count;
+
+  /* One RAID6 data block: accumulate P and Q.  */
+  start = grub_get_time_ms ();
+  for (i = 0; i < count; i++)
+    grub_raid_ref_block_mul_xor (grub_raid_ref_powx[i % 255], a, b, size);
+  print_speed ("bytewise", bytes, grub_get_time_ms () - start);
+
+  start = grub_get_time_ms ();
+  for (i = 0; i < count; i++)
+    grub_raid_block_mul_xor (grub_raid_ref_powx[i % 255], a, b, size);
+  print_speed ("mul_xor", bytes, grub_get_time_ms () - start);
+
+  start = grub_get_time_ms ();
+  for (i = 0; i < count; i++)
+    grub_raid_block_xor (a, b, size);
+  print_speed ("xor", bytes, grub_get_time_ms () - start);
+
+ quit:
+  grub_free (a);
+  grub_free (b);
+  return grub_errno;
+}
+
+static grub_extcmd_t cmd;
+
+GRUB_MOD_INIT(raidtest)
+{
+  grub_raid_ref_init ();
+  cmd = grub_register_extcmd ("raidtest", grub_cmd_raidtest, 0,
+			      N_("[-s SIZE] [-c COUNT]"),
+			      N_("Time RAID parity computation."),
+			      options);
+}
+
+GRUB_MOD_FINI(raidtest)
+{
+  grub_unregister_extcmd (cmd);
+}
@@ -30,6 +30,7 @@
 #include <grub/i18n.h>
 #include <grub/disk.h>
 #include <grub/partition.h>
+#include <grub/time.h>
 #if defined(DO_SEARCH_PART_UUID) || defined(DO_SEARCH_PART_LABEL) || \
     defined(DO_SEARCH_DISK_UUID)
 #include <grub/gpt_partition.h>
@@ -46,6 +47,26 @@ struct cache_entry
 
 static struct cache_entry *cache;
 
+/* What is known about a device from previous searches.  */
+struct probe_entry
+{
+  struct probe_entry *next;
+  char *name;
+  /* Whether VALUE, the string compared with the keys, is known.  VALUE is
+     NULL if the device has none.  Failed probes are not remembered, and
+     values are forgotten together with the disk cache.  */
+  int probed;
+  char *value;
+  /* Probing the device failed with a read error or took longer than
+     SEARCH_SLOW_MS, so it is probed after the other devices.  */
+  int slow;
+};
+
+#define SEARCH_SLOW_MS	500
+
+static struct probe_entry *probe_index;
+static grub_uint32_t probe_generation;
+
 /* Context for FUNC_NAME.  */
 struct search_ctx
 {
@@ -56,13 +77,130 @@ struct search_ctx
   unsigned nhints;
   int count;
   int is_cache;
+  /* During the scan of all devices, whether it is the pass over slow
+     devices, and whether any was skipped before it.  */
+  int scan;
+  int slow_pass;
+  int skipped_slow;
 };
 
+#if defined(DO_SEARCH_FS_UUID) || defined(DO_SEARCH_DISK_UUID) \
+    || defined(DO_SEARCH_PART_UUID)
+#define compare_fn grub_strcasecmp
+#else
+#define compare_fn grub_strcmp
+#endif
+
+static struct probe_entry *
+probe_index_get (const char *name)
+{
+  struct probe_entry *ent;
+
+  if (probe_generation != grub_disk_cache_generation)
+    {
+      for (ent = probe_index; ent; ent = ent->next)
+	{
+	  grub_free (ent->value);
+	  ent->value = NULL;
+	  ent->probed = 0;
+	}
+      probe_generation = grub_disk_cache_generation;
+    }
+
+  for (ent = probe_index; ent; ent = ent->next)
+    if (grub_strcmp (ent->name, name) == 0)
+      return ent;
+
+  ent = grub_zalloc (sizeof (*ent));
+  if (!ent)
+    return NULL;
+  ent->name = grub_strdup (name);
+  if (!ent->name)
+    {
+      grub_free (ent);
+      return NULL;
+    }
+  ent->next = probe_index;
+  probe_index = ent;
+  return ent;
+}
+
+#ifndef DO_SEARCH_FILE
+/* Read the string of device NAME compared with the keys into *VALUE.
+   Returns 1 if the result may be remembered, and 0 if probing failed and
+   may succeed later, e.g. after a read error or once the filesystem
+   module has been autoloaded.  */
+static int
+probe_device (const char *name, char **value)
+{
+  grub_device_t dev;
+  int known = 0;
+
+  *value = NULL;
+
+  dev = grub_device_open (name);
+  if (!dev)
+    return 0;
+
+#if defined(DO_SEARCH_PART_UUID)
+  if (grub_gpt_part_uuid (dev, value) != GRUB_ERR_NONE)
+    *value = NULL;
+  else
+    known = 1;
+#elif defined(DO_SEARCH_PART_LABEL)
+  if (grub_gpt_part_label (dev, value) != GRUB_ERR_NONE)
+    *value = NULL;
+  else
+    known = 1;
+#elif defined(DO_SEARCH_DISK_UUID)
+  if (grub_gpt_disk_uuid (dev, value) != GRUB_ERR_NONE)
+    *value = NULL;
+  else
+    known = 1;
+#else
+  {
+    /* SEARCH_FS_UUID or SEARCH_LABEL */
+    grub_fs_t fs;
+
+    fs = grub_fs_probe (dev);
+
+#ifdef DO_SEARCH_FS_UUID
+#define read_fn fs_uuid
+#else
+#define read_fn fs_label
+#endif
+
+    if (fs && fs->read_fn)
+      {
+	char *quid = NULL;
+
+	fs->read_fn (dev, &quid);
+
+	if (grub_errno == GRUB_ERR_NONE)
+	  {
+	    *value = quid;
+	    known = 1;
+	  }
+	else
+	  grub_free (quid);
+      }
+    else if (fs)
+      known = 1;
+  }
+#endif
+
+  grub_device_close (dev);
+  return known;
+}
+#endif
+
 /* Helper for FUNC_NAME.  */
 static int
 iterate_device (const char *name, void *data)
 {
   struct search_ctx *ctx = data;
+  struct probe_entry *ent;
+  grub_uint64_t start;
   int found = 0;
 
   /* Skip floppy drives when requested.  */
@@ -70,11 +208,18 @@ iterate_device (const char *name, void *data)
       name[0] == 'f' && name[1] == 'd' && name[2] >= '0' && name[2] <= '9')
     return 1;
 
-#if defined(DO_SEARCH_FS_UUID) || defined(DO_SEARCH_DISK_UUID)
-#define compare_fn grub_strcasecmp
-#else
-#define compare_fn grub_strcmp
-#endif
+  ent = probe_index_get (name);
+  grub_errno = GRUB_ERR_NONE;
+
+  /* Leave slow devices for the end of a full scan.  */
+  if (ent && ctx->scan && ent->slow != ctx->slow_pass)
+    {
+      if (ent->slow)
+	ctx->skipped_slow = 1;
+      return 0;
+    }
+
+  start = grub_get_time_ms ();
 
 #ifdef DO_SEARCH_FILE
     {
@@ -94,98 +239,35 @@ iterate_device (const char *name, void *data)
 	}
       grub_free (buf);
     }
-#elif defined(DO_SEARCH_PART_UUID)
+#else
     {
-      grub_device_t dev;
-      char *quid;
+      char *quid = NULL;
 
-      dev = grub_device_open (name);
-      if (dev)
+      if (ent && ent->probed)
+	quid = ent->value;
+      else
 	{
-	  if (grub_gpt_part_uuid (dev, &quid) == GRUB_ERR_NONE)
+	  if (probe_device (name, &quid) && ent)
 	    {
-	      if (grub_strcasecmp (quid, ctx->key) == 0)
-		    found = 1;
-
-	      grub_free (quid);
+	      ent->probed = 1;
+	      ent->value = quid;
 	    }
-
-	  grub_device_close (dev);
 	}
-    }
-#elif defined(DO_SEARCH_PART_LABEL)
-    {
-      grub_device_t dev;
-      char *quid;
 
-      dev = grub_device_open (name);
-      if (dev)
-	{
-	  if (grub_gpt_part_label (dev, &quid) == GRUB_ERR_NONE)
-	    {
-	      if (grub_strcmp (quid, ctx->key) == 0)
-		    found = 1;
+      if (quid && compare_fn (quid, ctx->key) == 0)
+	found = 1;
 
-	      grub_free (quid);
-	    }
-
-	  grub_device_close (dev);
-	}
+      if (!ent || !ent->probed)
+	grub_free (quid);
     }
-#elif defined(DO_SEARCH_DISK_UUID)
-    {
-      grub_device_t dev;
-      char *quid;
-
-      dev = grub_device_open (name);
-      if (dev)
-	{
-	  if (grub_gpt_disk_uuid (dev, &quid) == GRUB_ERR_NONE)
-	    {
-	      if (grub_strcmp (quid, ctx->key) == 0)
-		found = 1;
-
-	      grub_free (quid);
-	    }
-
-	  grub_device_close (dev);
-	}
-    }
-#else
-    {
-      /* SEARCH_FS_UUID or SEARCH_LABEL */
-      grub_device_t dev;
-      grub_fs_t fs;
-      char *quid;
-
-      dev = grub_device_open (name);
-      if (dev)
-	{
-	  fs = grub_fs_probe (dev);
-
-#ifdef DO_SEARCH_FS_UUID
-#define read_fn fs_uuid
-#else
-#define read_fn fs_label
 #endif
 
-	  if (fs && fs->read_fn)
-	    {
-	      fs->read_fn (dev, &quid);
-
-	      if (grub_errno == GRUB_ERR_NONE && quid)
-		{
-		  if (compare_fn (quid, ctx->key) == 0)
-		    found = 1;
-
-		  grub_free (quid);
-		}
-	    }
-
-	  grub_device_close (dev);
-	}
+  if (ent && (grub_errno == GRUB_ERR_READ_ERROR
+	      || grub_get_time_ms () - start > SEARCH_SLOW_MS))
+    {
+      grub_dprintf ("search", "%s is slow to probe\n", name);
+      ent->slow = 1;
     }
-#endif
 
   if (!ctx->is_cache && found && ctx->count == 0)
     {
@@ -318,7 +400,15 @@ try (struct search_ctx *ctx)
 	    return;
 	}
     }
-  grub_device_iterate (iterate_device, ctx);
+  ctx->scan = 1;
+  ctx->slow_pass = 0;
+  ctx->skipped_slow = 0;
+  if (!grub_device_iterate (iterate_device, ctx) && ctx->skipped_slow)
+    {
+      ctx->slow_pass = 1;
+      grub_device_iterate (iterate_device, ctx);
+    }
+  ctx->scan = 0;
 }
 
 void
@@ -332,7 +422,10 @@ FUNC_NAME (const char *key, const char *var, int no_floppy, int quiet,
     .hints = hints,
     .nhints = nhints,
     .count = 0,
-    .is_cache = 0
+    .is_cache = 0,
+    .scan = 0,
+    .slow_pass = 0,
+    .skipped_slow = 0
   };
   grub_fs_autoload_hook_t saved_autoload;
 
@@ -412,4 +505,14 @@ GRUB_MOD_FINI(search_label)
 #endif
 {
   grub_unregister_command (cmd);
+
+  while (probe_index)
+    {
+      struct probe_entry *ent = probe_index;
+
+      probe_index = ent->next;
+      grub_free (ent->name);
+      grub_free (ent->value);
+      grub_free (ent);
+    }
 }
@@ -0,0 +1,534 @@
+/* videobench.c - time the drawing, image and menu code of the video stack.  */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2020  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/dl.h>
+#include <grub/mm.h>
+#include <grub/misc.h>
+#include <grub/env.h>
+#include <grub/time.h>
+#include <grub/extcmd.h>
+#include <grub/i18n.h>
+#include <grub/video.h>
+#include <grub/video_fb.h>
+#include <grub/bitmap.h>
+#include <grub/bitmap_scale.h>
+#include <grub/font.h>
+#include <grub/gfxmenu_view.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+#define DEFAULT_WIDTH	1024
+#define DEFAULT_HEIGHT	768
+#define DEFAULT_TIME	250
+#define MAX_RESULTS	16
+#define FONT_NAME	"Unknown Regular 16"
+
+static const struct grub_arg_option options[] =
+  {
+    {"size", 's', 0, N_("Size of the screen to draw on."),
+     N_("WIDTHxHEIGHT"), ARG_TYPE_STRING},
+    {"time", 't', 0, N_("Milliseconds to spend on each measurement."),
+     N_("MS"), ARG_TYPE_INT},
+    {"theme", 'T', 0, N_("Compose menu frames with this theme."),
+     N_("FILE"), ARG_TYPE_STRING},
+    {0, 0, 0, 0, 0, 0}
+  };
+
+/* The layouts the framebuffer code has kernels for, named after the blit
+   format they map to, plus the generic path (15-bit) and palette.  */
+static struct
+{
+  const char *name;
+  struct grub_video_mode_info mode_info;
+} formats[] =
+  {
+    { "bgra8888", { GRUB_VIDEO_MI_RGBA8888 () } },
+    { "rgba8888", { GRUB_VIDEO_MI_BGRA8888 () } },
+    { "bgr888", { GRUB_VIDEO_MI_RGB888 () } },
+    { "rgb888", { GRUB_VIDEO_MI_BGR888 () } },
+    { "bgr565", { GRUB_VIDEO_MI_RGB565 () } },
+    { "rgb565", { GRUB_VIDEO_MI_BGR565 () } },
+    { "rgb555", { GRUB_VIDEO_MI_RGB555 () } },
+    { "index8", { .mode_type = GRUB_VIDEO_MODE_TYPE_INDEX_COLOR,
+		  .bpp = 8, .bytes_per_pixel = 1,
+		  .number_of_colors = GRUB_VIDEO_FBSTD_NUMCOLORS } }
+  };
+
+struct result
+{
+  const char *name;
+  unsigned long runs;
+  grub_uint64_t ms;
+  grub_uint64_t pixels;
+};
+
+/* Everything the measured operations work on.  */
+struct bench
+{
+  unsigned width;
+  unsigned height;
+  grub_uint64_t time;
+  grub_video_color_t colors[2];
+  unsigned phase;
+  struct grub_video_bitmap *opaque;
+  struct grub_video_bitmap *alpha;
+  struct grub_video_bitmap *source;
+  struct grub_video_render_target *layer;
+  enum grub_video_bitmap_scale_method scale_method;
+  const char *filename;
+  grub_font_t font;
+  const char *text;
+  grub_gfxmenu_view_t view;
+  struct result results[MAX_RESULTS];
+  unsigned nresults;
+};
+
+typedef void (*bench_func_t) (struct bench *b);
+
+/* Repeat FUNC for at least the configured time and record how many
+   PIXELS per run it got through.  Results are kept to be printed later:
+   while a capture is active the terminal cannot draw.  */
+static void
+measure (struct bench *b, const char *name, bench_func_t func,
+	 grub_uint64_t pixels)
+{
+  struct result *r;
+  grub_uint64_t start, now;
+  unsigned long runs = 0;
+
+  if (b->nresults == MAX_RESULTS)
+    return;
+
+  start = grub_get_time_ms ();
+  do
+    {
+      func (b);
+      runs++;
+      now = grub_get_time_ms ();
+    }
+  while (now - start < b->time && grub_errno == GRUB_ERR_NONE);
+
+  if (grub_errno != GRUB_ERR_NONE)
+    {
+      /* Dropped for now; shown once the results are printed.  */
+      grub_error_push ();
+      return;
+    }
+
+  r = &b->results[b->nresults++];
+  r->name = name;
+  r->runs = runs;
+  r->ms = now - start;
+  r->pixels = pixels;
+}
+
+static void
+print_results (struct bench *b)
+{
+  unsigned i;
+
+  for (i = 0; i < b->nresults; i++)
+    {
+      struct result *r = &b->results[i];
+      grub_uint64_t rate = 0;
+
+      /* Hundredths of a million pixels per second.  */
+      if (r->ms)
+	rate = grub_divmod64 (r->pixels * r->runs, r->ms * 10, 0);
+      grub_printf ("  %-14s %8lu runs %6u ms %6u.%02u MPix/s\n", r->name,
+		   r->runs, (unsigned) r->ms, (unsigned) (rate / 100),
+		   (unsigned) (rate % 100));
+    }
+  b->nresults = 0;
+
+  grub_print_error ();
+}
+
+static void
+bench_fill (struct bench *b)
+{
+  grub_video_fill_rect (b->colors[b->phase++ & 1], 0, 0,
+			b->width, b->height);
+}
+
+static void
+bench_blit (struct bench *b)
+{
+  grub_video_blit_bitmap (b->opaque, GRUB_VIDEO_BLIT_REPLACE, 0, 0, 0, 0,
+			  b->width, b->height);
+}
+
+static void
+bench_blend (struct bench *b)
+{
+  grub_video_blit_bitmap (b->alpha, GRUB_VIDEO_BLIT_BLEND, 0, 0, 0, 0,
+			  b->width, b->height);
+}
+
+static void
+bench_copy_target (struct bench *b)
+{
+  grub_video_blit_render_target (b->layer, GRUB_VIDEO_BLIT_REPLACE, 0, 0,
+				 0, 0, b->width, b->height);
+}
+
+static void
+bench_blend_target (struct bench *b)
+{
+  grub_video_blit_render_target (b->layer, GRUB_VIDEO_BLIT_BLEND, 0, 0,
+				 0, 0, b->width, b->height);
+}
+
+static void
+bench_scroll (struct bench *b)
+{
+  grub_video_scroll (b->colors[0], 0, -16);
+}
+
+static void
+draw_text (struct bench *b)
+{
+  int height = grub_font_get_max_char_height (b->font);
+  int y;
+
+  for (y = grub_font_get_ascent (b->font); y < (int) b->height; y += height)
+    grub_font_draw_string (b->text, b->font, b->colors[b->phase & 1], 0, y);
+  b->phase++;
+}
+
+static void
+bench_text (struct bench *b)
+{
+  draw_text (b);
+}
+
+static void
+bench_text_cold (struct bench *b)
+{
+  grub_font_flush_string_cache ();
+  draw_text (b);
+}
+
+static void
+bench_menu (struct bench *b)
+{
+  grub_gfxmenu_view_redraw (b->view, &b->view->screen);
+  grub_video_swap_buffers ();
+}
+
+static void
+bench_decode (struct bench *b)
+{
+  struct grub_video_bitmap *bitmap;
+
+  if (grub_video_bitmap_load (&bitmap, b->filename) == GRUB_ERR_NONE)
+    grub_video_bitmap_destroy (bitmap);
+}
+
+static void
+bench_scale (struct bench *b)
+{
+  struct grub_video_bitmap *bitmap;
+
+  if (grub_video_bitmap_create_scaled (&bitmap, b->width, b->height,
+				       b->source, b->scale_method)
+      == GRUB_ERR_NONE)
+    grub_video_bitmap_destroy (bitmap);
+}
+
+/* Something to blit that is not uniform: a gradient, with an alpha that
+   varies across the image when the format has one.  */
+static grub_err_t
+make_bitmap (struct grub_video_bitmap **bitmap, unsigned width,
+	     unsigned height, enum grub_video_blit_format format)
+{
+  unsigned x, y, bpp;
+  grub_err_t err;
+
+  err = grub_video_bitmap_create (bitmap, width, height, format);
+  if (err)
+    return err;
+
+  bpp = (*bitmap)->mode_info.bytes_per_pixel;
+  for (y = 0; y < height; y++)
+    {
+      grub_uint8_t *p = (grub_uint8_t *) (*bitmap)->data
+	+ y * (*bitmap)->mode_info.pitch;
+
+      for (x = 0; x < width; x++, p += bpp)
+	{
+	  p[0] = x * 255 / width;
+	  p[1] = y * 255 / height;
+	  p[2] = (x + y) & 0xff;
+	  if (bpp == 4)
+	    p[3] = (x * 7 + y * 3) & 0xff;
+	}
+    }
+
+  return GRUB_ERR_NONE;
+}
+
+static void
+measure_images (struct bench *b, int argc, char **args)
+{
+  static const struct
+  {
+    const char *name;
+    enum grub_video_bitmap_scale_method method;
+  } methods[] =
+    {
+      { "scale-nearest", GRUB_VIDEO_BITMAP_SCALE_METHOD_NEAREST },
+      { "scale-bilinear", GRUB_VIDEO_BITMAP_SCALE_METHOD_BILINEAR },
+      { "scale-box", GRUB_VIDEO_BITMAP_SCALE_METHOD_BOX },
+      { "scale-lanczos", GRUB_VIDEO_BITMAP_SCALE_METHOD_LANCZOS }
+    };
+  struct grub_video_bitmap *bitmap;
+  unsigned i;
+  int j;
+
+  for (j = 0; j < argc; j++)
+    {
+      if (grub_video_bitmap_load (&bitmap, args[j]) != GRUB_ERR_NONE)
+	{
+	  grub_print_error ();
+	  continue;
+	}
+
+      grub_printf ("%s %ux%u:\n", args[j], bitmap->mode_info.width,
+		   bitmap->mode_info.height);
+      b->filename = args[j];
+      measure (b, "decode", bench_decode, (grub_uint64_t)
+	       bitmap->mode_info.width * bitmap->mode_info.height);
+      print_results (b);
+
+      /* Scale the first image that can be read.  */
+      if (!b->source)
+	b->source = bitmap;
+      else
+	grub_video_bitmap_destroy (bitmap);
+    }
+
+  if (!b->source && make_bitmap (&b->source, 640, 480,
+				 GRUB_VIDEO_BLIT_FORMAT_RGBA_8888))
+    {
+      grub_print_error ();
+      return;
+    }
+
+  grub_printf ("scale %ux%u to %ux%u:\n", b->source->mode_info.width,
+	       b->source->mode_info.height, b->width, b->height);
+  for (i = 0; i < ARRAY_SIZE (methods); i++)
+    {
+      b->scale_method = methods[i].method;
+      measure (b, methods[i].name, bench_scale,
+	       (grub_uint64_t) b->width * b->height);
+    }
+  print_results (b);
+}
+
+/* Compose the menu of THEME as the menu code would, then time redrawing
+   all of it.  */
+static void
+measure_menu (struct bench *b, const char *theme)
+{
+  static struct grub_menu empty_menu;
+  grub_menu_t menu;
+
+  b->view = grub_gfxmenu_view_new (theme, b->width, b->height);
+  if (!b->view)
+    return;
+
+  menu = grub_env_get_menu () ? : &empty_menu;
+  b->view->double_repaint = 0;
+  b->view->selected = 0;
+  b->view->menu = menu;
+  b->view->nested = 0;
+  b->view->first_timeout = -1;
+  b->view->menu_title_offset = 0;
+  if (menu->size)
+    b->view->menu_title_offset
+      = grub_zalloc (sizeof (*b->view->menu_title_offset) * menu->size);
+
+  if (!menu->size || b->view->menu_title_offset)
+    {
+      grub_gfxmenu_view_compose (b->view);
+      measure (b, "menu", bench_menu, (grub_uint64_t) b->width * b->height);
+    }
+
+  grub_gfxmenu_view_destroy (b->view);
+  b->view = 0;
+}
+
+static void
+measure_format (struct bench *b, const char *theme)
+{
+  grub_uint64_t pixels = (grub_uint64_t) b->width * b->height;
+  grub_uint64_t text_pixels;
+  unsigned text_width;
+  int rows;
+
+  b->colors[0] = grub_video_map_rgb (0x20, 0x40, 0x80);
+  b->colors[1] = grub_video_map_rgb (0xe0, 0xc0, 0xa0);
+
+  measure (b, "fill", bench_fill, pixels);
+  measure (b, "blit-rgb", bench_blit, pixels);
+  measure (b, "blend-rgba", bench_blend, pixels);
+
+  /* What gfxterm does: an offscreen layer put on the screen.  */
+  if (grub_video_create_render_target (&b->layer, b->width, b->height,
+				       GRUB_VIDEO_MODE_TYPE_RGB
+				       | GRUB_VIDEO_MODE_TYPE_ALPHA)
+      == GRUB_ERR_NONE)
+    {
+      grub_video_set_active_render_target (b->layer);
+      grub_video_fill_rect (grub_video_map_rgba (0x10, 0x20, 0x30, 0x80),
+			    0, 0, b->width, b->height);
+      grub_video_fill_rect (grub_video_map_rgba (0, 0, 0, 0), b->width / 4,
+			    b->height / 4, b->width / 2, b->height / 2);
+      grub_video_set_active_render_target (GRUB_VIDEO_RENDER_TARGET_DISPLAY);
+
+      measure (b, "copy-target", bench_copy_target, pixels);
+      measure (b, "blend-target", bench_blend_target, pixels);
+
+      grub_video_delete_render_target (b->layer);
+      b->layer = 0;
+    }
+  else
+    /* Shown with the results, like the errors of the measurements.  */
+    grub_error_push ();
+
+  measure (b, "scroll", bench_scroll, pixels);
+
+  /* Count the area of the lines of text that is on the screen.  */
+  rows = (b->height - grub_font_get_ascent (b->font))
+    / grub_font_get_max_char_height (b->font) + 1;
+  text_width = grub_min ((unsigned) grub_font_get_string_width (b->font,
+								  b->text),
+			 b->width);
+  text_pixels = (grub_uint64_t) text_width
+    * grub_font_get_max_char_height (b->font) * rows;
+  measure (b, "text", bench_text, text_pixels);
+  measure (b, "text-uncached", bench_text_cold, text_pixels);
+
+  if (theme)
+    measure_menu (b, theme);
+}
+
+static grub_err_t
+grub_cmd_videobench (grub_extcmd_context_t ctxt, int argc, char **args)
+{
+  struct grub_arg_list *state = ctxt->state;
+  struct bench *b;
+  const char *theme = 0;
+  char *full_theme = 0;
+  unsigned i;
+
+  b = grub_zalloc (sizeof (*b));
+  if (!b)
+    return grub_errno;
+
+  b->width = DEFAULT_WIDTH;
+  b->height = DEFAULT_HEIGHT;
+  b->time = DEFAULT_TIME;
+  b->text = "The quick brown fox jumps over the lazy dog 0123456789";
+
+  if (state[0].set)
+    {
+      char *end;
+
+      b->width = grub_strtoul (state[0].arg, &end, 0);
+      if (grub_errno == GRUB_ERR_NONE && *end == 'x')
+	b->height = grub_strtoul (end + 1, &end, 0);
+      if (grub_errno == GRUB_ERR_NONE && *end != '\0')
+	grub_error (GRUB_ERR_BAD_ARGUMENT,
+		    N_("invalid video mode specification `%s'"),
+		    state[0].arg);
+    }
+  if (state[1].set)
+    b->time = grub_strtoul (state[1].arg, 0, 0);
+  if (grub_errno)
+    goto quit;
+  if (b->width == 0 || b->height == 0 || b->time == 0)
+    {
+      grub_error (GRUB_ERR_BAD_ARGUMENT, N_("invalid argument"));
+      goto quit;
+    }
+
+  theme = state[2].set ? state[2].arg : grub_env_get ("theme");
+  if (theme && theme[0] != '/' && theme[0] != '(')
+    {
+      full_theme = grub_xasprintf ("%s/themes/%s", grub_env_get ("prefix"),
+				   theme);
+      if (!full_theme)
+	goto quit;
+      theme = full_theme;
+    }
+
+  b->font = grub_font_get (FONT_NAME);
+
+  measure_images (b, argc, args);
+
+  if (make_bitmap (&b->opaque, b->width, b->height,
+		   GRUB_VIDEO_BLIT_FORMAT_RGB_888)
+      || make_bitmap (&b->alpha, b->width, b->height,
+		      GRUB_VIDEO_BLIT_FORMAT_RGBA_8888))
+    goto quit;
+
+  for (i = 0; i < ARRAY_SIZE (formats); i++)
+    {
+      struct grub_video_mode_info mode_info = formats[i].mode_info;
+
+      mode_info.width = b->width;
+      mode_info.height = b->height;
+      mode_info.pitch = b->width * mode_info.bytes_per_pixel;
+
+      if (grub_video_capture_start (&mode_info, grub_video_fbstd_colors,
+				    mode_info.number_of_colors))
+	break;
+      measure_format (b, theme);
+      grub_video_capture_end ();
+
+      grub_printf ("%s %ux%u:\n", formats[i].name, b->width, b->height);
+      print_results (b);
+    }
+
+ quit:
+  grub_video_bitmap_destroy (b->opaque);
+  grub_video_bitmap_destroy (b->alpha);
+  grub_video_bitmap_destroy (b->source);
+  grub_free (full_theme);
+  grub_free (b);
+  return grub_errno;
+}
+
+static grub_extcmd_t cmd;
+
+GRUB_MOD_INIT(videobench)
+{
+  cmd = grub_register_extcmd ("videobench", grub_cmd_videobench, 0,
+			      N_("[-s WIDTHxHEIGHT] [-t MS] [-T THEME] [FILE...]"),
+			      N_("Time drawing, image decoding and scaling "
+				 "and menu composition."),
+			      options);
+}
+
+GRUB_MOD_FINI(videobench)
+{
+  grub_unregister_extcmd (cmd);
+}
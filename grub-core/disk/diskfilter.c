@@ -24,6 +24,7 @@
 #include <grub/misc.h>
 #include <grub/diskfilter.h>
 #include <grub/partition.h>
+#include <grub/crypto.h>
 #ifdef GRUB_UTIL
 #include <grub/i18n.h>
 #include <grub/util/misc.h>
@@ -43,6 +44,135 @@ static struct grub_diskfilter_lv *
 find_lv (const char *name);
 static int is_lv_readable (struct grub_diskfilter_lv *lv, int easily);
 
+/* Parity arithmetic shared by the RAID recovery modules.  Blocks are
+   processed a machine word at a time, every byte of a word being an
+   independent element of GF(2^8) modulo x^8 + x^4 + x^3 + x^2 + 1.  */
+
+#define GF_WORD_ALIGNED(p) (((grub_addr_t) (p) & (sizeof (grub_uint64_t) - 1)) == 0)
+
+/* Multiply every byte of V by x.  */
+static inline grub_uint64_t
+gf_mulx_word (grub_uint64_t v)
+{
+  grub_uint64_t carry = (v >> 7) & 0x0101010101010101ULL;
+
+  return ((v << 1) & 0xfefefefefefefefeULL) ^ (carry * 0x1d);
+}
+
+/* Multiply every byte of V by MUL.  */
+static inline grub_uint64_t
+gf_mul_word (grub_uint64_t v, grub_uint8_t mul)
+{
+  grub_uint64_t r = 0;
+
+  for (;;)
+    {
+      if (mul & 1)
+	r ^= v;
+      mul >>= 1;
+      if (!mul)
+	return r;
+      v = gf_mulx_word (v);
+    }
+}
+
+void
+grub_raid_block_xor (void *dst, const void *src, grub_size_t size)
+{
+  grub_uint8_t *d = dst;
+  const grub_uint8_t *s = src;
+
+  if (((grub_addr_t) d ^ (grub_addr_t) s) & (sizeof (grub_uint64_t) - 1))
+    {
+      grub_crypto_xor (d, d, s, size);
+      return;
+    }
+
+  for (; size && !GF_WORD_ALIGNED (d); size--)
+    *d++ ^= *s++;
+
+  for (; size >= 4 * sizeof (grub_uint64_t); size -= 4 * sizeof (grub_uint64_t))
+    {
+      grub_uint64_t *dw = (grub_uint64_t *) (void *) d;
+      const grub_uint64_t *sw = (const grub_uint64_t *) (const void *) s;
+
+      dw[0] ^= sw[0];
+      dw[1] ^= sw[1];
+      dw[2] ^= sw[2];
+      dw[3] ^= sw[3];
+      d += 4 * sizeof (grub_uint64_t);
+      s += 4 * sizeof (grub_uint64_t);
+    }
+
+  for (; size; size--)
+    *d++ ^= *s++;
+}
+
+void
+grub_raid_block_mul (grub_uint8_t mul, void *buf, grub_size_t size)
+{
+  grub_uint8_t *p = buf;
+
+  if (mul == 1)
+    return;
+  if (mul == 0)
+    {
+      grub_memset (buf, 0, size);
+      return;
+    }
+
+  for (; size && !GF_WORD_ALIGNED (p); size--, p++)
+    *p = gf_mul_word (*p, mul);
+
+  for (; size >= sizeof (grub_uint64_t); size -= sizeof (grub_uint64_t))
+    {
+      grub_uint64_t *w = (grub_uint64_t *) (void *) p;
+
+      *w = gf_mul_word (*w, mul);
+      p += sizeof (grub_uint64_t);
+    }
+
+  for (; size; size--, p++)
+    *p = gf_mul_word (*p, mul);
+}
+
+void
+grub_raid_block_mul_xor (grub_uint8_t mul, void *dst, const void *src,
+			 grub_size_t size)
+{
+  grub_uint8_t *d = dst;
+  const grub_uint8_t *s = src;
+
+  if (mul == 0)
+    return;
+  if (mul == 1)
+    {
+      grub_raid_block_xor (dst, src, size);
+      return;
+    }
+
+  if (((grub_addr_t) d ^ (grub_addr_t) s) & (sizeof (grub_uint64_t) - 1))
+    {
+      for (; size; size--)
+	*d++ ^= gf_mul_word (*s++, mul);
+      return;
+    }
+
+  for (; size && !GF_WORD_ALIGNED (d); size--)
+    *d++ ^= gf_mul_word (*s++, mul);
+
+  for (; size >= sizeof (grub_uint64_t); size -= sizeof (grub_uint64_t))
+    {
+      *(grub_uint64_t *) (void *) d
+	^= gf_mul_word (*(const grub_uint64_t *) (const void *) s, mul);
+      d += sizeof (grub_uint64_t);
+      s += sizeof (grub_uint64_t);
+    }
+
+  for (; size; size--)
+    *d++ ^= gf_mul_word (*s++, mul);
+}
+
 
 
 static grub_err_t
@@ -575,6 +705,71 @@ validate_segment (struct grub_diskfilter_segment *seg)
 
 }
 
+/* Reads spanning several stripes of striped segments are done with one
+   read of up to this many sectors per node.  */
+#define STRIPED_READ_MAX	2048
+
+/* Read SIZE sectors at SECTOR of the striped segment SEG, reading all the
+   stripes each node holds in one go.  Return the number of sectors read,
+   which is less than SIZE if it is large, or 0 on error.  */
+static grub_size_t
+read_striped (struct grub_diskfilter_segment *seg, grub_disk_addr_t sector,
+	      grub_size_t size, char *buf)
+{
+  grub_uint64_t n = seg->node_count, stripe_size = seg->stripe_size;
+  grub_uint64_t first, last, first_ofs, last_end, g;
+  char *tmp;
+
+  if (size > n * STRIPED_READ_MAX)
+    size = n * STRIPED_READ_MAX;
+
+  first = grub_divmod64 (sector, stripe_size, &first_ofs);
+  last = grub_divmod64 (sector + size - 1, stripe_size, &last_end);
+  last_end++;
+
+  tmp = grub_malloc (((grub_divmod64 (last - first, n, NULL) + 1)
+		      * stripe_size) << GRUB_DISK_SECTOR_BITS);
+  if (!tmp)
+    return 0;
+
+  for (g = 0; g < n && first + g <= last; g++)
+    {
+      grub_uint64_t s0 = first + g, s1, s, row0, row1, disknr;
+      grub_uint64_t start, end;
+
+      row0 = grub_divmod64 (s0, n, &disknr);
+      s1 = s0 + grub_divmod64 (last - s0, n, NULL) * n;
+      row1 = grub_divmod64 (s1, n, NULL);
+      start = (s0 == first) ? first_ofs : 0;
+      end = (s1 == last) ? last_end : stripe_size;
+
+      if (grub_diskfilter_read_node (&seg->nodes[disknr],
+				     row0 * stripe_size + start,
+				     (row1 - row0) * stripe_size + end - start,
+				     tmp))
+	{
+	  grub_free (tmp);
+	  return 0;
+	}
+
+      for (s = s0; s <= s1; s += n)
+	{
+	  grub_uint64_t a = (s == first) ? first_ofs : 0;
+	  grub_uint64_t b = (s == last) ? last_end : stripe_size;
+	  grub_uint64_t row = grub_divmod64 (s, n, NULL);
+
+	  grub_memcpy (buf + ((s * stripe_size + a - sector)
+			      << GRUB_DISK_SECTOR_BITS),
+		       tmp + (((row - row0) * stripe_size + a - start)
+			      << GRUB_DISK_SECTOR_BITS),
+		       (b - a) << GRUB_DISK_SECTOR_BITS);
+	}
+    }
+
+  grub_free (tmp);
+  return size;
+}
+
 static grub_err_t
 read_segment (struct grub_diskfilter_segment *seg, grub_disk_addr_t sector,
 	      grub_size_t size, char *buf)
@@ -586,6 +781,28 @@ read_segment (struct grub_diskfilter_segment *seg, grub_disk_addr_t sector,
       if (seg->node_count == 1)
 	return grub_diskfilter_read_node (&seg->nodes[0],
 					  sector, size, buf);
+
+      /* Read whole rows of stripes with one read per node.  */
+      while (seg->stripe_size
+	     && grub_divmod64 (sector, seg->stripe_size, NULL)
+	     + seg->node_count
+	     <= grub_divmod64 (sector + size - 1, seg->stripe_size, NULL))
+	{
+	  grub_size_t done = read_striped (seg, sector, size, buf);
+
+	  if (!done)
+	    {
+	      if (grub_errno != GRUB_ERR_OUT_OF_MEMORY)
+		return grub_errno;
+	      grub_errno = GRUB_ERR_NONE;
+	      break;
+	    }
+	  sector += done;
+	  size -= done;
+	  buf += done << GRUB_DISK_SECTOR_BITS;
+	}
+      if (!size)
+	return GRUB_ERR_NONE;
       /* Fallthrough.  */
     case GRUB_DISKFILTER_MIRROR:
     case GRUB_DISKFILTER_RAID10:
@@ -851,13 +1068,190 @@ read_segment (struct grub_diskfilter_segment *seg, grub_disk_addr_t sector,
     }
 }
 
+/* Maps of logical volumes are rebuilt when this changes, i.e. whenever a
+   physical volume is found or an array grows.  */
+static unsigned int map_generation = 1;
+
+/* Limit on LVs stacked on LVs that are flattened into one map.  */
+#define MAP_MAX_DEPTH 8
+
+struct extent_vec
+{
+  struct grub_diskfilter_extent *e;
+  unsigned int count;
+  unsigned int alloc;
+};
+
 static grub_err_t
-read_lv (struct grub_diskfilter_lv *lv, grub_disk_addr_t sector,
-	 grub_size_t size, char *buf)
+build_extent_map (struct grub_diskfilter_lv *lv, int depth);
+
+static grub_err_t
+map_append (struct extent_vec *v, grub_disk_addr_t start,
+	    grub_disk_addr_t length, struct grub_diskfilter_pv *pv,
+	    struct grub_diskfilter_segment *seg, grub_disk_addr_t offset)
 {
-  if (!lv)
-    return grub_error (GRUB_ERR_UNKNOWN_DEVICE, "unknown volume");
+  struct grub_diskfilter_extent *e;
+
+  if (!length)
+    return GRUB_ERR_NONE;
+
+  if (v->count == v->alloc)
+    {
+      unsigned int alloc = v->alloc ? 2 * v->alloc : 8;
+
+      e = grub_realloc (v->e, alloc * sizeof (v->e[0]));
+      if (!e)
+	return grub_errno;
+      v->e = e;
+      v->alloc = alloc;
+    }
+  e = &v->e[v->count++];
+  e->start = start;
+  e->length = length;
+  e->pv = pv;
+  e->seg = seg;
+  e->offset = offset;
+  return GRUB_ERR_NONE;
+}
+
+/* Map LENGTH sectors of LV starting at START, backed by sectors from
+   OFFSET on in SEG.  A linear segment is resolved down to the physical
+   volume, through logical volumes it is stacked on if needed.  */
+static grub_err_t
+map_segment (struct extent_vec *v, struct grub_diskfilter_segment *seg,
+	     grub_disk_addr_t start, grub_disk_addr_t length,
+	     grub_disk_addr_t offset, int depth)
+{
+  struct grub_diskfilter_node *node = &seg->nodes[0];
+  struct grub_diskfilter_lv *sub;
+  grub_disk_addr_t pos, end;
+  unsigned int i;
+
+  if (seg->type != GRUB_DISKFILTER_STRIPED || seg->node_count != 1)
+    return map_append (v, start, length, NULL, seg, offset);
+
+  if (node->pv)
+    return map_append (v, start, length, node->pv, NULL,
+		       node->start + offset);
+
+  sub = node->lv;
+  if (!sub || depth >= MAP_MAX_DEPTH
+      || build_extent_map (sub, depth + 1) != GRUB_ERR_NONE)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return map_append (v, start, length, NULL, seg, offset);
+    }
+
+  /* Copy the part of the map of SUB we cover.  */
+  pos = node->start + offset;
+  end = pos + length;
+  for (i = 0; i < sub->extent_map_count && pos < end; i++)
+    {
+      struct grub_diskfilter_extent *e = &sub->extents[i];
+      grub_disk_addr_t len, skip;
+      grub_err_t err;
+
+      if (e->start + e->length <= pos)
+	continue;
+      if (e->start > pos)
+	break;
+      skip = pos - e->start;
+      len = e->length - skip;
+      if (len > end - pos)
+	len = end - pos;
+      err = map_append (v, start + (pos - node->start - offset), len,
+			e->pv, e->seg, e->offset + skip);
+      if (err)
+	return err;
+      pos += len;
+    }
+
+  /* Whatever SUB does not cover fails when read, as before.  */
+  return map_append (v, start + (pos - node->start - offset), end - pos,
+		     NULL, seg, pos - node->start);
+}
+
+static grub_err_t
+build_extent_map (struct grub_diskfilter_lv *lv, int depth)
+{
+  struct extent_vec v = { NULL, 0, 0 };
+  grub_uint64_t extent_size;
+  unsigned int i, j;
+
+  if (lv->extent_map_generation == map_generation)
+    return GRUB_ERR_NONE;
+
+  if (!lv->vg || !lv->vg->extent_size)
+    return grub_error (GRUB_ERR_READ_ERROR, "invalid volume");
+  extent_size = lv->vg->extent_size;
+
+  for (i = 0; i < lv->segment_count; i++)
+    {
+      struct grub_diskfilter_segment *seg = &lv->segments[i];
+
+      if (map_segment (&v, seg, seg->start_extent * extent_size,
+		       seg->extent_count * extent_size, 0, depth))
+	{
+	  grub_free (v.e);
+	  return grub_errno;
+	}
+    }
+
+  /* Sort by start, segments are normally in order already.  */
+  for (i = 1; i < v.count; i++)
+    {
+      struct grub_diskfilter_extent t = v.e[i];
+
+      for (j = i; j > 0 && v.e[j - 1].start > t.start; j--)
+	v.e[j] = v.e[j - 1];
+      v.e[j] = t;
+    }
+
+  /* Merge runs which are contiguous on both sides.  */
+  for (i = 0, j = 0; i < v.count; i++)
+    {
+      struct grub_diskfilter_extent *prev = j ? &v.e[j - 1] : NULL;
+
+      if (prev && prev->pv == v.e[i].pv && prev->seg == v.e[i].seg
+	  && prev->start + prev->length == v.e[i].start
+	  && prev->offset + prev->length == v.e[i].offset)
+	prev->length += v.e[i].length;
+      else
+	v.e[j++] = v.e[i];
+    }
+
+  grub_free (lv->extents);
+  lv->extents = v.e;
+  lv->extent_map_count = j;
+  lv->extent_map_generation = map_generation;
+  return GRUB_ERR_NONE;
+}
+
+/* Find the extent containing SECTOR.  */
+static struct grub_diskfilter_extent *
+find_extent (struct grub_diskfilter_lv *lv, grub_disk_addr_t sector)
+{
+  unsigned int lo = 0, hi = lv->extent_map_count;
+
+  while (lo < hi)
+    {
+      unsigned int mid = (lo + hi) / 2;
+      struct grub_diskfilter_extent *e = &lv->extents[mid];
 
+      if (sector < e->start)
+	hi = mid;
+      else if (sector >= e->start + e->length)
+	lo = mid + 1;
+      else
+	return e;
+    }
+  return NULL;
+}
+
+static grub_err_t
+read_lv_segments (struct grub_diskfilter_lv *lv, grub_disk_addr_t sector,
+		  grub_size_t size, char *buf)
+{
   while (size)
     {
       grub_err_t err = 0;
@@ -898,6 +1292,63 @@ read_lv (struct grub_diskfilter_lv *lv, grub_disk_addr_t sector,
   return GRUB_ERR_NONE;
 }
 
+static grub_err_t
+read_lv (struct grub_diskfilter_lv *lv, grub_disk_addr_t sector,
+	 grub_size_t size, char *buf)
+{
+  struct grub_diskfilter_extent *e, *end;
+
+  if (!lv)
+    return grub_error (GRUB_ERR_UNKNOWN_DEVICE, "unknown volume");
+
+  if (build_extent_map (lv, 0) != GRUB_ERR_NONE)
+    {
+      if (grub_errno != GRUB_ERR_OUT_OF_MEMORY)
+	return grub_errno;
+      grub_errno = GRUB_ERR_NONE;
+      return read_lv_segments (lv, sector, size, buf);
+    }
+
+  e = find_extent (lv, sector);
+  end = lv->extents + lv->extent_map_count;
+  while (size)
+    {
+      grub_uint64_t to_read;
+      grub_err_t err;
+
+      if (!e || e == end || sector < e->start
+	  || sector >= e->start + e->length)
+	return grub_error (GRUB_ERR_READ_ERROR, "incorrect segment");
+
+      to_read = e->start + e->length - sector;
+      if (to_read > size)
+	to_read = size;
+
+      if (e->pv)
+	{
+	  /* A linear run: one transfer straight from the physical disk.  */
+	  if (!e->pv->disk)
+	    return grub_error (GRUB_ERR_UNKNOWN_DEVICE,
+			       N_("physical volume %s not found"),
+			       e->pv->name);
+	  err = grub_disk_read (e->pv->disk, e->offset + (sector - e->start)
+				+ e->pv->start_sector, 0,
+				to_read << GRUB_DISK_SECTOR_BITS, buf);
+	}
+      else
+	err = read_segment (e->seg, e->offset + (sector - e->start),
+			    to_read, buf);
+      if (err)
+	return err;
+
+      size -= to_read;
+      sector += to_read;
+      buf += to_read << GRUB_DISK_SECTOR_BITS;
+      e++;
+    }
+  return GRUB_ERR_NONE;
+}
+
 static grub_err_t
 grub_diskfilter_read (grub_disk_t disk, grub_disk_addr_t sector,
 		      grub_size_t size, char *buf)
@@ -939,6 +1390,8 @@ grub_diskfilter_vg_register (struct grub_diskfilter_vg *vg)
   grub_util_info ("Found array %s", vg->name);
 #endif
 
+  map_generation++;
+
   for (lv = vg->lvs; lv; lv = lv->next)
     {
       grub_err_t err;
@@ -1065,6 +1518,7 @@ grub_diskfilter_make_raid (grub_size_t uuidlen, char *uuid, int nmemb,
       if (array->lvs && array->lvs->segments
 	  && array->lvs->segments->raid_member_size > disk_size)
 	array->lvs->segments->raid_member_size = disk_size;
+      map_generation++;
 
       grub_free (uuid);
       return array;
@@ -1236,6 +1690,7 @@ insert_array (grub_disk_t disk, const struct grub_diskfilter_pv_id *id,
 	if (start_sector != (grub_uint64_t)-1)
 	  pv->start_sector = start_sector;
 	pv->start_sector += pv->part_start;
+	map_generation++;
 	/* Add the device to the array. */
 	for (lv = array->lvs; lv; lv = lv->next)
 	  if (!lv->became_readable_at && lv->fullname && is_lv_readable (lv, 0))
@@ -1284,6 +1739,7 @@ free_array (void)
 	    grub_free (lv->segments[i].nodes);
 	  grub_free (lv->segments);
 	  grub_free (lv->internal_id);
+	  grub_free (lv->extents);
 	  grub_free (lv);
 	}
 
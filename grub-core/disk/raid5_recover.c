@@ -23,7 +23,6 @@
 #include <grub/err.h>
 #include <grub/misc.h>
 #include <grub/diskfilter.h>
-#include <grub/crypto.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -57,7 +56,7 @@ grub_raid5_recover (struct grub_diskfilter_segment *array, int disknr,
           return err;
         }
 
-      grub_crypto_xor (buf, buf, buf2, size);
+      grub_raid_block_xor (buf, buf2, size);
     }
 
   grub_free (buf2);
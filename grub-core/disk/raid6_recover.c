@@ -23,7 +23,6 @@
 #include <grub/err.h>
 #include <grub/misc.h>
 #include <grub/diskfilter.h>
-#include <grub/crypto.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -33,18 +32,6 @@ static grub_uint8_t powx[255 * 2];
 static unsigned powx_inv[256];
 static const grub_uint8_t poly = 0x1d;
 
-static void
-grub_raid_block_mulx (unsigned mul, char *buf, grub_size_t size)
-{
-  grub_size_t i;
-  grub_uint8_t *p;
-
-  p = (grub_uint8_t *) buf;
-  for (i = 0; i < size; i++, p++)
-    if (*p)
-      *p = powx[mul + powx_inv[*p]];
-}
-
 static void
 grub_raid6_init_table (void)
 {
@@ -123,9 +110,8 @@ grub_raid6_recover_gen (void *data, grub_uint64_t nstripes, int disknr, int p,
         {
 	  if (!read_func (data, pos, sector, buf, size))
             {
-              grub_crypto_xor (pbuf, pbuf, buf, size);
-              grub_raid_block_mulx (c, buf, size);
-              grub_crypto_xor (qbuf, qbuf, buf, size);
+              grub_raid_block_xor (pbuf, buf, size);
+              grub_raid_block_mul_xor (powx[c % 255], qbuf, buf, size);
             }
           else
             {
@@ -152,7 +138,7 @@ grub_raid6_recover_gen (void *data, grub_uint64_t nstripes, int disknr, int p,
       /* One bad device */
       if (!read_func (data, p, sector, buf, size))
         {
-          grub_crypto_xor (buf, buf, pbuf, size);
+          grub_raid_block_xor (buf, pbuf, size);
           goto quit;
         }
 
@@ -160,9 +146,8 @@ grub_raid6_recover_gen (void *data, grub_uint64_t nstripes, int disknr, int p,
       if (read_func (data, q, sector, buf, size))
         goto quit;
 
-      grub_crypto_xor (buf, buf, qbuf, size);
-      grub_raid_block_mulx (255 - bad1, buf,
-                           size);
+      grub_raid_block_xor (buf, qbuf, size);
+      grub_raid_block_mul (powx[255 - bad1], buf, size);
     }
   else
     {
@@ -172,22 +157,20 @@ grub_raid6_recover_gen (void *data, grub_uint64_t nstripes, int disknr, int p,
       if (read_func (data, p, sector, buf, size))
         goto quit;
 
-      grub_crypto_xor (pbuf, pbuf, buf, size);
+      grub_raid_block_xor (pbuf, buf, size);
 
       if (read_func (data, q, sector, buf, size))
         goto quit;
 
-      grub_crypto_xor (qbuf, qbuf, buf, size);
+      grub_raid_block_xor (qbuf, buf, size);
 
       c = mod_255((255 ^ bad1)
 		  + (255 ^ powx_inv[(powx[bad2 + (bad1 ^ 255)] ^ 1)]));
-      grub_raid_block_mulx (c, qbuf, size);
+      grub_raid_block_mul (powx[c], qbuf, size);
 
       c = mod_255((unsigned) bad2 + c);
-      grub_raid_block_mulx (c, pbuf, size);
-
-      grub_crypto_xor (pbuf, pbuf, qbuf, size);
-      grub_memcpy (buf, pbuf, size);
+      grub_memcpy (buf, qbuf, size);
+      grub_raid_block_mul_xor (powx[c], buf, pbuf, size);
     }
 
 quit:
@@ -59,6 +59,18 @@ GRUB_MOD_LICENSE ("GPLv3+");
 #define ZSTD_BTRFS_MAX_WINDOWLOG 17
 #define ZSTD_BTRFS_MAX_INPUT     (1 << ZSTD_BTRFS_MAX_WINDOWLOG)
 
+/* Number of tree nodes kept in memory.  */
+#define GRUB_BTRFS_NODE_CACHE_SIZE 64
+
+/* Compressed extents are decompressed at once, and kept for the following
+   reads, if they are at most this large uncompressed.  Btrfs itself does
+   not create larger ones.  */
+#define GRUB_BTRFS_MAX_DECOMPRESSED (128 * 1024)
+
+/* Reads spanning several stripes of RAID0 and RAID10 chunks are done with
+   one read of up to this many bytes per device.  */
+#define GRUB_BTRFS_STRIPED_READ_MAX (1024 * 1024)
+
 typedef grub_uint8_t grub_btrfs_checksum_t[0x20];
 typedef grub_uint16_t grub_btrfs_uuid_t[8];
 
@@ -80,7 +92,12 @@ struct grub_btrfs_superblock
   grub_uint64_t chunk_tree;
   grub_uint8_t dummy2[0x20];
   grub_uint64_t root_dir_objectid;
-  grub_uint8_t dummy3[0x41];
+  grub_uint64_t num_devices;
+  grub_uint32_t sectorsize;
+  grub_uint32_t nodesize;
+  grub_uint32_t leafsize;
+  grub_uint32_t stripesize;
+  grub_uint8_t dummy3[0x29];
   struct grub_btrfs_device this_device;
   char label[0x100];
   grub_uint8_t dummy4[0x100];
@@ -103,6 +120,14 @@ struct grub_btrfs_device_desc
   grub_uint64_t id;
 };
 
+/* A chunk mapped by grub_btrfs_read_logical.  */
+struct grub_btrfs_chunk_map
+{
+  grub_uint64_t start;
+  grub_uint64_t size;
+  struct grub_btrfs_chunk_item *chunk;
+};
+
 struct grub_btrfs_data
 {
   struct grub_btrfs_superblock sblock;
@@ -113,6 +138,11 @@ struct grub_btrfs_data
   unsigned n_devices_attached;
   unsigned n_devices_allocated;
 
+  /* Chunks looked up so far, sorted by logical address.  */
+  struct grub_btrfs_chunk_map *chunks;
+  unsigned n_chunks;
+  unsigned n_chunks_allocated;
+
   /* Cached extent data.  */
   grub_uint64_t extstart;
   grub_uint64_t extend;
@@ -120,6 +150,10 @@ struct grub_btrfs_data
   grub_uint64_t exttree;
   grub_size_t extsize;
   struct grub_btrfs_extent_data *extent;
+  /* The decompressed data of a compressed extent, from extstart to
+     extend, or NULL.  */
+  char *extdata;
+  int extdata_failed;
 };
 
 struct grub_btrfs_chunk_item
@@ -321,6 +355,190 @@ check_btrfs_header (struct grub_btrfs_data *data, struct btrfs_header *header,
   return GRUB_ERR_NONE;
 }
 
+/* Tree nodes read recently, of all mounted filesystems.  */
+struct grub_btrfs_node_cache_entry
+{
+  grub_btrfs_uuid_t uuid;
+  grub_uint64_t generation;
+  grub_disk_addr_t addr;
+  grub_uint32_t size;
+  grub_uint64_t last_use;
+  grub_uint8_t *node;
+};
+
+static struct grub_btrfs_node_cache_entry node_cache[GRUB_BTRFS_NODE_CACHE_SIZE];
+static grub_uint64_t node_cache_clock;
+static grub_uint32_t node_cache_disk_generation;
+
+static void
+node_cache_flush (void)
+{
+  unsigned i;
+
+  for (i = 0; i < ARRAY_SIZE (node_cache); i++)
+    {
+      grub_free (node_cache[i].node);
+      node_cache[i].node = NULL;
+    }
+}
+
+/* Read SIZE bytes at ADDR from the tree node at NODE_ADDR, keeping the
+   whole node in the node cache.  */
+static grub_err_t
+read_tree_node (struct grub_btrfs_data *data, grub_disk_addr_t node_addr,
+		grub_disk_addr_t addr, void *buf, grub_size_t size,
+		int recursion_depth)
+{
+  grub_uint32_t nodesize = grub_le_to_cpu32 (data->sblock.nodesize);
+  struct grub_btrfs_node_cache_entry *ent, *victim = NULL;
+  struct btrfs_header *head;
+  grub_uint8_t *node;
+  grub_err_t err;
+  unsigned i;
+
+  if (nodesize < 4096 || nodesize > 65536 || (nodesize & (nodesize - 1))
+      || addr < node_addr || addr - node_addr + size > nodesize)
+    return grub_btrfs_read_logical (data, addr, buf, size, recursion_depth);
+
+  if (node_cache_disk_generation != grub_disk_cache_generation)
+    {
+      node_cache_flush ();
+      node_cache_disk_generation = grub_disk_cache_generation;
+    }
+
+  for (i = 0; i < ARRAY_SIZE (node_cache); i++)
+    {
+      ent = &node_cache[i];
+      if (ent->node && ent->addr == node_addr && ent->size == nodesize
+	  && ent->generation == data->sblock.generation
+	  && grub_memcmp (ent->uuid, data->sblock.uuid,
+			  sizeof (grub_btrfs_uuid_t)) == 0)
+	{
+	  ent->last_use = ++node_cache_clock;
+	  grub_memcpy (buf, ent->node + (addr - node_addr), size);
+	  return GRUB_ERR_NONE;
+	}
+    }
+
+  node = grub_malloc (nodesize);
+  if (!node)
+    return grub_errno;
+  err = grub_btrfs_read_logical (data, node_addr, node, nodesize,
+				 recursion_depth);
+  if (err)
+    {
+      grub_free (node);
+      return err;
+    }
+  grub_memcpy (buf, node + (addr - node_addr), size);
+
+  /* Don't keep nodes which would fail check_btrfs_header.  */
+  head = (struct btrfs_header *) node;
+  if (grub_le_to_cpu64 (head->bytenr) != node_addr
+      || grub_memcmp (data->sblock.uuid, head->uuid,
+		      sizeof (grub_btrfs_uuid_t)))
+    {
+      grub_free (node);
+      return GRUB_ERR_NONE;
+    }
+
+  /* Reading the node may have filled the cache further, so only look for
+     a victim now.  */
+  for (i = 0; i < ARRAY_SIZE (node_cache); i++)
+    {
+      ent = &node_cache[i];
+      if (!ent->node)
+	{
+	  victim = ent;
+	  break;
+	}
+      if (!victim || ent->last_use < victim->last_use)
+	victim = ent;
+    }
+
+  grub_free (victim->node);
+  grub_memcpy (victim->uuid, data->sblock.uuid, sizeof (grub_btrfs_uuid_t));
+  victim->generation = data->sblock.generation;
+  victim->addr = node_addr;
+  victim->size = nodesize;
+  victim->last_use = ++node_cache_clock;
+  victim->node = node;
+  return GRUB_ERR_NONE;
+}
+
+/* Find the chunk mapping ADDR in the chunk map.  */
+static struct grub_btrfs_chunk_map *
+chunk_map_find (struct grub_btrfs_data *data, grub_uint64_t addr)
+{
+  unsigned lo = 0, hi = data->n_chunks;
+
+  while (lo < hi)
+    {
+      unsigned mid = lo + (hi - lo) / 2;
+
+      if (data->chunks[mid].start + data->chunks[mid].size <= addr)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  if (lo < data->n_chunks && data->chunks[lo].start <= addr)
+    return &data->chunks[lo];
+  return NULL;
+}
+
+/* Add CHUNK, an item of CHSIZE bytes, to the chunk map.  The map takes
+   it over on success.  */
+static int
+chunk_map_insert (struct grub_btrfs_data *data, grub_uint64_t start,
+		  struct grub_btrfs_chunk_item *chunk, grub_size_t chsize)
+{
+  grub_uint64_t size = grub_le_to_cpu64 (chunk->size);
+  unsigned lo = 0, hi = data->n_chunks;
+
+  if (size == 0 || start + size < start
+      || chsize < sizeof (*chunk)
+      || (chsize - sizeof (*chunk)) / sizeof (struct grub_btrfs_chunk_stripe)
+      < grub_le_to_cpu16 (chunk->nstripes))
+    return 0;
+
+  while (lo < hi)
+    {
+      unsigned mid = lo + (hi - lo) / 2;
+
+      if (data->chunks[mid].start < start)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  if ((lo < data->n_chunks && data->chunks[lo].start < start + size)
+      || (lo > 0 && data->chunks[lo - 1].start + data->chunks[lo - 1].size
+	  > start))
+    return 0;
+
+  if (data->n_chunks == data->n_chunks_allocated)
+    {
+      struct grub_btrfs_chunk_map *n;
+      unsigned alloc = data->n_chunks_allocated ? : 16;
+
+      n = grub_realloc (data->chunks, 2 * alloc * sizeof (n[0]));
+      if (!n)
+	{
+	  grub_errno = GRUB_ERR_NONE;
+	  return 0;
+	}
+      data->chunks = n;
+      data->n_chunks_allocated = 2 * alloc;
+    }
+
+  grub_memmove (&data->chunks[lo + 1], &data->chunks[lo],
+		(data->n_chunks - lo) * sizeof (data->chunks[0]));
+  data->chunks[lo].start = start;
+  data->chunks[lo].size = size;
+  data->chunks[lo].chunk = chunk;
+  data->n_chunks++;
+  return 1;
+}
+
 static grub_err_t
 save_ref (struct grub_btrfs_leaf_descriptor *desc,
 	  grub_disk_addr_t addr, unsigned i, unsigned m, int l)
@@ -366,16 +584,18 @@ next (struct grub_btrfs_data *data,
       struct grub_btrfs_internal_node node;
       struct btrfs_header head;
 
-      err = grub_btrfs_read_logical (data, desc->data[desc->depth - 1].iter
-				     * sizeof (node)
-				     + sizeof (struct btrfs_header)
-				     + desc->data[desc->depth - 1].addr,
-				     &node, sizeof (node), 0);
+      err = read_tree_node (data, desc->data[desc->depth - 1].addr,
+			    desc->data[desc->depth - 1].iter
+			    * sizeof (node)
+			    + sizeof (struct btrfs_header)
+			    + desc->data[desc->depth - 1].addr,
+			    &node, sizeof (node), 0);
       if (err)
 	return -err;
 
-      err = grub_btrfs_read_logical (data, grub_le_to_cpu64 (node.addr),
-				     &head, sizeof (head), 0);
+      err = read_tree_node (data, grub_le_to_cpu64 (node.addr),
+			    grub_le_to_cpu64 (node.addr),
+			    &head, sizeof (head), 0);
       check_btrfs_header (data, &head, grub_le_to_cpu64 (node.addr));
       if (err)
 	return -err;
@@ -383,11 +603,12 @@ next (struct grub_btrfs_data *data,
       save_ref (desc, grub_le_to_cpu64 (node.addr), 0,
 		grub_le_to_cpu32 (head.nitems), !head.level);
     }
-  err = grub_btrfs_read_logical (data, desc->data[desc->depth - 1].iter
-				 * sizeof (leaf)
-				 + sizeof (struct btrfs_header)
-				 + desc->data[desc->depth - 1].addr, &leaf,
-				 sizeof (leaf), 0);
+  err = read_tree_node (data, desc->data[desc->depth - 1].addr,
+			desc->data[desc->depth - 1].iter
+			* sizeof (leaf)
+			+ sizeof (struct btrfs_header)
+			+ desc->data[desc->depth - 1].addr, &leaf,
+			sizeof (leaf), 0);
   if (err)
     return -err;
   *outsize = grub_le_to_cpu32 (leaf.size);
@@ -435,9 +656,8 @@ lower_bound (struct grub_btrfs_data *data,
 
     reiter:
       depth++;
-      /* FIXME: preread few nodes into buffer. */
-      err = grub_btrfs_read_logical (data, addr, &head, sizeof (head),
-				     recursion_depth + 1);
+      err = read_tree_node (data, addr, addr, &head, sizeof (head),
+			    recursion_depth + 1);
       check_btrfs_header (data, &head, addr);
       if (err)
 	return err;
@@ -450,9 +670,10 @@ lower_bound (struct grub_btrfs_data *data,
 	  grub_memset (&node_last, 0, sizeof (node_last));
 	  for (i = 0; i < grub_le_to_cpu32 (head.nitems); i++)
 	    {
-	      err = grub_btrfs_read_logical (data, addr + i * sizeof (node),
-					     &node, sizeof (node),
-					     recursion_depth + 1);
+	      err = read_tree_node (data, addr - sizeof (head),
+				    addr + i * sizeof (node),
+				    &node, sizeof (node),
+				    recursion_depth + 1);
 	      if (err)
 		return err;
 
@@ -503,9 +724,10 @@ lower_bound (struct grub_btrfs_data *data,
 	int have_last = 0;
 	for (i = 0; i < grub_le_to_cpu32 (head.nitems); i++)
 	  {
-	    err = grub_btrfs_read_logical (data, addr + i * sizeof (leaf),
-					   &leaf, sizeof (leaf),
-					   recursion_depth + 1);
+	    err = read_tree_node (data, addr - sizeof (head),
+				  addr + i * sizeof (leaf),
+				  &leaf, sizeof (leaf),
+				  recursion_depth + 1);
 	    if (err)
 	      return err;
 
@@ -680,6 +902,69 @@ btrfs_read_from_chunk (struct grub_btrfs_data *data,
     return err;
 }
 
+/* Read LEN bytes at offset OFF of the RAID0 or RAID10 CHUNK, which has
+   NGROUPS groups of NSUBSTRIPES mirrored stripes, reading all the stripes
+   each device holds in one go.  */
+static grub_err_t
+btrfs_read_striped (struct grub_btrfs_data *data,
+		    struct grub_btrfs_chunk_item *chunk,
+		    grub_uint64_t ngroups, grub_uint16_t nsubstripes,
+		    grub_uint64_t off, grub_uint64_t len, grub_uint8_t *buf)
+{
+  grub_uint64_t stripe_length = grub_le_to_cpu64 (chunk->stripe_length);
+  grub_uint64_t first, last, first_ofs, last_end, g;
+  grub_uint8_t *tmp;
+  grub_err_t err = GRUB_ERR_NONE;
+
+  first = grub_divmod64 (off, stripe_length, &first_ofs);
+  last = grub_divmod64 (off + len - 1, stripe_length, &last_end);
+  last_end++;
+
+  tmp = grub_malloc ((grub_divmod64 (last - first, ngroups, NULL) + 1)
+		     * stripe_length);
+  if (!tmp)
+    return grub_errno;
+
+  for (g = 0; g < ngroups && first + g <= last; g++)
+    {
+      grub_uint64_t s0 = first + g, s1, s, row0, row1, group;
+      grub_uint64_t start, end, dev_len;
+      unsigned i;
+
+      row0 = grub_divmod64 (s0, ngroups, &group);
+      s1 = s0 + grub_divmod64 (last - s0, ngroups, NULL) * ngroups;
+      row1 = grub_divmod64 (s1, ngroups, NULL);
+      start = (s0 == first) ? first_ofs : 0;
+      end = (s1 == last) ? last_end : stripe_length;
+      dev_len = (row1 - row0) * stripe_length + end - start;
+
+      for (i = 0; i < nsubstripes; i++)
+	{
+	  err = btrfs_read_from_chunk (data, chunk, group * nsubstripes,
+				       row0 * stripe_length + start, i,
+				       dev_len, tmp);
+	  if (!err)
+	    break;
+	  grub_errno = GRUB_ERR_NONE;
+	}
+      if (err)
+	break;
+
+      for (s = s0; s <= s1; s += ngroups)
+	{
+	  grub_uint64_t a = (s == first) ? first_ofs : 0;
+	  grub_uint64_t b = (s == last) ? last_end : stripe_length;
+	  grub_uint64_t row = grub_divmod64 (s, ngroups, NULL);
+
+	  grub_memcpy (buf + s * stripe_length + a - off,
+		       tmp + (row - row0) * stripe_length + a - start, b - a);
+	}
+    }
+
+  grub_free (tmp);
+  return err;
+}
+
 struct raid56_buffer {
   void *buf;
   int  data_is_valid;
@@ -864,6 +1149,21 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 
       grub_dprintf ("btrfs", "searching for laddr %" PRIxGRUB_UINT64_T "\n",
 		    addr);
+
+      {
+	struct grub_btrfs_chunk_map *map = chunk_map_find (data, addr);
+
+	if (map)
+	  {
+	    key_out.object_id = grub_cpu_to_le64_compile_time (GRUB_BTRFS_OBJECT_ID_CHUNK);
+	    key_out.type = GRUB_BTRFS_ITEM_TYPE_CHUNK;
+	    key_out.offset = grub_cpu_to_le64 (map->start);
+	    key = &key_out;
+	    chunk = map->chunk;
+	    goto chunk_found;
+	  }
+      }
+
       for (ptr = data->sblock.bootstrap_mapping;
 	   ptr < data->sblock.bootstrap_mapping
 	   + sizeof (data->sblock.bootstrap_mapping)
@@ -912,6 +1212,9 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 	  grub_free (chunk);
 	  return err;
 	}
+      if (chunk_map_insert (data, grub_le_to_cpu64 (key->offset),
+			    chunk, chsize))
+	challoc = 0;
 
     chunk_found:
       {
@@ -1102,6 +1405,38 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 	if (csize > (grub_uint64_t) size)
 	  csize = size;
 
+	/* Spread reads over several stripes of RAID0 and RAID10 chunks
+	   into one read per device.  */
+	if (csize < size
+	    && (grub_le_to_cpu64 (chunk->type)
+		& ~GRUB_BTRFS_CHUNK_TYPE_BITS_DONTCARE)
+	    & (GRUB_BTRFS_CHUNK_TYPE_RAID0 | GRUB_BTRFS_CHUNK_TYPE_RAID10))
+	  {
+	    grub_uint16_t nsubstripes = 1;
+	    grub_uint64_t ngroups, len;
+
+	    if (grub_le_to_cpu64 (chunk->type) & GRUB_BTRFS_CHUNK_TYPE_RAID10)
+	      nsubstripes = grub_le_to_cpu16 (chunk->nsubstripes) ? : 1;
+	    ngroups = nstripes / nsubstripes;
+
+	    len = grub_le_to_cpu64 (chunk->size) - off;
+	    if (len > size)
+	      len = size;
+	    if (len > ngroups * GRUB_BTRFS_STRIPED_READ_MAX)
+	      len = ngroups * GRUB_BTRFS_STRIPED_READ_MAX;
+
+	    if (ngroups > 1 && grub_le_to_cpu64 (chunk->stripe_length)
+		&& len > csize
+		&& btrfs_read_striped (data, chunk, ngroups, nsubstripes,
+				       off, len, buf) == GRUB_ERR_NONE)
+	      {
+		csize = len;
+		goto chunk_read;
+	      }
+	    /* Read stripe by stripe, trying all the mirrors.  */
+	    grub_errno = GRUB_ERR_NONE;
+	  }
+
 	for (j = 0; j < 2; j++)
 	  {
 	    grub_dprintf ("btrfs", "chunk 0x%" PRIxGRUB_UINT64_T
@@ -1144,6 +1479,7 @@ grub_btrfs_read_logical (struct grub_btrfs_data *data, grub_disk_addr_t addr,
 	if (err)
 	  return grub_errno = err;
       }
+    chunk_read:
       size -= csize;
       buf = (grub_uint8_t *) buf + csize;
       addr += csize;
@@ -1157,6 +1493,8 @@ static struct grub_btrfs_data *
 grub_btrfs_mount (grub_device_t dev)
 {
   struct grub_btrfs_data *data;
+  struct grub_btrfs_chunk_item *chunk;
+  grub_uint8_t *ptr;
   grub_err_t err;
 
   if (!dev->disk)
@@ -1188,6 +1526,37 @@ grub_btrfs_mount (grub_device_t dev)
   data->devices_attached[0].dev = dev;
   data->devices_attached[0].id = data->sblock.this_device.device_id;
 
+  /* Start the chunk map with the chunks of the superblock.  */
+  for (ptr = data->sblock.bootstrap_mapping;
+       ptr + sizeof (struct grub_btrfs_key) + sizeof (*chunk)
+	 <= data->sblock.bootstrap_mapping
+	 + sizeof (data->sblock.bootstrap_mapping);)
+    {
+      struct grub_btrfs_key *key = (struct grub_btrfs_key *) ptr;
+      struct grub_btrfs_chunk_item *copy;
+      grub_size_t chsize;
+
+      if (key->type != GRUB_BTRFS_ITEM_TYPE_CHUNK)
+	break;
+      chunk = (struct grub_btrfs_chunk_item *) (key + 1);
+      chsize = sizeof (*chunk) + sizeof (struct grub_btrfs_chunk_stripe)
+	* grub_le_to_cpu16 (chunk->nstripes);
+      if ((grub_uint8_t *) chunk + chsize > data->sblock.bootstrap_mapping
+	  + sizeof (data->sblock.bootstrap_mapping))
+	break;
+      copy = grub_malloc (chsize);
+      if (!copy)
+	{
+	  grub_errno = GRUB_ERR_NONE;
+	  break;
+	}
+      grub_memcpy (copy, chunk, chsize);
+      if (!chunk_map_insert (data, grub_le_to_cpu64 (key->offset),
+			     copy, chsize))
+	grub_free (copy);
+      ptr += sizeof (*key) + chsize;
+    }
+
   return data;
 }
 
@@ -1200,7 +1569,11 @@ grub_btrfs_unmount (struct grub_btrfs_data *data)
     if (data->devices_attached[i].dev)
         grub_device_close (data->devices_attached[i].dev);
   grub_free (data->devices_attached);
+  for (i = 0; i < data->n_chunks; i++)
+    grub_free (data->chunks[i].chunk);
+  grub_free (data->chunks);
   grub_free (data->extent);
+  grub_free (data->extdata);
   grub_free (data);
 }
 
@@ -1412,6 +1785,70 @@ grub_btrfs_lzo_decompress(char *ibuf, grub_size_t isize, grub_off_t off,
   return ret;
 }
 
+/* Decompress the data of the current extent, which is compressed, from
+   extstart to extend into data->extdata.  */
+static void
+grub_btrfs_cache_extent (struct grub_btrfs_data *data)
+{
+  grub_size_t osize = data->extend - data->extstart;
+  grub_size_t isize;
+  char *ibuf, *tmp = NULL;
+  grub_off_t off;
+  grub_ssize_t ret;
+
+  data->extdata_failed = 1;
+  if (data->extend - data->extstart > GRUB_BTRFS_MAX_DECOMPRESSED)
+    return;
+
+  if (data->extent->type == GRUB_BTRFS_EXTENT_INLINE)
+    {
+      ibuf = data->extent->inl;
+      isize = data->extsize - ((grub_uint8_t *) data->extent->inl
+			       - (grub_uint8_t *) data->extent);
+      off = 0;
+    }
+  else
+    {
+      isize = grub_le_to_cpu64 (data->extent->compressed_size);
+      tmp = grub_malloc (isize);
+      if (!tmp)
+	goto fail;
+      if (grub_btrfs_read_logical (data,
+				   grub_le_to_cpu64 (data->extent->laddr),
+				   tmp, isize, 0))
+	goto fail;
+      ibuf = tmp;
+      off = grub_le_to_cpu64 (data->extent->offset);
+    }
+
+  data->extdata = grub_malloc (osize);
+  if (!data->extdata)
+    goto fail;
+
+  if (data->extent->compression == GRUB_BTRFS_COMPRESSION_ZLIB)
+    ret = grub_zlib_decompress (ibuf, isize, off, data->extdata, osize);
+  else if (data->extent->compression == GRUB_BTRFS_COMPRESSION_LZO)
+    ret = grub_btrfs_lzo_decompress (ibuf, isize, off, data->extdata, osize);
+  else if (data->extent->compression == GRUB_BTRFS_COMPRESSION_ZSTD)
+    ret = grub_btrfs_zstd_decompress (ibuf, isize, off, data->extdata, osize);
+  else
+    ret = -1;
+
+  if (ret == (grub_ssize_t) osize)
+    {
+      grub_free (tmp);
+      data->extdata_failed = 0;
+      return;
+    }
+
+ fail:
+  /* Let the reads decompress what they need and report the errors.  */
+  grub_free (tmp);
+  grub_free (data->extdata);
+  data->extdata = NULL;
+  grub_errno = GRUB_ERR_NONE;
+}
+
 static grub_ssize_t
 grub_btrfs_extent_read (struct grub_btrfs_data *data,
 			grub_uint64_t ino, grub_uint64_t tree,
@@ -1431,6 +1868,9 @@ grub_btrfs_extent_read (struct grub_btrfs_data *data,
 	  grub_size_t elemsize;
 
 	  grub_free (data->extent);
+	  grub_free (data->extdata);
+	  data->extdata = NULL;
+	  data->extdata_failed = 0;
 	  key_in.object_id = ino;
 	  key_in.type = GRUB_BTRFS_ITEM_TYPE_EXTENT_ITEM;
 	  key_in.offset = grub_cpu_to_le64 (pos);
@@ -1509,6 +1949,24 @@ grub_btrfs_extent_read (struct grub_btrfs_data *data,
 	  return -1;
 	}
 
+      /* Decompress compressed extents once for all the reads in them.  */
+      if (data->extent->compression != GRUB_BTRFS_COMPRESSION_NONE
+	  && (data->extent->type == GRUB_BTRFS_EXTENT_INLINE
+	      || (data->extent->type == GRUB_BTRFS_EXTENT_REGULAR
+		  && data->extent->laddr)))
+	{
+	  if (!data->extdata && !data->extdata_failed)
+	    grub_btrfs_cache_extent (data);
+	  if (data->extdata)
+	    {
+	      grub_memcpy (buf, data->extdata + extoff, csize);
+	      buf += csize;
+	      pos += csize;
+	      len -= csize;
+	      continue;
+	    }
+	}
+
       switch (data->extent->type)
 	{
 	case GRUB_BTRFS_EXTENT_INLINE:
@@ -2193,4 +2651,5 @@ GRUB_MOD_INIT (btrfs)
 GRUB_MOD_FINI (btrfs)
 {
   grub_fs_unregister (&grub_btrfs_fs);
+  node_cache_flush ();
 }
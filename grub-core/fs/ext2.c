@@ -141,7 +141,23 @@ GRUB_MOD_LICENSE ("GPLv3+");
 #define EXT3_JOURNAL_FLAG_LAST_TAG	8
 
 #define EXT4_ENCRYPT_FLAG              0x800
+#define EXT3_INDEX_FLAG			0x1000
 #define EXT4_EXTENTS_FLAG		0x80000
+#define EXT4_CASEFOLD_FLAG		0x40000000
+
+/* Superblock flags.  */
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+
+/* Hash versions of indexed directories.  */
+#define EXT3_DX_HASH_LEGACY		0
+#define EXT3_DX_HASH_HALF_MD4		1
+#define EXT3_DX_HASH_TEA		2
+#define EXT3_DX_HASH_LEGACY_UNSIGNED	3
+#define EXT3_DX_HASH_HALF_MD4_UNSIGNED	4
+#define EXT3_DX_HASH_TEA_UNSIGNED	5
+
+/* Indexed directories with more levels than this are searched linearly.  */
+#define EXT3_DX_MAX_LEVELS		3
 
 /* The ext2 superblock.  */
 struct grub_ext2_sblock
@@ -196,6 +212,12 @@ struct grub_ext2_sblock
   grub_uint32_t first_meta_bg;
   grub_uint32_t mkfs_time;
   grub_uint32_t jnl_blocks[17];
+  grub_uint32_t total_blocks_hi;
+  grub_uint32_t reserved_blocks_hi;
+  grub_uint32_t free_blocks_hi;
+  grub_uint16_t min_extra_isize;
+  grub_uint16_t want_extra_isize;
+  grub_uint32_t flags;
 };
 
 /* The ext2 blockgroup.  */
@@ -292,6 +314,31 @@ struct grub_ext3_journal_sblock
   grub_uint32_t start;
 };
 
+/* The header of the index in the first block of an indexed (htree)
+   directory, right after its "." and ".." entries.  */
+struct grub_ext3_dx_root_info
+{
+  grub_uint32_t reserved_zero;
+  grub_uint8_t hash_version;
+  grub_uint8_t info_length;
+  grub_uint8_t indirect_levels;
+  grub_uint8_t unused_flags;
+} GRUB_PACKED;
+
+/* An index entry.  The limit and the count of entries of an index block
+   take the place of the hash of the first entry, which is implicitly 0.  */
+struct grub_ext3_dx_entry
+{
+  grub_uint32_t hash;
+  grub_uint32_t block;
+} GRUB_PACKED;
+
+struct grub_ext3_dx_countlimit
+{
+  grub_uint16_t limit;
+  grub_uint16_t count;
+} GRUB_PACKED;
+
 #define EXT4_EXT_MAGIC		0xf30a
 
 struct grub_ext4_extent_header
@@ -744,6 +791,65 @@ grub_ext2_read_symlink (grub_fshelp_node_t node)
   return symlink;
 }
 
+/* Make the node for the directory entry DIRENT of DIRO.  */
+static grub_err_t
+grub_ext2_dirent_node (struct grub_fshelp_node *diro,
+		       const struct ext2_dirent *dirent,
+		       struct grub_fshelp_node **node,
+		       enum grub_fshelp_filetype *filetype)
+{
+  struct grub_fshelp_node *fdiro;
+  enum grub_fshelp_filetype type = GRUB_FSHELP_UNKNOWN;
+
+  fdiro = grub_malloc (sizeof (struct grub_fshelp_node));
+  if (! fdiro)
+    return grub_errno;
+
+  fdiro->data = diro->data;
+  fdiro->ino = grub_le_to_cpu32 (dirent->inode);
+
+  if (dirent->filetype != FILETYPE_UNKNOWN)
+    {
+      fdiro->inode_read = 0;
+
+      if (dirent->filetype == FILETYPE_DIRECTORY)
+	type = GRUB_FSHELP_DIR;
+      else if (dirent->filetype == FILETYPE_SYMLINK)
+	type = GRUB_FSHELP_SYMLINK;
+      else if (dirent->filetype == FILETYPE_REG)
+	type = GRUB_FSHELP_REG;
+    }
+  else
+    {
+      /* The filetype can not be read from the dirent, read
+	 the inode to get more information.  */
+      grub_ext2_read_inode (diro->data,
+			    grub_le_to_cpu32 (dirent->inode),
+			    &fdiro->inode);
+      if (grub_errno)
+	{
+	  grub_free (fdiro);
+	  return grub_errno;
+	}
+
+      fdiro->inode_read = 1;
+
+      if ((grub_le_to_cpu16 (fdiro->inode.mode)
+	   & FILETYPE_INO_MASK) == FILETYPE_INO_DIRECTORY)
+	type = GRUB_FSHELP_DIR;
+      else if ((grub_le_to_cpu16 (fdiro->inode.mode)
+		& FILETYPE_INO_MASK) == FILETYPE_INO_SYMLINK)
+	type = GRUB_FSHELP_SYMLINK;
+      else if ((grub_le_to_cpu16 (fdiro->inode.mode)
+		& FILETYPE_INO_MASK) == FILETYPE_INO_REG)
+	type = GRUB_FSHELP_REG;
+    }
+
+  *node = fdiro;
+  *filetype = type;
+  return GRUB_ERR_NONE;
+}
+
 static int
 grub_ext2_iterate_dir (grub_fshelp_node_t dir,
 		       grub_fshelp_iterate_dir_hook_t hook, void *hook_data)
@@ -781,58 +887,17 @@ grub_ext2_iterate_dir (grub_fshelp_node_t dir,
 	{
 	  char filename[MAX_NAMELEN + 1];
 	  struct grub_fshelp_node *fdiro;
-	  enum grub_fshelp_filetype type = GRUB_FSHELP_UNKNOWN;
+	  enum grub_fshelp_filetype type;
 
 	  grub_ext2_read_file (diro, 0, 0, fpos + sizeof (struct ext2_dirent),
 			       dirent.namelen, filename);
 	  if (grub_errno)
 	    return 0;
 
-	  fdiro = grub_malloc (sizeof (struct grub_fshelp_node));
-	  if (! fdiro)
-	    return 0;
-
-	  fdiro->data = diro->data;
-	  fdiro->ino = grub_le_to_cpu32 (dirent.inode);
-
 	  filename[dirent.namelen] = '\0';
 
-	  if (dirent.filetype != FILETYPE_UNKNOWN)
-	    {
-	      fdiro->inode_read = 0;
-
-	      if (dirent.filetype == FILETYPE_DIRECTORY)
-		type = GRUB_FSHELP_DIR;
-	      else if (dirent.filetype == FILETYPE_SYMLINK)
-		type = GRUB_FSHELP_SYMLINK;
-	      else if (dirent.filetype == FILETYPE_REG)
-		type = GRUB_FSHELP_REG;
-	    }
-	  else
-	    {
-	      /* The filetype can not be read from the dirent, read
-		 the inode to get more information.  */
-	      grub_ext2_read_inode (diro->data,
-                                    grub_le_to_cpu32 (dirent.inode),
-				    &fdiro->inode);
-	      if (grub_errno)
-		{
-		  grub_free (fdiro);
-		  return 0;
-		}
-
-	      fdiro->inode_read = 1;
-
-	      if ((grub_le_to_cpu16 (fdiro->inode.mode)
-		   & FILETYPE_INO_MASK) == FILETYPE_INO_DIRECTORY)
-		type = GRUB_FSHELP_DIR;
-	      else if ((grub_le_to_cpu16 (fdiro->inode.mode)
-			& FILETYPE_INO_MASK) == FILETYPE_INO_SYMLINK)
-		type = GRUB_FSHELP_SYMLINK;
-	      else if ((grub_le_to_cpu16 (fdiro->inode.mode)
-			& FILETYPE_INO_MASK) == FILETYPE_INO_REG)
-		type = GRUB_FSHELP_REG;
-	    }
+	  if (grub_ext2_dirent_node (diro, &dirent, &fdiro, &type))
+	    return 0;
 
 	  if (hook (filename, type, fdiro, hook_data))
 	    return 1;
@@ -844,6 +909,459 @@ grub_ext2_iterate_dir (grub_fshelp_node_t dir,
   return 0;
 }
 
+/* Hash functions of indexed directories, as in Linux fs/ext4/hash.c.  */
+
+#define DX_TEA_DELTA	0x9E3779B9
+
+static void
+dx_tea_transform (grub_uint32_t buf[4], const grub_uint32_t in[4])
+{
+  grub_uint32_t sum = 0;
+  grub_uint32_t b0 = buf[0], b1 = buf[1];
+  grub_uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+  int n = 16;
+
+  do
+    {
+      sum += DX_TEA_DELTA;
+      b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+      b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+    }
+  while (--n);
+
+  buf[0] += b0;
+  buf[1] += b1;
+}
+
+#define DX_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define DX_G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define DX_H(x, y, z) ((x) ^ (y) ^ (z))
+
+#define DX_ROUND(f, a, b, c, d, x, s)				\
+  ((a) += f ((b), (c), (d)) + (x),				\
+   (a) = ((a) << (s)) | ((a) >> (32 - (s))))
+
+#define DX_K1 0
+#define DX_K2 013240474631U
+#define DX_K3 015666365641U
+
+static void
+dx_half_md4_transform (grub_uint32_t buf[4], const grub_uint32_t in[8])
+{
+  grub_uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+  DX_ROUND (DX_F, a, b, c, d, in[0] + DX_K1, 3);
+  DX_ROUND (DX_F, d, a, b, c, in[1] + DX_K1, 7);
+  DX_ROUND (DX_F, c, d, a, b, in[2] + DX_K1, 11);
+  DX_ROUND (DX_F, b, c, d, a, in[3] + DX_K1, 19);
+  DX_ROUND (DX_F, a, b, c, d, in[4] + DX_K1, 3);
+  DX_ROUND (DX_F, d, a, b, c, in[5] + DX_K1, 7);
+  DX_ROUND (DX_F, c, d, a, b, in[6] + DX_K1, 11);
+  DX_ROUND (DX_F, b, c, d, a, in[7] + DX_K1, 19);
+
+  DX_ROUND (DX_G, a, b, c, d, in[1] + DX_K2, 3);
+  DX_ROUND (DX_G, d, a, b, c, in[3] + DX_K2, 5);
+  DX_ROUND (DX_G, c, d, a, b, in[5] + DX_K2, 9);
+  DX_ROUND (DX_G, b, c, d, a, in[7] + DX_K2, 13);
+  DX_ROUND (DX_G, a, b, c, d, in[0] + DX_K2, 3);
+  DX_ROUND (DX_G, d, a, b, c, in[2] + DX_K2, 5);
+  DX_ROUND (DX_G, c, d, a, b, in[4] + DX_K2, 9);
+  DX_ROUND (DX_G, b, c, d, a, in[6] + DX_K2, 13);
+
+  DX_ROUND (DX_H, a, b, c, d, in[3] + DX_K3, 3);
+  DX_ROUND (DX_H, d, a, b, c, in[7] + DX_K3, 9);
+  DX_ROUND (DX_H, c, d, a, b, in[2] + DX_K3, 11);
+  DX_ROUND (DX_H, b, c, d, a, in[6] + DX_K3, 15);
+  DX_ROUND (DX_H, a, b, c, d, in[1] + DX_K3, 3);
+  DX_ROUND (DX_H, d, a, b, c, in[5] + DX_K3, 9);
+  DX_ROUND (DX_H, c, d, a, b, in[0] + DX_K3, 11);
+  DX_ROUND (DX_H, b, c, d, a, in[4] + DX_K3, 15);
+
+  buf[0] += a;
+  buf[1] += b;
+  buf[2] += c;
+  buf[3] += d;
+}
+
+/* Characters are signed or unsigned depending on the platform which
+   created the filesystem, which is why both variants exist.  */
+static grub_uint32_t
+dx_char (const char *name, grub_size_t i, int is_unsigned)
+{
+  if (is_unsigned)
+    return (grub_uint8_t) name[i];
+  return (grub_uint32_t) (grub_int32_t) (grub_int8_t) name[i];
+}
+
+static grub_uint32_t
+dx_legacy_hash (const char *name, grub_size_t len, int is_unsigned)
+{
+  grub_uint32_t hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+  grub_size_t i;
+
+  for (i = 0; i < len; i++)
+    {
+      hash = hash1 + (hash0 ^ (dx_char (name, i, is_unsigned) * 7152373));
+
+      if (hash & 0x80000000)
+	hash -= 0x7fffffff;
+      hash1 = hash0;
+      hash0 = hash;
+    }
+  return hash0 << 1;
+}
+
+static void
+dx_str2hashbuf (const char *msg, grub_size_t len, grub_uint32_t *buf,
+		int num, int is_unsigned)
+{
+  grub_uint32_t pad, val;
+  grub_size_t i;
+
+  pad = (grub_uint32_t) len | ((grub_uint32_t) len << 8);
+  pad |= pad << 16;
+
+  val = pad;
+  if (len > (grub_size_t) num * 4)
+    len = num * 4;
+  for (i = 0; i < len; i++)
+    {
+      val = dx_char (msg, i, is_unsigned) + (val << 8);
+      if ((i % 4) == 3)
+	{
+	  *buf++ = val;
+	  val = pad;
+	  num--;
+	}
+    }
+  if (--num >= 0)
+    *buf++ = val;
+  while (--num >= 0)
+    *buf++ = pad;
+}
+
+/* Compute the major hash of NAME as stored in the index.  Return 0 if
+   VERSION is not supported.  */
+static int
+grub_ext2_dx_hash (const struct grub_ext2_data *data, int version,
+		   const char *name, grub_size_t len, grub_uint32_t *hash)
+{
+  grub_uint32_t buf[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+  grub_uint32_t in[8];
+  grub_uint32_t h;
+  int is_unsigned = 0;
+  int i;
+
+  for (i = 0; i < 4; i++)
+    if (data->sblock.hash_seed[i])
+      break;
+  if (i < 4)
+    for (i = 0; i < 4; i++)
+      buf[i] = grub_le_to_cpu32 (data->sblock.hash_seed[i]);
+
+  switch (version)
+    {
+    case EXT3_DX_HASH_LEGACY_UNSIGNED:
+      is_unsigned = 1;
+      /* Fallthrough.  */
+    case EXT3_DX_HASH_LEGACY:
+      h = dx_legacy_hash (name, len, is_unsigned);
+      break;
+
+    case EXT3_DX_HASH_HALF_MD4_UNSIGNED:
+      is_unsigned = 1;
+      /* Fallthrough.  */
+    case EXT3_DX_HASH_HALF_MD4:
+      while (1)
+	{
+	  dx_str2hashbuf (name, len, in, 8, is_unsigned);
+	  dx_half_md4_transform (buf, in);
+	  if (len <= 32)
+	    break;
+	  len -= 32;
+	  name += 32;
+	}
+      h = buf[1];
+      break;
+
+    case EXT3_DX_HASH_TEA_UNSIGNED:
+      is_unsigned = 1;
+      /* Fallthrough.  */
+    case EXT3_DX_HASH_TEA:
+      while (1)
+	{
+	  dx_str2hashbuf (name, len, in, 4, is_unsigned);
+	  dx_tea_transform (buf, in);
+	  if (len <= 16)
+	    break;
+	  len -= 16;
+	  name += 16;
+	}
+      h = buf[0];
+      break;
+
+    default:
+      return 0;
+    }
+
+  h &= ~1;
+  if (h == (0x7fffffffU << 1))
+    h = (0x7fffffffU - 1) << 1;
+  *hash = h;
+  return 1;
+}
+
+/* Read the directory block BLOCK of DIRO into BUF.  Return 0 if it is
+   outside of the directory.  */
+static int
+grub_ext2_read_dir_block (struct grub_fshelp_node *diro, grub_uint32_t block,
+			  char *buf)
+{
+  struct grub_ext2_data *data = diro->data;
+  grub_off_t pos = (grub_off_t) block << LOG2_BLOCK_SIZE (data);
+
+  if (pos + EXT2_BLOCK_SIZE (data) > grub_le_to_cpu32 (diro->inode.size))
+    return 0;
+
+  return grub_ext2_read_file (diro, 0, 0, pos, EXT2_BLOCK_SIZE (data), buf)
+    == (grub_ssize_t) EXT2_BLOCK_SIZE (data);
+}
+
+/* Search the directory block BUF for NAME.  Return 0 if the block is
+   corrupted, 1 otherwise with *DIRENT_OFF set to the offset of the entry
+   or -1 if it is not there.  */
+static int
+grub_ext2_search_dir_block (const char *buf, grub_uint32_t blocksize,
+			    const char *name, grub_size_t len,
+			    grub_ssize_t *dirent_off)
+{
+  grub_uint32_t off = 0;
+
+  *dirent_off = -1;
+  while (off + sizeof (struct ext2_dirent) <= blocksize)
+    {
+      const struct ext2_dirent *dirent
+	= (const struct ext2_dirent *) (buf + off);
+      grub_uint16_t direntlen = grub_le_to_cpu16 (dirent->direntlen);
+
+      if (direntlen < sizeof (struct ext2_dirent)
+	  || direntlen > blocksize - off)
+	return 0;
+
+      if (dirent->inode != 0 && dirent->namelen == len
+	  && sizeof (struct ext2_dirent) + len <= direntlen
+	  && grub_memcmp (dirent + 1, name, len) == 0)
+	{
+	  *dirent_off = off;
+	  return 1;
+	}
+
+      off += direntlen;
+    }
+  return 1;
+}
+
+/* Look NAME up through the htree index of DIRO.  Return 0 if the index
+   can not be used, in which case the directory has to be searched
+   linearly, or 1 with *NODE set to the node found or NULL.  */
+static int
+grub_ext2_dx_lookup (struct grub_fshelp_node *diro, const char *name,
+		     struct grub_fshelp_node **node,
+		     enum grub_fshelp_filetype *type)
+{
+  struct grub_ext2_data *data = diro->data;
+  grub_uint32_t blocksize = EXT2_BLOCK_SIZE (data);
+  const struct grub_ext3_dx_root_info *info;
+  const struct grub_ext3_dx_entry *entries, *at, *p, *q;
+  const struct grub_ext3_dx_countlimit *cl;
+  grub_size_t len = grub_strlen (name);
+  grub_uint32_t hash, count, block;
+  grub_ssize_t off;
+  unsigned level, levels;
+  int version, ret = 0;
+  char *index, *leaf;
+
+  *node = 0;
+  if (len > MAX_NAMELEN)
+    return 1;
+
+  index = grub_malloc (2 * blocksize);
+  if (! index)
+    return 0;
+  leaf = index + blocksize;
+
+  if (! grub_ext2_read_dir_block (diro, 0, index))
+    goto out;
+
+  /* Skip the "." and ".." entries.  */
+  info = (const struct grub_ext3_dx_root_info *) (index + 24);
+  if (info->reserved_zero != 0 || info->info_length < sizeof (*info)
+      || info->indirect_levels >= EXT3_DX_MAX_LEVELS
+      || 24 + info->info_length + sizeof (*cl) > blocksize)
+    goto out;
+
+  version = info->hash_version;
+  if (version <= EXT3_DX_HASH_TEA
+      && (data->sblock.flags
+	  & grub_cpu_to_le32_compile_time (EXT2_FLAGS_UNSIGNED_HASH)))
+    version += EXT3_DX_HASH_LEGACY_UNSIGNED;
+  if (! grub_ext2_dx_hash (data, version, name, len, &hash))
+    goto out;
+
+  levels = info->indirect_levels;
+  entries = (const struct grub_ext3_dx_entry *) (index + 24
+						 + info->info_length);
+  for (level = 0; ; level++)
+    {
+      cl = (const struct grub_ext3_dx_countlimit *) entries;
+      count = grub_le_to_cpu16 (cl->count);
+      if (count == 0 || count > grub_le_to_cpu16 (cl->limit)
+	  || (const char *) (entries + count) > index + blocksize)
+	goto out;
+
+      /* Find the last entry whose hash is not above ours.  */
+      p = entries + 1;
+      q = entries + count - 1;
+      while (p <= q)
+	{
+	  const struct grub_ext3_dx_entry *m = p + (q - p) / 2;
+
+	  if (grub_le_to_cpu32 (m->hash) > hash)
+	    q = m - 1;
+	  else
+	    p = m + 1;
+	}
+      at = p - 1;
+      block = grub_le_to_cpu32 (at->block) & 0x0fffffff;
+
+      if (level == levels)
+	break;
+
+      /* Interior blocks start with an empty directory entry.  */
+      if (! grub_ext2_read_dir_block (diro, block, index))
+	goto out;
+      entries = (const struct grub_ext3_dx_entry *) (index
+						     + sizeof (struct ext2_dirent));
+    }
+
+  while (1)
+    {
+      if (! grub_ext2_read_dir_block (diro, block, leaf)
+	  || ! grub_ext2_search_dir_block (leaf, blocksize, name, len, &off))
+	goto out;
+      if (off >= 0)
+	break;
+
+      /* Entries whose hash collides with ours may continue in the next
+	 leaf.  */
+      at++;
+      if (at == entries + count)
+	{
+	  /* The next leaf would be under another index block.  Rather than
+	     walking back up, fall back to a linear search for this rare
+	     case unless there is no other index block.  */
+	  ret = (levels == 0);
+	  goto out;
+	}
+      if ((grub_le_to_cpu32 (at->hash) & ~1) != hash)
+	{
+	  ret = 1;
+	  goto out;
+	}
+      block = grub_le_to_cpu32 (at->block) & 0x0fffffff;
+    }
+
+  if (grub_ext2_dirent_node (diro, (const struct ext2_dirent *) (leaf + off),
+			     node, type) == GRUB_ERR_NONE)
+    ret = 1;
+
+ out:
+  grub_free (index);
+  return ret;
+}
+
+/* Context for grub_ext2_lookup_file.  */
+struct grub_ext2_lookup_ctx
+{
+  const char *name;
+  grub_fshelp_node_t *foundnode;
+  enum grub_fshelp_filetype *foundtype;
+};
+
+/* Helper for grub_ext2_lookup_file.  */
+static int
+grub_ext2_lookup_iter (const char *filename,
+		       enum grub_fshelp_filetype filetype,
+		       grub_fshelp_node_t node, void *data)
+{
+  struct grub_ext2_lookup_ctx *ctx = data;
+
+  if (filetype == GRUB_FSHELP_UNKNOWN || grub_strcmp (ctx->name, filename))
+    {
+      grub_free (node);
+      return 0;
+    }
+
+  *ctx->foundnode = node;
+  *ctx->foundtype = filetype;
+  return 1;
+}
+
+/* Look up the single name NAME in DIR, using the htree index if the
+   directory has one.  */
+static grub_err_t
+grub_ext2_lookup_file (grub_fshelp_node_t dir, const char *name,
+		       grub_fshelp_node_t *foundnode,
+		       enum grub_fshelp_filetype *foundtype)
+{
+  struct grub_fshelp_node *diro = dir;
+  struct grub_ext2_lookup_ctx ctx = {
+    .name = name,
+    .foundnode = foundnode,
+    .foundtype = foundtype
+  };
+
+  *foundnode = 0;
+
+  if (! diro->inode_read)
+    {
+      grub_ext2_read_inode (diro->data, diro->ino, &diro->inode);
+      if (grub_errno)
+	return grub_errno;
+      diro->inode_read = 1;
+    }
+
+  if ((diro->inode.flags & grub_cpu_to_le32_compile_time (EXT3_INDEX_FLAG))
+      && (diro->data->sblock.feature_compatibility
+	  & grub_cpu_to_le32_compile_time (EXT2_FEATURE_COMPAT_DIR_INDEX))
+      && ! (diro->inode.flags
+	    & grub_cpu_to_le32_compile_time (EXT4_ENCRYPT_FLAG
+					     | EXT4_CASEFOLD_FLAG)))
+    {
+      struct grub_fshelp_node *node;
+      enum grub_fshelp_filetype type = GRUB_FSHELP_UNKNOWN;
+
+      if (grub_ext2_dx_lookup (diro, name, &node, &type))
+	{
+	  if (node && type == GRUB_FSHELP_UNKNOWN)
+	    {
+	      grub_free (node);
+	      node = 0;
+	    }
+	  *foundnode = node;
+	  *foundtype = type;
+	  return GRUB_ERR_NONE;
+	}
+      if (grub_errno)
+	return grub_errno;
+      grub_dprintf ("ext2", "unusable directory index in inode %d\n",
+		    diro->ino);
+    }
+
+  grub_ext2_iterate_dir (dir, grub_ext2_lookup_iter, &ctx);
+  return grub_errno;
+}
+
 /* Open a file named NAME and initialize FILE.  */
 static grub_err_t
 grub_ext2_open (struct grub_file *file, const char *name)
@@ -861,9 +1379,11 @@ grub_ext2_open (struct grub_file *file, const char *name)
       goto fail;
     }
 
-  err = grub_fshelp_find_file (name, &data->diropen, &fdiro,
-			       grub_ext2_iterate_dir,
-			       grub_ext2_read_symlink, GRUB_FSHELP_REG);
+  err = grub_fshelp_find_file_cached (name, &data->diropen, &fdiro,
+				      grub_ext2_iterate_dir,
+				      grub_ext2_lookup_file,
+				      grub_ext2_read_symlink, GRUB_FSHELP_REG,
+				      data->disk, sizeof (*fdiro));
   if (err)
     goto fail;
 
@@ -973,9 +1493,11 @@ grub_ext2_dir (grub_device_t device, const char *path, grub_fs_dir_hook_t hook,
   if (! ctx.data)
     goto fail;
 
-  grub_fshelp_find_file (path, &ctx.data->diropen, &fdiro,
-			 grub_ext2_iterate_dir, grub_ext2_read_symlink,
-			 GRUB_FSHELP_DIR);
+  grub_fshelp_find_file_cached (path, &ctx.data->diropen, &fdiro,
+				grub_ext2_iterate_dir, grub_ext2_lookup_file,
+				grub_ext2_read_symlink, GRUB_FSHELP_DIR,
+				ctx.data->disk,
+				sizeof (*fdiro));
   if (grub_errno)
     goto fail;
 
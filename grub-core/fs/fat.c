@@ -161,6 +161,14 @@ typedef struct grub_fat_dir_entry grub_fat_dir_node_t;
 
 #endif
 
+/* The FAT is read through a buffer of this many (log2) bytes.  */
+#define GRUB_FAT_FAT_BLOCK_BITS	12
+#define GRUB_FAT_FAT_BLOCK_SIZE	(1 << GRUB_FAT_FAT_BLOCK_BITS)
+
+/* Cluster chains of open files are mapped with at most this many
+   extents.  */
+#define GRUB_FAT_MAX_EXTENTS	4096
+
 struct grub_fat_data
 {
   int logical_sector_bits;
@@ -182,6 +190,18 @@ struct grub_fat_data
   grub_uint32_t num_clusters;
 
   grub_uint32_t uuid;
+
+  /* The block of the FAT in fat_buf, or ~0U.  */
+  grub_uint32_t fat_block;
+  grub_uint8_t fat_buf[GRUB_FAT_FAT_BLOCK_SIZE];
+};
+
+/* A run of contiguous clusters of a cluster chain.  */
+struct grub_fat_extent
+{
+  grub_uint32_t logical;
+  grub_uint32_t cluster;
+  grub_uint32_t length;
 };
 
 struct grub_fshelp_node {
@@ -198,6 +218,13 @@ struct grub_fshelp_node {
   grub_uint32_t cur_cluster_num;
   grub_uint32_t cur_cluster;
 
+  /* The extents of the first mapped_clusters clusters of the chain, for
+     files opened with grub_fat_open.  */
+  struct grub_fat_extent *extents;
+  grub_uint32_t num_extents;
+  grub_uint32_t alloc_extents;
+  grub_uint32_t mapped_clusters;
+
 #ifdef MODE_EXFAT
   int is_contiguous;
 #endif
@@ -238,6 +265,8 @@ grub_fat_mount (grub_disk_t disk)
   if (! data)
     goto fail;
 
+  data->fat_block = ~0U;
+
   /* Read the BPB.  */
   if (grub_disk_read (disk, 0, 0, sizeof (bpb), &bpb))
     goto fail;
@@ -448,6 +477,166 @@ grub_fat_mount (grub_disk_t disk)
   return 0;
 }
 
+/* Find the extent of NODE which maps the logical cluster NUM.  */
+static struct grub_fat_extent *
+grub_fat_find_extent (grub_fshelp_node_t node, grub_uint32_t num)
+{
+  grub_uint32_t lo = 0, hi;
+
+  if (num >= node->mapped_clusters)
+    return NULL;
+
+  hi = node->num_extents - 1;
+  while (lo < hi)
+    {
+      grub_uint32_t mid = lo + (hi - lo + 1) / 2;
+
+      if (node->extents[mid].logical <= num)
+	lo = mid;
+      else
+	hi = mid - 1;
+    }
+  return &node->extents[lo];
+}
+
+/* Record that the logical cluster NUM of NODE is CLUSTER, if the map of
+   NODE ends right before it.  */
+static void
+grub_fat_map_cluster (grub_fshelp_node_t node, grub_uint32_t num,
+		      grub_uint32_t cluster)
+{
+  struct grub_fat_extent *e;
+
+  if (!node->extents || num != node->mapped_clusters)
+    return;
+
+  if (node->num_extents)
+    {
+      e = &node->extents[node->num_extents - 1];
+      if (e->cluster + e->length == cluster)
+	{
+	  e->length++;
+	  node->mapped_clusters++;
+	  return;
+	}
+    }
+
+  if (node->num_extents == node->alloc_extents)
+    {
+      struct grub_fat_extent *n;
+
+      /* Past the limit, the rest of the chain is walked as before.  */
+      if (node->alloc_extents >= GRUB_FAT_MAX_EXTENTS)
+	return;
+      n = grub_realloc (node->extents,
+			2 * node->alloc_extents * sizeof (n[0]));
+      if (!n)
+	{
+	  grub_errno = GRUB_ERR_NONE;
+	  return;
+	}
+      node->extents = n;
+      node->alloc_extents *= 2;
+    }
+
+  e = &node->extents[node->num_extents++];
+  e->logical = num;
+  e->cluster = cluster;
+  e->length = 1;
+  node->mapped_clusters++;
+}
+
+/* Read the FAT entry at FAT_OFFSET bytes into the FAT of DATA into *ENTRY,
+   which is SIZE bytes long.  */
+static grub_err_t
+grub_fat_read_fat (grub_disk_t disk, struct grub_fat_data *data,
+		   grub_uint32_t fat_offset, grub_size_t size, void *entry)
+{
+  grub_uint32_t block = fat_offset >> GRUB_FAT_FAT_BLOCK_BITS;
+  grub_uint32_t in_block = fat_offset & (GRUB_FAT_FAT_BLOCK_SIZE - 1);
+
+  /* Entries crossing the end of a block, or in a partial block at the
+     end of the FAT, are read directly.  */
+  if (in_block + size > GRUB_FAT_FAT_BLOCK_SIZE
+      || ((grub_uint64_t) block + 1) << GRUB_FAT_FAT_BLOCK_BITS
+      > (grub_uint64_t) data->sectors_per_fat << GRUB_DISK_SECTOR_BITS)
+    return grub_disk_read (disk, data->fat_sector, fat_offset, size, entry);
+
+  if (data->fat_block != block)
+    {
+      data->fat_block = ~0U;
+      if (grub_disk_read (disk, data->fat_sector,
+			  (grub_off_t) block << GRUB_FAT_FAT_BLOCK_BITS,
+			  GRUB_FAT_FAT_BLOCK_SIZE, data->fat_buf))
+	return grub_errno;
+      data->fat_block = block;
+    }
+
+  grub_memcpy (entry, data->fat_buf + in_block, size);
+  return GRUB_ERR_NONE;
+}
+
+/* Move NODE to the next cluster of its chain.  Return 1 on success, 0 at
+   the end of the chain and -1 on error.  */
+static int
+grub_fat_next_cluster (grub_disk_t disk, grub_fshelp_node_t node)
+{
+  grub_uint32_t next_cluster = 0;
+  grub_uint32_t fat_offset;
+
+  switch (node->data->fat_size)
+    {
+    case 32:
+      fat_offset = node->cur_cluster << 2;
+      break;
+    case 16:
+      fat_offset = node->cur_cluster << 1;
+      break;
+    default:
+      /* case 12: */
+      fat_offset = node->cur_cluster + (node->cur_cluster >> 1);
+      break;
+    }
+
+  /* Read the FAT.  */
+  if (grub_fat_read_fat (disk, node->data, fat_offset,
+			 (node->data->fat_size + 7) >> 3, &next_cluster))
+    return -1;
+
+  next_cluster = grub_le_to_cpu32 (next_cluster);
+  switch (node->data->fat_size)
+    {
+    case 16:
+      next_cluster &= 0xFFFF;
+      break;
+    case 12:
+      if (node->cur_cluster & 1)
+	next_cluster >>= 4;
+
+      next_cluster &= 0x0FFF;
+      break;
+    }
+
+  grub_dprintf ("fat", "fat_size=%d, next_cluster=%u\n",
+		node->data->fat_size, next_cluster);
+
+  /* Check the end.  */
+  if (next_cluster >= node->data->cluster_eof_mark)
+    return 0;
+
+  if (next_cluster < 2 || next_cluster >= node->data->num_clusters)
+    {
+      grub_error (GRUB_ERR_BAD_FS, "invalid cluster %u",
+		  next_cluster);
+      return -1;
+    }
+
+  node->cur_cluster = next_cluster;
+  node->cur_cluster_num++;
+  grub_fat_map_cluster (node, node->cur_cluster_num, next_cluster);
+  return 1;
+}
+
 static grub_ssize_t
 grub_fat_read_data (grub_disk_t disk, grub_fshelp_node_t node,
 		    grub_disk_read_hook_t read_hook, void *read_hook_data,
@@ -501,77 +690,80 @@ grub_fat_read_data (grub_disk_t disk, grub_fshelp_node_t node,
   logical_cluster = offset >> logical_cluster_bits;
   offset &= (1ULL << logical_cluster_bits) - 1;
 
-  if (logical_cluster < node->cur_cluster_num)
-    {
-      node->cur_cluster_num = 0;
-      node->cur_cluster = node->file_cluster;
-    }
-
   while (len)
     {
-      while (logical_cluster > node->cur_cluster_num)
+      struct grub_fat_extent *e;
+      grub_uint32_t run = 1;
+      grub_uint64_t want;
+
+      /* Start from the closest known cluster.  */
+      e = grub_fat_find_extent (node, logical_cluster);
+      if (e)
+	{
+	  node->cur_cluster_num = logical_cluster;
+	  node->cur_cluster = e->cluster + (logical_cluster - e->logical);
+	}
+      else if (node->mapped_clusters
+	       && (logical_cluster < node->cur_cluster_num
+		   || node->cur_cluster_num < node->mapped_clusters - 1))
+	{
+	  e = &node->extents[node->num_extents - 1];
+	  node->cur_cluster_num = node->mapped_clusters - 1;
+	  node->cur_cluster = e->cluster + e->length - 1;
+	}
+      else if (logical_cluster < node->cur_cluster_num)
 	{
-	  /* Find next cluster.  */
-	  grub_uint32_t next_cluster;
-	  grub_uint32_t fat_offset;
+	  node->cur_cluster_num = 0;
+	  node->cur_cluster = node->file_cluster;
+	  grub_fat_map_cluster (node, 0, node->file_cluster);
+	}
 
-	  switch (node->data->fat_size)
-	    {
-	    case 32:
-	      fat_offset = node->cur_cluster << 2;
-	      break;
-	    case 16:
-	      fat_offset = node->cur_cluster << 1;
-	      break;
-	    default:
-	      /* case 12: */
-	      fat_offset = node->cur_cluster + (node->cur_cluster >> 1);
-	      break;
-	    }
+      while (logical_cluster > node->cur_cluster_num)
+	{
+	  int r = grub_fat_next_cluster (disk, node);
 
-	  /* Read the FAT.  */
-	  if (grub_disk_read (disk, node->data->fat_sector, fat_offset,
-			      (node->data->fat_size + 7) >> 3,
-			      (char *) &next_cluster))
+	  if (r < 0)
 	    return -1;
+	  if (r == 0)
+	    return ret;
+	}
 
-	  next_cluster = grub_le_to_cpu32 (next_cluster);
-	  switch (node->data->fat_size)
+      /* Map the chain ahead as far as this read goes, so that contiguous
+	 clusters are read at once.  */
+      want = (offset + len + (1ULL << logical_cluster_bits) - 1)
+	>> logical_cluster_bits;
+      if (node->extents)
+	{
+	  while (node->cur_cluster_num == node->mapped_clusters - 1
+		 && node->cur_cluster_num - logical_cluster + 1 < want)
 	    {
-	    case 16:
-	      next_cluster &= 0xFFFF;
-	      break;
-	    case 12:
-	      if (node->cur_cluster & 1)
-		next_cluster >>= 4;
-
-	      next_cluster &= 0x0FFF;
-	      break;
-	    }
+	      int r = grub_fat_next_cluster (disk, node);
 
-	  grub_dprintf ("fat", "fat_size=%d, next_cluster=%u\n",
-			node->data->fat_size, next_cluster);
-
-	  /* Check the end.  */
-	  if (next_cluster >= node->data->cluster_eof_mark)
-	    return ret;
+	      if (r < 0)
+		return -1;
+	      if (r == 0)
+		break;
+	    }
 
-	  if (next_cluster < 2 || next_cluster >= node->data->num_clusters)
+	  e = grub_fat_find_extent (node, logical_cluster);
+	  if (e)
 	    {
-	      grub_error (GRUB_ERR_BAD_FS, "invalid cluster %u",
-			  next_cluster);
-	      return -1;
+	      run = e->logical + e->length - logical_cluster;
+	      if (run > want)
+		run = want;
 	    }
-
-	  node->cur_cluster = next_cluster;
-	  node->cur_cluster_num++;
 	}
 
       /* Read the data here.  */
-      sector = (node->data->cluster_sector
-		+ ((node->cur_cluster - 2)
-		   << node->data->cluster_bits));
-      size = (1 << logical_cluster_bits) - offset;
+      if (e)
+	sector = (node->data->cluster_sector
+		  + ((e->cluster + (logical_cluster - e->logical) - 2)
+		     << node->data->cluster_bits));
+      else
+	sector = (node->data->cluster_sector
+		  + ((node->cur_cluster - 2)
+		     << node->data->cluster_bits));
+      size = ((grub_size_t) run << logical_cluster_bits) - offset;
       if (size > len)
 	size = len;
 
@@ -585,7 +777,7 @@ grub_fat_read_data (grub_disk_t disk, grub_fshelp_node_t node,
       len -= size;
       buf += size;
       ret += size;
-      logical_cluster++;
+      logical_cluster += run;
       offset = 0;
     }
 
@@ -900,6 +1092,10 @@ static grub_err_t lookup_file (grub_fshelp_node_t node,
 	    (*foundnode)->file_cluster = node->data->root_cluster;
 #endif
 	  (*foundnode)->cur_cluster_num = ~0U;
+	  (*foundnode)->extents = NULL;
+	  (*foundnode)->num_extents = 0;
+	  (*foundnode)->alloc_extents = 0;
+	  (*foundnode)->mapped_clusters = 0;
 	  (*foundnode)->data = node->data;
 	  (*foundnode)->disk = node->disk;
 
@@ -1019,6 +1215,18 @@ grub_fat_open (grub_file_t file, const char *name)
   if (err)
     goto fail;
 
+  /* Map the cluster chain for random access.  */
+#ifdef MODE_EXFAT
+  if (!found->is_contiguous)
+#endif
+    {
+      found->extents = grub_malloc (16 * sizeof (found->extents[0]));
+      if (found->extents)
+	found->alloc_extents = 16;
+      else
+	grub_errno = GRUB_ERR_NONE;
+    }
+
   file->data = found;
   file->size = found->file_size;
 
@@ -1049,6 +1257,7 @@ grub_fat_close (grub_file_t file)
 {
   grub_fshelp_node_t node = file->data;
 
+  grub_free (node->extents);
   grub_free (node->data);
   grub_free (node);
 
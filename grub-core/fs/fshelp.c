@@ -21,6 +21,7 @@
 #include <grub/mm.h>
 #include <grub/misc.h>
 #include <grub/disk.h>
+#include <grub/partition.h>
 #include <grub/fshelp.h>
 #include <grub/dl.h>
 #include <grub/i18n.h>
@@ -40,6 +41,8 @@ struct stack_element {
   struct stack_element *parent;
   grub_fshelp_node_t node;
   enum grub_fshelp_filetype type;
+  /* Id of the directory entry cache entry for the node, 0 if none.  */
+  grub_uint32_t id;
 };
 
 /* Context for grub_fshelp_find_file.  */
@@ -49,6 +52,12 @@ struct grub_fshelp_find_file_ctx
   const char *path;
   grub_fshelp_node_t rootnode;
 
+  /* Directory entry cache key of the filesystem, only used if DISK is
+     set.  */
+  grub_disk_t disk;
+  grub_disk_addr_t part_start;
+  grub_size_t node_size;
+
   /* Global options. */
   int symlinknest;
 
@@ -56,6 +65,174 @@ struct grub_fshelp_find_file_ctx
   struct stack_element *currnode;
 };
 
+/* The directory entry cache of grub_fshelp_find_file_cached.  Entries are
+   keyed by the filesystem, the cache id of the directory they are in and
+   their name.  Ids are never reused, so entries of a directory which was
+   evicted just become unreachable and age out.  */
+#define DENTRY_CACHE_MAX	256
+#define DENTRY_HASH_SIZE	64
+#define DENTRY_ROOT_ID		1
+
+struct dentry
+{
+  struct dentry *hash_next;
+  struct dentry *lru_prev;
+  struct dentry *lru_next;
+
+  unsigned long dev_id;
+  unsigned long disk_id;
+  grub_disk_addr_t part_start;
+  iterate_dir_func iterate_dir;
+  grub_uint32_t parent;
+  grub_uint32_t hash;
+
+  grub_uint32_t id;
+  enum grub_fshelp_filetype type;
+  /* A copy of the node, NULL if the name does not exist.  */
+  grub_fshelp_node_t node;
+  char name[0];
+};
+
+static struct dentry *dentry_hash[DENTRY_HASH_SIZE];
+/* Most recently used first.  */
+static struct dentry *dentry_lru_head, *dentry_lru_tail;
+static unsigned dentry_count;
+static grub_uint32_t dentry_next_id = DENTRY_ROOT_ID + 1;
+static grub_uint32_t dentry_generation;
+
+static grub_uint32_t
+dentry_name_hash (grub_uint32_t parent, const char *name)
+{
+  grub_uint32_t h = parent;
+
+  while (*name)
+    h = h * 31 + (grub_uint8_t) *name++;
+
+  return h;
+}
+
+static void
+dentry_lru_unlink (struct dentry *d)
+{
+  if (d->lru_prev)
+    d->lru_prev->lru_next = d->lru_next;
+  else
+    dentry_lru_head = d->lru_next;
+  if (d->lru_next)
+    d->lru_next->lru_prev = d->lru_prev;
+  else
+    dentry_lru_tail = d->lru_prev;
+}
+
+static void
+dentry_lru_push (struct dentry *d)
+{
+  d->lru_prev = 0;
+  d->lru_next = dentry_lru_head;
+  if (dentry_lru_head)
+    dentry_lru_head->lru_prev = d;
+  else
+    dentry_lru_tail = d;
+  dentry_lru_head = d;
+}
+
+static void
+dentry_remove (struct dentry *d)
+{
+  struct dentry **p;
+
+  for (p = &dentry_hash[d->hash % DENTRY_HASH_SIZE]; *p; p = &(*p)->hash_next)
+    if (*p == d)
+      {
+	*p = d->hash_next;
+	break;
+      }
+  dentry_lru_unlink (d);
+  dentry_count--;
+  grub_free (d->node);
+  grub_free (d);
+}
+
+static void
+dentry_flush (void)
+{
+  while (dentry_lru_head)
+    dentry_remove (dentry_lru_head);
+}
+
+static struct dentry *
+dentry_find (struct grub_fshelp_find_file_ctx *ctx,
+	     iterate_dir_func iterate_dir, const char *name)
+{
+  grub_uint32_t parent = ctx->currnode->id;
+  grub_uint32_t hash = dentry_name_hash (parent, name);
+  struct dentry *d;
+
+  for (d = dentry_hash[hash % DENTRY_HASH_SIZE]; d; d = d->hash_next)
+    if (d->hash == hash && d->parent == parent
+	&& d->iterate_dir == iterate_dir
+	&& d->dev_id == ctx->disk->dev->id && d->disk_id == ctx->disk->id
+	&& d->part_start == ctx->part_start
+	&& grub_strcmp (d->name, name) == 0)
+      {
+	dentry_lru_unlink (d);
+	dentry_lru_push (d);
+	return d;
+      }
+
+  return 0;
+}
+
+/* Remember the result of looking up NAME in the current directory and
+   return the id of the new entry, or 0 if it could not be stored.  */
+static grub_uint32_t
+dentry_add (struct grub_fshelp_find_file_ctx *ctx,
+	    iterate_dir_func iterate_dir, const char *name,
+	    grub_fshelp_node_t node, enum grub_fshelp_filetype type)
+{
+  struct dentry *d;
+  grub_size_t len = grub_strlen (name);
+
+  d = grub_malloc (sizeof (*d) + len + 1);
+  if (!d)
+    goto fail;
+
+  d->node = 0;
+  if (node)
+    {
+      d->node = grub_malloc (ctx->node_size);
+      if (!d->node)
+	{
+	  grub_free (d);
+	  goto fail;
+	}
+      grub_memcpy (d->node, node, ctx->node_size);
+    }
+
+  d->dev_id = ctx->disk->dev->id;
+  d->disk_id = ctx->disk->id;
+  d->part_start = ctx->part_start;
+  d->iterate_dir = iterate_dir;
+  d->parent = ctx->currnode->id;
+  d->hash = dentry_name_hash (d->parent, name);
+  d->id = dentry_next_id++;
+  d->type = type;
+  grub_memcpy (d->name, name, len + 1);
+
+  d->hash_next = dentry_hash[d->hash % DENTRY_HASH_SIZE];
+  dentry_hash[d->hash % DENTRY_HASH_SIZE] = d;
+  dentry_lru_push (d);
+  if (++dentry_count > DENTRY_CACHE_MAX)
+    dentry_remove (dentry_lru_tail);
+
+  return d->id;
+
+ fail:
+  /* The cache is only an optimization.  */
+  grub_errno = GRUB_ERR_NONE;
+  return 0;
+}
+
 /* Helper for find_file_iter.  */
 static void
 free_node (grub_fshelp_node_t node, struct grub_fshelp_find_file_ctx *ctx)
@@ -90,7 +267,8 @@ go_up_a_level (struct grub_fshelp_find_file_ctx *ctx)
 }
 
 static grub_err_t
-push_node (struct grub_fshelp_find_file_ctx *ctx, grub_fshelp_node_t node, enum grub_fshelp_filetype filetype)
+push_node (struct grub_fshelp_find_file_ctx *ctx, grub_fshelp_node_t node,
+	   enum grub_fshelp_filetype filetype, grub_uint32_t id)
 {
   struct stack_element *nst;
   nst = grub_malloc (sizeof (*nst));
@@ -98,6 +276,7 @@ push_node (struct grub_fshelp_find_file_ctx *ctx, grub_fshelp_node_t node, enum
     return grub_errno;
   nst->node = node;
   nst->type = filetype & ~GRUB_FSHELP_CASE_INSENSITIVE;
+  nst->id = id;
   nst->parent = ctx->currnode;
   ctx->currnode = nst;
   return GRUB_ERR_NONE;
@@ -107,7 +286,8 @@ static grub_err_t
 go_to_root (struct grub_fshelp_find_file_ctx *ctx)
 {
   free_stack (ctx);
-  return push_node (ctx, ctx->rootnode, GRUB_FSHELP_DIR);
+  return push_node (ctx, ctx->rootnode, GRUB_FSHELP_DIR,
+		    ctx->disk ? DENTRY_ROOT_ID : 0);
 }
 
 struct grub_fshelp_find_file_iter_ctx
@@ -158,6 +338,46 @@ directory_find_file (grub_fshelp_node_t node, const char *name, grub_fshelp_node
   return GRUB_ERR_NONE;
 }
 
+/* Look NAME up in the current directory through the directory entry
+   cache.  */
+static grub_err_t
+cached_find_file (struct grub_fshelp_find_file_ctx *ctx, const char *name,
+		  grub_fshelp_node_t *foundnode,
+		  enum grub_fshelp_filetype *foundtype, grub_uint32_t *foundid,
+		  iterate_dir_func iterate_dir, lookup_file_func lookup_file)
+{
+  struct dentry *d;
+  grub_err_t err;
+
+  d = dentry_find (ctx, iterate_dir, name);
+  if (d)
+    {
+      if (d->node)
+	{
+	  *foundnode = grub_malloc (ctx->node_size);
+	  if (!*foundnode)
+	    return grub_errno;
+	  grub_memcpy (*foundnode, d->node, ctx->node_size);
+	  /* Point the copy to the current mount.  */
+	  *(void **) *foundnode = *(void **) ctx->rootnode;
+	  *foundtype = d->type;
+	  *foundid = d->id;
+	}
+      return GRUB_ERR_NONE;
+    }
+
+  if (lookup_file)
+    err = lookup_file (ctx->currnode->node, name, foundnode, foundtype);
+  else
+    err = directory_find_file (ctx->currnode->node, name, foundnode,
+			       foundtype, iterate_dir);
+  if (err)
+    return err;
+
+  *foundid = dentry_add (ctx, iterate_dir, name, *foundnode, *foundtype);
+  return GRUB_ERR_NONE;
+}
+
 static grub_err_t
 find_file (char *currpath,
 	   iterate_dir_func iterate_dir, lookup_file_func lookup_file,
@@ -171,6 +391,7 @@ find_file (char *currpath,
       char c;
       grub_fshelp_node_t foundnode = NULL;
       enum grub_fshelp_filetype foundtype = 0;
+      grub_uint32_t foundid = 0;
 
       /* Remove all leading slashes.  */
       while (*name == '/')
@@ -202,7 +423,10 @@ find_file (char *currpath,
       /* Iterate over the directory.  */
       c = *next;
       *next = '\0';
-      if (lookup_file)
+      if (ctx->currnode->id)
+	err = cached_find_file (ctx, name, &foundnode, &foundtype, &foundid,
+				iterate_dir, lookup_file);
+      else if (lookup_file)
 	err = lookup_file (ctx->currnode->node, name, &foundnode, &foundtype);
       else
 	err = directory_find_file (ctx->currnode->node, name, &foundnode, &foundtype, iterate_dir);
@@ -214,7 +438,7 @@ find_file (char *currpath,
       if (!foundnode)
 	break;
 
-      push_node (ctx, foundnode, foundtype);
+      push_node (ctx, foundnode, foundtype, foundid);
  
       /* Read in the symlink and follow it.  */
       if (ctx->currnode->type == GRUB_FSHELP_SYMLINK)
@@ -264,11 +488,14 @@ grub_fshelp_find_file_real (const char *path, grub_fshelp_node_t rootnode,
 			    iterate_dir_func iterate_dir,
 			    lookup_file_func lookup_file,
 			    read_symlink_func read_symlink,
-			    enum grub_fshelp_filetype expecttype)
+			    enum grub_fshelp_filetype expecttype,
+			    grub_disk_t disk, grub_size_t node_size)
 {
   struct grub_fshelp_find_file_ctx ctx = {
     .path = path,
     .rootnode = rootnode,
+    .disk = disk,
+    .node_size = node_size,
     .symlinknest = 0,
     .currnode = 0
   };
@@ -281,6 +508,16 @@ grub_fshelp_find_file_real (const char *path, grub_fshelp_node_t rootnode,
       return grub_error (GRUB_ERR_BAD_FILENAME, N_("invalid file name `%s'"), path);
     }
 
+  if (disk)
+    {
+      if (dentry_generation != grub_disk_cache_generation)
+	{
+	  dentry_flush ();
+	  dentry_generation = grub_disk_cache_generation;
+	}
+      ctx.part_start = grub_partition_get_start (disk->partition);
+    }
+
   err = go_to_root (&ctx);
   if (err)
     return err;
@@ -327,10 +564,24 @@ grub_fshelp_find_file (const char *path, grub_fshelp_node_t rootnode,
 {
   return grub_fshelp_find_file_real (path, rootnode, foundnode,
 				     iterate_dir, NULL, 
-				     read_symlink, expecttype);
+				     read_symlink, expecttype, NULL, 0);
 
 }
 
+grub_err_t
+grub_fshelp_find_file_cached (const char *path, grub_fshelp_node_t rootnode,
+			      grub_fshelp_node_t *foundnode,
+			      iterate_dir_func iterate_dir,
+			      lookup_file_func lookup_file,
+			      read_symlink_func read_symlink,
+			      enum grub_fshelp_filetype expecttype,
+			      grub_disk_t disk, grub_size_t node_size)
+{
+  return grub_fshelp_find_file_real (path, rootnode, foundnode,
+				     iterate_dir, lookup_file, read_symlink,
+				     expecttype, disk, node_size);
+}
+
 grub_err_t
 grub_fshelp_find_file_lookup (const char *path, grub_fshelp_node_t rootnode,
 			      grub_fshelp_node_t *foundnode,
@@ -340,7 +591,7 @@ grub_fshelp_find_file_lookup (const char *path, grub_fshelp_node_t rootnode,
 {
   return grub_fshelp_find_file_real (path, rootnode, foundnode,
 				     NULL, lookup_file, 
-				     read_symlink, expecttype);
+				     read_symlink, expecttype, NULL, 0);
 
 }
 
@@ -427,3 +678,8 @@ grub_fshelp_read_file (grub_disk_t disk, grub_fshelp_node_t node,
 
   return len;
 }
+
+GRUB_MOD_FINI(fshelp)
+{
+  dentry_flush ();
+}
@@ -28,6 +28,7 @@
 #include <grub/fshelp.h>
 #include <grub/charset.h>
 #include <grub/datetime.h>
+#include <grub/partition.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -146,6 +147,17 @@ struct grub_iso9660_susp_ce
   grub_uint32_t len_be;
 } GRUB_PACKED;
 
+/* What identifies a mounted volume in the caches below.  */
+struct grub_iso9660_volume
+{
+  enum grub_disk_dev_id dev_id;
+  unsigned long disk_id;
+  grub_disk_addr_t part_start;
+  grub_uint32_t root_sector;
+  int rockridge;
+  int joliet;
+};
+
 struct grub_iso9660_data
 {
   struct grub_iso9660_primary_voldesc voldesc;
@@ -154,6 +166,7 @@ struct grub_iso9660_data
   int susp_skip;
   int joliet;
   struct grub_fshelp_node *node;
+  struct grub_iso9660_volume volume;
 };
 
 struct grub_fshelp_node
@@ -487,6 +500,14 @@ grub_iso9660_mount (grub_disk_t disk)
       block++;
     } while (voldesc.voldesc.type != GRUB_ISO9660_VOLDESC_END);
 
+  data->volume.dev_id = disk->dev->id;
+  data->volume.disk_id = disk->id;
+  data->volume.part_start = grub_partition_get_start (disk->partition);
+  data->volume.root_sector
+    = grub_le_to_cpu32 (data->voldesc.rootdir.first_sector);
+  data->volume.rockridge = data->rockridge;
+  data->volume.joliet = data->joliet;
+
   return data;
 
  fail:
@@ -653,9 +674,11 @@ susp_iterate_dir (struct grub_iso9660_susp_entry *entry,
   return 0;
 }
 
+/* Decode the records of directory DIR, calling HOOK for each entry.  */
 static int
-grub_iso9660_iterate_dir (grub_fshelp_node_t dir,
-			  grub_fshelp_iterate_dir_hook_t hook, void *hook_data)
+grub_iso9660_iterate_records (grub_fshelp_node_t dir,
+			      grub_fshelp_iterate_dir_hook_t hook,
+			      void *hook_data)
 {
   struct grub_iso9660_dir dirent;
   grub_off_t offset = 0;
@@ -837,6 +860,604 @@ grub_iso9660_iterate_dir (grub_fshelp_node_t dir,
 }
 
 
+/* Directories decoded recently, with their names already taken from the
+   Rock Ridge or Joliet records, so that further lookups and listings
+   neither parse the records nor read continuation areas again.  Mounts
+   are per operation, so the cache is global and keyed by volume; it is
+   dropped together with the disk cache.  */
+#define DIR_CACHE_SIZE		32
+#define DIR_CACHE_MAX_BYTES	(1024 * 1024)
+
+struct dir_cache_ent
+{
+  char *name;
+  enum grub_fshelp_filetype type;
+  grub_size_t have_dirents;
+  /* The records of all extents, followed by the symlink target and the
+     name in the same allocation.  */
+  struct grub_iso9660_dir *dirents;
+  char *symlink;
+};
+
+struct dir_cache
+{
+  struct grub_iso9660_volume volume;
+  grub_uint32_t sector;
+  grub_size_t count, alloc;
+  grub_size_t bytes;
+  struct dir_cache_ent *ents;
+  unsigned long last_use;
+  /* Listings being replayed are not freed until they are done.  */
+  int busy;
+  int stale;
+};
+
+static struct dir_cache dir_cache[DIR_CACHE_SIZE];
+static unsigned long dir_cache_clock;
+static grub_size_t dir_cache_bytes;
+static grub_uint32_t dir_cache_generation;
+
+static void
+dir_cache_free (struct dir_cache *dc)
+{
+  grub_size_t i;
+
+  for (i = 0; i < dc->count; i++)
+    grub_free (dc->ents[i].dirents);
+  grub_free (dc->ents);
+  dir_cache_bytes -= dc->bytes;
+  grub_memset (dc, 0, sizeof (*dc));
+}
+
+static void
+dir_cache_release (struct dir_cache *dc)
+{
+  if (!dc->ents)
+    return;
+  if (dc->busy)
+    dc->stale = 1;
+  else
+    dir_cache_free (dc);
+}
+
+static void
+dir_cache_flush (void)
+{
+  unsigned i;
+
+  for (i = 0; i < ARRAY_SIZE (dir_cache); i++)
+    dir_cache_release (&dir_cache[i]);
+}
+
+/* The path table of the volume used last, for finding directories without
+   reading their parents.  It only has the ISO 9660 or Joliet names, so it
+   is not used on Rock Ridge volumes.  */
+#define PATH_TABLE_MAX_SIZE	(4 * 1024 * 1024)
+
+struct path_table_dir
+{
+  grub_uint32_t sector;
+  grub_uint16_t parent;
+  char *name;
+};
+
+static struct
+{
+  struct grub_iso9660_volume volume;
+  int loaded;
+  grub_size_t count;
+  /* Directory number N is dirs[N - 1].  */
+  struct path_table_dir *dirs;
+  /* Indices into dirs ordered by sector.  */
+  grub_uint16_t *by_sector;
+  char *names;
+} path_table;
+
+static void
+path_table_free (void)
+{
+  grub_free (path_table.dirs);
+  grub_free (path_table.by_sector);
+  grub_free (path_table.names);
+  grub_memset (&path_table, 0, sizeof (path_table));
+}
+
+/* Drop everything read before the disk cache was last invalidated.  */
+static void
+check_cache_generation (void)
+{
+  if (dir_cache_generation != grub_disk_cache_generation)
+    {
+      dir_cache_flush ();
+      path_table_free ();
+      dir_cache_generation = grub_disk_cache_generation;
+    }
+}
+
+static grub_uint32_t
+node_sector (grub_fshelp_node_t node)
+{
+  return grub_le_to_cpu32 (node->dirents[0].first_sector);
+}
+
+/* Make a node of DATA for the cached entry E.  */
+static struct grub_fshelp_node *
+dir_cache_node (struct grub_iso9660_data *data, const struct dir_cache_ent *e)
+{
+  struct grub_fshelp_node *node;
+  grub_size_t alloc = ARRAY_SIZE (node->dirents);
+  grub_size_t symsize = e->symlink ? grub_strlen (e->symlink) + 1 : 0;
+
+  if (alloc < e->have_dirents)
+    alloc = e->have_dirents;
+  node = grub_malloc (sizeof (struct grub_fshelp_node)
+		      + (alloc - ARRAY_SIZE (node->dirents))
+		      * sizeof (node->dirents[0]) + symsize);
+  if (!node)
+    return NULL;
+  node->data = data;
+  node->alloc_dirents = alloc;
+  node->have_dirents = e->have_dirents;
+  node->have_symlink = !!e->symlink;
+  grub_memcpy (node->dirents, e->dirents,
+	       e->have_dirents * sizeof (node->dirents[0]));
+  if (e->symlink)
+    grub_strcpy (node->symlink + node->have_dirents * sizeof (node->dirents[0])
+		 - sizeof (node->dirents), e->symlink);
+  return node;
+}
+
+/* A listing being decoded by dir_cache_get.  */
+struct dir_cache_fill
+{
+  struct dir_cache dc;
+  struct grub_iso9660_data *data;
+  /* Once the listing is known not to fit, the entries decoded so far
+     are replayed to HOOK and the rest passed to it directly, so that
+     the records are not decoded a second time.  */
+  grub_fshelp_iterate_dir_hook_t hook;
+  void *hook_data;
+  int passing;
+};
+
+/* Pass the entries recorded in FILL to its hook.  */
+static int
+dir_cache_replay (struct dir_cache_fill *fill)
+{
+  grub_size_t i;
+
+  for (i = 0; i < fill->dc.count; i++)
+    {
+      struct grub_fshelp_node *node;
+
+      node = dir_cache_node (fill->data, &fill->dc.ents[i]);
+      if (!node)
+	return 1;
+      if (fill->hook (fill->dc.ents[i].name, fill->dc.ents[i].type,
+		      node, fill->hook_data))
+	return 1;
+    }
+  return 0;
+}
+
+/* Helper for dir_cache_get.  Takes over NODE.  */
+static int
+dir_cache_record (const char *filename, enum grub_fshelp_filetype filetype,
+		  grub_fshelp_node_t node, void *data)
+{
+  struct dir_cache_fill *fill = data;
+  struct dir_cache *dc = &fill->dc;
+  struct dir_cache_ent *e;
+  grub_size_t dsize, symsize = 0, namesize, size;
+  char *symlink = NULL;
+  char *blob;
+
+  if (fill->passing)
+    return fill->hook (filename, filetype, node, fill->hook_data);
+
+  if (node->have_symlink)
+    {
+      symlink = node->symlink + node->have_dirents * sizeof (node->dirents[0])
+	- sizeof (node->dirents);
+      symsize = grub_strlen (symlink) + 1;
+    }
+  dsize = node->have_dirents * sizeof (node->dirents[0]);
+  namesize = grub_strlen (filename) + 1;
+  size = dsize + symsize + namesize;
+
+  if (dc->bytes + size + sizeof (*e) > DIR_CACHE_MAX_BYTES)
+    goto fail;
+
+  if (dc->count == dc->alloc)
+    {
+      grub_size_t alloc = dc->alloc ? 2 * dc->alloc : 32;
+
+      e = grub_realloc (dc->ents, alloc * sizeof (*e));
+      if (!e)
+	goto fail;
+      dc->ents = e;
+      dc->bytes += (alloc - dc->alloc) * sizeof (*e);
+      dc->alloc = alloc;
+    }
+
+  blob = grub_malloc (size);
+  if (!blob)
+    goto fail;
+  grub_memcpy (blob, node->dirents, dsize);
+  if (symlink)
+    grub_memcpy (blob + dsize, symlink, symsize);
+  grub_memcpy (blob + dsize + symsize, filename, namesize);
+
+  e = &dc->ents[dc->count++];
+  e->dirents = (struct grub_iso9660_dir *) blob;
+  e->have_dirents = node->have_dirents;
+  e->symlink = symlink ? blob + dsize : NULL;
+  e->name = blob + dsize + symsize;
+  e->type = filetype;
+  dc->bytes += size;
+
+  grub_free (node);
+  return 0;
+
+ fail:
+  /* The listing does not fit.  Any error is from the allocations above.  */
+  grub_errno = GRUB_ERR_NONE;
+  fill->passing = 1;
+  if (dir_cache_replay (fill))
+    {
+      grub_free (node);
+      return 1;
+    }
+  return fill->hook (filename, filetype, node, fill->hook_data);
+}
+
+/* Return the decoded listing of DIR, decoding it first if needed.  If it
+   cannot be cached, the entries are passed to HOOK instead, its result is
+   stored in *HOOK_RET and NULL is returned.  */
+static struct dir_cache *
+dir_cache_get (grub_fshelp_node_t dir,
+	       grub_fshelp_iterate_dir_hook_t hook, void *hook_data,
+	       int *hook_ret)
+{
+  struct dir_cache_fill fill;
+  struct dir_cache *dc, *victim = NULL;
+  unsigned i;
+  int ret;
+
+  *hook_ret = 0;
+
+  check_cache_generation ();
+
+  for (i = 0; i < ARRAY_SIZE (dir_cache); i++)
+    {
+      dc = &dir_cache[i];
+      if (dc->ents && !dc->stale && dc->sector == node_sector (dir)
+	  && grub_memcmp (&dc->volume, &dir->data->volume,
+			  sizeof (dc->volume)) == 0)
+	{
+	  dc->last_use = ++dir_cache_clock;
+	  return dc;
+	}
+    }
+
+  grub_memset (&fill, 0, sizeof (fill));
+  fill.data = dir->data;
+  fill.hook = hook;
+  fill.hook_data = hook_data;
+  /* The decoded listing takes at least as much memory as the records.  */
+  fill.passing = get_node_size (dir) > DIR_CACHE_MAX_BYTES;
+  ret = grub_iso9660_iterate_records (dir, dir_cache_record, &fill);
+  /* Account for the listing before anything frees it.  */
+  dir_cache_bytes += fill.dc.bytes;
+  if (grub_errno || fill.passing || !fill.dc.ents)
+    {
+      if (fill.passing)
+	*hook_ret = ret;
+      dir_cache_free (&fill.dc);
+      return NULL;
+    }
+
+  for (i = 0; i < ARRAY_SIZE (dir_cache); i++)
+    {
+      dc = &dir_cache[i];
+      if (dc->busy)
+	continue;
+      if (!dc->ents)
+	{
+	  victim = dc;
+	  break;
+	}
+      if (!victim || dc->last_use < victim->last_use)
+	victim = dc;
+    }
+  if (victim)
+    dir_cache_free (victim);
+  for (i = 0; i < ARRAY_SIZE (dir_cache)
+	 && dir_cache_bytes > DIR_CACHE_MAX_BYTES; i++)
+    if (&dir_cache[i] != victim)
+      dir_cache_release (&dir_cache[i]);
+  if (!victim || dir_cache_bytes > DIR_CACHE_MAX_BYTES)
+    {
+      *hook_ret = dir_cache_replay (&fill);
+      dir_cache_free (&fill.dc);
+      return NULL;
+    }
+
+  *victim = fill.dc;
+  victim->volume = dir->data->volume;
+  victim->sector = node_sector (dir);
+  victim->last_use = ++dir_cache_clock;
+  return victim;
+}
+
+static int
+grub_iso9660_iterate_dir (grub_fshelp_node_t dir,
+			  grub_fshelp_iterate_dir_hook_t hook, void *hook_data)
+{
+  struct dir_cache *dc;
+  grub_size_t i;
+  int ret = 0;
+
+  dc = dir_cache_get (dir, hook, hook_data, &ret);
+  if (!dc)
+    return ret;
+
+  /* HOOK may look into other directories of the volume.  */
+  dc->busy++;
+  for (i = 0; i < dc->count && !ret; i++)
+    {
+      struct grub_fshelp_node *node;
+
+      node = dir_cache_node (dir->data, &dc->ents[i]);
+      if (!node)
+	break;
+      ret = hook (dc->ents[i].name, dc->ents[i].type, node, hook_data);
+    }
+  if (!--dc->busy && dc->stale)
+    dir_cache_free (dc);
+  return ret;
+}
+
+/* Parse the little endian path table of DATA.  Returns 0 if the volume
+   has no usable path table.  */
+static int
+path_table_load (struct grub_iso9660_data *data)
+{
+  grub_uint32_t size = grub_le_to_cpu32 (data->voldesc.path_table_size);
+  grub_uint8_t *raw = NULL;
+  char *names;
+  grub_size_t count = 0, namebytes = 0, pos, i, j;
+
+  check_cache_generation ();
+
+  if (path_table.loaded
+      && grub_memcmp (&path_table.volume, &data->volume,
+		      sizeof (path_table.volume)) == 0)
+    return path_table.count != 0;
+
+  path_table_free ();
+
+  if (data->rockridge || size < sizeof (struct grub_iso9660_path)
+      || size > PATH_TABLE_MAX_SIZE)
+    goto fail;
+
+  raw = grub_malloc (size);
+  if (!raw)
+    goto fail;
+  if (grub_disk_read (data->disk, ((grub_disk_addr_t) grub_le_to_cpu32
+				   (data->voldesc.path_table))
+		      << GRUB_ISO9660_LOG2_BLKSZ, 0, size, raw))
+    goto fail;
+
+  for (pos = 0; pos + sizeof (struct grub_iso9660_path) <= size; count++)
+    {
+      struct grub_iso9660_path *rec = (struct grub_iso9660_path *) (raw + pos);
+
+      if (!rec->len || pos + sizeof (*rec) + rec->len > size
+	  || count == 0xffff)
+	goto fail;
+      namebytes += (data->joliet ? (rec->len >> 1) * GRUB_MAX_UTF8_PER_UTF16
+		    : rec->len) + 1;
+      pos += sizeof (*rec) + rec->len + (rec->len & 1);
+    }
+
+  path_table.dirs = grub_malloc (count * sizeof (path_table.dirs[0]));
+  path_table.by_sector = grub_malloc (count
+				     * sizeof (path_table.by_sector[0]));
+  names = path_table.names = grub_malloc (namebytes);
+  if (!path_table.dirs || !path_table.by_sector || !names)
+    goto fail;
+
+  for (pos = 0, i = 0; i < count; i++)
+    {
+      struct grub_iso9660_path *rec = (struct grub_iso9660_path *) (raw + pos);
+      struct path_table_dir *d = &path_table.dirs[i];
+
+      d->sector = grub_le_to_cpu32 (rec->first_sector);
+      d->parent = grub_le_to_cpu16 (rec->parentdir);
+      d->name = names;
+      /* Parents come first and the table is ordered by parent.  */
+      if (d->parent == 0 || d->parent > i + 1
+	  || (i > 0 && d->parent < path_table.dirs[i - 1].parent))
+	goto fail;
+      if (data->joliet)
+	{
+	  grub_uint16_t t[MAX_NAMELEN / 2 + 1];
+	  unsigned k;
+
+	  for (k = 0; k < (unsigned) rec->len >> 1; k++)
+	    t[k] = grub_be_to_cpu16 (grub_get_unaligned16 (rec->name + 2 * k));
+	  names = (char *) grub_utf16_to_utf8 ((grub_uint8_t *) names, t, k);
+	}
+      else
+	for (j = 0; j < rec->len; j++)
+	  *names++ = grub_tolower (rec->name[j]);
+      *names++ = '\0';
+      pos += sizeof (*rec) + rec->len + (rec->len & 1);
+
+      /* Insertion sort, the table is mostly in sector order already.  */
+      for (j = i; j > 0
+	     && path_table.dirs[path_table.by_sector[j - 1]].sector > d->sector;
+	   j--)
+	path_table.by_sector[j] = path_table.by_sector[j - 1];
+      path_table.by_sector[j] = i;
+    }
+
+  if (path_table.dirs[0].sector != data->volume.root_sector)
+    goto fail;
+
+  grub_free (raw);
+  path_table.volume = data->volume;
+  path_table.loaded = 1;
+  path_table.count = count;
+  return 1;
+
+ fail:
+  grub_free (raw);
+  path_table_free ();
+  path_table.volume = data->volume;
+  path_table.loaded = 1;
+  if (grub_errno == GRUB_ERR_OUT_OF_MEMORY)
+    grub_errno = GRUB_ERR_NONE;
+  return 0;
+}
+
+/* Find the subdirectory NAME of DIR in the path table.  */
+static struct grub_fshelp_node *
+path_table_lookup (grub_fshelp_node_t dir, const char *name)
+{
+  grub_uint32_t sector = node_sector (dir);
+  struct grub_fshelp_node *node;
+  grub_size_t lo = 0, hi = path_table.count, num, i;
+
+  while (lo < hi)
+    {
+      grub_size_t mid = (lo + hi) / 2;
+
+      if (path_table.dirs[path_table.by_sector[mid]].sector < sector)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  if (lo == path_table.count
+      || path_table.dirs[path_table.by_sector[lo]].sector != sector)
+    return NULL;
+  num = path_table.by_sector[lo] + 1;
+
+  /* Children are grouped by parent number; the root is its own parent.  */
+  lo = 1;
+  hi = path_table.count;
+  while (lo < hi)
+    {
+      grub_size_t mid = (lo + hi) / 2;
+
+      if (path_table.dirs[mid].parent < num)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  for (i = lo; i < path_table.count && path_table.dirs[i].parent == num; i++)
+    if (dir->data->joliet ? grub_strcmp (path_table.dirs[i].name, name) == 0
+	: grub_strcasecmp (path_table.dirs[i].name, name) == 0)
+      break;
+  if (i == path_table.count || path_table.dirs[i].parent != num)
+    return NULL;
+
+  /* The "." record of the directory gives its size.  */
+  node = grub_malloc (sizeof (struct grub_fshelp_node));
+  if (!node)
+    return NULL;
+  node->data = dir->data;
+  node->alloc_dirents = ARRAY_SIZE (node->dirents);
+  node->have_dirents = 1;
+  node->have_symlink = 0;
+  if (grub_disk_read (dir->data->disk, ((grub_disk_addr_t)
+					path_table.dirs[i].sector)
+		      << GRUB_ISO9660_LOG2_BLKSZ, 0,
+		      sizeof (node->dirents[0]), &node->dirents[0])
+      || node_sector (node) != path_table.dirs[i].sector
+      || (node->dirents[0].flags & FLAG_TYPE) != FLAG_TYPE_DIR)
+    {
+      grub_free (node);
+      grub_errno = GRUB_ERR_NONE;
+      return NULL;
+    }
+  return node;
+}
+
+struct grub_iso9660_lookup_ctx
+{
+  const char *name;
+  grub_fshelp_node_t *foundnode;
+  enum grub_fshelp_filetype *foundtype;
+};
+
+/* Helper for grub_iso9660_lookup_file.  */
+static int
+grub_iso9660_lookup_iter (const char *filename,
+			  enum grub_fshelp_filetype filetype,
+			  grub_fshelp_node_t node, void *data)
+{
+  struct grub_iso9660_lookup_ctx *ctx = data;
+
+  if ((filetype & GRUB_FSHELP_CASE_INSENSITIVE)
+      ? grub_strcasecmp (ctx->name, filename)
+      : grub_strcmp (ctx->name, filename))
+    {
+      grub_free (node);
+      return 0;
+    }
+
+  *ctx->foundnode = node;
+  *ctx->foundtype = filetype;
+  return 1;
+}
+
+/* Look the single name NAME up in DIR.  */
+static grub_err_t
+grub_iso9660_lookup_file (grub_fshelp_node_t dir, const char *name,
+			  grub_fshelp_node_t *foundnode,
+			  enum grub_fshelp_filetype *foundtype)
+{
+  struct grub_iso9660_lookup_ctx ctx = {
+    .name = name,
+    .foundnode = foundnode,
+    .foundtype = foundtype
+  };
+  struct dir_cache *dc;
+  grub_size_t i;
+  int ret;
+
+  *foundnode = NULL;
+
+  if (path_table_load (dir->data))
+    {
+      *foundnode = path_table_lookup (dir, name);
+      if (*foundnode)
+	{
+	  *foundtype = GRUB_FSHELP_DIR;
+	  return GRUB_ERR_NONE;
+	}
+      if (grub_errno)
+	return grub_errno;
+    }
+
+  dc = dir_cache_get (dir, grub_iso9660_lookup_iter, &ctx, &ret);
+  if (!dc)
+    return grub_errno;
+
+  for (i = 0; i < dc->count; i++)
+    if ((dc->ents[i].type & GRUB_FSHELP_CASE_INSENSITIVE)
+	? grub_strcasecmp (name, dc->ents[i].name) == 0
+	: grub_strcmp (name, dc->ents[i].name) == 0)
+      {
+	*foundnode = dir_cache_node (dir->data, &dc->ents[i]);
+	*foundtype = dc->ents[i].type;
+	break;
+      }
+  return grub_errno;
+}
+
 
 /* Context for grub_iso9660_dir.  */
 struct grub_iso9660_dir_ctx
@@ -884,11 +1505,11 @@ grub_iso9660_dir (grub_device_t device, const char *path,
   rootnode.dirents[0] = data->voldesc.rootdir;
 
   /* Use the fshelp function to traverse the path.  */
-  if (grub_fshelp_find_file (path, &rootnode,
-			     &foundnode,
-			     grub_iso9660_iterate_dir,
-			     grub_iso9660_read_symlink,
-			     GRUB_FSHELP_DIR))
+  if (grub_fshelp_find_file_lookup (path, &rootnode,
+				    &foundnode,
+				    grub_iso9660_lookup_file,
+				    grub_iso9660_read_symlink,
+				    GRUB_FSHELP_DIR))
     goto fail;
 
   /* List the files in the directory.  */
@@ -927,11 +1548,11 @@ grub_iso9660_open (struct grub_file *file, const char *name)
   rootnode.dirents[0] = data->voldesc.rootdir;
 
   /* Use the fshelp function to traverse the path.  */
-  if (grub_fshelp_find_file (name, &rootnode,
-			     &foundnode,
-			     grub_iso9660_iterate_dir,
-			     grub_iso9660_read_symlink,
-			     GRUB_FSHELP_REG))
+  if (grub_fshelp_find_file_lookup (name, &rootnode,
+				    &foundnode,
+				    grub_iso9660_lookup_file,
+				    grub_iso9660_read_symlink,
+				    GRUB_FSHELP_REG))
     goto fail;
 
   data->node = foundnode;
@@ -1122,4 +1743,6 @@ GRUB_MOD_INIT(iso9660)
 GRUB_MOD_FINI(iso9660)
 {
   grub_fs_unregister (&grub_iso9660_fs);
+  dir_cache_flush ();
+  path_table_free ();
 }
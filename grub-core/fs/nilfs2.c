@@ -989,9 +989,10 @@ grub_nilfs2_open (struct grub_file *file, const char *name)
   if (!data)
     goto fail;
 
-  grub_fshelp_find_file (name, &data->diropen, &fdiro,
-			 grub_nilfs2_iterate_dir, grub_nilfs2_read_symlink,
-			 GRUB_FSHELP_REG);
+  grub_fshelp_find_file_cached (name, &data->diropen, &fdiro,
+				grub_nilfs2_iterate_dir, NULL,
+				grub_nilfs2_read_symlink, GRUB_FSHELP_REG,
+				data->disk, sizeof (*fdiro));
   if (grub_errno)
     goto fail;
 
@@ -1093,9 +1094,10 @@ grub_nilfs2_dir (grub_device_t device, const char *path,
   if (!ctx.data)
     goto fail;
 
-  grub_fshelp_find_file (path, &ctx.data->diropen, &fdiro,
-			 grub_nilfs2_iterate_dir, grub_nilfs2_read_symlink,
-			 GRUB_FSHELP_DIR);
+  grub_fshelp_find_file_cached (path, &ctx.data->diropen, &fdiro,
+				grub_nilfs2_iterate_dir, NULL,
+				grub_nilfs2_read_symlink, GRUB_FSHELP_DIR,
+				ctx.data->disk, sizeof (*fdiro));
   if (grub_errno)
     goto fail;
 
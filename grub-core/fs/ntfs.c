@@ -571,6 +571,37 @@ get_utf8 (grub_uint8_t *in, grub_size_t len)
   return (char *) buf;
 }
 
+/* Make the node for the index entry POS of DIRO.  */
+static struct grub_ntfs_file *
+entry_node (struct grub_ntfs_file *diro, grub_uint8_t *pos,
+	    enum grub_fshelp_filetype *type)
+{
+  struct grub_ntfs_file *fdiro;
+  grub_uint32_t attr;
+
+  attr = u32at (pos, 0x48);
+  if (attr & GRUB_NTFS_ATTR_REPARSE)
+    *type = GRUB_FSHELP_SYMLINK;
+  else if (attr & GRUB_NTFS_ATTR_DIRECTORY)
+    *type = GRUB_FSHELP_DIR;
+  else
+    *type = GRUB_FSHELP_REG;
+
+  /* Names outside of the POSIX namespace are case insensitive.  */
+  if (pos[0x51])
+    *type |= GRUB_FSHELP_CASE_INSENSITIVE;
+
+  fdiro = grub_zalloc (sizeof (struct grub_ntfs_file));
+  if (!fdiro)
+    return NULL;
+
+  fdiro->data = diro->data;
+  fdiro->ino = u64at (pos, 0) & 0xffffffffffffULL;
+  fdiro->mtime = u64at (pos, 0x20);
+
+  return fdiro;
+}
+
 static int
 list_file (struct grub_ntfs_file *diro, grub_uint8_t *pos,
 	   grub_fshelp_iterate_dir_hook_t hook, void *hook_data)
@@ -598,32 +629,17 @@ list_file (struct grub_ntfs_file *diro, grub_uint8_t *pos,
 	{
 	  enum grub_fshelp_filetype type;
 	  struct grub_ntfs_file *fdiro;
-	  grub_uint32_t attr;
-
-	  attr = u32at (pos, 0x48);
-	  if (attr & GRUB_NTFS_ATTR_REPARSE)
-	    type = GRUB_FSHELP_SYMLINK;
-	  else if (attr & GRUB_NTFS_ATTR_DIRECTORY)
-	    type = GRUB_FSHELP_DIR;
-	  else
-	    type = GRUB_FSHELP_REG;
 
-	  fdiro = grub_zalloc (sizeof (struct grub_ntfs_file));
+	  fdiro = entry_node (diro, pos, &type);
 	  if (!fdiro)
 	    return 0;
 
-	  fdiro->data = diro->data;
-	  fdiro->ino = u64at (pos, 0) & 0xffffffffffffULL;
-	  fdiro->mtime = u64at (pos, 0x20);
-
 	  ustr = get_utf8 (np, ns);
 	  if (ustr == NULL)
 	    {
 	      grub_free (fdiro);
 	      return 0;
 	    }
-          if (namespace)
-            type |= GRUB_FSHELP_CASE_INSENSITIVE;
 
 	  if (hook (ustr, type, fdiro, hook_data))
 	    {
@@ -730,6 +746,56 @@ grub_ntfs_read_symlink (grub_fshelp_node_t node)
   return buf;
 }
 
+/* Find the $I30 index root of MFT with AT.  Return its value, and its
+   length in *LEN.  */
+static grub_uint8_t *
+locate_index_root (struct grub_ntfs_attr *at, struct grub_ntfs_file *mft,
+		   grub_size_t *len)
+{
+  grub_uint8_t *cur_pos;
+
+  init_attr (at, mft);
+  while (1)
+    {
+      cur_pos = find_attr (at, GRUB_NTFS_AT_INDEX_ROOT);
+      if (cur_pos == NULL)
+	{
+	  grub_error (GRUB_ERR_BAD_FS, "no $INDEX_ROOT");
+	  return NULL;
+	}
+
+      /* Resident, Namelen=4, Offset=0x18, Flags=0x00, Name="$I30" */
+      if ((u32at (cur_pos, 8) != 0x180400) ||
+	  (u32at (cur_pos, 0x18) != 0x490024) ||
+	  (u32at (cur_pos, 0x1C) != 0x300033))
+	continue;
+      *len = u32at (cur_pos, 0x10);
+      cur_pos += u16at (cur_pos, 0x14);
+      if (*cur_pos != 0x30)	/* Not filename index */
+	continue;
+      return cur_pos;
+    }
+}
+
+/* Find the $I30 index allocation of MFT with AT.  */
+static grub_uint8_t *
+locate_index_allocation (struct grub_ntfs_attr *at, struct grub_ntfs_file *mft)
+{
+  grub_uint8_t *cur_pos;
+
+  cur_pos = locate_attr (at, mft, GRUB_NTFS_AT_INDEX_ALLOCATION);
+  while (cur_pos != NULL)
+    {
+      /* Non-resident, Namelen=4, Offset=0x40, Flags=0, Name="$I30" */
+      if ((u32at (cur_pos, 8) == 0x400401) &&
+	  (u32at (cur_pos, 0x40) == 0x490024) &&
+	  (u32at (cur_pos, 0x44) == 0x300033))
+	break;
+      cur_pos = find_attr (at, GRUB_NTFS_AT_INDEX_ALLOCATION);
+    }
+  return cur_pos;
+}
+
 static int
 grub_ntfs_iterate_dir (grub_fshelp_node_t dir,
 		       grub_fshelp_iterate_dir_hook_t hook, void *hook_data)
@@ -738,7 +804,7 @@ grub_ntfs_iterate_dir (grub_fshelp_node_t dir,
   struct grub_ntfs_attr attr, *at;
   grub_uint8_t *cur_pos, *indx, *bmp;
   int ret = 0;
-  grub_size_t bitmap_len;
+  grub_size_t bitmap_len, root_len;
   struct grub_ntfs_file *mft;
 
   mft = (struct grub_ntfs_file *) dir;
@@ -753,26 +819,9 @@ grub_ntfs_iterate_dir (grub_fshelp_node_t dir,
   bmp = NULL;
 
   at = &attr;
-  init_attr (at, mft);
-  while (1)
-    {
-      cur_pos = find_attr (at, GRUB_NTFS_AT_INDEX_ROOT);
-      if (cur_pos == NULL)
-	{
-	  grub_error (GRUB_ERR_BAD_FS, "no $INDEX_ROOT");
-	  goto done;
-	}
-
-      /* Resident, Namelen=4, Offset=0x18, Flags=0x00, Name="$I30" */
-      if ((u32at (cur_pos, 8) != 0x180400) ||
-	  (u32at (cur_pos, 0x18) != 0x490024) ||
-	  (u32at (cur_pos, 0x1C) != 0x300033))
-	continue;
-      cur_pos += u16at (cur_pos, 0x14);
-      if (*cur_pos != 0x30)	/* Not filename index */
-	continue;
-      break;
-    }
+  cur_pos = locate_index_root (at, mft, &root_len);
+  if (cur_pos == NULL)
+    goto done;
 
   cur_pos += 0x10;		/* Skip index root */
   ret = list_file (mft, cur_pos + u16at (cur_pos, 0), hook, hook_data);
@@ -824,16 +873,7 @@ grub_ntfs_iterate_dir (grub_fshelp_node_t dir,
     }
 
   free_attr (at);
-  cur_pos = locate_attr (at, mft, GRUB_NTFS_AT_INDEX_ALLOCATION);
-  while (cur_pos != NULL)
-    {
-      /* Non-resident, Namelen=4, Offset=0x40, Flags=0, Name="$I30" */
-      if ((u32at (cur_pos, 8) == 0x400401) &&
-	  (u32at (cur_pos, 0x40) == 0x490024) &&
-	  (u32at (cur_pos, 0x44) == 0x300033))
-	break;
-      cur_pos = find_attr (at, GRUB_NTFS_AT_INDEX_ALLOCATION);
-    }
+  cur_pos = locate_index_allocation (at, mft);
 
   if ((!cur_pos) && (bitmap))
     {
@@ -883,6 +923,318 @@ done:
   return ret;
 }
 
+/* Context for grub_ntfs_lookup_file.  */
+struct grub_ntfs_lookup_ctx
+{
+  struct grub_ntfs_data *data;
+  /* The name looked up, in UTF-16.  */
+  grub_uint16_t *key;
+  grub_size_t keylen;
+  /* $UpCase, opened when the first page of it is needed.  */
+  struct grub_ntfs_file upcase;
+  int upcase_open;
+};
+
+/* Store the uppercase form of C in *UC, reading the page of $UpCase it
+   is in if needed.  */
+static grub_err_t
+upcase_char (struct grub_ntfs_lookup_ctx *ctx, grub_uint16_t c,
+	     grub_uint16_t *uc)
+{
+  struct grub_ntfs_data *data = ctx->data;
+  unsigned page = c >> GRUB_NTFS_UPCASE_PAGE_SHIFT;
+  grub_uint16_t *p;
+  unsigned i;
+
+  if (data->upcase_loaded[page / 32] & (1U << (page % 32)))
+    {
+      *uc = data->upcase[c];
+      return GRUB_ERR_NONE;
+    }
+
+  if (!data->upcase)
+    {
+      data->upcase = grub_malloc (0x10000 * sizeof (data->upcase[0]));
+      if (!data->upcase)
+	return grub_errno;
+    }
+
+  if (!ctx->upcase_open)
+    {
+      ctx->upcase.data = data;
+      ctx->upcase_open = 1;
+      if (init_file (&ctx->upcase, GRUB_NTFS_FILE_UPCASE))
+	return grub_errno;
+      if (ctx->upcase.size < 0x10000 * sizeof (data->upcase[0]))
+	return grub_error (GRUB_ERR_BAD_FS, "invalid $UpCase");
+    }
+
+  p = data->upcase + (page << GRUB_NTFS_UPCASE_PAGE_SHIFT);
+  if (read_attr (&ctx->upcase.attr, (grub_uint8_t *) p,
+		 (page << GRUB_NTFS_UPCASE_PAGE_SHIFT) * sizeof (*p),
+		 (1 << GRUB_NTFS_UPCASE_PAGE_SHIFT) * sizeof (*p), 1, 0, 0))
+    return grub_errno;
+  for (i = 0; i < (1 << GRUB_NTFS_UPCASE_PAGE_SHIFT); i++)
+    p[i] = grub_le_to_cpu16 (p[i]);
+
+  data->upcase_loaded[page / 32] |= 1U << (page % 32);
+  *uc = data->upcase[c];
+  return GRUB_ERR_NONE;
+}
+
+/* Compare the key with the name NAME of NS characters, ignoring case, as
+   in the order of $I30 indexes.  Return -2 if $UpCase can not be read.  */
+static int
+collate_name (struct grub_ntfs_lookup_ctx *ctx, grub_uint8_t *name,
+	      grub_size_t ns)
+{
+  grub_size_t i;
+
+  for (i = 0; i < ctx->keylen && i < ns; i++)
+    {
+      grub_uint16_t a, b;
+
+      if (upcase_char (ctx, ctx->key[i], &a)
+	  || upcase_char (ctx, u16at (name, 2 * i), &b))
+	return -2;
+      if (a != b)
+	return (a < b) ? -1 : 1;
+    }
+  if (ctx->keylen != ns)
+    return (ctx->keylen < ns) ? -1 : 1;
+  return 0;
+}
+
+/* Check whether NAME of the index entry in NAMESPACE is the key, the way
+   grub_fshelp_find_file would compare the names.  */
+static int
+match_name (struct grub_ntfs_lookup_ctx *ctx, grub_uint8_t *name,
+	    grub_uint8_t namespace)
+{
+  grub_size_t i;
+
+  for (i = 0; i < ctx->keylen; i++)
+    {
+      grub_uint16_t a = ctx->key[i], b = u16at (name, 2 * i);
+
+      if (a == b)
+	continue;
+      if (!namespace || a >= 0x80 || b >= 0x80
+	  || grub_tolower (a) != grub_tolower (b))
+	return 0;
+    }
+  return 1;
+}
+
+/* Look the key up in the $I30 index of MFT.  Return 0 if the index can
+   not be used and the directory has to be searched linearly, or 1 with
+   *FOUNDNODE set to the node found or NULL, or with grub_errno set.  */
+static int
+index_lookup (struct grub_ntfs_lookup_ctx *ctx, struct grub_ntfs_file *mft,
+	      grub_fshelp_node_t *foundnode,
+	      enum grub_fshelp_filetype *foundtype)
+{
+  struct grub_ntfs_data *data = mft->data;
+  struct grub_ntfs_attr attr, *at = &attr;
+  grub_uint8_t *cur_pos, *pos, *end, *indx = NULL;
+  grub_size_t root_len, idx_bytes;
+  grub_uint64_t vcn;
+  int vcn_shift, depth, ret = 0;
+
+  idx_bytes = data->idx_size << GRUB_NTFS_BLK_SHR;
+  if (data->idx_size >= (1ULL << data->log_spc))
+    vcn_shift = data->log_spc + GRUB_NTFS_BLK_SHR;
+  else
+    vcn_shift = GRUB_NTFS_BLK_SHR;
+
+  cur_pos = locate_index_root (at, mft, &root_len);
+  if (cur_pos == NULL)
+    {
+      ret = 1;
+      goto done;
+    }
+  if (root_len < 0x20 || u32at (cur_pos, 4) != 1)	/* Not COLLATION_FILENAME */
+    goto done;
+
+  cur_pos += 0x10;		/* Skip index root */
+  pos = cur_pos + u32at (cur_pos, 0);
+  end = cur_pos + u32at (cur_pos, 4);
+  if (u32at (cur_pos, 4) > root_len - 0x10)
+    goto done;
+
+  for (depth = 0; depth < GRUB_NTFS_MAX_INDEX_DEPTH; depth++)
+    {
+      /* Find the first entry not below the key.  */
+      while (1)
+	{
+	  grub_size_t len;
+	  int cmp;
+
+	  if (pos + 0x10 > end)
+	    goto done;
+	  len = u16at (pos, 8);
+	  if (len < 0x10 || len > (grub_size_t) (end - pos)
+	      || ((pos[0xC] & 1) && len < 0x18))
+	    goto done;
+
+	  if (pos[0xC] & 2)	/* end signature */
+	    break;
+
+	  if (len < 0x52 || u16at (pos, 0xA) < 0x42
+	      || 0x52 + 2 * (grub_size_t) pos[0x50] > len)
+	    goto done;
+
+	  cmp = collate_name (ctx, pos + 0x52, pos[0x50]);
+	  if (cmp == -2)
+	    {
+	      grub_dprintf ("ntfs", "can't read $UpCase: %s\n", grub_errmsg);
+	      grub_errno = GRUB_ERR_NONE;
+	      goto done;
+	    }
+	  if (cmp < 0)
+	    break;
+	  if (cmp == 0)
+	    {
+	      /* DOS names are not listed, and names which only differ in
+		 case may follow in any order: leave them to the linear
+		 search.  */
+	      if (pos[0x51] == 2 || !match_name (ctx, pos + 0x52, pos[0x51]))
+		goto done;
+
+	      *foundnode = entry_node (mft, pos, foundtype);
+	      ret = 1;
+	      goto done;
+	    }
+	  pos += len;
+	}
+
+      /* The key would be in the subnode of this entry, if any.  */
+      if (!(pos[0xC] & 1))
+	{
+	  ret = 1;
+	  goto done;
+	}
+      vcn = u64at (pos, u16at (pos, 8) - 8);
+
+      if (!indx)
+	{
+	  free_attr (at);
+	  if (!locate_index_allocation (at, mft))
+	    goto done;
+	  indx = grub_malloc (idx_bytes);
+	  if (!indx)
+	    {
+	      ret = 1;
+	      goto done;
+	    }
+	}
+
+      if (read_attr (at, indx, vcn << vcn_shift, idx_bytes, 0, 0, 0)
+	  || fixup (indx, data->idx_size, (const grub_uint8_t *) "INDX"))
+	{
+	  ret = 1;
+	  goto done;
+	}
+      if (u64at (indx, 0x10) != vcn
+	  || 0x18 + (grub_size_t) u32at (indx, 0x1C) > idx_bytes)
+	goto done;
+      pos = indx + 0x18 + u32at (indx, 0x18);
+      end = indx + 0x18 + u32at (indx, 0x1C);
+    }
+
+ done:
+  free_attr (at);
+  grub_free (indx);
+  return ret;
+}
+
+/* Context for grub_ntfs_lookup_iter.  */
+struct grub_ntfs_lookup_iter_ctx
+{
+  const char *name;
+  grub_fshelp_node_t *foundnode;
+  enum grub_fshelp_filetype *foundtype;
+};
+
+/* Helper for grub_ntfs_lookup_file.  */
+static int
+grub_ntfs_lookup_iter (const char *filename,
+		       enum grub_fshelp_filetype filetype,
+		       grub_fshelp_node_t node, void *data)
+{
+  struct grub_ntfs_lookup_iter_ctx *ctx = data;
+
+  if ((filetype & GRUB_FSHELP_CASE_INSENSITIVE)
+      ? grub_strcasecmp (ctx->name, filename)
+      : grub_strcmp (ctx->name, filename))
+    {
+      grub_free (node);
+      return 0;
+    }
+
+  *ctx->foundnode = node;
+  *ctx->foundtype = filetype;
+  return 1;
+}
+
+/* Look up NAME in DIR by descending its $I30 B+tree, so that only the
+   index blocks on the path to the name are read.  */
+static grub_err_t
+grub_ntfs_lookup_file (grub_fshelp_node_t dir, const char *name,
+		       grub_fshelp_node_t *foundnode,
+		       enum grub_fshelp_filetype *foundtype)
+{
+  struct grub_ntfs_file *mft = dir;
+  struct grub_ntfs_lookup_ctx ctx;
+  struct grub_ntfs_lookup_iter_ctx iter_ctx = {
+    .name = name,
+    .foundnode = foundnode,
+    .foundtype = foundtype
+  };
+  const grub_uint8_t *name_end;
+  grub_size_t len;
+  int done = 0;
+
+  *foundnode = NULL;
+
+  if (!mft->inode_read)
+    {
+      if (init_file (mft, mft->ino))
+	return grub_errno;
+    }
+
+  grub_memset (&ctx, 0, sizeof (ctx));
+  ctx.data = mft->data;
+
+  len = grub_strlen (name);
+  /* NTFS names are at most 255 UTF-16 characters long.  */
+  if (len > 255 * GRUB_MAX_UTF8_PER_UTF16)
+    return GRUB_ERR_NONE;
+  ctx.key = grub_malloc (len * sizeof (ctx.key[0]) + 1);
+  if (!ctx.key)
+    return grub_errno;
+  ctx.keylen = grub_utf8_to_utf16 (ctx.key, len, (const grub_uint8_t *) name,
+				   len, &name_end);
+  if (ctx.keylen != (grub_size_t) -1
+      && name_end == (const grub_uint8_t *) name + len)
+    {
+      if (ctx.keylen > 255)
+	done = 1;
+      else
+	done = index_lookup (&ctx, mft, foundnode, foundtype);
+    }
+
+  if (ctx.upcase_open)
+    free_file (&ctx.upcase);
+  grub_free (ctx.key);
+
+  if (done)
+    return grub_errno;
+
+  grub_ntfs_iterate_dir (dir, grub_ntfs_lookup_iter, &iter_ctx);
+  return grub_errno;
+}
+
 static struct grub_ntfs_data *
 grub_ntfs_mount (grub_disk_t disk)
 {
@@ -969,6 +1321,7 @@ fail:
     {
       free_file (&data->mmft);
       free_file (&data->cmft);
+      grub_free (data->upcase);
       grub_free (data);
     }
   return 0;
@@ -1013,8 +1366,9 @@ grub_ntfs_dir (grub_device_t device, const char *path,
   if (!data)
     goto fail;
 
-  grub_fshelp_find_file (path, &data->cmft, &fdiro, grub_ntfs_iterate_dir,
-			 grub_ntfs_read_symlink, GRUB_FSHELP_DIR);
+  grub_fshelp_find_file_lookup (path, &data->cmft, &fdiro,
+				grub_ntfs_lookup_file, grub_ntfs_read_symlink,
+				GRUB_FSHELP_DIR);
 
   if (grub_errno)
     goto fail;
@@ -1031,6 +1385,7 @@ fail:
     {
       free_file (&data->mmft);
       free_file (&data->cmft);
+      grub_free (data->upcase);
       grub_free (data);
     }
 
@@ -1051,8 +1406,9 @@ grub_ntfs_open (grub_file_t file, const char *name)
   if (!data)
     goto fail;
 
-  grub_fshelp_find_file (name, &data->cmft, &mft, grub_ntfs_iterate_dir,
-			 grub_ntfs_read_symlink, GRUB_FSHELP_REG);
+  grub_fshelp_find_file_lookup (name, &data->cmft, &mft,
+				grub_ntfs_lookup_file, grub_ntfs_read_symlink,
+				GRUB_FSHELP_REG);
 
   if (grub_errno)
     goto fail;
@@ -1080,6 +1436,7 @@ fail:
     {
       free_file (&data->mmft);
       free_file (&data->cmft);
+      grub_free (data->upcase);
       grub_free (data);
     }
 
@@ -1113,6 +1470,7 @@ grub_ntfs_close (grub_file_t file)
     {
       free_file (&data->mmft);
       free_file (&data->cmft);
+      grub_free (data->upcase);
       grub_free (data);
     }
 
@@ -1173,6 +1531,7 @@ fail:
     {
       free_file (&data->mmft);
       free_file (&data->cmft);
+      grub_free (data->upcase);
       grub_free (data);
     }
 
@@ -1199,6 +1558,7 @@ grub_ntfs_uuid (grub_device_t device, char **uuid)
 	  *ptr = grub_toupper (*ptr);
       free_file (&data->mmft);
       free_file (&data->cmft);
+      grub_free (data->upcase);
       grub_free (data);
     }
   else
@@ -26,6 +26,7 @@
 #include <grub/video.h>
 #include <grub/bitmap.h>
 #include <grub/bitmap_scale.h>
+#include <grub/bitmap_cache.h>
 #include <grub/gfxmenu_view.h>
 #include <grub/menu.h>
 
@@ -262,8 +263,12 @@ to_loading_picture (animation_class_t vself, const char *dir,
   pstr = grub_stpcpy (pstr, ext);
   *pstr = '\0';
 
+  /* The decoded frames are shared through the bitmap cache, so replaying
+     the animation after the local cache is cleared does not decode the
+     files again.  */
   struct grub_video_bitmap *original_bitmap;
-  grub_video_bitmap_load (&original_bitmap, path);
+  grub_video_bitmap_cache_get (&original_bitmap, path, 0, 0,
+			       GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
   grub_free (path);
   grub_errno = GRUB_ERR_NONE;
 
@@ -276,7 +281,7 @@ to_loading_picture (animation_class_t vself, const char *dir,
 
   to_process_bitmap (&processed_bitmap, original_bitmap, vself);
 
-  grub_video_bitmap_destroy (original_bitmap);
+  grub_video_bitmap_cache_release (original_bitmap);
 
   if (!processed_bitmap)
     {
@@ -857,25 +862,19 @@ generate_new_bounds (animation_class_t vself)
   return cur_bounds;
 }
 
-static void
-animation_paint (void *vself, const grub_video_rect_t *region)
+/* Work out size and starting position the first time the animation is
+   shown.  Returns 0 if it cannot be shown.  */
+static int
+animation_layout (animation_class_t self)
 {
-  animation_class_t self = vself;
   enum attach_to_menu atm = self->bind_menu;
-  grub_video_rect_t old_save;
-  grub_video_rect_t new_bounds;
-
-  if (!self->dir_name || !self->cur_index || !self->view->is_animation)
-    {
-      return;
-    }
 
   if (!self->ani_w || !self->ani_h)
     {
       if (self->pic_ratio <= 0 || self->move_speed < 0 || !self->bounds.width
 	  || !self->bounds.height)
 	{
-	  return;
+	  return 0;
 	}
 
       if (atm || self->p_mode)
@@ -894,13 +893,31 @@ animation_paint (void *vself, const grub_video_rect_t *region)
 	}
     }
 
-  if (atm && self->follow_mark)
+  return 1;
+}
+
+static void
+animation_paint (void *vself, const grub_video_rect_t *region)
+{
+  animation_class_t self = vself;
+  grub_video_rect_t old_save;
+  grub_video_rect_t new_bounds;
+
+  if (!self->dir_name || !self->cur_index || !self->view->is_animation)
+    {
+      return;
+    }
+
+  if (!animation_layout (self))
     {
-      set_logo_position (self);
+      return;
     }
-  else
+
+  /* Moving is done frame by frame in animation_step, so that painting
+     more often does not make the animation faster.  */
+  if (self->bind_menu && self->follow_mark)
     {
-      animation_check_collision (self);
+      set_logo_position (self);
     }
 
   if (!grub_video_have_common_points (region, &self->bounds))
@@ -1153,12 +1170,77 @@ get_playback_state (animation_class_t vself)
     }
 }
 
+/* Advance by one frame: the next picture and, for moving animations, the
+   next position.  */
+static void
+animation_step (animation_class_t self)
+{
+  self->cur_index++;
+
+  if (self->cur_index % EXPLOSION_PROOF == 0)
+    {
+      animation_clear_cache (self);
+    }
+
+  if (self->cur_index > self->pic_num)
+    {
+      get_playback_state (self);
+
+      if (self->pic_num > EXPLOSION_PROOF)
+	{
+	  animation_clear_cache (self);
+	}
+    }
+
+  /* Not placed yet: the first paint does it.  */
+  if (self->ani_w && !(self->bind_menu && self->follow_mark))
+    {
+      animation_check_collision (self);
+    }
+}
+
+/* Tell the view what the last frames changed: where the picture was and
+   where it is now.  */
+static void
+animation_invalidate (animation_class_t self, int old_index,
+		      const grub_video_rect_t *old_rect)
+{
+  grub_video_rect_t new_rect = generate_new_bounds (self);
+
+  if (self->cur_index == old_index && new_rect.x == old_rect->x
+      && new_rect.y == old_rect->y && new_rect.width == old_rect->width
+      && new_rect.height == old_rect->height)
+    {
+      return;
+    }
+
+  if (!self->ani_w || !self->ani_h)
+    {
+      /* Placed when first painted.  */
+      grub_gfxmenu_view_invalidate (self->view, &self->bounds);
+      return;
+    }
+
+  if (old_index && old_rect->width)
+    {
+      grub_gfxmenu_view_invalidate (self->view, old_rect);
+    }
+
+  if (self->cur_index)
+    {
+      grub_gfxmenu_view_invalidate (self->view, &new_rect);
+    }
+}
+
 static void
 animation_refresh_info (void *vself, grub_gfxmenu_view_t view)
 {
   animation_class_t self = vself;
   self->view = view;
   int cur_selected = view->selected;
+  int frames = view->need_refresh;
+  int old_index = self->cur_index;
+  grub_video_rect_t old_rect = generate_new_bounds (self);
 
   if (self->bind_menu && (self->is_selected != cur_selected))
     {
@@ -1173,25 +1255,12 @@ animation_refresh_info (void *vself, grub_gfxmenu_view_t view)
       as_logo_function (self);
     }
 
-  if (self->view->need_refresh && !self->play_mark && self->pic_num > 0)
+  for (; frames > 0 && !self->play_mark && self->pic_num > 0; frames--)
     {
-      self->cur_index++;
-
-      if (self->cur_index % EXPLOSION_PROOF == 0)
-	{
-	  animation_clear_cache (self);
-	}
-
-      if (self->cur_index > self->pic_num)
-	{
-	  get_playback_state (self);
-
-	  if (self->pic_num > EXPLOSION_PROOF)
-	    {
-	      animation_clear_cache (self);
-	    }
-	}
+      animation_step (self);
     }
+
+  animation_invalidate (self, old_index, &old_rect);
 }
 
 grub_gui_component_t
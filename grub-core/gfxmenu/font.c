@@ -31,6 +31,290 @@
 #include <grub/fontformat.h>
 #include <grub/gfxmenu_view.h>
 
+/* Rendered strings are kept as bitmaps in the pixel order of the display,
+   so that redrawing a menu takes one blit per string instead of bidi
+   reordering, glyph construction and a blit per glyph.  */
+#define STRING_CACHE_SIZE	(1024 * 1024)
+
+struct string_run
+{
+  /* Next less recently used run.  */
+  struct string_run *next;
+  grub_uint32_t hash;
+  char *str;
+  grub_font_t font;
+  grub_video_color_t color;
+  enum grub_video_blit_format format;
+  /* Width as returned by grub_font_get_string_width, or -1 if unknown.  */
+  int width;
+  /* Position of the bitmap relative to the pen position and baseline.  */
+  int left;
+  int top;
+  /* Inked pixels, or NULL for a string without any.  */
+  struct grub_video_bitmap *bitmap;
+  /* Set for a string too large to keep as a bitmap, which is drawn glyph
+     by glyph instead without measuring it again.  */
+  int uncacheable;
+  grub_size_t size;
+};
+
+/* Most recently used first.  */
+static struct string_run *string_runs;
+static grub_size_t string_runs_size;
+
+static grub_uint32_t
+hash_string (const char *str)
+{
+  grub_uint32_t hash = 2166136261U;
+
+  for (; *str; str++)
+    hash = (hash ^ (grub_uint8_t) *str) * 16777619;
+  return hash;
+}
+
+static void
+free_run (struct string_run *run)
+{
+  grub_video_bitmap_destroy (run->bitmap);
+  grub_free (run->str);
+  grub_free (run);
+}
+
+/* Drop least recently used runs until the cache fits in LIMIT bytes.  */
+static void
+trim_runs (grub_size_t limit)
+{
+  while (string_runs && string_runs_size > limit)
+    {
+      struct string_run **p, *run;
+
+      for (p = &string_runs; (*p)->next; p = &(*p)->next)
+	;
+      run = *p;
+      *p = 0;
+      string_runs_size -= run->size;
+      free_run (run);
+    }
+}
+
+void
+grub_font_flush_string_cache (void)
+{
+  trim_runs (0);
+}
+
+/* Convert STR to glyphs in display order.  */
+static grub_ssize_t
+string_to_visual (const char *str, struct grub_unicode_glyph **visual)
+{
+  grub_uint32_t *logical;
+  grub_ssize_t logical_len, visual_len;
+
+  logical_len = grub_utf8_to_ucs4_alloc (str, &logical, 0);
+  if (logical_len < 0)
+    return -1;
+
+  visual_len = grub_bidi_logical_to_visual (logical, logical_len, visual,
+					    0, 0, 0, 0, 0, 0, 0);
+  grub_free (logical);
+  return visual_len;
+}
+
+static void
+free_visual (struct grub_unicode_glyph *visual, grub_ssize_t visual_len)
+{
+  struct grub_unicode_glyph *ptr;
+
+  for (ptr = visual; ptr < visual + visual_len; ptr++)
+    grub_unicode_destroy_glyph (ptr);
+  grub_free (visual);
+}
+
+/* Format strings are rendered in for the current render target, which the
+   blenders have a direct path for.  Returns 0 if there is none.  */
+static int
+run_format (enum grub_video_blit_format *format)
+{
+  struct grub_video_mode_info mode_info;
+
+  if (grub_video_get_info (&mode_info) != GRUB_ERR_NONE)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return 0;
+    }
+
+  switch (mode_info.blit_format)
+    {
+    case GRUB_VIDEO_BLIT_FORMAT_BGRA_8888:
+      *format = GRUB_VIDEO_BLIT_FORMAT_BGRA_8888;
+      return 1;
+    case GRUB_VIDEO_BLIT_FORMAT_RGBA_8888:
+    case GRUB_VIDEO_BLIT_FORMAT_BGR_888:
+    case GRUB_VIDEO_BLIT_FORMAT_RGB_888:
+      *format = GRUB_VIDEO_BLIT_FORMAT_RGBA_8888;
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+/* Render STR into a new run.  Glyphs are either fully inked or not at all,
+   so every pixel is either COLOR or transparent.  A string too large to be
+   worth caching gets a run without a bitmap marked as uncacheable.
+   Returns NULL if the string cannot be rendered.  */
+static struct string_run *
+render_run (const char *str, grub_font_t font, grub_video_color_t color,
+	    enum grub_video_blit_format format)
+{
+  struct grub_unicode_glyph *visual, *ptr;
+  grub_ssize_t visual_len;
+  struct grub_video_bitmap *bitmap = 0;
+  struct string_run *run = 0;
+  int x, left = 0, right = 0, top = 0, bottom = 0, empty = 1;
+  int uncacheable = 0;
+
+  visual_len = string_to_visual (str, &visual);
+  if (visual_len < 0)
+    return 0;
+
+  /* Find the box of all inked pixels first.  */
+  for (ptr = visual, x = 0; ptr < visual + visual_len; ptr++)
+    {
+      struct grub_font_glyph *glyph;
+      int gl, gt;
+
+      glyph = grub_font_construct_glyph (font, ptr);
+      if (!glyph)
+	goto out;
+      if (glyph->width != 0 && glyph->height != 0)
+	{
+	  gl = x + glyph->offset_x;
+	  gt = -glyph->offset_y - glyph->height;
+	  if (empty || gl < left)
+	    left = gl;
+	  if (empty || gl + glyph->width > right)
+	    right = gl + glyph->width;
+	  if (empty || gt < top)
+	    top = gt;
+	  if (empty || gt + glyph->height > bottom)
+	    bottom = gt + glyph->height;
+	  empty = 0;
+	}
+      x += glyph->device_width;
+    }
+
+  if (!empty && (grub_size_t) (right - left) * (bottom - top) * 4
+      > STRING_CACHE_SIZE / 4)
+    uncacheable = 1;
+  else if (!empty)
+    {
+      grub_uint8_t r, g, b, a;
+      grub_uint32_t pixel;
+
+      if (grub_video_bitmap_create (&bitmap, right - left, bottom - top,
+				    format) != GRUB_ERR_NONE)
+	goto out;
+
+      grub_video_unmap_color (color, &r, &g, &b, &a);
+      pixel = ((grub_uint32_t) r << bitmap->mode_info.red_field_pos)
+	| ((grub_uint32_t) g << bitmap->mode_info.green_field_pos)
+	| ((grub_uint32_t) b << bitmap->mode_info.blue_field_pos)
+	| ((grub_uint32_t) a << bitmap->mode_info.reserved_field_pos);
+
+      for (ptr = visual, x = 0; ptr < visual + visual_len; ptr++)
+	{
+	  struct grub_font_glyph *glyph;
+	  unsigned i, j, bit = 0;
+	  grub_uint8_t *row;
+
+	  glyph = grub_font_construct_glyph (font, ptr);
+	  if (!glyph)
+	    goto out;
+	  if (glyph->width == 0 || glyph->height == 0)
+	    {
+	      x += glyph->device_width;
+	      continue;
+	    }
+	  row = (grub_uint8_t *) bitmap->data
+	    + (-glyph->offset_y - glyph->height - top) * bitmap->mode_info.pitch
+	    + (x + glyph->offset_x - left) * 4;
+	  for (j = 0; j < glyph->height; j++, row += bitmap->mode_info.pitch)
+	    for (i = 0; i < glyph->width; i++, bit++)
+	      if (glyph->bitmap[bit >> 3] & (0x80 >> (bit & 7)))
+		((grub_uint32_t *) row)[i] = pixel;
+	  x += glyph->device_width;
+	}
+    }
+
+  run = grub_malloc (sizeof (*run));
+  if (!run)
+    goto out;
+  run->str = grub_strdup (str);
+  if (!run->str)
+    {
+      grub_free (run);
+      run = 0;
+      goto out;
+    }
+  run->font = font;
+  run->color = color;
+  run->format = format;
+  run->width = -1;
+  run->left = left;
+  run->top = top;
+  run->bitmap = bitmap;
+  run->uncacheable = uncacheable;
+  run->size = sizeof (*run) + grub_strlen (str) + 1;
+  if (bitmap)
+    run->size += (grub_size_t) bitmap->mode_info.pitch
+      * bitmap->mode_info.height;
+
+ out:
+  if (!run)
+    grub_video_bitmap_destroy (bitmap);
+  free_visual (visual, visual_len);
+  return run;
+}
+
+/* Find the run of STR in FONT drawn in COLOR, rendering it if it is not
+   cached yet.  Returns NULL if it cannot be rendered.  */
+static struct string_run *
+get_run (const char *str, grub_font_t font, grub_video_color_t color)
+{
+  enum grub_video_blit_format format;
+  struct string_run **p, *run;
+  grub_uint32_t hash;
+
+  if (!run_format (&format))
+    return 0;
+
+  hash = hash_string (str);
+  for (p = &string_runs; *p; p = &(*p)->next)
+    {
+      run = *p;
+      if (run->hash == hash && run->font == font && run->color == color
+	  && run->format == format && grub_strcmp (run->str, str) == 0)
+	{
+	  *p = run->next;
+	  run->next = string_runs;
+	  string_runs = run;
+	  return run;
+	}
+    }
+
+  run = render_run (str, font, color, format);
+  if (!run)
+    return 0;
+
+  run->hash = hash;
+  run->next = string_runs;
+  string_runs = run;
+  string_runs_size += run->size;
+  trim_runs (STRING_CACHE_SIZE);
+
+  return run;
+}
+
 /* Draw a UTF-8 string of text on the current video render target.
    The x coordinate specifies the starting x position for the first character,
    while the y coordinate specifies the baseline position.
@@ -42,18 +326,34 @@ grub_font_draw_string (const char *str, grub_font_t font,
                        int left_x, int baseline_y)
 {
   int x;
-  grub_uint32_t *logical;
-  grub_ssize_t logical_len, visual_len;
+  grub_ssize_t visual_len;
   struct grub_unicode_glyph *visual, *ptr;
+  struct string_run *run;
   grub_err_t err;
+  int pending;
 
-  logical_len = grub_utf8_to_ucs4_alloc (str, &logical, 0);
-  if (logical_len < 0)
-    return grub_errno;
+  /* Failing to cache is not an error of the caller, but errors already
+     pending are theirs.  */
+  pending = grub_errno != GRUB_ERR_NONE;
+  if (pending)
+    grub_error_push ();
+  run = get_run (str, font, color);
+  if (pending)
+    grub_error_pop ();
+  else
+    grub_errno = GRUB_ERR_NONE;
 
-  visual_len = grub_bidi_logical_to_visual (logical, logical_len, &visual,
-					    0, 0, 0, 0, 0, 0, 0);
-  grub_free (logical);
+  if (run && !run->uncacheable)
+    {
+      if (!run->bitmap)
+	return GRUB_ERR_NONE;
+      return grub_video_blit_bitmap (run->bitmap, GRUB_VIDEO_BLIT_BLEND,
+				     left_x + run->left, baseline_y + run->top,
+				     0, 0, run->bitmap->mode_info.width,
+				     run->bitmap->mode_info.height);
+    }
+
+  visual_len = string_to_visual (str, &visual);
   if (visual_len < 0)
     return grub_errno;
 
@@ -74,9 +374,7 @@ grub_font_draw_string (const char *str, grub_font_t font,
     }
 
 out:
-  for (ptr = visual; ptr < visual + visual_len; ptr++)
-    grub_unicode_destroy_glyph (ptr);
-  grub_free (visual);
+  free_visual (visual, visual_len);
 
   return err;
 }
@@ -91,6 +389,18 @@ grub_font_get_string_width (grub_font_t font, const char *str)
   grub_uint32_t *ptr;
   grub_ssize_t logical_len;
   grub_uint32_t *logical;
+  struct string_run *run;
+  grub_uint32_t hash;
+
+  /* Widths are asked for on every redraw to align labels; remember them
+     along with the rendered strings.  */
+  hash = hash_string (str);
+  for (run = string_runs; run; run = run->next)
+    if (run->hash == hash && run->font == font
+	&& grub_strcmp (run->str, str) == 0)
+      break;
+  if (run && run->width >= 0)
+    return run->width;
 
   logical_len = grub_utf8_to_ucs4_alloc (str, &logical, 0);
   if (logical_len < 0)
@@ -112,5 +422,8 @@ grub_font_get_string_width (grub_font_t font, const char *str)
     }
   grub_free (logical);
 
+  if (run)
+    run->width = width;
+
   return width;
 }
@@ -24,6 +24,7 @@
 #include <grub/gui_string_util.h>
 #include <grub/gfxmenu_view.h>
 #include <grub/gfxwidgets.h>
+#include <grub/bitmap_cache.h>
 #include <grub/trig.h>
 
 struct grub_gui_circular_progress
@@ -55,6 +56,8 @@ circprog_destroy (void *vself)
 {
   circular_progress_t self = vself;
   grub_gfxmenu_timeout_unregister ((grub_gui_component_t) self);
+  grub_video_bitmap_cache_release (self->center_bitmap);
+  grub_video_bitmap_cache_release (self->tick_bitmap);
   grub_free (self);
 }
 
@@ -88,7 +91,8 @@ load_bitmap (const char *dir, const char *file)
 
   /* Load the image.  */
   grub_errno = GRUB_ERR_NONE;
-  grub_video_bitmap_load (&bitmap, abspath);
+  grub_video_bitmap_cache_get (&bitmap, abspath, 0, 0,
+                               GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
   grub_errno = GRUB_ERR_NONE;
 
   grub_free (abspath);
@@ -100,8 +104,8 @@ check_pixmaps (circular_progress_t self)
 {
   if (self->need_to_load_pixmaps)
     {
-      if (self->center_bitmap)
-        grub_video_bitmap_destroy (self->center_bitmap);
+      grub_video_bitmap_cache_release (self->center_bitmap);
+      grub_video_bitmap_cache_release (self->tick_bitmap);
       self->center_bitmap = load_bitmap (self->theme_dir, self->center_file);
       self->tick_bitmap = load_bitmap (self->theme_dir, self->tick_file);
       self->need_to_load_pixmaps = 0;
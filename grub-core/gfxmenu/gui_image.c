@@ -23,6 +23,7 @@
 #include <grub/gui_string_util.h>
 #include <grub/bitmap.h>
 #include <grub/bitmap_scale.h>
+#include <grub/bitmap_cache.h>
 
 struct grub_gui_image
 {
@@ -32,6 +33,7 @@ struct grub_gui_image
   grub_video_rect_t bounds;
   char *id;
   char *theme_dir;
+  char *path;
   struct grub_video_bitmap *raw_bitmap;
   struct grub_video_bitmap *bitmap;
 };
@@ -45,9 +47,10 @@ image_destroy (void *vself)
 
   /* Free the scaled bitmap, unless it's a reference to the raw bitmap.  */
   if (self->bitmap && (self->bitmap != self->raw_bitmap))
-    grub_video_bitmap_destroy (self->bitmap);
+    grub_video_bitmap_cache_release (self->bitmap);
   if (self->raw_bitmap)
-    grub_video_bitmap_destroy (self->raw_bitmap);
+    grub_video_bitmap_cache_release (self->raw_bitmap);
+  grub_free (self->path);
 
   grub_free (self);
 }
@@ -108,7 +111,7 @@ rescale_image (grub_gui_image_t self)
     {
       if (self->bitmap)
         {
-          grub_video_bitmap_destroy (self->bitmap);
+          grub_video_bitmap_cache_release (self->bitmap);
           self->bitmap = 0;
         }
       return grub_errno;
@@ -128,7 +131,7 @@ rescale_image (grub_gui_image_t self)
   /* Free any old scaled bitmap,
      *unless* it's a reference to the raw bitmap.  */
   if (self->bitmap && (self->bitmap != self->raw_bitmap))
-    grub_video_bitmap_destroy (self->bitmap);
+    grub_video_bitmap_cache_release (self->bitmap);
 
   self->bitmap = 0;
 
@@ -145,12 +148,12 @@ rescale_image (grub_gui_image_t self)
   if (width <= 0 || height <= 0)
     return grub_errno;
 
-  /* Create the scaled bitmap.  */
-  grub_video_bitmap_create_scaled (&self->bitmap,
-                                   width,
-                                   height,
-                                   self->raw_bitmap,
-                                   GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
+  /* Get the scaled bitmap.  */
+  grub_video_bitmap_cache_get (&self->bitmap,
+                               self->path,
+                               width,
+                               height,
+                               GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
   return grub_errno;
 }
 
@@ -191,14 +194,26 @@ static grub_err_t
 load_image (grub_gui_image_t self, const char *path)
 {
   struct grub_video_bitmap *bitmap;
-  if (grub_video_bitmap_load (&bitmap, path) != GRUB_ERR_NONE)
+  char *path_copy;
+
+  path_copy = grub_strdup (path);
+  if (! path_copy)
     return grub_errno;
+  if (grub_video_bitmap_cache_get (&bitmap, path, 0, 0,
+                                   GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST)
+      != GRUB_ERR_NONE)
+    {
+      grub_free (path_copy);
+      return grub_errno;
+    }
 
   if (self->bitmap && (self->bitmap != self->raw_bitmap))
-    grub_video_bitmap_destroy (self->bitmap);
+    grub_video_bitmap_cache_release (self->bitmap);
   if (self->raw_bitmap)
-    grub_video_bitmap_destroy (self->raw_bitmap);
+    grub_video_bitmap_cache_release (self->raw_bitmap);
+  grub_free (self->path);
 
+  self->path = path_copy;
   self->raw_bitmap = bitmap;
   return rescale_image (self);
 }
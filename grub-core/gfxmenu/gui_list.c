@@ -83,6 +83,12 @@ struct grub_gui_list_impl
   grub_gfxmenu_icon_manager_t icon_manager;
 
   grub_gfxmenu_view_t view;
+
+  /* State the list was last drawn with, to report what changed.  */
+  grub_menu_t painted_menu;
+  int painted_first;
+  int painted_selected;
+  int painted_offset;
 };
 
 typedef struct grub_gui_list_impl *list_impl_t;
@@ -249,6 +255,82 @@ make_selected_item_visible (list_impl_t self)
     self->first_shown_index = selected_index - (num_shown_items - 1);
 }
 
+/* Get the screen area of the row showing ITEM_INDEX, spanning the whole
+   width of the list.  Return 0 if the item is not shown.  */
+static int
+get_item_rect (list_impl_t self, int item_index, grub_video_rect_t *rect)
+{
+  grub_gfxmenu_box_t box = self->menu_box;
+  grub_gfxmenu_box_t itembox = self->item_box;
+  grub_gfxmenu_box_t selbox = self->selected_item_box;
+  int visible_index = item_index - self->first_shown_index;
+  int max_toppad = grub_max (itembox->get_top_pad (itembox),
+			     selbox->get_top_pad (selbox));
+  int max_bottompad = grub_max (itembox->get_bottom_pad (itembox),
+				selbox->get_bottom_pad (selbox));
+
+  if (visible_index < 0 || visible_index >= get_num_shown_items (self)
+      || item_index >= self->view->menu->size)
+    return 0;
+
+  rect->x = self->bounds.x;
+  rect->width = self->bounds.width;
+  rect->y = (self->bounds.y + box->get_top_pad (box) + self->item_padding
+	     + visible_index * (self->item_height + self->item_spacing));
+  rect->height = max_toppad + self->item_height + max_bottompad;
+  return 1;
+}
+
+static int
+get_title_offset (list_impl_t self, int item_index)
+{
+  if (item_index < 0 || item_index >= self->view->menu->size)
+    return 0;
+  return self->view->menu_title_offset[item_index];
+}
+
+/* Tell the view which parts of the list changed since it was last drawn:
+   the whole list when it scrolled, otherwise only the rows whose
+   selection or title scrolling changed.  */
+static void
+invalidate_changes (list_impl_t self)
+{
+  grub_gfxmenu_view_t view = self->view;
+  int selected = view->selected;
+  int offset = get_title_offset (self, selected);
+  grub_video_rect_t rect;
+
+  if (! self->visible)
+    return;
+
+  if (! check_boxes (self))
+    {
+      grub_gfxmenu_view_invalidate (view, &self->bounds);
+      return;
+    }
+
+  make_selected_item_visible (self);
+
+  if (self->painted_menu != view->menu
+      || self->painted_first != self->first_shown_index)
+    grub_gfxmenu_view_invalidate (view, &self->bounds);
+  else if (self->painted_selected != selected)
+    {
+      if (get_item_rect (self, self->painted_selected, &rect))
+	grub_gfxmenu_view_invalidate (view, &rect);
+      if (get_item_rect (self, selected, &rect))
+	grub_gfxmenu_view_invalidate (view, &rect);
+    }
+  else if (self->painted_offset != offset
+	   && get_item_rect (self, selected, &rect))
+    grub_gfxmenu_view_invalidate (view, &rect);
+
+  self->painted_menu = view->menu;
+  self->painted_first = self->first_shown_index;
+  self->painted_selected = selected;
+  self->painted_offset = offset;
+}
+
 /* Draw a scrollbar on the menu.  */
 static void
 draw_scrollbar (list_impl_t self,
@@ -344,7 +426,8 @@ grub_utf8_offset_code (const char *src, grub_size_t srcsize, int num)
 
 /* Draw the list of items.  */
 static void
-draw_menu (list_impl_t self, int num_shown_items)
+draw_menu (list_impl_t self, int num_shown_items,
+	   const grub_video_rect_t *region)
 {
   if (! self->menu_box || ! self->selected_item_box || ! self->item_box)
     return;
@@ -374,6 +457,8 @@ draw_menu (list_impl_t self, int num_shown_items)
 
   int max_leftpad = grub_max (item_leftpad, sel_leftpad);
   int max_toppad = grub_max (item_toppad, sel_toppad);
+  int max_bottompad = grub_max (itembox->get_bottom_pad (itembox),
+				selbox->get_bottom_pad (selbox));
   int item_top = 0;
   int menu_index;
   int visible_index;
@@ -429,6 +514,25 @@ draw_menu (list_impl_t self, int num_shown_items)
       int top_pad;
       int icon_top_offset;
       int viewport_width;
+      grub_video_rect_t row;
+
+      if (is_selected)
+        {
+          /* Tell the animation point to who.  */
+    	  self->view->point_x = oviewport.x;
+    	  self->view->point_y = oviewport.y + item_top + boxpad + sel_box_top_offset;
+        }
+
+      /* Rows outside the region being repainted are left alone.  */
+      row.x = oviewport.x;
+      row.y = oviewport.y + boxpad + item_top;
+      row.width = oviewport.width;
+      row.height = max_toppad + text_box_height + max_bottompad;
+      if (!grub_video_have_common_points (region, &row))
+        {
+          item_top += text_box_height + item_vspace;
+          continue;
+        }
 
       if (is_selected)
         {
@@ -439,10 +543,6 @@ draw_menu (list_impl_t self, int num_shown_items)
           top_pad = sel_toppad;
           icon_top_offset = sel_icon_top_offset;
           viewport_width = sel_viewport_width;
-          
-          /* Tell the animation point to who.  */
-    	  self->view->point_x = oviewport.x;
-    	  self->view->point_y = oviewport.y + item_top + boxpad + sel_box_top_offset;
         }
       else
         {
@@ -547,7 +647,7 @@ list_paint (void *vself, const grub_video_rect_t *region)
       }
 
     grub_gui_set_viewport (&content_rect, &vpsave2);
-    draw_menu (self, num_shown_items);
+    draw_menu (self, num_shown_items, region);
     grub_gui_restore_viewport (&vpsave2);
 
     if (drawing_scrollbar)
@@ -890,6 +990,7 @@ list_set_view_info (void *vself,
   grub_gfxmenu_icon_manager_set_theme_path (self->icon_manager,
 					    view->theme_path);
   self->view = view;
+  invalidate_changes (self);
 }
 
 /* Refresh list variables */
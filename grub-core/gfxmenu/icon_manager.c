@@ -24,6 +24,7 @@
 #include <grub/gui_string_util.h>
 #include <grub/bitmap.h>
 #include <grub/bitmap_scale.h>
+#include <grub/bitmap_cache.h>
 #include <grub/menu.h>
 #include <grub/icon_manager.h>
 #include <grub/env.h>
@@ -93,7 +94,7 @@ grub_gfxmenu_icon_manager_clear_cache (grub_gfxmenu_icon_manager_t mgr)
     {
       next = cur->next;
       grub_free (cur->class_name);
-      grub_video_bitmap_destroy (cur->bitmap);
+      grub_video_bitmap_cache_release (cur->bitmap);
       grub_free (cur);
     }
   mgr->cache.next = 0;
@@ -133,8 +134,8 @@ grub_gfxmenu_icon_manager_set_icon_size (grub_gfxmenu_icon_manager_t mgr,
 }
 
 /* Try to load an icon for the specified CLASS_NAME in the directory DIR.
-   Returns 0 if the icon could not be loaded, or returns a pointer to a new
-   bitmap if it was successful.  */
+   Returns 0 if the icon could not be loaded, or returns a reference to the
+   scaled bitmap in the shared bitmap cache if it was successful.  */
 static struct grub_video_bitmap *
 try_loading_icon (grub_gfxmenu_icon_manager_t mgr,
                   const char *dir, const char *class_name)
@@ -153,21 +154,12 @@ try_loading_icon (grub_gfxmenu_icon_manager_t mgr,
   ptr = grub_stpcpy (ptr, icon_extension);
   *ptr = '\0';
 
-  struct grub_video_bitmap *raw_bitmap;
-  grub_video_bitmap_load (&raw_bitmap, path);
+  struct grub_video_bitmap *scaled_bitmap;
+  grub_video_bitmap_cache_get (&scaled_bitmap, path,
+                               mgr->icon_width, mgr->icon_height,
+                               GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
   grub_free (path);
   grub_errno = GRUB_ERR_NONE;  /* Critical to clear the error!!  */
-  if (! raw_bitmap)
-    return 0;
-
-  struct grub_video_bitmap *scaled_bitmap;
-  grub_video_bitmap_create_scaled (&scaled_bitmap,
-                                   mgr->icon_width, mgr->icon_height,
-                                   raw_bitmap,
-                                   GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
-  grub_video_bitmap_destroy (raw_bitmap);
-  if (! scaled_bitmap)
-    return 0;
 
   return scaled_bitmap;
 }
@@ -223,7 +215,7 @@ get_icon_by_class (grub_gfxmenu_icon_manager_t mgr, const char *class_name)
   entry = grub_malloc (sizeof (*entry));
   if (! entry)
     {
-      grub_video_bitmap_destroy (icon);
+      grub_video_bitmap_cache_release (icon);
       return 0;
     }
   entry->class_name = grub_strdup (class_name);
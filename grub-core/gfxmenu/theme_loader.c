@@ -21,12 +21,14 @@
 #include <grub/file.h>
 #include <grub/misc.h>
 #include <grub/mm.h>
+#include <grub/arena.h>
 #include <grub/err.h>
 #include <grub/dl.h>
 #include <grub/video.h>
 #include <grub/gui_string_util.h>
 #include <grub/bitmap.h>
 #include <grub/bitmap_scale.h>
+#include <grub/bitmap_cache.h>
 #include <grub/gfxwidgets.h>
 #include <grub/gfxmenu_view.h>
 #include <grub/gui.h>
@@ -169,13 +171,16 @@ theme_set_string (grub_gfxmenu_view_t view,
       path = grub_resolve_relative_path (theme_dir, value);
       if (! path)
         return grub_errno;
-      if (grub_video_bitmap_load (&raw_bitmap, path) != GRUB_ERR_NONE)
+      if (grub_video_bitmap_cache_get (&raw_bitmap, path, 0, 0,
+                                       GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST)
+          != GRUB_ERR_NONE)
         {
           grub_free (path);
           return grub_errno;
         }
-      grub_free(path);
-      grub_video_bitmap_destroy (view->raw_desktop_image);
+      grub_free (view->desktop_image_path);
+      view->desktop_image_path = path;
+      grub_video_bitmap_cache_release (view->raw_desktop_image);
       view->raw_desktop_image = raw_bitmap;
     }
   else if (! grub_strcmp ("desktop-image-scale-method", name))
@@ -307,6 +312,9 @@ struct parsebuf
   const char *filename;
   char *theme_dir;
   grub_gfxmenu_view_t view;
+  /* Identifiers and values read from the theme file; released at once
+     when the whole file has been parsed.  */
+  grub_arena_t strings;
 };
 
 static int
@@ -407,7 +415,7 @@ read_identifier (struct parsebuf *p)
   if (end - start < 1)
     return 0;
 
-  return grub_new_substring (p->buf, start, end);
+  return grub_arena_strndup (p->strings, p->buf + start, end - start);
 }
 
 static char *
@@ -461,7 +469,7 @@ read_expression (struct parsebuf *p)
       return 0;
     }
 
-  return grub_new_substring (p->buf, start, end);
+  return grub_arena_strndup (p->strings, p->buf + start, end - start);
 }
 
 static grub_err_t
@@ -640,7 +648,6 @@ read_object (struct parsebuf *p, grub_gui_container_t parent)
           grub_error (GRUB_ERR_IO,
                       "%s:%d:%d expected `=' after property name `%s'",
                       p->filename, p->line_num, p->col_num, property);
-          grub_free (property);
           goto cleanup;
         }
       skip_whitespace (p);
@@ -648,10 +655,7 @@ read_object (struct parsebuf *p, grub_gui_container_t parent)
       char *value;
       value = read_expression (p);
       if (! value)
-        {
-          grub_free (property);
-          goto cleanup;
-        }
+        goto cleanup;
 
       /* Handle the property value.  */
       if (grub_strcmp (property, "left") == 0)
@@ -666,14 +670,11 @@ read_object (struct parsebuf *p, grub_gui_container_t parent)
 	/* General property handling.  */
 	component->ops->set_property (component, property, value);
 
-      grub_free (value);
-      grub_free (property);
       if (grub_errno != GRUB_ERR_NONE)
         goto cleanup;
     }
 
 cleanup:
-  grub_free (name);
   return grub_errno;
 }
 
@@ -720,7 +721,6 @@ read_property (struct parsebuf *p)
          below.  */
       theme_set_string (p->view, name, value, p->theme_dir,
                         p->filename, p->line_num, p->col_num);
-      grub_free (value);
     }
   else
     {
@@ -732,7 +732,6 @@ read_property (struct parsebuf *p)
     }
 
 done:
-  grub_free (name);
   return grub_errno;
 }
 
@@ -754,6 +753,14 @@ grub_gfxmenu_view_load_theme (grub_gfxmenu_view_t view, const char *theme_path)
       return grub_errno;
     }
 
+  p.strings = grub_arena_create (0);
+  if (! p.strings)
+    {
+      grub_file_close (file);
+      grub_free (p.theme_dir);
+      return grub_errno;
+    }
+
   p.len = grub_file_size (file);
   p.buf = grub_malloc (p.len);
   p.pos = 0;
@@ -762,6 +769,7 @@ grub_gfxmenu_view_load_theme (grub_gfxmenu_view_t view, const char *theme_path)
   p.filename = theme_path;
   if (! p.buf)
     {
+      grub_arena_destroy (p.strings);
       grub_file_close (file);
       grub_free (p.theme_dir);
       return grub_errno;
@@ -769,6 +777,7 @@ grub_gfxmenu_view_load_theme (grub_gfxmenu_view_t view, const char *theme_path)
   if (grub_file_read (file, p.buf, p.len) != p.len)
     {
       grub_free (p.buf);
+      grub_arena_destroy (p.strings);
       grub_file_close (file);
       grub_free (p.theme_dir);
       return grub_errno;
@@ -826,6 +835,7 @@ fail:
 
 cleanup:
   grub_free (p.buf);
+  grub_arena_destroy (p.strings);
   grub_file_close (file);
   grub_free (p.theme_dir);
   return grub_errno;
@@ -28,6 +28,7 @@
 #include <grub/gfxterm.h>
 #include <grub/bitmap.h>
 #include <grub/bitmap_scale.h>
+#include <grub/bitmap_cache.h>
 #include <grub/term.h>
 #include <grub/gfxwidgets.h>
 #include <grub/time.h>
@@ -94,6 +95,7 @@ grub_gfxmenu_view_new (const char *theme_path,
   view->title_color = default_fg_color;
   view->message_color = default_bg_color;
   view->message_bg_color = default_fg_color;
+  view->desktop_image_path = 0;
   view->raw_desktop_image = 0;
   view->scaled_desktop_image = 0;
   view->desktop_image_scale_method = GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH;
@@ -110,6 +112,8 @@ grub_gfxmenu_view_new (const char *theme_path,
   view->need_refresh = 0;
   view->point_x = 0;
   view->point_y = 0;
+  grub_video_damage_clear (&view->damage);
+  view->painted_selected = -1;
   if (grub_env_get (ENGINE_FRAME_SPEED))
     {
       view->is_animation = 1;
@@ -145,8 +149,10 @@ grub_gfxmenu_view_destroy (grub_gfxmenu_view_t view)
       grub_gfxmenu_timeout_notifications = grub_gfxmenu_timeout_notifications->next;
       grub_free (p);
     }
-  grub_video_bitmap_destroy (view->raw_desktop_image);
-  grub_video_bitmap_destroy (view->scaled_desktop_image);
+  grub_video_bitmap_cache_release (view->raw_desktop_image);
+  grub_video_bitmap_cache_release (view->scaled_desktop_image);
+  grub_font_flush_string_cache ();
+  grub_free (view->desktop_image_path);
   if (view->terminal_box)
     view->terminal_box->destroy (view->terminal_box);
   grub_free (view->terminal_font_name);
@@ -216,8 +222,41 @@ update_timeouts (int visible, int start, int value, int end)
     cur->set_state (cur->self, visible, start, value, end);
 }
 
+void
+grub_gfxmenu_view_invalidate (grub_gfxmenu_view_t view,
+			      const grub_video_rect_t *rect)
+{
+  grub_video_damage_add (&view->damage, rect->x, rect->y,
+			 rect->width, rect->height);
+}
+
+static void
+repaint_damage (grub_gfxmenu_view_t view)
+{
+  unsigned int i;
+
+  for (i = 0; i < view->damage.count; i++)
+    {
+      grub_video_set_area_status (GRUB_VIDEO_AREA_ENABLED);
+      grub_gfxmenu_view_redraw (view, &view->damage.rects[i]);
+    }
+}
+
+/* Repaint everything invalidated since the last flush and show it.  Only
+   the damaged rectangles are drawn, and the video driver copies only
+   those to the screen.  */
 static void
-redraw_timeouts (struct grub_gfxmenu_view *view)
+flush_damage (grub_gfxmenu_view_t view)
+{
+  repaint_damage (view);
+  grub_video_swap_buffers ();
+  if (view->double_repaint)
+    repaint_damage (view);
+  grub_video_damage_clear (&view->damage);
+}
+
+static void
+invalidate_timeouts (struct grub_gfxmenu_view *view)
 {
   struct grub_gfxmenu_timeout_notify *cur;
 
@@ -225,8 +264,7 @@ redraw_timeouts (struct grub_gfxmenu_view *view)
     {
       grub_video_rect_t bounds;
       cur->self->ops->get_bounds (cur->self, &bounds);
-      grub_video_set_area_status (GRUB_VIDEO_AREA_ENABLED);
-      grub_gfxmenu_view_redraw (view, &bounds);
+      grub_gfxmenu_view_invalidate (view, &bounds);
     }
 }
 
@@ -239,10 +277,8 @@ grub_gfxmenu_print_timeout (int timeout, void *data)
     view->first_timeout = timeout;
 
   update_timeouts (1, -view->first_timeout, -timeout, 0);
-  redraw_timeouts (view);
-  grub_video_swap_buffers ();
-  if (view->double_repaint)
-    redraw_timeouts (view);
+  invalidate_timeouts (view);
+  flush_damage (view);
 }
 
 void 
@@ -251,10 +287,8 @@ grub_gfxmenu_clear_timeout (void *data)
   struct grub_gfxmenu_view *view = data;
 
   update_timeouts (0, 1, 0, 0);
-  redraw_timeouts (view);
-  grub_video_swap_buffers ();
-  if (view->double_repaint)
-    redraw_timeouts (view);
+  invalidate_timeouts (view);
+  flush_damage (view);
 }
 
 static void
@@ -370,13 +404,32 @@ grub_gfxmenu_view_redraw (grub_gfxmenu_view_t view,
     grub_video_set_area_status (GRUB_VIDEO_AREA_ENABLED);
 }
 
+/* Lay out the components and paint the whole menu into the active render
+   target.  Unlike grub_gfxmenu_view_draw, the terminal window is left
+   alone and nothing is shown.  */
+void
+grub_gfxmenu_view_compose (grub_gfxmenu_view_t view)
+{
+  init_background (view);
+
+  refresh_menu_components (view);
+  update_menu_components (view);
+  
+  refresh_animation_components (view);
+
+  /* Everything is repainted below.  */
+  grub_video_damage_clear (&view->damage);
+  view->painted_selected = view->selected;
+
+  grub_video_set_area_status (GRUB_VIDEO_AREA_DISABLED);
+  grub_gfxmenu_view_redraw (view, &view->screen);
+}
+
 void
 grub_gfxmenu_view_draw (grub_gfxmenu_view_t view)
 {
   init_terminal (view);
 
-  init_background (view);
-
   /* Clear the screen; there may be garbage left over in video memory. */
   grub_video_fill_rect (grub_video_map_rgb (0, 0, 0),
                         view->screen.x, view->screen.y,
@@ -387,13 +440,7 @@ grub_gfxmenu_view_draw (grub_gfxmenu_view_t view)
 			  view->screen.x, view->screen.y,
 			  view->screen.width, view->screen.height);
 
-  refresh_menu_components (view);
-  update_menu_components (view);
-  
-  refresh_animation_components (view);
-
-  grub_video_set_area_status (GRUB_VIDEO_AREA_DISABLED);
-  grub_gfxmenu_view_redraw (view, &view->screen);
+  grub_gfxmenu_view_compose (view);
   grub_video_swap_buffers ();
   if (view->double_repaint)
     {
@@ -404,33 +451,24 @@ grub_gfxmenu_view_draw (grub_gfxmenu_view_t view)
 }
 
 static void
-redraw_menu_visit (grub_gui_component_t component,
-                   void *userdata)
+invalidate_animation_visit (grub_gui_component_t component,
+			    void *userdata)
 {
   grub_gfxmenu_view_t view;
   view = userdata;
-  if (component->ops->is_instance (component, "list"))
-    {
-      grub_video_rect_t bounds;
-
-      component->ops->get_bounds (component, &bounds);
-      grub_video_set_area_status (GRUB_VIDEO_AREA_ENABLED);
-      grub_gfxmenu_view_redraw (view, &bounds);
-    }
-    
   if (component->ops->is_instance (component, "animation"))
     {
       grub_video_rect_t bounds;
 
       component->ops->get_bounds (component, &bounds);
-      grub_video_set_area_status (GRUB_VIDEO_AREA_ENABLED);
-      grub_gfxmenu_view_redraw (view, &bounds);
+      grub_gfxmenu_view_invalidate (view, &bounds);
     }
 }
 
 void
 grub_gfxmenu_redraw_menu (grub_gfxmenu_view_t view)
 {
+  /* The lists report the rows that changed.  */
   update_menu_components (view);
   
   /* Avoid interference.  */
@@ -439,14 +477,14 @@ grub_gfxmenu_redraw_menu (grub_gfxmenu_view_t view)
       refresh_animation_components (view);
     }
 
-  grub_gui_iterate_recursively ((grub_gui_component_t) view->canvas,
-                                redraw_menu_visit, view);
-  grub_video_swap_buffers ();
-  if (view->double_repaint)
-    {
-      grub_gui_iterate_recursively ((grub_gui_component_t) view->canvas,
-				    redraw_menu_visit, view);
-    }
+  /* Animations report the frames they stepped themselves; the ones that
+     follow the selection are only placed when painted.  */
+  if (view->painted_selected != view->selected)
+    grub_gui_iterate_recursively ((grub_gui_component_t) view->canvas,
+				  invalidate_animation_visit, view);
+  view->painted_selected = view->selected;
+
+  flush_damage (view);
 }
 
 void
@@ -454,7 +492,8 @@ grub_gfxmenu_set_animation_state (int need_refresh, void *data)
 {
   grub_gfxmenu_view_t view = data;
 
-  /* Frame rate set by the user.  */
+  /* Number of frames due at the rate set by the user.  All of them are
+     composited at once.  */
   view->need_refresh = need_refresh;
   grub_gfxmenu_redraw_menu (view);
   view->need_refresh = 0;
@@ -668,7 +707,15 @@ init_background (grub_gfxmenu_view_t view)
 
   struct grub_video_bitmap *scaled_bitmap;
   if (view->desktop_image_scale_method ==
-      GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH)
+      GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH
+      && view->desktop_image_path)
+    grub_video_bitmap_cache_get (&scaled_bitmap,
+                                 view->desktop_image_path,
+                                 view->screen.width,
+                                 view->screen.height,
+                                 GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
+  else if (view->desktop_image_scale_method ==
+           GRUB_VIDEO_BITMAP_SELECTION_METHOD_STRETCH)
     grub_video_bitmap_create_scaled (&scaled_bitmap,
                                      view->screen.width,
                                      view->screen.height,
@@ -24,6 +24,7 @@
 #include <grub/video.h>
 #include <grub/bitmap.h>
 #include <grub/bitmap_scale.h>
+#include <grub/bitmap_cache.h>
 #include <grub/gfxwidgets.h>
 
 enum box_pixmaps
@@ -266,7 +267,7 @@ destroy (grub_gfxmenu_box_t self)
   for (i = 0; i < BOX_NUM_PIXMAPS; i++)
     {
       if (self->raw_pixmaps[i])
-        grub_video_bitmap_destroy(self->raw_pixmaps[i]);
+        grub_video_bitmap_cache_release (self->raw_pixmaps[i]);
       self->raw_pixmaps[i] = 0;
 
       if (self->scaled_pixmaps[i])
@@ -335,7 +336,8 @@ grub_gfxmenu_create_box (const char *pixmaps_prefix,
           path_end = grub_stpcpy (path_end, box_pixmap_names[i]);
           path_end = grub_stpcpy (path_end, pixmaps_suffix);
 
-          grub_video_bitmap_load (&box->raw_pixmaps[i], path);
+          grub_video_bitmap_cache_get (&box->raw_pixmaps[i], path, 0, 0,
+                                       GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST);
           grub_free (path);
 
           /* Ignore missing pixmaps.  */
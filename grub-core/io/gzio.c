@@ -1384,6 +1384,44 @@ grub_deflate_decompress (char *inbuf, grub_size_t insize, grub_off_t off,
   return ret;
 }
 
+/* Open a file inflating the zlib stream read from IO.  The size of the
+   uncompressed data is not recorded in the stream, so it is unknown.  On
+   success closing the file closes IO too; on failure IO is left open.  */
+grub_file_t
+grub_zlib_file_open (grub_file_t io)
+{
+  grub_file_t file;
+  grub_gzio_t gzio;
+
+  file = (grub_file_t) grub_zalloc (sizeof (*file));
+  if (! file)
+    return 0;
+
+  gzio = grub_zalloc (sizeof (*gzio));
+  if (! gzio)
+    {
+      grub_free (file);
+      return 0;
+    }
+
+  gzio->file = io;
+
+  file->device = io->device;
+  file->data = gzio;
+  file->fs = &grub_gzio_fs;
+  file->size = GRUB_FILE_SIZE_UNKNOWN;
+  file->not_easily_seekable = 1;
+
+  if (! test_zlib_header (gzio))
+    {
+      grub_free (gzio);
+      grub_free (file);
+      return 0;
+    }
+
+  return file;
+}
+
 
 
 static struct grub_fs grub_gzio_fs =
@@ -0,0 +1,182 @@
+/* arena.c - region allocator */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2020  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/arena.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/i18n.h>
+
+/* Alignment of every allocation, enough for any scalar type.  */
+#define ARENA_ALIGN	(2 * sizeof (grub_uint64_t))
+
+struct grub_arena_chunk
+{
+  struct grub_arena_chunk *next;
+  grub_size_t size;
+  grub_size_t used;
+};
+
+#define CHUNK_HEADER_SIZE \
+  ALIGN_UP (sizeof (struct grub_arena_chunk), ARENA_ALIGN)
+
+struct grub_arena
+{
+  /* The chunk allocations are currently taken from.  */
+  struct grub_arena_chunk *cur;
+  /* Chunks that are full or were allocated for a single large request.  */
+  struct grub_arena_chunk *full;
+  grub_size_t chunk_size;
+};
+
+static struct grub_arena_chunk *
+chunk_new (grub_size_t size)
+{
+  struct grub_arena_chunk *chunk;
+
+  if (size > ~(grub_size_t) 0 - CHUNK_HEADER_SIZE)
+    {
+      grub_error (GRUB_ERR_OUT_OF_MEMORY, N_("out of memory"));
+      return NULL;
+    }
+
+  chunk = grub_malloc (CHUNK_HEADER_SIZE + size);
+  if (!chunk)
+    return NULL;
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  return chunk;
+}
+
+grub_arena_t
+grub_arena_create (grub_size_t chunk_size)
+{
+  grub_arena_t arena;
+
+  arena = grub_malloc (sizeof (*arena));
+  if (!arena)
+    return NULL;
+
+  arena->cur = NULL;
+  arena->full = NULL;
+  arena->chunk_size = chunk_size ? : GRUB_ARENA_CHUNK_SIZE;
+  return arena;
+}
+
+void *
+grub_arena_alloc (grub_arena_t arena, grub_size_t size)
+{
+  struct grub_arena_chunk *chunk = arena->cur;
+  void *ret;
+
+  size = ALIGN_UP (size, ARENA_ALIGN);
+  if (!size)
+    size = ARENA_ALIGN;
+
+  if (chunk && chunk->size - chunk->used >= size)
+    {
+      ret = (char *) chunk + CHUNK_HEADER_SIZE + chunk->used;
+      chunk->used += size;
+      return ret;
+    }
+
+  /* Big requests get a chunk of their own, so that the space left in the
+     current chunk is not wasted.  */
+  if (size > arena->chunk_size / 4)
+    {
+      chunk = chunk_new (size);
+      if (!chunk)
+	return NULL;
+      chunk->used = size;
+      chunk->next = arena->full;
+      arena->full = chunk;
+      return (char *) chunk + CHUNK_HEADER_SIZE;
+    }
+
+  chunk = chunk_new (arena->chunk_size);
+  if (!chunk)
+    return NULL;
+  if (arena->cur)
+    {
+      arena->cur->next = arena->full;
+      arena->full = arena->cur;
+    }
+  arena->cur = chunk;
+  chunk->used = size;
+  return (char *) chunk + CHUNK_HEADER_SIZE;
+}
+
+void *
+grub_arena_zalloc (grub_arena_t arena, grub_size_t size)
+{
+  void *ret;
+
+  ret = grub_arena_alloc (arena, size);
+  if (ret)
+    grub_memset (ret, 0, size);
+  return ret;
+}
+
+char *
+grub_arena_strndup (grub_arena_t arena, const char *s, grub_size_t n)
+{
+  grub_size_t len;
+  char *p;
+
+  for (len = 0; len < n && s[len]; len++);
+  p = grub_arena_alloc (arena, len + 1);
+  if (!p)
+    return NULL;
+
+  grub_memcpy (p, s, len);
+  p[len] = '\0';
+  return p;
+}
+
+char *
+grub_arena_strdup (grub_arena_t arena, const char *s)
+{
+  grub_size_t len;
+  char *p;
+
+  len = grub_strlen (s) + 1;
+  p = grub_arena_alloc (arena, len);
+  if (!p)
+    return NULL;
+
+  return grub_memcpy (p, s, len);
+}
+
+void
+grub_arena_destroy (grub_arena_t arena)
+{
+  struct grub_arena_chunk *chunk, *next;
+
+  if (!arena)
+    return;
+
+  grub_free (arena->cur);
+  for (chunk = arena->full; chunk; chunk = next)
+    {
+      next = chunk->next;
+      grub_free (chunk);
+    }
+  grub_free (arena);
+}
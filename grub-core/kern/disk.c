@@ -32,6 +32,7 @@
 static grub_uint64_t grub_last_time = 0;
 
 struct grub_disk_cache grub_disk_cache_table[GRUB_DISK_CACHE_NUM];
+grub_uint32_t grub_disk_cache_generation;
 
 void (*grub_disk_firmware_fini) (void);
 int grub_disk_firmware_is_tainted;
@@ -60,6 +61,8 @@ grub_disk_cache_invalidate_all (void)
 {
   unsigned i;
 
+  grub_disk_cache_generation++;
+
   for (i = 0; i < GRUB_DISK_CACHE_NUM; i++)
     {
       struct grub_disk_cache *cache = grub_disk_cache_table + i;
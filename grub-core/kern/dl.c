@@ -76,52 +76,87 @@ grub_dl_remove (grub_dl_t mod)
 struct grub_symbol
 {
   struct grub_symbol *next;
+  struct grub_symbol *mod_next;	/* Next symbol of the same module.  */
   const char *name;
+  grub_uint32_t hash;
   void *addr;
   int isfunc;
   grub_dl_t mod;	/* The module to which this symbol belongs.  */
 };
 typedef struct grub_symbol *grub_symbol_t;
 
-/* The size of the symbol table.  */
-#define GRUB_SYMTAB_SIZE	509
+/* The initial size of the symbol table.  It must be a power of two; the
+   table doubles whenever it holds more symbols than it has buckets.  */
+#define GRUB_SYMTAB_INITIAL_SIZE	1024
 
 /* The symbol table (using an open-hash).  */
-static struct grub_symbol *grub_symtab[GRUB_SYMTAB_SIZE];
+static struct grub_symbol *grub_symtab_initial[GRUB_SYMTAB_INITIAL_SIZE];
+static struct grub_symbol **grub_symtab = grub_symtab_initial;
+static grub_size_t grub_symtab_size = GRUB_SYMTAB_INITIAL_SIZE;
+static grub_size_t grub_symtab_count;
 
-/* Simple hash function.  */
-static unsigned
-grub_symbol_hash (const char *s)
+static inline struct grub_symbol **
+grub_symtab_bucket (grub_uint32_t hash)
 {
-  unsigned key = 0;
+  return &grub_symtab[hash & (grub_symtab_size - 1)];
+}
 
-  while (*s)
-    key = key * 65599 + *s++;
+/* Double the number of buckets.  Failing to do so is not an error, the
+   chains just get longer.  */
+static void
+grub_symtab_grow (void)
+{
+  struct grub_symbol **old = grub_symtab, **new;
+  grub_size_t old_size = grub_symtab_size, i;
+
+  new = grub_zalloc (2 * old_size * sizeof (*new));
+  if (!new)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return;
+    }
+
+  grub_symtab = new;
+  grub_symtab_size = 2 * old_size;
+
+  for (i = 0; i < old_size; i++)
+    {
+      grub_symbol_t sym, q;
 
-  return (key + (key >> 5)) % GRUB_SYMTAB_SIZE;
+      for (sym = old[i]; sym; sym = q)
+	{
+	  struct grub_symbol **b = grub_symtab_bucket (sym->hash);
+
+	  q = sym->next;
+	  sym->next = *b;
+	  *b = sym;
+	}
+    }
+
+  if (old != grub_symtab_initial)
+    grub_free (old);
 }
 
-/* Resolve the symbol name NAME and return the address.
+/* Resolve the symbol name NAME whose hash is HASH and return the address.
    Return NULL, if not found.  */
 static grub_symbol_t
-grub_dl_resolve_symbol (const char *name)
+grub_dl_resolve_symbol (const char *name, grub_uint32_t hash)
 {
   grub_symbol_t sym;
 
-  for (sym = grub_symtab[grub_symbol_hash (name)]; sym; sym = sym->next)
-    if (grub_strcmp (sym->name, name) == 0)
+  for (sym = *grub_symtab_bucket (hash); sym; sym = sym->next)
+    if (sym->hash == hash && grub_strcmp (sym->name, name) == 0)
       return sym;
 
   return 0;
 }
 
-/* Register a symbol with the name NAME and the address ADDR.  */
-grub_err_t
-grub_dl_register_symbol (const char *name, void *addr, int isfunc,
-			 grub_dl_t mod)
+static grub_err_t
+grub_dl_register_symbol_hash (const char *name, grub_uint32_t hash,
+			      void *addr, int isfunc, grub_dl_t mod)
 {
   grub_symbol_t sym;
-  unsigned k;
+  struct grub_symbol **b;
 
   sym = (grub_symbol_t) grub_malloc (sizeof (*sym));
   if (! sym)
@@ -135,58 +170,74 @@ grub_dl_register_symbol (const char *name, void *addr, int isfunc,
 	  grub_free (sym);
 	  return grub_errno;
 	}
+      sym->mod_next = mod->symbols;
+      mod->symbols = sym;
     }
   else
-    sym->name = name;
+    {
+      sym->name = name;
+      sym->mod_next = 0;
+    }
 
+  sym->hash = hash;
   sym->addr = addr;
   sym->mod = mod;
   sym->isfunc = isfunc;
 
-  k = grub_symbol_hash (name);
-  sym->next = grub_symtab[k];
-  grub_symtab[k] = sym;
+  if (++grub_symtab_count > grub_symtab_size)
+    grub_symtab_grow ();
+
+  b = grub_symtab_bucket (hash);
+  sym->next = *b;
+  *b = sym;
 
   return GRUB_ERR_NONE;
 }
 
+/* Register a symbol with the name NAME and the address ADDR.  */
+grub_err_t
+grub_dl_register_symbol (const char *name, void *addr, int isfunc,
+			 grub_dl_t mod)
+{
+  return grub_dl_register_symbol_hash (name, grub_dl_symbol_hash (name),
+				       addr, isfunc, mod);
+}
+
 /* Unregister all the symbols defined in the module MOD.  */
 static void
 grub_dl_unregister_symbols (grub_dl_t mod)
 {
-  unsigned i;
+  grub_symbol_t sym, q;
 
   if (! mod)
     grub_fatal ("core symbols cannot be unregistered");
 
-  for (i = 0; i < GRUB_SYMTAB_SIZE; i++)
+  for (sym = mod->symbols; sym; sym = q)
     {
-      grub_symbol_t sym, *p, q;
+      struct grub_symbol **p;
 
-      for (p = &grub_symtab[i], sym = *p; sym; sym = q)
-	{
-	  q = sym->next;
-	  if (sym->mod == mod)
-	    {
-	      *p = q;
-	      grub_free ((void *) sym->name);
-	      grub_free (sym);
-	    }
-	  else
-	    p = &sym->next;
-	}
+      q = sym->mod_next;
+      for (p = grub_symtab_bucket (sym->hash); *p; p = &(*p)->next)
+	if (*p == sym)
+	  {
+	    *p = sym->next;
+	    break;
+	  }
+      grub_symtab_count--;
+      grub_free ((void *) sym->name);
+      grub_free (sym);
     }
+  mod->symbols = 0;
 }
 
-/* Return the address of a section whose index is N.  */
+/* Return the address of a section whose index is N.  SECTIONS maps
+   section numbers to the segments of the module.  */
 static void *
-grub_dl_get_section_addr (grub_dl_t mod, unsigned n)
+grub_dl_get_section_addr (const Elf_Ehdr *e, grub_dl_segment_t *sections,
+			  unsigned n)
 {
-  grub_dl_segment_t seg;
-
-  for (seg = mod->segment; seg; seg = seg->next)
-    if (seg->section == n)
-      return seg->addr;
+  if (n < e->e_shnum && sections[n])
+    return sections[n]->addr;
 
   return 0;
 }
@@ -218,9 +269,11 @@ grub_dl_check_header (void *ehdr, grub_size_t size)
   return GRUB_ERR_NONE;
 }
 
-/* Load all segments from memory specified by E.  */
+/* Load all segments from memory specified by E and record them in
+   SECTIONS by section number.  */
 static grub_err_t
-grub_dl_load_segments (grub_dl_t mod, const Elf_Ehdr *e)
+grub_dl_load_segments (grub_dl_t mod, const Elf_Ehdr *e,
+		       grub_dl_segment_t *sections)
 {
   unsigned i;
   const Elf_Shdr *s;
@@ -302,6 +355,7 @@ grub_dl_load_segments (grub_dl_t mod, const Elf_Ehdr *e)
 	  seg->section = i;
 	  seg->next = mod->segment;
 	  mod->segment = seg;
+	  sections[i] = seg;
 	}
     }
 #if !defined (__i386__) && !defined (__x86_64__) && !defined(__riscv)
@@ -318,14 +372,41 @@ grub_dl_load_segments (grub_dl_t mod, const Elf_Ehdr *e)
   return GRUB_ERR_NONE;
 }
 
+static Elf_Shdr *grub_dl_find_section (Elf_Ehdr *e, const char *name);
+
+/* Return the precomputed symbol name hashes of E if it has usable ones.
+   objcopy does not align the section, so they are read with
+   grub_get_unaligned32.  */
+static const grub_uint8_t *
+grub_dl_get_symbol_hashes (Elf_Ehdr *e, grub_size_t nsyms)
+{
+  Elf_Shdr *s;
+  const grub_uint8_t *h;
+
+  s = grub_dl_find_section (e, ".modhash");
+  if (!s || s->sh_size < sizeof (struct grub_dl_modhash)
+      + nsyms * sizeof (grub_uint32_t))
+    return 0;
+
+  /* The magic and the count come before the hashes.  */
+  h = (const grub_uint8_t *) e + s->sh_offset;
+  if (grub_get_unaligned32 (h) != GRUB_DL_MODHASH_MAGIC
+      || grub_get_unaligned32 (h + sizeof (grub_uint32_t)) != nsyms)
+    return 0;
+
+  return h + sizeof (struct grub_dl_modhash);
+}
+
 static grub_err_t
-grub_dl_resolve_symbols (grub_dl_t mod, Elf_Ehdr *e)
+grub_dl_resolve_symbols (grub_dl_t mod, Elf_Ehdr *e,
+			 grub_dl_segment_t *sections)
 {
   unsigned i;
   Elf_Shdr *s;
   Elf_Sym *sym;
   const char *str;
   Elf_Word size, entsize;
+  const grub_uint8_t *hashes;
 
   for (i = 0, s = (Elf_Shdr *) ((char *) e + e->e_shoff);
        i < e->e_shnum;
@@ -355,6 +436,8 @@ grub_dl_resolve_symbols (grub_dl_t mod, Elf_Ehdr *e)
   s = (Elf_Shdr *) ((char *) e + e->e_shoff + e->e_shentsize * s->sh_link);
   str = (char *) e + s->sh_offset;
 
+  hashes = grub_dl_get_symbol_hashes (e, size / entsize);
+
   for (i = 0;
        i < size / entsize;
        i++, sym = (Elf_Sym *) ((char *) sym + entsize))
@@ -362,6 +445,12 @@ grub_dl_resolve_symbols (grub_dl_t mod, Elf_Ehdr *e)
       unsigned char type = ELF_ST_TYPE (sym->st_info);
       unsigned char bind = ELF_ST_BIND (sym->st_info);
       const char *name = str + sym->st_name;
+      grub_uint32_t hash = 0;
+
+      /* Only global and undefined symbols go through the symbol table.  */
+      if (bind != STB_LOCAL || sym->st_shndx == SHN_UNDEF)
+	hash = hashes ? grub_get_unaligned32 (hashes + i * sizeof (grub_uint32_t))
+	  : grub_dl_symbol_hash (name);
 
       switch (type)
 	{
@@ -370,7 +459,7 @@ grub_dl_resolve_symbols (grub_dl_t mod, Elf_Ehdr *e)
 	  /* Resolve a global symbol.  */
 	  if (sym->st_name != 0 && sym->st_shndx == 0)
 	    {
-	      grub_symbol_t nsym = grub_dl_resolve_symbol (name);
+	      grub_symbol_t nsym = grub_dl_resolve_symbol (name, hash);
 	      if (! nsym)
 		return grub_error (GRUB_ERR_BAD_MODULE,
 				   N_("symbol `%s' not found"), name);
@@ -380,16 +469,18 @@ grub_dl_resolve_symbols (grub_dl_t mod, Elf_Ehdr *e)
 	    }
 	  else
 	    {
-	      sym->st_value += (Elf_Addr) grub_dl_get_section_addr (mod,
+	      sym->st_value += (Elf_Addr) grub_dl_get_section_addr (e, sections,
 								    sym->st_shndx);
 	      if (bind != STB_LOCAL)
-		if (grub_dl_register_symbol (name, (void *) sym->st_value, 0, mod))
+		if (grub_dl_register_symbol_hash (name, hash,
+						  (void *) sym->st_value, 0,
+						  mod))
 		  return grub_errno;
 	    }
 	  break;
 
 	case STT_FUNC:
-	  sym->st_value += (Elf_Addr) grub_dl_get_section_addr (mod,
+	  sym->st_value += (Elf_Addr) grub_dl_get_section_addr (e, sections,
 								sym->st_shndx);
 #ifdef __ia64__
 	  {
@@ -404,7 +495,8 @@ grub_dl_resolve_symbols (grub_dl_t mod, Elf_Ehdr *e)
 	  }
 #endif
 	  if (bind != STB_LOCAL)
-	    if (grub_dl_register_symbol (name, (void *) sym->st_value, 1, mod))
+	    if (grub_dl_register_symbol_hash (name, hash,
+					      (void *) sym->st_value, 1, mod))
 	      return grub_errno;
 	  if (grub_strcmp (name, "grub_mod_init") == 0)
 	    mod->init = (void (*) (grub_dl_t)) sym->st_value;
@@ -413,7 +505,7 @@ grub_dl_resolve_symbols (grub_dl_t mod, Elf_Ehdr *e)
 	  break;
 
 	case STT_SECTION:
-	  sym->st_value = (Elf_Addr) grub_dl_get_section_addr (mod,
+	  sym->st_value = (Elf_Addr) grub_dl_get_section_addr (e, sections,
 							       sym->st_shndx);
 	  break;
 
@@ -557,38 +649,59 @@ grub_dl_flush_cache (grub_dl_t mod)
   grub_arch_sync_caches (mod->base, mod->sz);
 }
 
+/* Apply the relocations of E.  Relocation sections are first chained by
+   the section they patch, so that each target section is relocated in one
+   go instead of being looked up again for every relocation section.  */
 static grub_err_t
-grub_dl_relocate_symbols (grub_dl_t mod, void *ehdr)
+grub_dl_relocate_symbols (grub_dl_t mod, void *ehdr,
+			  grub_dl_segment_t *sections)
 {
   Elf_Ehdr *e = ehdr;
   Elf_Shdr *s;
-  unsigned i;
+  unsigned i, *first, *next;
+  grub_err_t err = GRUB_ERR_NONE;
 
-  for (i = 0, s = (Elf_Shdr *) ((char *) e + e->e_shoff);
-       i < e->e_shnum;
-       i++, s = (Elf_Shdr *) ((char *) s + e->e_shentsize))
-    if (s->sh_type == SHT_REL || s->sh_type == SHT_RELA)
-      {
-	grub_dl_segment_t seg;
-	grub_err_t err;
+  first = grub_zalloc (2 * e->e_shnum * sizeof (*first));
+  if (!first)
+    return grub_errno;
+  next = first + e->e_shnum;
 
-	/* Find the target segment.  */
-	for (seg = mod->segment; seg; seg = seg->next)
-	  if (seg->section == s->sh_info)
-	    break;
+  /* Walk backwards so that every chain keeps the file order.  Section 0 is
+     never a relocation section and so doubles as the end marker.  */
+  for (i = e->e_shnum; i-- > 1; )
+    {
+      s = (Elf_Shdr *) ((char *) e + e->e_shoff + i * e->e_shentsize);
+      if ((s->sh_type == SHT_REL || s->sh_type == SHT_RELA)
+	  && s->sh_info < e->e_shnum && sections[s->sh_info])
+	{
+	  next[i] = first[s->sh_info];
+	  first[s->sh_info] = i;
+	}
+    }
 
-	if (seg)
-	  {
-	    if (!mod->symtab)
-	      return grub_error (GRUB_ERR_BAD_MODULE, "relocation without symbol table");
+  for (i = 0; i < e->e_shnum && !err; i++)
+    {
+      unsigned r;
 
-	    err = grub_arch_dl_relocate_symbols (mod, ehdr, s, seg);
-	    if (err)
-	      return err;
-	  }
-      }
+      if (!first[i])
+	continue;
 
-  return GRUB_ERR_NONE;
+      if (!mod->symtab)
+	{
+	  err = grub_error (GRUB_ERR_BAD_MODULE,
+			    "relocation without symbol table");
+	  break;
+	}
+
+      for (r = first[i]; r && !err; r = next[r])
+	{
+	  s = (Elf_Shdr *) ((char *) e + e->e_shoff + r * e->e_shentsize);
+	  err = grub_arch_dl_relocate_symbols (mod, ehdr, s, sections[i]);
+	}
+    }
+
+  grub_free (first);
+  return err;
 }
 
 /* Load a module from core memory.  */
@@ -597,6 +710,7 @@ grub_dl_load_core_noinit (void *addr, grub_size_t size)
 {
   Elf_Ehdr *e;
   grub_dl_t mod;
+  grub_dl_segment_t *sections;
 
   grub_dprintf ("modules", "module at %p, size 0x%lx\n", addr,
 		(unsigned long) size);
@@ -621,6 +735,13 @@ grub_dl_load_core_noinit (void *addr, grub_size_t size)
   if (! mod)
     return 0;
 
+  sections = grub_zalloc (e->e_shnum * sizeof (*sections));
+  if (! sections)
+    {
+      grub_free (mod);
+      return 0;
+    }
+
   mod->ref_count = 1;
 
   grub_dprintf ("modules", "relocating to %p\n", mod);
@@ -635,15 +756,18 @@ grub_dl_load_core_noinit (void *addr, grub_size_t size)
   if (grub_dl_check_license (e)
       || grub_dl_resolve_name (mod, e)
       || grub_dl_resolve_dependencies (mod, e)
-      || grub_dl_load_segments (mod, e)
-      || grub_dl_resolve_symbols (mod, e)
-      || grub_dl_relocate_symbols (mod, e))
+      || grub_dl_load_segments (mod, e, sections)
+      || grub_dl_resolve_symbols (mod, e, sections)
+      || grub_dl_relocate_symbols (mod, e, sections))
     {
+      grub_free (sections);
       mod->fini = 0;
       grub_dl_unload (mod);
       return 0;
     }
 
+  grub_free (sections);
+
   grub_dl_flush_cache (mod);
 
   grub_dprintf ("modules", "module name: %s\n", mod->name);
@@ -721,12 +845,152 @@ grub_dl_load_file (const char *filename)
   return mod;
 }
 
+/* The module bundle found in the module directory of BUNDLE_PREFIX, if any.
+   It is read once per prefix and kept for later loads.  */
+static char *bundle;
+static grub_size_t bundle_size;
+static char *bundle_prefix;
+
+static grub_err_t
+grub_dl_check_bundle (const char *buf, grub_size_t size)
+{
+  const struct grub_dl_bundle_header *h = (const void *) buf;
+  const struct grub_dl_bundle_entry *ent;
+  grub_uint32_t i;
+
+  if (size < sizeof (*h)
+      || grub_memcmp (h->magic, GRUB_DL_BUNDLE_MAGIC, sizeof (h->magic)) != 0
+      || h->size != size
+      || h->nmodules > (size - sizeof (*h)) / sizeof (*ent))
+    return grub_error (GRUB_ERR_BAD_MODULE, "invalid module bundle");
+
+  /* Left over from an older installation: its modules may not match the
+     symbols this kernel exports.  */
+  if (grub_strncmp (h->version, PACKAGE_VERSION, sizeof (h->version)) != 0)
+    return grub_error (GRUB_ERR_BAD_MODULE,
+		       "module bundle is for another version");
+
+  ent = (const struct grub_dl_bundle_entry *) (h + 1);
+  for (i = 0; i < h->nmodules; i++, ent++)
+    if (ent->name >= size
+	|| !grub_memchr (buf + ent->name, '\0', size - ent->name)
+	|| ent->offset > size || ent->size > size - ent->offset)
+      return grub_error (GRUB_ERR_BAD_MODULE, "invalid module bundle");
+
+  return GRUB_ERR_NONE;
+}
+
+/* Read the module bundle of PREFIX unless it has been tried already.  A
+   missing or unusable bundle is not an error, modules are then loaded
+   from separate files.  */
+static void
+grub_dl_open_bundle (const char *prefix)
+{
+  grub_file_t file;
+  char *filename;
+  grub_off_t size;
+
+  if (bundle_prefix && grub_strcmp (bundle_prefix, prefix) == 0)
+    return;
+
+  /* Keep whatever error the caller has; only ours are dropped below.  */
+  grub_error_push ();
+
+  grub_free (bundle);
+  grub_free (bundle_prefix);
+  bundle = 0;
+  bundle_size = 0;
+  bundle_prefix = grub_strdup (prefix);
+  if (!bundle_prefix)
+    goto fail;
+
+  filename = grub_xasprintf ("%s/" GRUB_TARGET_CPU "-" GRUB_PLATFORM
+			     "/" GRUB_DL_BUNDLE_NAME, prefix);
+  if (!filename)
+    goto fail;
+  file = grub_file_open (filename, GRUB_FILE_TYPE_GRUB_MODULE);
+  grub_free (filename);
+  if (!file)
+    goto fail;
+
+  grub_boot_time ("Loading module bundle");
+
+  size = grub_file_size (file);
+  if (size != (grub_size_t) size)
+    {
+      grub_file_close (file);
+      goto fail;
+    }
+  bundle = grub_malloc (size);
+  if (bundle && grub_file_read (file, bundle, size) == (grub_ssize_t) size
+      && grub_dl_check_bundle (bundle, size) == GRUB_ERR_NONE)
+    bundle_size = size;
+  else
+    {
+      grub_free (bundle);
+      bundle = 0;
+    }
+  grub_file_close (file);
+
+  if (bundle)
+    grub_dprintf ("modules", "module bundle with %u modules\n",
+		  ((struct grub_dl_bundle_header *) bundle)->nmodules);
+
+ fail:
+  grub_errno = GRUB_ERR_NONE;
+  grub_error_pop ();
+}
+
+/* Load the module NAME from the current bundle.  *FOUND tells whether the
+   bundle has it; if not, NULL is returned and grub_errno is left alone.  */
+static grub_dl_t
+grub_dl_load_from_bundle (const char *name, int *found)
+{
+  const struct grub_dl_bundle_header *h;
+  const struct grub_dl_bundle_entry *ent;
+  grub_uint32_t i, hash;
+  grub_dl_t mod;
+  void *core;
+
+  *found = 0;
+  if (!bundle)
+    return 0;
+
+  h = (const struct grub_dl_bundle_header *) bundle;
+  ent = (const struct grub_dl_bundle_entry *) (h + 1);
+  hash = grub_dl_symbol_hash (name);
+  for (i = 0; i < h->nmodules; i++, ent++)
+    if (ent->hash == hash && grub_strcmp (bundle + ent->name, name) == 0)
+      break;
+  if (i == h->nmodules)
+    return 0;
+  *found = 1;
+
+  /* Loading patches the symbol table in place, so work on a copy to keep
+     the bundle usable if the module is unloaded and loaded again.  */
+  core = grub_malloc (ent->size);
+  if (!core)
+    return 0;
+  grub_memcpy (core, bundle + ent->offset, ent->size);
+
+  /* Dependencies are resolved by grub_dl_load and so are found in the
+     bundle as well; they precede the module there.  */
+  mod = grub_dl_load_core (core, ent->size);
+  grub_free (core);
+  if (! mod)
+    return 0;
+
+  mod->ref_count--;
+  return mod;
+}
+
 /* Load a module using a symbolic name.  */
 grub_dl_t
 grub_dl_load (const char *name)
 {
   char *filename;
   grub_dl_t mod;
+  int in_bundle;
   const char *grub_dl_dir = grub_env_get ("prefix");
 
   mod = grub_dl_get (name);
@@ -741,13 +1005,18 @@ grub_dl_load (const char *name)
     return 0;
   }
 
-  filename = grub_xasprintf ("%s/" GRUB_TARGET_CPU "-" GRUB_PLATFORM "/%s.mod",
-			     grub_dl_dir, name);
-  if (! filename)
-    return 0;
+  grub_dl_open_bundle (grub_dl_dir);
+  mod = grub_dl_load_from_bundle (name, &in_bundle);
+  if (! in_bundle)
+    {
+      filename = grub_xasprintf ("%s/" GRUB_TARGET_CPU "-" GRUB_PLATFORM "/%s.mod",
+				 grub_dl_dir, name);
+      if (! filename)
+	return 0;
 
-  mod = grub_dl_load_file (filename);
-  grub_free (filename);
+      mod = grub_dl_load_file (filename);
+      grub_free (filename);
+    }
 
   if (! mod)
     return 0;
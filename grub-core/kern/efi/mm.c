@@ -42,6 +42,23 @@
 #define MIN_HEAP_SIZE	0x100000
 #define MAX_HEAP_SIZE	(1600 * 0x100000)
 
+/* When the heap runs out, it is grown from conventional memory in chunks
+   starting at MIN_HEAP_GROW_SIZE and doubling up to MAX_HEAP_GROW_SIZE.  */
+#define MIN_HEAP_GROW_SIZE	(4 * 0x100000)
+#define MAX_HEAP_GROW_SIZE	(256 * 0x100000)
+#define MAX_HEAP_GROWTHS	64
+
+static struct
+{
+  grub_efi_physical_address_t addr;
+  grub_efi_uint64_t pages;
+} heap_growth[MAX_HEAP_GROWTHS];
+static unsigned num_heap_growths;
+static grub_size_t heap_grow_size = MIN_HEAP_GROW_SIZE;
+static int heap_grown;
+
+static void release_heap_growth (void);
+
 static void *finish_mmap_buf = 0;
 static grub_efi_uintn_t finish_mmap_size = 0;
 static grub_efi_uintn_t finish_key = 0;
@@ -263,6 +280,8 @@ grub_efi_finish_boot_services (grub_efi_uintn_t *outbuf_size, void *outbuf,
 			   apple, sizeof (apple)) == 0);
 #endif
 
+  release_heap_growth ();
+
   while (1)
     {
       if (grub_efi_get_memory_map (&finish_mmap_size, finish_mmap_buf, &finish_key,
@@ -502,12 +521,14 @@ get_total_pages (grub_efi_memory_descriptor_t *memory_map,
   return total;
 }
 
-/* Add memory regions.  */
-static void
+/* Add memory regions.  If CONSECUTIVE is set, the pages must come from a
+   single descriptor, so that one allocation of that size can succeed.  */
+static grub_err_t
 add_memory_regions (grub_efi_memory_descriptor_t *memory_map,
 		    grub_efi_uintn_t desc_size,
 		    grub_efi_memory_descriptor_t *memory_map_end,
-		    grub_efi_uint64_t required_pages)
+		    grub_efi_uint64_t required_pages,
+		    int consecutive)
 {
   grub_efi_memory_descriptor_t *desc;
 
@@ -526,78 +547,65 @@ add_memory_regions (grub_efi_memory_descriptor_t *memory_map,
 	  start += PAGES_TO_BYTES (pages - required_pages);
 	  pages = required_pages;
 	}
+      else if (consecutive && pages < required_pages)
+	continue;
 
       addr = grub_efi_allocate_pages_real (start, pages,
 					   GRUB_EFI_ALLOCATE_ADDRESS,
 					   GRUB_EFI_LOADER_CODE);      
       if (! addr)
-	grub_fatal ("cannot allocate conventional memory %p with %u pages",
-		    (void *) ((grub_addr_t) start),
-		    (unsigned) pages);
+	{
+	  if (consecutive)
+	    continue;
+	  return grub_error (GRUB_ERR_OUT_OF_MEMORY,
+			     "cannot allocate conventional memory %p with %u pages",
+			     (void *) ((grub_addr_t) start),
+			     (unsigned) pages);
+	}
 
       grub_mm_init_region (addr, PAGES_TO_BYTES (pages));
 
+      if (heap_grown)
+	{
+	  heap_growth[num_heap_growths].addr = start;
+	  heap_growth[num_heap_growths].pages = pages;
+	  num_heap_growths++;
+	}
+
       required_pages -= pages;
       if (required_pages == 0)
 	break;
     }
 
   if (required_pages > 0)
-    grub_fatal ("too little memory");
-}
+    return grub_error (GRUB_ERR_OUT_OF_MEMORY, "too little memory");
 
-void
-grub_efi_memory_fini (void)
-{
-  /*
-   * Free all stale allocations. grub_efi_free_pages() will remove
-   * the found entry from the list and it will always find the first
-   * list entry (efi_allocated_memory is the list start). Hence we
-   * remove all entries from the list until none is left altogether.
-   */
-  while (efi_allocated_memory)
-      grub_efi_free_pages (efi_allocated_memory->address,
-                           efi_allocated_memory->pages);
-}
-
-#if 0
-/* Print the memory map.  */
-static void
-print_memory_map (grub_efi_memory_descriptor_t *memory_map,
-		  grub_efi_uintn_t desc_size,
-		  grub_efi_memory_descriptor_t *memory_map_end)
-{
-  grub_efi_memory_descriptor_t *desc;
-  int i;
-
-  for (desc = memory_map, i = 0;
-       desc < memory_map_end;
-       desc = NEXT_MEMORY_DESCRIPTOR (desc, desc_size), i++)
-    {
-      grub_printf ("MD: t=%x, p=%llx, v=%llx, n=%llx, a=%llx\n",
-		   desc->type, desc->physical_start, desc->virtual_start,
-		   desc->num_pages, desc->attribute);
-    }
+  return GRUB_ERR_NONE;
 }
-#endif
 
-void
-grub_efi_mm_init (void)
+/* Obtain the firmware memory map and add REQUIRED_BYTES of conventional
+   memory to the heap.  If REQUIRED_BYTES is 0, pick the initial heap size
+   from the amount of available memory.  */
+static grub_err_t
+grub_efi_mm_add_regions (grub_size_t required_bytes, int consecutive)
 {
   grub_efi_memory_descriptor_t *memory_map;
   grub_efi_memory_descriptor_t *memory_map_end;
   grub_efi_memory_descriptor_t *filtered_memory_map;
   grub_efi_memory_descriptor_t *filtered_memory_map_end;
   grub_efi_uintn_t map_size;
+  grub_efi_uintn_t map_pages;
   grub_efi_uintn_t desc_size;
   grub_efi_uint64_t total_pages;
   grub_efi_uint64_t required_pages;
+  grub_err_t err;
   int mm_status;
 
   /* Prepare a memory region to store two memory maps.  */
-  memory_map = grub_efi_allocate_any_pages (2 * BYTES_TO_PAGES (MEMORY_MAP_SIZE));
+  map_pages = 2 * BYTES_TO_PAGES (MEMORY_MAP_SIZE);
+  memory_map = grub_efi_allocate_any_pages (map_pages);
   if (! memory_map)
-    grub_fatal ("cannot allocate memory");
+    return grub_error (GRUB_ERR_OUT_OF_MEMORY, "cannot allocate memory");
 
   /* Obtain descriptors for available memory.  */
   map_size = MEMORY_MAP_SIZE;
@@ -607,22 +615,25 @@ grub_efi_mm_init (void)
   if (mm_status == 0)
     {
       grub_efi_free_pages
-	((grub_efi_physical_address_t) ((grub_addr_t) memory_map),
-	 2 * BYTES_TO_PAGES (MEMORY_MAP_SIZE));
+	((grub_efi_physical_address_t) ((grub_addr_t) memory_map), map_pages);
 
       /* Freeing/allocating operations may increase memory map size.  */
       map_size += desc_size * 32;
 
-      memory_map = grub_efi_allocate_any_pages (2 * BYTES_TO_PAGES (map_size));
+      map_pages = 2 * BYTES_TO_PAGES (map_size);
+      memory_map = grub_efi_allocate_any_pages (map_pages);
       if (! memory_map)
-	grub_fatal ("cannot allocate memory");
+	return grub_error (GRUB_ERR_OUT_OF_MEMORY, "cannot allocate memory");
 
       mm_status = grub_efi_get_memory_map (&map_size, memory_map, 0,
 					   &desc_size, 0);
     }
 
   if (mm_status < 0)
-    grub_fatal ("cannot get memory map");
+    {
+      grub_efi_free_pages ((grub_addr_t) memory_map, map_pages);
+      return grub_error (GRUB_ERR_IO, "cannot get memory map");
+    }
 
   memory_map_end = NEXT_MEMORY_DESCRIPTOR (memory_map, map_size);
 
@@ -631,22 +642,28 @@ grub_efi_mm_init (void)
   filtered_memory_map_end = filter_memory_map (memory_map, filtered_memory_map,
 					       desc_size, memory_map_end);
 
-  /* By default, request a quarter of the available memory.  */
-  total_pages = get_total_pages (filtered_memory_map, desc_size,
-				 filtered_memory_map_end);
-  required_pages = (total_pages >> 2);
-  if (required_pages < BYTES_TO_PAGES (MIN_HEAP_SIZE))
-    required_pages = BYTES_TO_PAGES (MIN_HEAP_SIZE);
-  else if (required_pages > BYTES_TO_PAGES (MAX_HEAP_SIZE))
-    required_pages = BYTES_TO_PAGES (MAX_HEAP_SIZE);
+  if (required_bytes)
+    required_pages = BYTES_TO_PAGES (required_bytes);
+  else
+    {
+      /* By default, request a quarter of the available memory.  */
+      total_pages = get_total_pages (filtered_memory_map, desc_size,
+				     filtered_memory_map_end);
+      required_pages = (total_pages >> 2);
+      if (required_pages < BYTES_TO_PAGES (MIN_HEAP_SIZE))
+	required_pages = BYTES_TO_PAGES (MIN_HEAP_SIZE);
+      else if (required_pages > BYTES_TO_PAGES (MAX_HEAP_SIZE))
+	required_pages = BYTES_TO_PAGES (MAX_HEAP_SIZE);
+    }
 
   /* Sort the filtered descriptors, so that GRUB can allocate pages
      from smaller regions.  */
   sort_memory_map (filtered_memory_map, desc_size, filtered_memory_map_end);
 
   /* Allocate memory regions for GRUB's memory management.  */
-  add_memory_regions (filtered_memory_map, desc_size,
-		      filtered_memory_map_end, required_pages);
+  err = add_memory_regions (filtered_memory_map, desc_size,
+			    filtered_memory_map_end, required_pages,
+			    consecutive);
 
 #if 0
   /* For debug.  */
@@ -662,8 +679,111 @@ grub_efi_mm_init (void)
 #endif
 
   /* Release the memory maps.  */
-  grub_efi_free_pages ((grub_addr_t) memory_map,
-		       2 * BYTES_TO_PAGES (MEMORY_MAP_SIZE));
+  grub_efi_free_pages ((grub_addr_t) memory_map, map_pages);
+
+  return err;
+}
+
+/* Called by the allocator when no region can satisfy a request of SIZE
+   bytes.  Grow the heap by at least SIZE bytes, in chunks that double
+   each time so that a long series of allocations does not hit the
+   firmware every time.  */
+static grub_err_t
+grub_efi_mm_grow (grub_size_t size)
+{
+  grub_size_t grow;
+  grub_err_t err;
+
+  if (grub_efi_is_finished || num_heap_growths >= MAX_HEAP_GROWTHS)
+    return GRUB_ERR_OUT_OF_MEMORY;
+
+  /* Leave room for the region header.  */
+  size = ALIGN_UP (size + 0x1000, 0x1000);
+  grow = grub_max (size, heap_grow_size);
+
+  heap_grown = 1;
+  err = grub_efi_mm_add_regions (grow, 1);
+  if (err != GRUB_ERR_NONE && grow > size)
+    {
+      /* Memory is getting scarce, ask for just what is needed.  */
+      grub_errno = GRUB_ERR_NONE;
+      err = grub_efi_mm_add_regions (size, 1);
+    }
+  heap_grown = 0;
+
+  if (err != GRUB_ERR_NONE)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return err;
+    }
+
+  if (heap_grow_size < MAX_HEAP_GROW_SIZE)
+    heap_grow_size *= 2;
+
+  return GRUB_ERR_NONE;
+}
+
+/* Give heap regions added at run time back to the firmware if nothing
+   is allocated from them any more.  */
+static void
+release_heap_growth (void)
+{
+  unsigned i, j;
+
+  for (i = 0, j = 0; i < num_heap_growths; i++)
+    {
+      void *addr = (void *) (grub_addr_t) heap_growth[i].addr;
+
+      if (grub_mm_remove_region (addr, PAGES_TO_BYTES (heap_growth[i].pages)))
+	grub_efi_free_pages (heap_growth[i].addr, heap_growth[i].pages);
+      else
+	heap_growth[j++] = heap_growth[i];
+    }
+  num_heap_growths = j;
+}
+
+void
+grub_efi_memory_fini (void)
+{
+  /*
+   * Free all stale allocations. grub_efi_free_pages() will remove
+   * the found entry from the list and it will always find the first
+   * list entry (efi_allocated_memory is the list start). Hence we
+   * remove all entries from the list until none is left altogether.
+   */
+  while (efi_allocated_memory)
+      grub_efi_free_pages (efi_allocated_memory->address,
+                           efi_allocated_memory->pages);
+}
+
+#if 0
+/* Print the memory map.  */
+static void
+print_memory_map (grub_efi_memory_descriptor_t *memory_map,
+		  grub_efi_uintn_t desc_size,
+		  grub_efi_memory_descriptor_t *memory_map_end)
+{
+  grub_efi_memory_descriptor_t *desc;
+  int i;
+
+  for (desc = memory_map, i = 0;
+       desc < memory_map_end;
+       desc = NEXT_MEMORY_DESCRIPTOR (desc, desc_size), i++)
+    {
+      grub_printf ("MD: t=%x, p=%llx, v=%llx, n=%llx, a=%llx\n",
+		   desc->type, desc->physical_start, desc->virtual_start,
+		   desc->num_pages, desc->attribute);
+    }
+}
+#endif
+
+void
+grub_efi_mm_init (void)
+{
+  if (grub_efi_mm_add_regions (0, 0) != GRUB_ERR_NONE)
+    grub_fatal ("%s", grub_errmsg);
+
+  grub_mm_add_region_fn = grub_efi_mm_grow;
 }
 
 #if defined (__aarch64__) || defined (__arm__) || defined (__riscv)
@@ -28,6 +28,10 @@
   - multiple regions may be used as free space. They may not be
   contiguous.
 
+  - the platform may add regions on demand through grub_mm_add_region_fn
+  when no region can satisfy a request, and take back regions that are
+  completely free with grub_mm_remove_region.
+
   Regions are managed by a singly linked list, and the meta information is
   stored in the beginning of each region. Space after the meta information
   is used to allocate memory.
@@ -53,6 +57,14 @@
   a typical optimization against defragmentation, and makes the
   implementation a bit easier.
 
+  Small blocks, up to GRUB_MM_NUM_CLASSES cells including the header, are
+  segregated by size. Freed small blocks are not returned to their region
+  immediately but pushed on a per-size class list, and allocations of that
+  size pop them back without searching the rings. When a class list is
+  empty, GRUB_MM_CLASS_REFILL blocks are carved out of a region with one
+  search. Blocks on class lists look allocated to the regions; they are
+  given back to their regions (and so coalesced) when a search fails.
+
   For safety, both allocated blocks and free ones are marked by magic
   numbers. Whenever anything unexpected is detected, GRUB aborts the
   operation.
@@ -79,6 +91,11 @@
 
 
 grub_mm_region_t grub_mm_base;
+struct grub_mm_stats grub_mm_stats;
+grub_mm_add_region_func_t grub_mm_add_region_fn;
+
+/* Heads of the size class lists, indexed by block size in cells - 1.  */
+static grub_mm_header_t class_head[GRUB_MM_NUM_CLASSES];
 
 /* Get a header from the pointer PTR, and set *P and *R to a pointer
    to the header and a pointer to its region, respectively. PTR must
@@ -98,13 +115,16 @@ get_header_from_pointer (void *ptr, grub_mm_header_t *p, grub_mm_region_t *r)
     grub_fatal ("out of range pointer %p", ptr);
 
   *p = (grub_mm_header_t) ptr - 1;
-  if ((*p)->magic == GRUB_MM_FREE_MAGIC)
+  if ((*p)->magic == GRUB_MM_FREE_MAGIC
+      || (*p)->magic == GRUB_MM_CACHED_MAGIC)
     grub_fatal ("double free at %p", *p);
   if ((*p)->magic != GRUB_MM_ALLOC_MAGIC)
     grub_fatal ("alloc magic is broken at %p: %lx", *p,
 		(unsigned long) (*p)->magic);
 }
 
+static void free_block (grub_mm_header_t p, grub_mm_region_t r);
+
 /* Initialize a region starting from ADDR and whose size is SIZE,
    to use it as free space.  */
 void
@@ -141,7 +161,7 @@ grub_mm_init_region (void *addr, grub_size_t size)
 	    r->size += h->size << GRUB_MM_ALIGN_LOG2;
 	    r->pre_size &= (GRUB_MM_ALIGN - 1);
 	    *p = r;
-	    grub_free (h + 1);
+	    free_block (h, r);
 	  }
 	*p = r;
 	return;
@@ -175,6 +195,46 @@ grub_mm_init_region (void *addr, grub_size_t size)
   r->next = q;
 }
 
+/* Remove the region that was added with grub_mm_init_region (ADDR, SIZE)
+   if nothing is allocated from it.  Return non-zero if the region was
+   removed and its memory may be given back.  */
+int
+grub_mm_remove_region (void *addr, grub_size_t size)
+{
+  grub_mm_region_t r, *p;
+
+  grub_mm_flush_classes ();
+
+  for (p = &grub_mm_base, r = *p; r; p = &(r->next), r = *p)
+    {
+      grub_mm_header_t h = (grub_mm_header_t) (r + 1);
+
+      if ((grub_addr_t) r - r->pre_size != (grub_addr_t) addr)
+	continue;
+
+      /* The region has been merged with its neighbour.  */
+      if ((grub_addr_t) (r + 1) + r->size > (grub_addr_t) addr + size)
+	return 0;
+
+      if (r->first != h || h->magic != GRUB_MM_FREE_MAGIC
+	  || h->next != h || (h->size << GRUB_MM_ALIGN_LOG2) != r->size)
+	return 0;
+
+      *p = r->next;
+      return 1;
+    }
+
+  return 0;
+}
+
+static inline void
+account_scan (grub_size_t steps)
+{
+  grub_mm_stats.scan_steps += steps;
+  if (steps > grub_mm_stats.max_scan)
+    grub_mm_stats.max_scan = steps;
+}
+
 /* Allocate the number of units N with the alignment ALIGN from the ring
    buffer starting from *FIRST.  ALIGN must be a power of two. Both N and
    ALIGN are in units of GRUB_MM_ALIGN.  Return a non-NULL if successful,
@@ -183,14 +243,17 @@ static void *
 grub_real_malloc (grub_mm_header_t *first, grub_size_t n, grub_size_t align)
 {
   grub_mm_header_t p, q;
+  grub_size_t steps = 0;
 
   /* When everything is allocated side effect is that *first will have alloc
      magic marked, meaning that there is no room in this region.  */
   if ((*first)->magic == GRUB_MM_ALLOC_MAGIC)
     return 0;
 
+  grub_mm_stats.scans++;
+
   /* Try to search free slot for allocation in this memory region.  */
-  for (q = *first, p = q->next; ; q = p, p = p->next)
+  for (q = *first, p = q->next; ; q = p, p = p->next, steps++)
     {
       grub_off_t extra;
 
@@ -303,6 +366,7 @@ grub_real_malloc (grub_mm_header_t *first, grub_size_t n, grub_size_t align)
 	      || *first == p)
 	    *first = q;
 
+	  account_scan (steps + 1);
 	  return p + 1;
 	}
 
@@ -311,9 +375,105 @@ grub_real_malloc (grub_mm_header_t *first, grub_size_t n, grub_size_t align)
 	break;
     }
 
+  account_scan (steps + 1);
   return 0;
 }
 
+/* Take a block of N cells from its class list, refilling the list from
+   the regions if it is empty.  N must not exceed GRUB_MM_NUM_CLASSES.  */
+static void *
+class_alloc (grub_size_t n)
+{
+  struct grub_mm_class_stats *st = &grub_mm_stats.classes[n - 1];
+  grub_mm_region_t r;
+  grub_mm_header_t p;
+  grub_size_t count;
+
+  st->allocs++;
+
+  p = class_head[n - 1];
+  if (p)
+    {
+      if (p->magic != GRUB_MM_CACHED_MAGIC)
+	grub_fatal ("cached magic is broken at %p: %lx", p,
+		    (unsigned long) p->magic);
+      class_head[n - 1] = p->next;
+      st->cached--;
+      st->hits++;
+      p->magic = GRUB_MM_ALLOC_MAGIC;
+      return p + 1;
+    }
+
+  /* Carve several blocks at once so that the following allocations of
+     this size do not have to search the rings.  */
+  count = GRUB_MM_CLASS_REFILL;
+  if (count > GRUB_MM_CLASS_MAX_CACHED + 1)
+    count = GRUB_MM_CLASS_MAX_CACHED + 1;
+
+  for (; count > 1; count /= 2)
+    for (r = grub_mm_base; r; r = r->next)
+      {
+	grub_size_t i;
+
+	p = grub_real_malloc (&(r->first), n * count, 1);
+	if (!p)
+	  continue;
+
+	/* Split the block into COUNT blocks of N cells each. The first one
+	   is returned, the rest go to the class list.  */
+	p--;
+	p->size = n;
+	for (i = count - 1; i > 0; i--)
+	  {
+	    grub_mm_header_t b = p + i * n;
+
+	    b->magic = GRUB_MM_CACHED_MAGIC;
+	    b->size = n;
+	    b->next = class_head[n - 1];
+	    class_head[n - 1] = b;
+	  }
+	st->cached += count - 1;
+	return p + 1;
+      }
+
+  for (r = grub_mm_base; r; r = r->next)
+    {
+      p = grub_real_malloc (&(r->first), n, 1);
+      if (p)
+	return p;
+    }
+
+  return 0;
+}
+
+/* Give all blocks on the class lists back to their regions. Return
+   non-zero if anything was released.  */
+int
+grub_mm_flush_classes (void)
+{
+  unsigned i;
+  int released = 0;
+
+  for (i = 0; i < GRUB_MM_NUM_CLASSES; i++)
+    while (class_head[i])
+      {
+	grub_mm_header_t p = class_head[i];
+	grub_mm_region_t r;
+
+	class_head[i] = p->next;
+	p->magic = GRUB_MM_ALLOC_MAGIC;
+	get_header_from_pointer (p + 1, &p, &r);
+	free_block (p, r);
+	grub_mm_stats.classes[i].cached--;
+	released = 1;
+      }
+
+  if (released)
+    grub_mm_stats.flushes++;
+
+  return released;
+}
+
 /* Allocate SIZE bytes with the alignment ALIGN and return the pointer.  */
 void *
 grub_memalign (grub_size_t align, grub_size_t size)
@@ -338,26 +498,55 @@ grub_memalign (grub_size_t align, grub_size_t size)
   if (align == 0)
     align = 1;
 
+  if (align != 1 || n > GRUB_MM_NUM_CLASSES)
+    grub_mm_stats.large_allocs++;
+
  again:
 
-  for (r = grub_mm_base; r; r = r->next)
+  if (align == 1 && n <= GRUB_MM_NUM_CLASSES)
     {
       void *p;
 
-      p = grub_real_malloc (&(r->first), n, align);
+      p = class_alloc (n);
       if (p)
 	return p;
     }
+  else
+    for (r = grub_mm_base; r; r = r->next)
+      {
+	void *p;
+
+	p = grub_real_malloc (&(r->first), n, align);
+	if (p)
+	  return p;
+      }
 
   /* If failed, increase free memory somehow.  */
   switch (count)
     {
     case 0:
+      /* Let cached small blocks coalesce with their neighbours.  */
+      count++;
+      if (grub_mm_flush_classes ())
+	goto again;
+      /* Fallthrough.  */
+
+    case 1:
       /* Invalidate disk caches.  */
       grub_disk_cache_invalidate_all ();
       count++;
       goto again;
 
+    case 2:
+      /* Ask the platform for more memory.  */
+      count++;
+      if (grub_mm_add_region_fn
+	  && grub_mm_add_region_fn (((n + align) << GRUB_MM_ALIGN_LOG2)
+				    + sizeof (struct grub_mm_region)
+				    + GRUB_MM_ALIGN) == GRUB_ERR_NONE)
+	goto again;
+      break;
+
 #if 0
     case 1:
       /* Unload unneeded modules.  */
@@ -395,18 +584,10 @@ grub_zalloc (grub_size_t size)
   return ret;
 }
 
-/* Deallocate the pointer PTR.  */
-void
-grub_free (void *ptr)
+/* Return the allocated block P of region R to the region's free ring.  */
+static void
+free_block (grub_mm_header_t p, grub_mm_region_t r)
 {
-  grub_mm_header_t p;
-  grub_mm_region_t r;
-
-  if (! ptr)
-    return;
-
-  get_header_from_pointer (ptr, &p, &r);
-
   if (r->first->magic == GRUB_MM_ALLOC_MAGIC)
     {
       p->magic = GRUB_MM_FREE_MAGIC;
@@ -465,6 +646,36 @@ grub_free (void *ptr)
     }
 }
 
+/* Deallocate the pointer PTR.  */
+void
+grub_free (void *ptr)
+{
+  grub_mm_header_t p;
+  grub_mm_region_t r;
+
+  if (! ptr)
+    return;
+
+  get_header_from_pointer (ptr, &p, &r);
+
+  if (p->size <= GRUB_MM_NUM_CLASSES)
+    {
+      struct grub_mm_class_stats *st = &grub_mm_stats.classes[p->size - 1];
+
+      st->frees++;
+      if (st->cached < GRUB_MM_CLASS_MAX_CACHED)
+	{
+	  p->magic = GRUB_MM_CACHED_MAGIC;
+	  p->next = class_head[p->size - 1];
+	  class_head[p->size - 1] = p;
+	  st->cached++;
+	  return;
+	}
+    }
+
+  free_block (p, r);
+}
+
 /* Reallocate SIZE bytes and return the pointer. The contents will be
    the same as that of PTR.  */
 void *
@@ -554,6 +765,9 @@ grub_mm_dump (unsigned lineno)
 	    case GRUB_MM_ALLOC_MAGIC:
 	      grub_printf ("A:%p:%u\n", p, (unsigned int) p->size << GRUB_MM_ALIGN_LOG2);
 	      break;
+	    case GRUB_MM_CACHED_MAGIC:
+	      grub_printf ("C:%p:%u\n", p, (unsigned int) p->size << GRUB_MM_ALIGN_LOG2);
+	      break;
 	    }
 	}
     }
@@ -19,6 +19,7 @@
 #include <grub/types.h>
 #include <grub/misc.h>
 #include <grub/mm.h>
+#include <grub/arena.h>
 #include <grub/err.h>
 #include <grub/legacy_parse.h>
 #include <grub/i386/pc/vesa_modes_table.h>
@@ -356,8 +357,17 @@ static struct legacy_command legacy_commands[] =
     /* FIXME: viewport unsupported.  */
   };
 
-char *
-grub_legacy_escape (const char *in, grub_size_t len)
+/* Allocate the converted arguments of one line from ARENA, so that they
+   go away together however the conversion ends.  grub_legacy_escape
+   passes NULL and returns heap memory instead.  */
+static void *
+arg_alloc (grub_arena_t arena, grub_size_t size)
+{
+  return arena ? grub_arena_alloc (arena, size) : grub_malloc (size);
+}
+
+static char *
+escape (grub_arena_t arena, const char *in, grub_size_t len)
 {
   char *ptr;
   char *ret;
@@ -367,7 +377,7 @@ grub_legacy_escape (const char *in, grub_size_t len)
   for (ptr = (char*)in; ptr < in + len && *ptr; ptr++)
     if (*ptr == '\'')
       overhead += 3;
-  ret = grub_malloc (ptr - in + overhead + 1);
+  ret = arg_alloc (arena, ptr - in + overhead + 1);
   if (!ret)
     return NULL;
 
@@ -379,15 +389,21 @@ grub_legacy_escape (const char *in, grub_size_t len)
   return ret;
 }
 
+char *
+grub_legacy_escape (const char *in, grub_size_t len)
+{
+  return escape (NULL, in, len);
+}
+
 static char *
-adjust_file (const char *in, grub_size_t len)
+adjust_file (grub_arena_t arena, const char *in, grub_size_t len)
 {
   const char *comma, *ptr, *rest;
   char *ret, *outptr;
   int overhead = 0;
   int part = -1, subpart = -1;
   if (in[0] != '(')
-    return grub_legacy_escape (in, len);
+    return escape (arena, in, len);
   for (ptr = in + 1; ptr < in + len && *ptr && *ptr != ')'
 	 && *ptr != ','; ptr++)
     if (*ptr == '\'' || *ptr == '\\')
@@ -401,7 +417,7 @@ adjust_file (const char *in, grub_size_t len)
 	if (*ptr == '\'' || *ptr == '\\')
 	  overhead++;
 
-      ret = grub_malloc (ptr - in + overhead + 15);
+      ret = arg_alloc (arena, ptr - in + overhead + 15);
       if (!ret)
 	return NULL;
 
@@ -417,7 +433,7 @@ adjust_file (const char *in, grub_size_t len)
       return ret;
     }
   if (*comma != ',')
-    return grub_legacy_escape (in, len);
+    return escape (arena, in, len);
   part = grub_strtoull (comma + 1, (char **) &rest, 0);
   if (rest[0] == ',' && rest[1] >= 'a' && rest[1] <= 'z')
     {
@@ -429,7 +445,7 @@ adjust_file (const char *in, grub_size_t len)
       overhead++;
 
   /* 35 is enough for any 2 numbers.  */
-  ret = grub_malloc (ptr - in + overhead + 35 + 5);
+  ret = arg_alloc (arena, ptr - in + overhead + 35 + 5);
   if (!ret)
     return NULL;
 
@@ -499,6 +515,8 @@ grub_legacy_parse (const char *buf, char **entryname, char **suffix)
   const char *cmdname;
   unsigned i, cmdnum;
   char *args[ARRAY_SIZE (legacy_commands[0].argt)];
+  grub_arena_t arena;
+  char *converted = NULL;
 
   *suffix = NULL;
 
@@ -631,6 +649,10 @@ grub_legacy_parse (const char *buf, char **entryname, char **suffix)
       return grub_strdup (outbuf);
     }
 
+  arena = grub_arena_create (0);
+  if (!arena)
+    return NULL;
+
   grub_memset (args, 0, sizeof (args));
 
   {
@@ -667,7 +689,7 @@ grub_legacy_parse (const char *buf, char **entryname, char **suffix)
 	    /* Fallthrough.  */
 	  case TYPE_PARTITION:
 	  case TYPE_FILE:
-	    args[i] = adjust_file (curarg, curarglen);
+	    args[i] = adjust_file (arena, curarg, curarglen);
 	    break;
 
 	  case TYPE_REST_VERBATIM:
@@ -686,9 +708,10 @@ grub_legacy_parse (const char *buf, char **entryname, char **suffix)
 		  overhead += 3;
 		}
 		
-	      outptr0 = args[i] = grub_malloc (overhead + (ptr - curarg));
+	      outptr0 = args[i] = grub_arena_alloc (arena,
+						    overhead + (ptr - curarg));
 	      if (!outptr0)
-		return NULL;
+		goto out;
 	      ptr = curarg;
 	      outptr = outptr0;
 	      while (*ptr)
@@ -718,7 +741,7 @@ grub_legacy_parse (const char *buf, char **entryname, char **suffix)
 	    break;
 
 	  case TYPE_VERBATIM:
-	    args[i] = grub_legacy_escape (curarg, curarglen);
+	    args[i] = escape (arena, curarg, curarglen);
 	    break;
 	  case TYPE_WITH_CONFIGFILE_OPTION:
 	  case TYPE_FORCE_OPTION:
@@ -727,10 +750,10 @@ grub_legacy_parse (const char *buf, char **entryname, char **suffix)
 	  case TYPE_OPTION:
 	    if (is_option (legacy_commands[cmdnum].argt[i], curarg, curarglen))
 	      {
-		args[i] = grub_strndup (curarg, curarglen);
+		args[i] = grub_arena_strndup (arena, curarg, curarglen);
 		break;
 	      }
-	    args[i] = grub_strdup ("");
+	    args[i] = grub_arena_strdup (arena, "");
 	    hold_arg = 1;
 	    break;
 	  case TYPE_INT:
@@ -758,15 +781,16 @@ grub_legacy_parse (const char *buf, char **entryname, char **suffix)
 		    break;
 		}
 	      if (brk == curarg)
-		args[i] = grub_strdup ("0");
+		args[i] = grub_arena_strdup (arena, "0");
 	      else
-		args[i] = grub_strndup (curarg, brk - curarg);
+		args[i] = grub_arena_strndup (arena, curarg, brk - curarg);
 	    }
 	    break;
 	  case TYPE_VBE_MODE:
 	    {
 	      unsigned mod;
 	      struct grub_vesa_mode_table_entry *modedesc;
+	      char modebuf[3 * sizeof ("4294967295")];
 
 	      mod = grub_strtoul (curarg, 0, 0);
 	      if (grub_errno)
@@ -777,25 +801,26 @@ grub_legacy_parse (const char *buf, char **entryname, char **suffix)
 	      if (mod < GRUB_VESA_MODE_TABLE_START
 		  || mod > GRUB_VESA_MODE_TABLE_END)
 		{
-		  args[i] = grub_strdup ("auto");
+		  args[i] = grub_arena_strdup (arena, "auto");
 		  break;
 		}
 	      modedesc = &grub_vesa_mode_table[mod - GRUB_VESA_MODE_TABLE_START];
 	      if (!modedesc->width)
 		{
-		  args[i] = grub_strdup ("auto");
+		  args[i] = grub_arena_strdup (arena, "auto");
 		  break;
 		}
-	      args[i] = grub_xasprintf ("%ux%ux%u",
-					modedesc->width, modedesc->height,
-					modedesc->depth);
+	      grub_snprintf (modebuf, sizeof (modebuf), "%ux%ux%u",
+			     modedesc->width, modedesc->height,
+			     modedesc->depth);
+	      args[i] = grub_arena_strdup (arena, modebuf);
 	      break;
 	    }
 	  case TYPE_BOOL:
 	    if (curarglen == 2 && curarg[0] == 'o' && curarg[1] == 'n')
-	      args[i] = grub_strdup ("1");
+	      args[i] = grub_arena_strdup (arena, "1");
 	    else
-	      args[i] = grub_strdup ("0");
+	      args[i] = grub_arena_strdup (arena, "0");
 	    break;
 	  }
       }
@@ -820,14 +845,14 @@ grub_legacy_parse (const char *buf, char **entryname, char **suffix)
       case TYPE_NOAPM_OPTION:
       case TYPE_TYPE_OR_NOMEM_OPTION:
       case TYPE_OPTION:	
-	args[i] = grub_strdup ("");
+	args[i] = grub_arena_strdup (arena, "");
 	break;
       case TYPE_BOOL:
       case TYPE_INT:
-	args[i] = grub_strdup ("0");
+	args[i] = grub_arena_strdup (arena, "0");
 	break;
       case TYPE_VBE_MODE:    
-	args[i] = grub_strdup ("auto");
+	args[i] = grub_arena_strdup (arena, "auto");
 	break;
       }
 
@@ -843,11 +868,11 @@ grub_legacy_parse (const char *buf, char **entryname, char **suffix)
 	{
 	  grub_error (GRUB_ERR_BAD_ARGUMENT, N_("invalid color specification `%s'"),
 		      args[0]);
-	  return NULL;
+	  goto out;
 	}
-      invert = grub_malloc (len + 1);
+      invert = grub_arena_alloc (arena, len + 1);
       if (!invert)
-	return NULL;
+	goto out;
       grub_memcpy (invert, slash + 1, len - (slash - corig) - 1);
       invert[len - (slash - args[0]) - 1] = '/'; 
       grub_memcpy (invert + len - (slash - corig), corig, slash - corig);
@@ -860,16 +885,13 @@ grub_legacy_parse (const char *buf, char **entryname, char **suffix)
       *suffix = grub_xasprintf (legacy_commands[cmdnum].suffix,
 				args[legacy_commands[cmdnum].suffixarg]);
       if (*suffix)
-	return NULL;
+	goto out;
     }
 
-  {
-    char *ret = grub_xasprintf (legacy_commands[cmdnum].map, args[0], args[1],
-				args[2], args[3]);
-    grub_free (args[0]);
-    grub_free (args[1]);
-    grub_free (args[2]);
-    grub_free (args[3]);
-    return ret;
-  }
+  converted = grub_xasprintf (legacy_commands[cmdnum].map, args[0], args[1],
+			      args[2], args[3]);
+
+ out:
+  grub_arena_destroy (arena);
+  return converted;
 }
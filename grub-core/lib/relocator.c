@@ -439,6 +439,10 @@ malloc_in_range (struct grub_relocator *rel,
   if (end < start + size)
     return 0;
 
+  /* Small blocks parked on the class lists would otherwise split the
+     free ranges we are about to look at.  */
+  grub_mm_flush_classes ();
+
   /* We have to avoid any allocations when filling scanline events. 
      Hence 2-stages.
    */
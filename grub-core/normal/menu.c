@@ -42,6 +42,11 @@
    entry failing to boot.  */
 #define DEFAULT_ENTRY_ERROR_DELAY_MS  2500
 
+/* Most animation frames stepped over at once.  Beyond that the menu was
+   held up (a prompt, a slow disk) and the animations resume from where
+   they were rather than jumping ahead.  */
+#define ENGINE_MAX_SKIPPED_FRAMES  8
+
 grub_err_t (*grub_gfxmenu_try_hook) (int entry, grub_menu_t menu,
 				     int nested) = NULL;
 
@@ -868,11 +873,23 @@ run_menu (grub_menu_t menu, int nested, int *auto_boot)
 
       grub_uint64_t cur_time = grub_get_time_ms ();
 
-      /* Refresh the animation.  */
-      if (animation_open && (cur_time - s1_time >= frame_speed))
+      /* Refresh the animation.  Frames fall due every FRAME_SPEED ms
+	 after S1_TIME.  When drawing could not keep up, the animations
+	 step over the frames that were missed and are drawn once, so they
+	 move at the same speed whatever the machine.  */
+      if (animation_open && frame_speed && (cur_time - s1_time >= frame_speed))
 	{
-	  s1_time = cur_time;
-	  menu_set_animation_state (egn_refresh);
+	  grub_uint64_t frames;
+
+	  frames = grub_divmod64 (cur_time - s1_time, frame_speed, 0);
+	  if (frames > ENGINE_MAX_SKIPPED_FRAMES)
+	    {
+	      frames = 1;
+	      s1_time = cur_time;
+	    }
+	  else
+	    s1_time += frames * frame_speed;
+	  menu_set_animation_state ((int) frames);
 	}
 
 #if defined (__i386__) || defined (__x86_64__)
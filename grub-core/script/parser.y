@@ -41,7 +41,7 @@
   char *string;
   struct {
     unsigned offset;
-    struct grub_script_mem *memory;
+    grub_arena_t memory;
     struct grub_script *scripts;
   };
 }
@@ -190,7 +190,7 @@ block: "{"
        commands1 delimiters0 "}"
        {
          char *p;
-	 struct grub_script_mem *memory;
+	 grub_arena_t memory;
 	 struct grub_script *s = $<scripts>2;
 
 	 memory = grub_script_mem_record_stop (state, $<memory>2);
@@ -27,53 +27,39 @@
    allocations.  The memory is freed in case of an error, or assigned
    to the parsed script when parsing was successful.
 
-   In case of the normal malloc, some additional bytes are allocated
-   for this datastructure.  All reserved memory is stored in a linked
-   list so it can be easily freed.  The original memory can be found
-   from &mem.  */
-struct grub_script_mem
-{
-  struct grub_script_mem *next;
-  char mem;
-};
+   All memory is taken from an arena, which is created on the first
+   allocation after recording starts, so the parsed script (or a failed
+   parse) is freed at once without walking every node.  */
 
-/* Return malloc'ed memory and keep track of the allocation.  */
+/* Return arena memory and keep track of the allocation.  */
 void *
 grub_script_malloc (struct grub_parser_param *state, grub_size_t size)
 {
-  struct grub_script_mem *mem;
-  mem = (struct grub_script_mem *) grub_malloc (size + sizeof (*mem)
-						- sizeof (char));
-  if (!mem)
-    return 0;
+  if (!state->memused)
+    {
+      state->memused = grub_arena_create (0);
+      if (!state->memused)
+	return 0;
+      grub_dprintf ("scripting", "arena %p\n", state->memused);
+    }
 
-  grub_dprintf ("scripting", "malloc %p\n", mem);
-  mem->next = state->memused;
-  state->memused = mem;
-  return (void *) &mem->mem;
+  return grub_arena_alloc (state->memused, size);
 }
 
 /* Free all memory described by MEM.  */
 void
-grub_script_mem_free (struct grub_script_mem *mem)
+grub_script_mem_free (grub_arena_t mem)
 {
-  struct grub_script_mem *memfree;
-
-  while (mem)
-    {
-      memfree = mem->next;
-      grub_dprintf ("scripting", "free %p\n", mem);
-      grub_free (mem);
-      mem = memfree;
-    }
+  grub_dprintf ("scripting", "free arena %p\n", mem);
+  grub_arena_destroy (mem);
 }
 
 /* Start recording memory usage.  Returns the memory that should be
    restored when calling stop.  */
-struct grub_script_mem *
+grub_arena_t
 grub_script_mem_record (struct grub_parser_param *state)
 {
-  struct grub_script_mem *mem = state->memused;
+  grub_arena_t mem = state->memused;
   state->memused = 0;
 
   return mem;
@@ -81,11 +67,11 @@ grub_script_mem_record (struct grub_parser_param *state)
 
 /* Stop recording memory usage.  Restore previous recordings using
    RESTORE.  Return the recorded memory.  */
-struct grub_script_mem *
+grub_arena_t
 grub_script_mem_record_stop (struct grub_parser_param *state,
-			     struct grub_script_mem *restore)
+			     grub_arena_t restore)
 {
-  struct grub_script_mem *mem = state->memused;
+  grub_arena_t mem = state->memused;
   state->memused = restore;
   return mem;
 }
@@ -320,7 +306,7 @@ grub_script_append_cmd (struct grub_parser_param *state,
 
 
 struct grub_script *
-grub_script_create (struct grub_script_cmd *cmd, struct grub_script_mem *mem)
+grub_script_create (struct grub_script_cmd *cmd, grub_arena_t mem)
 {
   struct grub_script *parsed;
 
@@ -344,7 +330,7 @@ grub_script_parse (char *script,
 		   grub_reader_getline_t getline, void *getline_data)
 {
   struct grub_script *parsed;
-  struct grub_script_mem *membackup;
+  grub_arena_t membackup;
   struct grub_lexer_param *lexstate;
   struct grub_parser_param *parsestate;
 
@@ -376,7 +362,7 @@ grub_script_parse (char *script,
   /* Parse the script.  */
   if (grub_script_yyparse (parsestate) || parsestate->err)
     {
-      struct grub_script_mem *memfree;
+      grub_arena_t memfree;
       memfree = grub_script_mem_record_stop (parsestate, membackup);
       grub_script_mem_free (memfree);
       grub_script_lexer_fini (lexstate);
@@ -0,0 +1,145 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2020  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/test.h>
+#include <grub/dl.h>
+#include <grub/misc.h>
+#include <grub/video.h>
+#include <grub/bitmap.h>
+#include <grub/bitmap_scale.h>
+#include <grub/lib/crc.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+#define BOX	GRUB_VIDEO_BITMAP_SCALE_METHOD_BOX
+#define LANCZOS	GRUB_VIDEO_BITMAP_SCALE_METHOD_LANCZOS
+#define BEST	GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST
+#define RGBA	GRUB_VIDEO_BLIT_FORMAT_RGBA_8888
+#define RGB	GRUB_VIDEO_BLIT_FORMAT_RGB_888
+
+/* Scaling of fixed pseudo-random bitmaps.  The checksums are CRC-32C of
+   the rows of the result.  */
+static const struct
+{
+  unsigned sw, sh, dw, dh;
+  enum grub_video_bitmap_scale_method method;
+  enum grub_video_blit_format format;
+  grub_uint32_t crc;
+} cases[] =
+  {
+    /* Whole factors, averaged block by block.  */
+    { 8, 6, 4, 3, BOX, RGBA, 0x5ad54542 },
+    { 8, 4, 4, 2, BOX, RGB, 0x5c620657 },
+    { 9, 6, 3, 2, BOX, RGBA, 0xafe3a1f7 },
+    { 1, 8, 1, 4, BOX, RGBA, 0x8b850144 },
+    { 1, 9, 1, 3, BOX, RGB, 0x8c502de8 },
+    { 12, 8, 6, 4, BEST, RGBA, 0xc7b661ff },
+    { 1, 6, 1, 2, BEST, RGB, 0xa2543d5c },
+    /* Everything else goes through the separable filters.  */
+    { 10, 7, 4, 3, BOX, RGBA, 0xe6a0c307 },
+    { 1, 7, 1, 3, BOX, RGBA, 0xbeebac8d },
+    { 3, 5, 7, 9, BOX, RGB, 0x8a74c770 },
+    { 8, 8, 4, 4, LANCZOS, RGBA, 0xdc30d1a3 },
+    { 16, 12, 7, 5, LANCZOS, RGB, 0x07aaa76e },
+    { 5, 4, 12, 9, LANCZOS, RGBA, 0x28435111 },
+    { 1, 9, 1, 4, LANCZOS, RGBA, 0xb326bb02 },
+    { 1, 5, 1, 9, LANCZOS, RGB, 0xdfa7dd60 },
+    { 1, 6, 3, 2, BEST, RGBA, 0x715bdac0 },
+    { 6, 4, 13, 9, BEST, RGB, 0x509dfb74 },
+    { 1, 1, 4, 4, BEST, RGBA, 0xc7ad9758 },
+  };
+
+static void
+fill (struct grub_video_bitmap *bitmap, grub_uint32_t *seed)
+{
+  unsigned x, y;
+
+  for (y = 0; y < bitmap->mode_info.height; y++)
+    {
+      grub_uint8_t *p = (grub_uint8_t *) bitmap->data
+	+ y * bitmap->mode_info.pitch;
+
+      for (x = 0; x < bitmap->mode_info.width
+	     * bitmap->mode_info.bytes_per_pixel; x++)
+	{
+	  *seed = *seed * 1103515245 + 12345;
+	  p[x] = *seed >> 16;
+	}
+    }
+}
+
+static grub_uint32_t
+checksum (struct grub_video_bitmap *bitmap)
+{
+  grub_uint32_t crc = 0;
+  unsigned y;
+
+  for (y = 0; y < bitmap->mode_info.height; y++)
+    crc = grub_getcrc32c (crc, (grub_uint8_t *) bitmap->data
+			  + y * bitmap->mode_info.pitch,
+			  bitmap->mode_info.width
+			  * bitmap->mode_info.bytes_per_pixel);
+  return crc;
+}
+
+static void
+bitmap_scale_test (void)
+{
+  grub_uint32_t seed = 1;
+  unsigned i;
+
+  for (i = 0; i < ARRAY_SIZE (cases); i++)
+    {
+      struct grub_video_bitmap *src, *dst;
+      grub_uint32_t crc;
+
+      if (grub_video_bitmap_create (&src, cases[i].sw, cases[i].sh,
+				    cases[i].format) != GRUB_ERR_NONE)
+	{
+	  grub_test_assert (0, "cannot create %ux%u source",
+			    cases[i].sw, cases[i].sh);
+	  return;
+	}
+      fill (src, &seed);
+
+      if (grub_video_bitmap_create_scaled (&dst, cases[i].dw, cases[i].dh,
+					   src, cases[i].method)
+	  != GRUB_ERR_NONE)
+	{
+	  grub_test_assert (0, "cannot scale %ux%u to %ux%u: %s",
+			    cases[i].sw, cases[i].sh, cases[i].dw, cases[i].dh,
+			    grub_errmsg);
+	  grub_errno = GRUB_ERR_NONE;
+	  grub_video_bitmap_destroy (src);
+	  continue;
+	}
+
+      crc = checksum (dst);
+      grub_test_assert (crc == cases[i].crc,
+			"%ux%u to %ux%u with method %d: checksum 0x%08x,"
+			" expected 0x%08x", cases[i].sw, cases[i].sh,
+			cases[i].dw, cases[i].dh, cases[i].method,
+			crc, cases[i].crc);
+
+      grub_video_bitmap_destroy (dst);
+      grub_video_bitmap_destroy (src);
+    }
+}
+
+/* Register bitmap_scale_test method as a functional test.  */
+GRUB_FUNCTIONAL_TEST (bitmap_scale_test, bitmap_scale_test);
@@ -0,0 +1,86 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2020  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/test.h>
+#include <grub/dl.h>
+#include <grub/misc.h>
+#include <grub/disk.h>
+#include <grub/diskfilter.h>
+#include <grub/raid_ref.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+#define TEST_SIZE 1024
+
+static grub_uint8_t a[TEST_SIZE], b[TEST_SIZE], ref[TEST_SIZE];
+
+/* Compare every block operation against the reference for all multipliers
+   and for all relative alignments of the buffers.  */
+static void
+raid_test (void)
+{
+  grub_uint32_t seed = 1;
+  unsigned mul, doff, soff;
+  grub_size_t i, len;
+
+  grub_raid_ref_init ();
+
+  for (mul = 0; mul < 256; mul++)
+    for (doff = 0; doff < 8; doff++)
+      for (soff = 0; soff < 8; soff++)
+	{
+	  len = TEST_SIZE - 8 - ((mul + doff + soff) & 31);
+	  grub_raid_ref_fill (a, TEST_SIZE, &seed);
+	  grub_raid_ref_fill (b, TEST_SIZE, &seed);
+	  grub_memcpy (ref, a, TEST_SIZE);
+
+	  grub_raid_ref_block_mul_xor (mul, ref + doff, b + soff, len);
+	  grub_raid_block_mul_xor (mul, a + doff, b + soff, len);
+	  grub_test_assert (grub_memcmp (a, ref, TEST_SIZE) == 0,
+			    "mul_xor mismatch: multiplier 0x%02x, offsets %u/%u",
+			    mul, doff, soff);
+
+	  if (soff != 0)
+	    continue;
+
+	  for (i = 0; i < len; i++)
+	    ref[doff + i] = grub_raid_ref_mul (ref[doff + i], mul);
+	  grub_raid_block_mul (mul, a + doff, len);
+	  grub_test_assert (grub_memcmp (a, ref, TEST_SIZE) == 0,
+			    "mul mismatch: multiplier 0x%02x, offset %u",
+			    mul, doff);
+	}
+
+  for (doff = 0; doff < 8; doff++)
+    for (soff = 0; soff < 8; soff++)
+      {
+	len = TEST_SIZE - 8 - doff;
+	grub_raid_ref_fill (a, TEST_SIZE, &seed);
+	grub_raid_ref_fill (b, TEST_SIZE, &seed);
+	grub_memcpy (ref, a, TEST_SIZE);
+
+	for (i = 0; i < len; i++)
+	  ref[doff + i] ^= b[soff + i];
+	grub_raid_block_xor (a + doff, b + soff, len);
+	grub_test_assert (grub_memcmp (a, ref, TEST_SIZE) == 0,
+			  "xor mismatch: offsets %u/%u", doff, soff);
+      }
+}
+
+/* Register raid_test method as a functional test.  */
+GRUB_FUNCTIONAL_TEST (raid_test, raid_test);
@@ -0,0 +1,228 @@
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2020  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/test.h>
+#include <grub/dl.h>
+#include <grub/misc.h>
+#include <grub/video.h>
+#include <grub/video_fb.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+#define WIDTH		64
+#define HEIGHT		48
+#define ITERATIONS	20000
+
+static struct grub_video_mode_info mode_info =
+  {
+    .width = WIDTH,
+    .height = HEIGHT,
+    .pitch = WIDTH * 4,
+    GRUB_VIDEO_MI_RGBA8888 ()
+  };
+
+/* What a driver using the shadow operations would have on the screen.  */
+static grub_uint32_t screen[WIDTH * HEIGHT];
+static grub_uint32_t moved[WIDTH * HEIGHT];
+static unsigned int nmoves, nfills;
+static grub_uint32_t *shadow;
+
+static int
+rect_ok (unsigned int x, unsigned int y, unsigned int width,
+	 unsigned int height)
+{
+  return x <= WIDTH && width <= WIDTH - x && y <= HEIGHT
+    && height <= HEIGHT - y;
+}
+
+static grub_err_t
+mock_update (const grub_video_rect_t *rect)
+{
+  unsigned int y;
+
+  if (!rect_ok (rect->x, rect->y, rect->width, rect->height))
+    return grub_error (GRUB_ERR_BUG, "update outside of the screen");
+  for (y = rect->y; y < rect->y + rect->height; y++)
+    grub_memcpy (screen + y * WIDTH + rect->x, shadow + y * WIDTH + rect->x,
+		 rect->width * sizeof (screen[0]));
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+mock_move (unsigned int src_x, unsigned int src_y,
+	   unsigned int dst_x, unsigned int dst_y,
+	   unsigned int width, unsigned int height)
+{
+  unsigned int y;
+
+  if (!rect_ok (src_x, src_y, width, height)
+      || !rect_ok (dst_x, dst_y, width, height))
+    return grub_error (GRUB_ERR_BUG, "move outside of the screen");
+  nmoves++;
+  for (y = 0; y < height; y++)
+    grub_memcpy (moved + y * WIDTH, screen + (src_y + y) * WIDTH + src_x,
+		 width * sizeof (screen[0]));
+  for (y = 0; y < height; y++)
+    grub_memcpy (screen + (dst_y + y) * WIDTH + dst_x, moved + y * WIDTH,
+		 width * sizeof (screen[0]));
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+mock_fill (grub_video_color_t color, const grub_video_rect_t *rect)
+{
+  unsigned int x, y;
+
+  if (!rect_ok (rect->x, rect->y, rect->width, rect->height))
+    return grub_error (GRUB_ERR_BUG, "fill outside of the screen");
+  nfills++;
+  for (y = rect->y; y < rect->y + rect->height; y++)
+    for (x = rect->x; x < rect->x + rect->width; x++)
+      screen[y * WIDTH + x] = color;
+  return GRUB_ERR_NONE;
+}
+
+static const struct grub_video_fb_shadow_ops mock_ops =
+  {
+    .update = mock_update,
+    .move = mock_move,
+    .fill = mock_fill
+  };
+
+static grub_uint32_t seed;
+
+static unsigned int
+rnd (unsigned int n)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) % n;
+}
+
+static grub_video_color_t
+rnd_color (void)
+{
+  return grub_video_map_rgb (rnd (256), rnd (256), rnd (256));
+}
+
+/* Draw at random with the operations the shadow code treats specially,
+   and check after every swap that the moves, fills and updates it issued
+   leave the screen equal to the shadow.  */
+static void
+video_shadow_test (void)
+{
+  struct grub_video_render_target *sprite, *display;
+  unsigned int i, x, y;
+  int swaps = 0;
+
+  seed = 1;
+  nmoves = nfills = 0;
+  grub_memset (screen, 0, sizeof (screen));
+
+  if (grub_video_capture_start_shadow (&mode_info, grub_video_fbstd_colors,
+				       GRUB_VIDEO_FBSTD_NUMCOLORS,
+				       &mock_ops))
+    {
+      grub_test_assert (0, "can't start capture: %s", grub_errmsg);
+      grub_errno = GRUB_ERR_NONE;
+      return;
+    }
+  shadow = grub_video_capture_get_framebuffer ();
+  grub_memset (shadow, 0, WIDTH * HEIGHT * sizeof (shadow[0]));
+
+  if (grub_video_create_render_target (&sprite, 8, 8,
+				       GRUB_VIDEO_MODE_TYPE_RGB))
+    {
+      grub_test_assert (0, "can't create render target: %s", grub_errmsg);
+      grub_errno = GRUB_ERR_NONE;
+      grub_video_capture_end ();
+      return;
+    }
+
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      unsigned int op = rnd (10);
+
+      if (op == 0)
+	{
+	  x = rnd (WIDTH);
+	  y = rnd (HEIGHT);
+	  grub_video_set_viewport (x, y, 1 + rnd (WIDTH - x),
+				   1 + rnd (HEIGHT - y));
+	}
+      else if (op == 1)
+	grub_video_set_viewport (0, 0, WIDTH, HEIGHT);
+      else if (op <= 4)
+	grub_video_fill_rect (rnd_color (), (int) rnd (WIDTH) - 8,
+			      (int) rnd (HEIGHT) - 8, rnd (20), rnd (20));
+      else if (op == 5)
+	{
+	  /* Fills large enough to be left to the driver.  */
+	  if (rnd (3) == 0)
+	    grub_video_fill_rect (rnd_color (), 0, 0, WIDTH, HEIGHT);
+	  else
+	    grub_video_fill_rect (rnd_color (), rnd (10), rnd (10),
+				  WIDTH / 2 + rnd (WIDTH),
+				  HEIGHT / 2 + rnd (HEIGHT));
+	}
+      else if (op <= 7)
+	grub_video_scroll (rnd_color (),
+			   rnd (3) == 0 ? (int) rnd (9) - 4 : 0,
+			   (int) rnd (17) - 8);
+      else if (op == 8)
+	{
+	  grub_video_get_active_render_target (&display);
+	  grub_video_set_active_render_target (sprite);
+	  grub_video_fill_rect (rnd_color (), rnd (8), rnd (8), rnd (8),
+				rnd (8));
+	  grub_video_set_active_render_target (display);
+	  grub_video_blit_render_target (sprite, GRUB_VIDEO_BLIT_REPLACE,
+					 (int) rnd (WIDTH) - 4,
+					 (int) rnd (HEIGHT) - 4, 0, 0, 8, 8);
+	}
+      else
+	{
+	  grub_video_swap_buffers ();
+	  swaps++;
+	  for (y = 0; y < HEIGHT; y++)
+	    for (x = 0; x < WIDTH; x++)
+	      if (screen[y * WIDTH + x] != shadow[y * WIDTH + x])
+		{
+		  grub_test_assert (0, "screen differs from the shadow at"
+				    " %u,%u after swap %d", x, y, swaps);
+		  goto out;
+		}
+	}
+
+      if (grub_errno)
+	{
+	  grub_test_assert (0, "operation %u failed: %s", op, grub_errmsg);
+	  grub_errno = GRUB_ERR_NONE;
+	  goto out;
+	}
+    }
+
+  grub_test_assert (nmoves > 0, "the driver was never asked to move");
+  grub_test_assert (nfills > 0, "the driver was never asked to fill");
+
+ out:
+  grub_video_delete_render_target (sprite);
+  grub_video_capture_end ();
+}
+
+/* Register video_shadow_test method as a functional test.  */
+GRUB_FUNCTIONAL_TEST (video_shadow_test, video_shadow_test);
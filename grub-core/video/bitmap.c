@@ -97,6 +97,22 @@ grub_video_bitmap_create (struct grub_video_bitmap **bitmap,
         mode_info->reserved_field_pos = 24;
         break;
 
+      case GRUB_VIDEO_BLIT_FORMAT_BGRA_8888:
+        mode_info->mode_type = GRUB_VIDEO_MODE_TYPE_RGB
+                               | GRUB_VIDEO_MODE_TYPE_ALPHA;
+        mode_info->bpp = 32;
+        mode_info->bytes_per_pixel = 4;
+        mode_info->number_of_colors = 256;
+        mode_info->red_mask_size = 8;
+        mode_info->red_field_pos = 16;
+        mode_info->green_mask_size = 8;
+        mode_info->green_field_pos = 8;
+        mode_info->blue_mask_size = 8;
+        mode_info->blue_field_pos = 0;
+        mode_info->reserved_mask_size = 8;
+        mode_info->reserved_field_pos = 24;
+        break;
+
       case GRUB_VIDEO_BLIT_FORMAT_RGB_888:
         mode_info->mode_type = GRUB_VIDEO_MODE_TYPE_RGB;
         mode_info->bpp = 24;
@@ -112,6 +128,21 @@ grub_video_bitmap_create (struct grub_video_bitmap **bitmap,
         mode_info->reserved_field_pos = 0;
         break;
 
+      case GRUB_VIDEO_BLIT_FORMAT_BGR_888:
+        mode_info->mode_type = GRUB_VIDEO_MODE_TYPE_RGB;
+        mode_info->bpp = 24;
+        mode_info->bytes_per_pixel = 3;
+        mode_info->number_of_colors = 256;
+        mode_info->red_mask_size = 8;
+        mode_info->red_field_pos = 16;
+        mode_info->green_mask_size = 8;
+        mode_info->green_field_pos = 8;
+        mode_info->blue_mask_size = 8;
+        mode_info->blue_field_pos = 0;
+        mode_info->reserved_mask_size = 0;
+        mode_info->reserved_field_pos = 0;
+        break;
+
       case GRUB_VIDEO_BLIT_FORMAT_INDEXCOLOR:
         mode_info->mode_type = GRUB_VIDEO_MODE_TYPE_INDEX_COLOR;
         mode_info->bpp = 8;
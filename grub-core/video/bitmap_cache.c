@@ -0,0 +1,377 @@
+/* bitmap_cache.c - Shared cache of decoded, scaled and converted images.  */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2020  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <grub/mm.h>
+#include <grub/misc.h>
+#include <grub/env.h>
+#include <grub/video.h>
+#include <grub/bitmap.h>
+#include <grub/bitmap_scale.h>
+#include <grub/bitmap_cache.h>
+#include <grub/types.h>
+#include <grub/dl.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+/* One image as loaded from FILENAME, scaled to WIDTH x HEIGHT (0 x 0 for
+   its own size) and converted for a display using FORMAT.  */
+struct cache_entry
+{
+  struct cache_entry *next;
+  char *filename;
+  unsigned int width;
+  unsigned int height;
+  enum grub_video_bitmap_scale_method scale_method;
+  enum grub_video_blit_format format;
+  struct grub_video_bitmap *bitmap;
+  grub_size_t size;
+  unsigned int refs;
+  grub_uint64_t last_use;
+};
+
+static struct cache_entry *cache;
+static grub_size_t cache_used;
+static grub_uint64_t use_clock;
+
+static grub_size_t
+cache_budget (void)
+{
+  const char *val;
+  const char *end;
+  unsigned long kib;
+
+  val = grub_env_get ("bitmap_cache_size");
+  if (val && *val)
+    {
+      kib = grub_strtoul (val, (char **) &end, 0);
+      if (grub_errno == GRUB_ERR_NONE && *end == '\0')
+	return (grub_size_t) kib << 10;
+      grub_errno = GRUB_ERR_NONE;
+    }
+
+  return (grub_size_t) GRUB_VIDEO_BITMAP_CACHE_DEFAULT_SIZE << 10;
+}
+
+static void
+free_entry (struct cache_entry *entry)
+{
+  cache_used -= entry->size;
+  grub_video_bitmap_destroy (entry->bitmap);
+  grub_free (entry->filename);
+  grub_free (entry);
+}
+
+/* Drop least recently used images nobody holds until the cache fits in
+   LIMIT bytes.  */
+static void
+cache_trim (grub_size_t limit)
+{
+  while (cache_used > limit)
+    {
+      struct cache_entry **p, **victim = 0;
+
+      for (p = &cache; *p; p = &(*p)->next)
+	if ((*p)->refs == 0
+	    && (! victim || (*p)->last_use < (*victim)->last_use))
+	  victim = p;
+
+      if (! victim)
+	break;
+
+      {
+	struct cache_entry *entry = *victim;
+	*victim = entry->next;
+	free_entry (entry);
+      }
+    }
+}
+
+/* Pixel format images should be converted to, or GRUB_VIDEO_BLIT_FORMAT_RGBA
+   when no video mode is set and they are kept as loaded.  */
+static enum grub_video_blit_format
+display_format (void)
+{
+  struct grub_video_mode_info mode_info;
+
+  if (grub_video_get_info (&mode_info) != GRUB_ERR_NONE)
+    {
+      grub_errno = GRUB_ERR_NONE;
+      return GRUB_VIDEO_BLIT_FORMAT_RGBA;
+    }
+
+  return grub_video_get_blit_format (&mode_info);
+}
+
+/* Convert an image as produced by the readers to the display's layout so
+   that blits need no per-pixel conversion.  Images without transparency
+   lose their alpha channel and are blitted as plain copies; others keep
+   it, with the channels reordered where the blender supports that.  */
+static grub_err_t
+convert_bitmap (struct grub_video_bitmap **bitmap,
+		enum grub_video_blit_format format)
+{
+  struct grub_video_bitmap *src = *bitmap, *dst;
+  enum grub_video_blit_format from = src->mode_info.blit_format;
+  unsigned int width = src->mode_info.width;
+  unsigned int height = src->mode_info.height;
+  unsigned int x, y, sbpp, dbpp;
+  int opaque = 1, swap;
+  grub_err_t err;
+
+  if (from != GRUB_VIDEO_BLIT_FORMAT_RGBA_8888
+      && from != GRUB_VIDEO_BLIT_FORMAT_RGB_888)
+    return GRUB_ERR_NONE;
+  if (format != GRUB_VIDEO_BLIT_FORMAT_BGRA_8888
+      && format != GRUB_VIDEO_BLIT_FORMAT_RGBA_8888
+      && format != GRUB_VIDEO_BLIT_FORMAT_BGR_888
+      && format != GRUB_VIDEO_BLIT_FORMAT_RGB_888)
+    return GRUB_ERR_NONE;
+
+  if (from == GRUB_VIDEO_BLIT_FORMAT_RGBA_8888)
+    for (y = 0; y < height && opaque; y++)
+      {
+	grub_uint8_t *s = (grub_uint8_t *) src->data + y * src->mode_info.pitch;
+
+	for (x = 0; x < width; x++)
+	  if (s[4 * x + 3] != 0xff)
+	    {
+	      opaque = 0;
+	      break;
+	    }
+      }
+
+  if (! opaque)
+    format = (format == GRUB_VIDEO_BLIT_FORMAT_BGRA_8888
+	      ? GRUB_VIDEO_BLIT_FORMAT_BGRA_8888
+	      : GRUB_VIDEO_BLIT_FORMAT_RGBA_8888);
+
+  swap = (format == GRUB_VIDEO_BLIT_FORMAT_BGRA_8888
+	  || format == GRUB_VIDEO_BLIT_FORMAT_BGR_888);
+  sbpp = src->mode_info.bytes_per_pixel;
+  dbpp = (format == GRUB_VIDEO_BLIT_FORMAT_BGRA_8888
+	  || format == GRUB_VIDEO_BLIT_FORMAT_RGBA_8888) ? 4 : 3;
+
+  if (sbpp == dbpp)
+    {
+      /* Same size: reorder in place.  */
+      if (swap)
+	{
+	  for (y = 0; y < height; y++)
+	    {
+	      grub_uint8_t *s = (grub_uint8_t *) src->data
+		+ y * src->mode_info.pitch;
+
+	      for (x = 0; x < width; x++, s += sbpp)
+		{
+		  grub_uint8_t t = s[0];
+		  s[0] = s[2];
+		  s[2] = t;
+		}
+	    }
+	  src->mode_info.red_field_pos = 16;
+	  src->mode_info.blue_field_pos = 0;
+	  src->mode_info.blit_format = format;
+	}
+      dst = src;
+    }
+  else
+    {
+      err = grub_video_bitmap_create (&dst, width, height, format);
+      if (err)
+	return err;
+
+      for (y = 0; y < height; y++)
+	{
+	  grub_uint8_t *s = (grub_uint8_t *) src->data
+	    + y * src->mode_info.pitch;
+	  grub_uint8_t *d = (grub_uint8_t *) dst->data
+	    + y * dst->mode_info.pitch;
+
+	  for (x = 0; x < width; x++, s += sbpp, d += dbpp)
+	    {
+	      d[0] = swap ? s[2] : s[0];
+	      d[1] = s[1];
+	      d[2] = swap ? s[0] : s[2];
+	      if (dbpp == 4)
+		d[3] = 0xff;
+	    }
+	}
+      grub_video_bitmap_destroy (src);
+    }
+
+  if (opaque)
+    dst->mode_info.mode_type &= ~GRUB_VIDEO_MODE_TYPE_ALPHA;
+
+  *bitmap = dst;
+  return GRUB_ERR_NONE;
+}
+
+static struct cache_entry *
+cache_lookup (const char *filename, unsigned int width, unsigned int height,
+	      enum grub_video_bitmap_scale_method scale_method,
+	      enum grub_video_blit_format format)
+{
+  struct cache_entry *entry;
+
+  for (entry = cache; entry; entry = entry->next)
+    if (entry->width == width && entry->height == height
+	&& entry->scale_method == scale_method && entry->format == format
+	&& grub_strcmp (entry->filename, filename) == 0)
+      return entry;
+
+  return 0;
+}
+
+grub_err_t
+grub_video_bitmap_cache_get (struct grub_video_bitmap **bitmap,
+			     const char *filename,
+			     unsigned int width, unsigned int height,
+			     enum grub_video_bitmap_scale_method scale_method)
+{
+  enum grub_video_blit_format format = display_format ();
+  struct grub_video_bitmap *result;
+  struct cache_entry *entry;
+  grub_err_t err;
+
+  if (! bitmap)
+    return grub_error (GRUB_ERR_BUG, "invalid argument");
+
+  *bitmap = 0;
+
+  if (width == 0 || height == 0)
+    {
+      width = height = 0;
+      scale_method = GRUB_VIDEO_BITMAP_SCALE_METHOD_FASTEST;
+    }
+
+  entry = cache_lookup (filename, width, height, scale_method, format);
+  if (entry)
+    {
+      entry->refs++;
+      entry->last_use = ++use_clock;
+      *bitmap = entry->bitmap;
+      return GRUB_ERR_NONE;
+    }
+
+  if (width == 0)
+    {
+      err = grub_video_bitmap_load (&result, filename);
+      if (err)
+	return err;
+      err = convert_bitmap (&result, format);
+      if (err)
+	{
+	  grub_video_bitmap_destroy (result);
+	  return err;
+	}
+    }
+  else
+    {
+      struct grub_video_bitmap *raw;
+
+      /* Scale from the cached full-size image, so that a new size does
+	 not mean decoding the file again.  */
+      err = grub_video_bitmap_cache_get (&raw, filename, 0, 0, scale_method);
+      if (err)
+	return err;
+
+      if (raw->mode_info.width == width && raw->mode_info.height == height)
+	{
+	  *bitmap = raw;
+	  return GRUB_ERR_NONE;
+	}
+
+      err = grub_video_bitmap_create_scaled (&result, width, height, raw,
+					     scale_method);
+      grub_video_bitmap_cache_release (raw);
+      if (err)
+	return err;
+    }
+
+  *bitmap = result;
+
+  entry = grub_malloc (sizeof (*entry));
+  if (! entry)
+    {
+      /* Still usable, just not shared; releasing it destroys it.  */
+      grub_errno = GRUB_ERR_NONE;
+      return GRUB_ERR_NONE;
+    }
+  entry->filename = grub_strdup (filename);
+  if (! entry->filename)
+    {
+      grub_free (entry);
+      grub_errno = GRUB_ERR_NONE;
+      return GRUB_ERR_NONE;
+    }
+
+  entry->width = width;
+  entry->height = height;
+  entry->scale_method = scale_method;
+  entry->format = format;
+  entry->bitmap = result;
+  entry->size = ((grub_size_t) result->mode_info.pitch
+		 * result->mode_info.height);
+  entry->refs = 1;
+  entry->last_use = ++use_clock;
+  entry->next = cache;
+  cache = entry;
+  cache_used += entry->size;
+
+  cache_trim (cache_budget ());
+
+  return GRUB_ERR_NONE;
+}
+
+void
+grub_video_bitmap_cache_release (struct grub_video_bitmap *bitmap)
+{
+  struct cache_entry *entry;
+
+  if (! bitmap)
+    return;
+
+  for (entry = cache; entry; entry = entry->next)
+    if (entry->bitmap == bitmap)
+      {
+	if (entry->refs)
+	  entry->refs--;
+	cache_trim (cache_budget ());
+	return;
+      }
+
+  /* Never made it into the cache.  */
+  grub_video_bitmap_destroy (bitmap);
+}
+
+void
+grub_video_bitmap_cache_flush (void)
+{
+  cache_trim (0);
+}
+
+GRUB_MOD_FINI(bitmap_cache)
+{
+  while (cache)
+    {
+      struct cache_entry *entry = cache;
+      cache = entry->next;
+      free_entry (entry);
+    }
+}
@@ -32,6 +32,10 @@ static grub_err_t scale_nn (struct grub_video_bitmap *dst,
                             struct grub_video_bitmap *src);
 static grub_err_t scale_bilinear (struct grub_video_bitmap *dst,
                                   struct grub_video_bitmap *src);
+static grub_err_t scale_filtered (struct grub_video_bitmap *dst,
+                                  struct grub_video_bitmap *src,
+                                  enum grub_video_bitmap_scale_method
+                                  scale_method);
 
 static grub_err_t
 grub_video_bitmap_scale (struct grub_video_bitmap *dst,
@@ -43,9 +47,12 @@ grub_video_bitmap_scale (struct grub_video_bitmap *dst,
     case GRUB_VIDEO_BITMAP_SCALE_METHOD_FASTEST:
     case GRUB_VIDEO_BITMAP_SCALE_METHOD_NEAREST:
       return scale_nn (dst, src);
-    case GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST:
     case GRUB_VIDEO_BITMAP_SCALE_METHOD_BILINEAR:
       return scale_bilinear (dst, src);
+    case GRUB_VIDEO_BITMAP_SCALE_METHOD_BEST:
+    case GRUB_VIDEO_BITMAP_SCALE_METHOD_BOX:
+    case GRUB_VIDEO_BITMAP_SCALE_METHOD_LANCZOS:
+      return scale_filtered (dst, src, scale_method);
     default:
       return grub_error (GRUB_ERR_BUG, "Invalid scale_method value");
     }
@@ -84,6 +91,9 @@ grub_video_bitmap_create_scaled (struct grub_video_bitmap **dst,
   if (ret != GRUB_ERR_NONE)
     return ret;                 /* Error. */
 
+  /* Scaling adds no transparency: an image known to be opaque stays so.  */
+  (*dst)->mode_info.mode_type = src->mode_info.mode_type;
+
   ret = grub_video_bitmap_scale (*dst, src, scale_method);
 
   if (ret == GRUB_ERR_NONE)
@@ -451,3 +461,464 @@ scale_bilinear (struct grub_video_bitmap *dst, struct grub_video_bitmap *src)
     }
   return GRUB_ERR_NONE;
 }
+
+/* Separable filtered scaling.
+
+   The image is filtered horizontally and then vertically.  For each axis
+   the source pixels contributing to every output pixel and their weights
+   are worked out once, in fixed point.  Each source row is filtered
+   horizontally only once, into a ring of rows that is just large enough to
+   hold all the rows one output row needs.  */
+
+/* Weights are fixed point numbers with this many fractional bits.  */
+#define WEIGHT_BITS	14
+/* Fractional bits of horizontally filtered samples.  */
+#define ROW_BITS	7
+
+#define LANCZOS_RADIUS	3
+/* Entries of lanczos_table per unit of distance.  */
+#define LANCZOS_STEPS	64
+
+/* sinc (x) * sinc (x / 3) at x = i / LANCZOS_STEPS, in WEIGHT_BITS fixed
+   point.  */
+static const grub_int16_t lanczos_table[LANCZOS_RADIUS * LANCZOS_STEPS + 1] =
+{
+  16384, 16377, 16355, 16318, 16267, 16202, 16122, 16028,
+  15921, 15799, 15664, 15515, 15354, 15179, 14993, 14794,
+  14583, 14361, 14128, 13884, 13630, 13366, 13093, 12811,
+  12521, 12223, 11917, 11605, 11287, 10962, 10633, 10299,
+  9960, 9618, 9273, 8926, 8576, 8226, 7874, 7522,
+  7170, 6819, 6470, 6122, 5776, 5434, 5094, 4758,
+  4427, 4100, 3778, 3462, 3151, 2847, 2549, 2258,
+  1975, 1699, 1431, 1171, 919, 676, 442, 216,
+  0, -207, -405, -593, -772, -941, -1101, -1251,
+  -1391, -1522, -1643, -1755, -1858, -1951, -2035, -2111,
+  -2177, -2235, -2284, -2325, -2358, -2383, -2400, -2410,
+  -2413, -2409, -2398, -2381, -2359, -2330, -2296, -2257,
+  -2213, -2165, -2113, -2056, -1996, -1933, -1867, -1799,
+  -1728, -1654, -1580, -1504, -1426, -1348, -1269, -1190,
+  -1111, -1032, -953, -875, -798, -721, -646, -573,
+  -501, -431, -362, -296, -232, -170, -111, -54,
+  0, 52, 100, 147, 190, 230, 268, 303,
+  335, 364, 390, 414, 435, 453, 468, 481,
+  492, 500, 506, 509, 511, 510, 507, 503,
+  497, 489, 479, 469, 457, 444, 429, 414,
+  398, 382, 365, 347, 329, 311, 292, 274,
+  256, 237, 219, 202, 184, 167, 151, 136,
+  121, 106, 93, 80, 68, 57, 47, 38,
+  30, 23, 17, 12, 7, 4, 2, 0,
+  0
+};
+
+enum scale_filter
+  {
+    SCALE_FILTER_BOX,
+    SCALE_FILTER_TRIANGLE,
+    SCALE_FILTER_LANCZOS
+  };
+
+/* The contributions to each output pixel along one axis: COUNT[i] source
+   pixels from START[i] on, weighted by WEIGHTS[i * MAX_TAPS ...].  */
+struct scale_axis
+{
+  unsigned max_taps;
+  unsigned *start;
+  unsigned *count;
+  grub_int32_t *weights;
+};
+
+static void
+free_axis (struct scale_axis *axis)
+{
+  grub_free (axis->start);
+  grub_free (axis->count);
+  grub_free (axis->weights);
+}
+
+/* W / SUM in WEIGHT_BITS fixed point.  */
+static grub_int32_t
+normalize_weight (grub_int32_t w, grub_uint32_t sum)
+{
+  grub_uint64_t n = (grub_uint64_t) (w < 0 ? -w : w) << WEIGHT_BITS;
+  grub_int32_t r = grub_divmod64 (n + sum / 2, sum, 0);
+
+  return w < 0 ? -r : r;
+}
+
+/* Value of FILTER at distance D (16.16 fixed point), in WEIGHT_BITS.  */
+static grub_int32_t
+filter_weight (enum scale_filter filter, grub_uint32_t d)
+{
+  grub_uint32_t pos, frac;
+
+  if (filter == SCALE_FILTER_TRIANGLE)
+    return d >= 0x10000 ? 0 : (0x10000 - d) >> (16 - WEIGHT_BITS);
+
+  if (d >= (LANCZOS_RADIUS << 16))
+    return 0;
+  pos = (d * LANCZOS_STEPS) >> 16;
+  frac = (d * LANCZOS_STEPS) & 0xffff;
+  return lanczos_table[pos]
+    + (((lanczos_table[pos + 1] - lanczos_table[pos]) * (grub_int32_t) frac)
+       >> 16);
+}
+
+static grub_err_t
+make_axis (struct scale_axis *axis, unsigned sw, unsigned dw,
+	   enum scale_filter filter)
+{
+  grub_uint64_t support, inv_scale;
+  unsigned x, i;
+
+  if (filter == SCALE_FILTER_BOX)
+    /* An output pixel covers sw / dw source pixels, plus a partial one
+       at each end.  */
+    axis->max_taps = grub_divmod64 (sw + dw - 1, dw, 0) + 1;
+  else
+    {
+      /* Filters are stretched by the scale factor when shrinking so that
+	 every source pixel is taken into account.  */
+      support = (filter == SCALE_FILTER_LANCZOS ? LANCZOS_RADIUS : 1) << 16;
+      inv_scale = 0x10000;
+      if (sw > dw)
+	{
+	  support = grub_divmod64 (support * sw, dw, 0);
+	  inv_scale = grub_divmod64 ((grub_uint64_t) dw << 16, sw, 0);
+	}
+      axis->max_taps = 2 * (support >> 16) + 3;
+    }
+
+  axis->start = grub_malloc (dw * sizeof (axis->start[0]));
+  axis->count = grub_malloc (dw * sizeof (axis->count[0]));
+  axis->weights = grub_malloc (dw * axis->max_taps
+			       * sizeof (axis->weights[0]));
+  if (!axis->start || !axis->count || !axis->weights)
+    return grub_errno;
+
+  for (x = 0; x < dw; x++)
+    {
+      grub_int32_t *w = axis->weights + x * axis->max_taps;
+      grub_int32_t sum = 0;
+      unsigned best = 0;
+
+      grub_memset (w, 0, axis->max_taps * sizeof (w[0]));
+
+      if (filter == SCALE_FILTER_BOX)
+	{
+	  /* Measured in units of 1 / dw source pixels, output pixel X
+	     spans [x * sw, (x + 1) * sw) and source pixel I spans
+	     [i * dw, (i + 1) * dw).  */
+	  grub_uint64_t from = (grub_uint64_t) x * sw, to = from + sw;
+	  unsigned lo = grub_divmod64 (from, dw, 0);
+	  unsigned hi = grub_divmod64 (to - 1, dw, 0);
+
+	  axis->start[x] = lo;
+	  axis->count[x] = hi - lo + 1;
+	  for (i = lo; i <= hi; i++)
+	    {
+	      grub_uint64_t a = (grub_uint64_t) i * dw, b = a + dw;
+
+	      if (a < from)
+		a = from;
+	      if (b > to)
+		b = to;
+	      w[i - lo] = normalize_weight (b - a, sw);
+	    }
+	}
+      else
+	{
+	  /* Centre of output pixel X in source pixels, 16.16 fixed point.  */
+	  grub_int64_t center = (grub_int64_t)
+	    grub_divmod64 (((grub_uint64_t) (2 * x + 1) * sw) << 15, dw, 0)
+	    - 0x8000;
+	  grub_int64_t lo = (center - (grub_int64_t) support) >> 16;
+	  grub_int64_t hi = (center + (grub_int64_t) support) >> 16;
+	  grub_int64_t j;
+	  unsigned first, last;
+
+	  first = lo < 0 ? 0 : lo;
+	  last = hi >= sw ? sw - 1 : hi;
+	  axis->start[x] = first;
+	  axis->count[x] = last - first + 1;
+
+	  /* Taps past the edges fall on the edge pixels.  */
+	  for (j = lo; j <= hi; j++)
+	    {
+	      grub_int64_t d = j * 0x10000 - center;
+	      unsigned tap;
+
+	      if (d < 0)
+		d = -d;
+	      tap = (j < first ? first : j > last ? last : j) - first;
+	      w[tap] += filter_weight (filter, (d * inv_scale) >> 16);
+	    }
+
+	  for (i = 0; i < axis->count[x]; i++)
+	    sum += w[i];
+	  if (sum <= 0)
+	    {
+	      /* Cannot happen with these filters; fall back to the nearest
+		 pixel all the same.  */
+	      grub_memset (w, 0, axis->max_taps * sizeof (w[0]));
+	      i = (center + 0x8000) >> 16;
+	      if (i >= sw)
+		i = sw - 1;
+	      axis->start[x] = i;
+	      axis->count[x] = 1;
+	      w[0] = 1 << WEIGHT_BITS;
+	      continue;
+	    }
+	  for (i = 0; i < axis->count[x]; i++)
+	    w[i] = normalize_weight (w[i], sum);
+	}
+
+      /* Make the weights add up to exactly one, so that flat areas stay
+	 flat.  */
+      sum = 0;
+      for (i = 0; i < axis->count[x]; i++)
+	{
+	  sum += w[i];
+	  if (w[i] > w[best])
+	    best = i;
+	}
+      w[best] += (1 << WEIGHT_BITS) - sum;
+    }
+
+  return GRUB_ERR_NONE;
+}
+
+/* Filter one source row horizontally into OUT, with ROW_BITS fractional
+   bits.  */
+static void
+filter_row (grub_int32_t *out, const grub_uint8_t *in,
+	    const struct scale_axis *axis, unsigned dw, int bytes_per_pixel)
+{
+  const int round = 1 << (WEIGHT_BITS - ROW_BITS - 1);
+  unsigned x, k;
+  int comp;
+
+  for (x = 0; x < dw; x++, out += bytes_per_pixel)
+    {
+      const grub_int32_t *w = axis->weights + x * axis->max_taps;
+      const grub_uint8_t *p = in + axis->start[x] * bytes_per_pixel;
+      unsigned n = axis->count[x];
+
+      if (bytes_per_pixel == 4)
+	{
+	  grub_int32_t a0 = round, a1 = round, a2 = round, a3 = round;
+
+	  for (k = 0; k < n; k++, p += 4)
+	    {
+	      a0 += w[k] * p[0];
+	      a1 += w[k] * p[1];
+	      a2 += w[k] * p[2];
+	      a3 += w[k] * p[3];
+	    }
+	  out[0] = a0 >> (WEIGHT_BITS - ROW_BITS);
+	  out[1] = a1 >> (WEIGHT_BITS - ROW_BITS);
+	  out[2] = a2 >> (WEIGHT_BITS - ROW_BITS);
+	  out[3] = a3 >> (WEIGHT_BITS - ROW_BITS);
+	}
+      else if (bytes_per_pixel == 3)
+	{
+	  grub_int32_t a0 = round, a1 = round, a2 = round;
+
+	  for (k = 0; k < n; k++, p += 3)
+	    {
+	      a0 += w[k] * p[0];
+	      a1 += w[k] * p[1];
+	      a2 += w[k] * p[2];
+	    }
+	  out[0] = a0 >> (WEIGHT_BITS - ROW_BITS);
+	  out[1] = a1 >> (WEIGHT_BITS - ROW_BITS);
+	  out[2] = a2 >> (WEIGHT_BITS - ROW_BITS);
+	}
+      else
+	for (comp = 0; comp < bytes_per_pixel; comp++)
+	  {
+	    grub_int32_t a = round;
+
+	    for (k = 0; k < n; k++)
+	      a += w[k] * p[k * bytes_per_pixel + comp];
+	    out[comp] = a >> (WEIGHT_BITS - ROW_BITS);
+	  }
+    }
+}
+
+/* Area averaging by whole factors in both directions, which is what most
+   downscaling of backgrounds comes down to (e.g. 3840x2160 to 1920x1080).
+   Every output pixel is the plain mean of a block of source pixels, so
+   only sums are needed.  */
+static grub_err_t
+scale_box_whole (struct grub_video_bitmap *dst, struct grub_video_bitmap *src)
+{
+  unsigned dw = dst->mode_info.width;
+  unsigned dh = dst->mode_info.height;
+  unsigned xf = src->mode_info.width / dw;
+  unsigned yf = src->mode_info.height / dh;
+  int bytes_per_pixel = dst->mode_info.bytes_per_pixel;
+  unsigned row_len = dw * bytes_per_pixel;
+  /* 1 / (xf * yf) in 22-bit fixed point; sums stay below 2^8 * xf * yf.  */
+  grub_uint32_t scale = ((1 << 22) + xf * yf / 2) / (xf * yf);
+  grub_uint32_t *sum;
+  unsigned dy, sy, x, k, i;
+  int comp;
+
+  sum = grub_malloc (row_len * sizeof (sum[0]));
+  if (!sum)
+    return grub_errno;
+
+  for (dy = 0; dy < dh; dy++)
+    {
+      grub_uint8_t *dptr = (grub_uint8_t *) dst->data
+	+ dy * dst->mode_info.pitch;
+
+      grub_memset (sum, 0, row_len * sizeof (sum[0]));
+      for (sy = dy * yf; sy < (dy + 1) * yf; sy++)
+	{
+	  const grub_uint8_t *p = (grub_uint8_t *) src->data
+	    + sy * src->mode_info.pitch;
+	  grub_uint32_t *s = sum;
+
+	  if (xf == 2 && bytes_per_pixel == 4)
+	    for (x = 0; x < dw; x++, s += 4, p += 8)
+	      {
+		s[0] += p[0] + p[4];
+		s[1] += p[1] + p[5];
+		s[2] += p[2] + p[6];
+		s[3] += p[3] + p[7];
+	      }
+	  else if (xf == 2 && bytes_per_pixel == 3)
+	    for (x = 0; x < dw; x++, s += 3, p += 6)
+	      {
+		s[0] += p[0] + p[3];
+		s[1] += p[1] + p[4];
+		s[2] += p[2] + p[5];
+	      }
+	  else
+	    for (x = 0; x < dw; x++, s += bytes_per_pixel)
+	      for (k = 0; k < xf; k++, p += bytes_per_pixel)
+		for (comp = 0; comp < bytes_per_pixel; comp++)
+		  s[comp] += p[comp];
+	}
+
+      for (i = 0; i < row_len; i++)
+	dptr[i] = (sum[i] * scale + (1 << 21)) >> 22;
+    }
+
+  grub_free (sum);
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+scale_filtered (struct grub_video_bitmap *dst, struct grub_video_bitmap *src,
+		enum grub_video_bitmap_scale_method scale_method)
+{
+  grub_err_t err = verify_bitmaps(dst, src);
+  if (err != GRUB_ERR_NONE)
+    return err;
+
+  unsigned dw = dst->mode_info.width;
+  unsigned dh = dst->mode_info.height;
+  unsigned sw = src->mode_info.width;
+  unsigned sh = src->mode_info.height;
+  /* bytes_per_pixel is the same for both src and dst. */
+  int bytes_per_pixel = dst->mode_info.bytes_per_pixel;
+  unsigned row_len = dw * bytes_per_pixel;
+  struct scale_axis xaxis = { 0 }, yaxis = { 0 };
+  enum scale_filter xfilter, yfilter;
+  grub_int32_t *ring = 0;
+  const grub_int32_t **rows = 0;
+  unsigned dy, k, i, next_row = 0;
+
+  switch (scale_method)
+    {
+    case GRUB_VIDEO_BITMAP_SCALE_METHOD_BOX:
+      xfilter = yfilter = SCALE_FILTER_BOX;
+      break;
+    case GRUB_VIDEO_BITMAP_SCALE_METHOD_LANCZOS:
+      xfilter = yfilter = SCALE_FILTER_LANCZOS;
+      break;
+    default:
+      /* Area averaging does not alias when shrinking and is cheap; a
+	 triangle filter gives smooth enlargements.  */
+      xfilter = sw > dw ? SCALE_FILTER_BOX : SCALE_FILTER_TRIANGLE;
+      yfilter = sh > dh ? SCALE_FILTER_BOX : SCALE_FILTER_TRIANGLE;
+      break;
+    }
+
+  if (xfilter == SCALE_FILTER_BOX && yfilter == SCALE_FILTER_BOX
+      && sw % dw == 0 && sh % dh == 0)
+    return scale_box_whole (dst, src);
+
+  if (make_axis (&xaxis, sw, dw, xfilter)
+      || make_axis (&yaxis, sh, dh, yfilter))
+    goto out;
+
+  ring = grub_malloc (yaxis.max_taps * row_len * sizeof (ring[0]));
+  rows = grub_malloc (yaxis.max_taps * sizeof (rows[0]));
+  if (!ring || !rows)
+    goto out;
+
+  for (dy = 0; dy < dh; dy++)
+    {
+      unsigned first = yaxis.start[dy], n = yaxis.count[dy];
+      const grub_int32_t *w = yaxis.weights + dy * yaxis.max_taps;
+      grub_uint8_t *dptr = (grub_uint8_t *) dst->data
+	+ dy * dst->mode_info.pitch;
+
+      /* The rows needed only move forward; a row's slot is reused once
+	 all output rows using it are done.  */
+      if (next_row < first)
+	next_row = first;
+      for (; next_row < first + n; next_row++)
+	filter_row (ring + (next_row % yaxis.max_taps) * row_len,
+		    (grub_uint8_t *) src->data
+		    + next_row * src->mode_info.pitch,
+		    &xaxis, dw, bytes_per_pixel);
+
+      for (k = 0; k < n; k++)
+	rows[k] = ring + ((first + k) % yaxis.max_taps) * row_len;
+
+      if (n <= 4)
+	{
+	  /* Box filters shrinking by less than 3 and triangle filters
+	     need at most 4 rows: unroll, giving missing rows no weight.  */
+	  const grub_int32_t *r0 = rows[0];
+	  const grub_int32_t *r1 = rows[n > 1 ? 1 : 0];
+	  const grub_int32_t *r2 = rows[n > 2 ? 2 : 0];
+	  const grub_int32_t *r3 = rows[n > 3 ? 3 : 0];
+	  grub_int32_t w0 = w[0];
+	  grub_int32_t w1 = n > 1 ? w[1] : 0;
+	  grub_int32_t w2 = n > 2 ? w[2] : 0;
+	  grub_int32_t w3 = n > 3 ? w[3] : 0;
+
+	  for (i = 0; i < row_len; i++)
+	    {
+	      grub_int32_t v = (1 << (WEIGHT_BITS + ROW_BITS - 1))
+		+ w0 * r0[i] + w1 * r1[i] + w2 * r2[i] + w3 * r3[i];
+
+	      v >>= WEIGHT_BITS + ROW_BITS;
+	      dptr[i] = v < 0 ? 0 : v > 255 ? 255 : v;
+	    }
+	  continue;
+	}
+
+      for (i = 0; i < row_len; i++)
+	{
+	  grub_int32_t v = 1 << (WEIGHT_BITS + ROW_BITS - 1);
+
+	  for (k = 0; k < n; k++)
+	    v += w[k] * rows[k][i];
+	  v >>= WEIGHT_BITS + ROW_BITS;
+	  dptr[i] = v < 0 ? 0 : v > 255 ? 255 : v;
+	}
+    }
+
+ out:
+  free_axis (&xaxis);
+  free_axis (&yaxis);
+  grub_free (ring);
+  grub_free (rows);
+  return grub_errno;
+}
@@ -5,12 +5,17 @@
 #include <grub/video_fb.h>
 #include <grub/mm.h>
 #include <grub/misc.h>
+#include <grub/dl.h>
+
+GRUB_MOD_LICENSE ("GPLv3+");
 
 static struct
 {
   struct grub_video_mode_info mode_info;
   struct grub_video_render_target *render_target;
   grub_uint8_t *ptr;
+  /* Set when rendering into PTR as a shadow buffer.  */
+  const struct grub_video_fb_shadow_ops *shadow_ops;
 } framebuffer;
 
 void (*grub_video_capture_refresh_cb) (void);
@@ -18,6 +23,14 @@ void (*grub_video_capture_refresh_cb) (void);
 static grub_err_t
 grub_video_capture_swap_buffers (void)
 {
+  if (framebuffer.shadow_ops)
+    {
+      grub_err_t err;
+
+      err = grub_video_fb_swap_buffers ();
+      if (err)
+	return err;
+    }
   if (grub_video_capture_refresh_cb)
     grub_video_capture_refresh_cb ();
   return GRUB_ERR_NONE;
@@ -26,7 +39,7 @@ grub_video_capture_swap_buffers (void)
 static grub_err_t
 grub_video_capture_set_active_render_target (struct grub_video_render_target *target)
 {
-  if (target == GRUB_VIDEO_RENDER_TARGET_DISPLAY)
+  if (target == GRUB_VIDEO_RENDER_TARGET_DISPLAY && framebuffer.render_target)
     target = framebuffer.render_target;
 
   return grub_video_fb_set_active_render_target (target);
@@ -76,10 +89,11 @@ static struct grub_video_adapter grub_video_capture_adapter =
 static struct grub_video_adapter *saved;
 static struct grub_video_mode_info saved_mode_info;
 
-grub_err_t
-grub_video_capture_start (const struct grub_video_mode_info *mode_info,
-			  struct grub_video_palette_data *palette,
-			  unsigned int palette_size)
+static grub_err_t
+capture_start (const struct grub_video_mode_info *mode_info,
+	       struct grub_video_palette_data *palette,
+	       unsigned int palette_size,
+	       const struct grub_video_fb_shadow_ops *shadow_ops)
 {
   grub_err_t err;
   grub_memset (&framebuffer, 0, sizeof (framebuffer));
@@ -93,14 +107,26 @@ grub_video_capture_start (const struct grub_video_mode_info *mode_info,
   if (!framebuffer.ptr)
     return grub_errno;
   
-  err = grub_video_fb_create_render_target_from_pointer (&framebuffer.render_target,
-							 &framebuffer.mode_info,
-							 framebuffer.ptr);
-  if (err)
-    return err;
-  err = grub_video_fb_set_active_render_target (framebuffer.render_target);
-  if (err)
-    return err;
+  if (shadow_ops)
+    {
+      /* The shadow is the display target of the framebuffer code.  */
+      err = grub_video_fb_setup_shadow (&framebuffer.mode_info,
+					framebuffer.ptr, shadow_ops);
+      if (err)
+	return err;
+      framebuffer.shadow_ops = shadow_ops;
+    }
+  else
+    {
+      err = grub_video_fb_create_render_target_from_pointer (&framebuffer.render_target,
+							     &framebuffer.mode_info,
+							     framebuffer.ptr);
+      if (err)
+	return err;
+      err = grub_video_fb_set_active_render_target (framebuffer.render_target);
+      if (err)
+	return err;
+    }
   err = grub_video_fb_set_palette (0, palette_size, palette);
   if (err)
     return err;
@@ -117,6 +143,26 @@ grub_video_capture_start (const struct grub_video_mode_info *mode_info,
   return GRUB_ERR_NONE;
 }
 
+grub_err_t
+grub_video_capture_start (const struct grub_video_mode_info *mode_info,
+			  struct grub_video_palette_data *palette,
+			  unsigned int palette_size)
+{
+  return capture_start (mode_info, palette, palette_size, 0);
+}
+
+/* Capture as a driver with a shadow buffer would draw: the framebuffer is
+   the shadow, and SHADOW_OPS are called to bring the screen up to date on
+   every swap.  */
+grub_err_t
+grub_video_capture_start_shadow (const struct grub_video_mode_info *mode_info,
+				 struct grub_video_palette_data *palette,
+				 unsigned int palette_size,
+				 const struct grub_video_fb_shadow_ops *shadow_ops)
+{
+  return capture_start (mode_info, palette, palette_size, shadow_ops);
+}
+
 void *
 grub_video_capture_get_framebuffer (void)
 {
@@ -47,7 +47,6 @@ grub_video_gop_iterate (int (*hook) (const struct grub_video_mode_info *info, vo
 static struct
 {
   struct grub_video_mode_info mode_info;
-  struct grub_video_render_target *render_target;
   grub_uint8_t *ptr;
   grub_uint8_t *offscreen;
 } framebuffer;
@@ -347,10 +346,64 @@ grub_gop_get_preferred_mode (unsigned int *width, unsigned int *height)
   return GRUB_ERR_NONE;
 }
 
+static grub_err_t
+check_blt (grub_efi_status_t status)
+{
+  if (status != GRUB_EFI_SUCCESS)
+    return grub_error (GRUB_ERR_IO, "GOP Blt failed");
+  return GRUB_ERR_NONE;
+}
+
+static grub_err_t
+grub_video_gop_update (const grub_video_rect_t *rect)
+{
+  return check_blt (efi_call_10 (gop->blt, gop, framebuffer.offscreen,
+				 GRUB_EFI_BLT_BUFFER_TO_VIDEO,
+				 rect->x, rect->y, rect->x, rect->y,
+				 rect->width, rect->height,
+				 framebuffer.mode_info.pitch));
+}
+
+/* The screen is often mapped uncached, so scrolling is left to the
+   firmware rather than read back.  */
+static grub_err_t
+grub_video_gop_move (unsigned int src_x, unsigned int src_y,
+		     unsigned int dst_x, unsigned int dst_y,
+		     unsigned int width, unsigned int height)
+{
+  return check_blt (efi_call_10 (gop->blt, gop, NULL,
+				 GRUB_EFI_BLT_VIDEO_TO_VIDEO,
+				 src_x, src_y, dst_x, dst_y,
+				 width, height, 0));
+}
+
+static grub_err_t
+grub_video_gop_fill (grub_video_color_t color, const grub_video_rect_t *rect)
+{
+  struct grub_efi_gop_blt_pixel pixel;
+
+  /* The shadow uses the Blt pixel layout.  */
+  pixel.blue = color & 0xff;
+  pixel.green = (color >> 8) & 0xff;
+  pixel.red = (color >> 16) & 0xff;
+  pixel.reserved = 0;
+
+  return check_blt (efi_call_10 (gop->blt, gop, &pixel,
+				 GRUB_EFI_BLT_VIDEO_FILL, 0, 0,
+				 rect->x, rect->y, rect->width, rect->height,
+				 0));
+}
+
+static const struct grub_video_fb_shadow_ops shadow_ops =
+  {
+    .update = grub_video_gop_update,
+    .move = grub_video_gop_move,
+    .fill = grub_video_gop_fill
+  };
+
 static grub_err_t
 grub_video_gop_setup (unsigned int width, unsigned int height,
-		      unsigned int mode_type,
-		      unsigned int mode_mask __attribute__ ((unused)))
+		      unsigned int mode_type, unsigned int mode_mask)
 {
   unsigned int depth;
   struct grub_efi_gop_mode_info *info = NULL;
@@ -360,7 +413,6 @@ grub_video_gop_setup (unsigned int width, unsigned int height,
   int found = 0;
   unsigned long long best_volume = 0;
   unsigned int preferred_width = 0, preferred_height = 0;
-  grub_uint8_t *buffer;
 
   depth = (mode_type & GRUB_VIDEO_MODE_TYPE_DEPTH_MASK)
     >> GRUB_VIDEO_MODE_TYPE_DEPTH_POS;
@@ -480,23 +532,27 @@ grub_video_gop_setup (unsigned int width, unsigned int height,
 		   * framebuffer.mode_info.width 
 		   * sizeof (struct grub_efi_gop_blt_pixel));
 
-  buffer = framebuffer.offscreen;
-      
-  if (!buffer)
+  if (framebuffer.offscreen)
     {
+      grub_dprintf ("video", "GOP: initialising FB @ %p %dx%dx%d\n",
+		    framebuffer.ptr, framebuffer.mode_info.width,
+		    framebuffer.mode_info.height, framebuffer.mode_info.bpp);
+
+      err = grub_video_fb_setup_shadow (&framebuffer.mode_info,
+					framebuffer.offscreen, &shadow_ops);
+    }
+  else
+    {
+      /* Draw straight to the screen, in its own pixel format.  */
       grub_dprintf ("video", "GOP: couldn't allocate shadow\n");
-      grub_errno = 0;
-      err = grub_video_gop_fill_mode_info (gop->mode->mode, info,
-					   &framebuffer.mode_info);
-      buffer = framebuffer.ptr;
+      grub_errno = GRUB_ERR_NONE;
+      err = grub_video_gop_fill_real_mode_info (gop->mode->mode, info,
+						&framebuffer.mode_info);
+      if (!err)
+	err = grub_video_fb_setup (mode_type, mode_mask,
+				   &framebuffer.mode_info,
+				   framebuffer.ptr, NULL, NULL);
     }
-    
-  grub_dprintf ("video", "GOP: initialising FB @ %p %dx%dx%d\n",
-		framebuffer.ptr, framebuffer.mode_info.width,
-		framebuffer.mode_info.height, framebuffer.mode_info.bpp);
- 
-  err = grub_video_fb_create_render_target_from_pointer
-    (&framebuffer.render_target, &framebuffer.mode_info, buffer);
 
   if (err)
     {
@@ -504,14 +560,6 @@ grub_video_gop_setup (unsigned int width, unsigned int height,
       return err;
     }
  
-  err = grub_video_fb_set_active_render_target (framebuffer.render_target);
- 
-  if (err)
-    {
-      grub_dprintf ("video", "GOP: Couldn't set FB target\n");
-      return err;
-    }
- 
   err = grub_video_fb_set_palette (0, GRUB_VIDEO_FBSTD_NUMCOLORS,
 				   grub_video_fbstd_colors);
 
@@ -523,28 +571,6 @@ grub_video_gop_setup (unsigned int width, unsigned int height,
   return err;
 }
 
-static grub_err_t
-grub_video_gop_swap_buffers (void)
-{
-  if (framebuffer.offscreen)
-    {
-      efi_call_10 (gop->blt, gop, framebuffer.offscreen,
-		   GRUB_EFI_BLT_BUFFER_TO_VIDEO, 0, 0, 0, 0,
-		   framebuffer.mode_info.width, framebuffer.mode_info.height,
-		   framebuffer.mode_info.width * 4);
-    }
-  return GRUB_ERR_NONE;
-}
-
-static grub_err_t
-grub_video_gop_set_active_render_target (struct grub_video_render_target *target)
-{
-  if (target == GRUB_VIDEO_RENDER_TARGET_DISPLAY)
-    target = framebuffer.render_target;
-
-  return grub_video_fb_set_active_render_target (target);
-}
-
 static grub_err_t
 grub_video_gop_get_info_and_fini (struct grub_video_mode_info *mode_info,
 				  void **framebuf)
@@ -561,6 +587,8 @@ grub_video_gop_get_info_and_fini (struct grub_video_mode_info *mode_info,
 
   *framebuf = (char *) framebuffer.ptr;
 
+  /* Whatever was drawn last is what the kernel inherits.  */
+  grub_video_fb_swap_buffers ();
   grub_video_fb_fini ();
 
   grub_free (framebuffer.offscreen);
@@ -598,10 +626,10 @@ static struct grub_video_adapter grub_video_gop_adapter =
     .blit_bitmap = grub_video_fb_blit_bitmap,
     .blit_render_target = grub_video_fb_blit_render_target,
     .scroll = grub_video_fb_scroll,
-    .swap_buffers = grub_video_gop_swap_buffers,
+    .swap_buffers = grub_video_fb_swap_buffers,
     .create_render_target = grub_video_fb_create_render_target,
     .delete_render_target = grub_video_fb_delete_render_target,
-    .set_active_render_target = grub_video_gop_set_active_render_target,
+    .set_active_render_target = grub_video_fb_set_active_render_target,
     .get_active_render_target = grub_video_fb_get_active_render_target,
     .iterate = grub_video_gop_iterate,
 
@@ -34,6 +34,13 @@
 #include <grub/types.h>
 #include <grub/video.h>
 
+/* Exchange the first and third channel of a 32-bit pixel.  */
+static inline grub_uint32_t
+swap_rb_32 (grub_uint32_t color)
+{
+  return (color & 0xff00ff00) | ((color >> 16) & 0xff) | ((color & 0xff) << 16);
+}
+
 /* Generic replacing blitter (slow).  Works for every supported format.  */
 static void
 grub_video_fbblit_replace (struct grub_video_fbblit_info *dst,
@@ -769,8 +776,8 @@ grub_video_fbblit_replace_BGRX8888_RGBX8888 (struct grub_video_fbblit_info *dst,
 {
   int i;
   int j;
-  grub_uint8_t *srcptr;
-  grub_uint8_t *dstptr;
+  grub_uint32_t *srcptr;
+  grub_uint32_t *dstptr;
   unsigned int srcrowskip;
   unsigned int dstrowskip;
 
@@ -782,33 +789,15 @@ grub_video_fbblit_replace_BGRX8888_RGBX8888 (struct grub_video_fbblit_info *dst,
   srcptr = grub_video_fb_get_video_ptr (src, offset_x, offset_y);
   dstptr = grub_video_fb_get_video_ptr (dst, x, y);
 
+  /* In either byte order red and blue are bits 0-7 and 16-23 of the
+     pixel, so the conversion works on whole pixels.  */
   for (j = 0; j < height; j++)
     {
       for (i = 0; i < width; i++)
-        {
-#ifdef GRUB_CPU_WORDS_BIGENDIAN
-          grub_uint8_t a = *srcptr++;
-#endif
-          grub_uint8_t r = *srcptr++;
-          grub_uint8_t g = *srcptr++;
-          grub_uint8_t b = *srcptr++;
-#ifndef GRUB_CPU_WORDS_BIGENDIAN
-          grub_uint8_t a = *srcptr++;
-#endif
+	*dstptr++ = swap_rb_32 (*srcptr++);
 
-#ifdef GRUB_CPU_WORDS_BIGENDIAN
-          *dstptr++ = a;
-#endif
-          *dstptr++ = b;
-          *dstptr++ = g;
-          *dstptr++ = r;
-#ifndef GRUB_CPU_WORDS_BIGENDIAN
-          *dstptr++ = a;
-#endif
-        }
-
-      srcptr += srcrowskip;
-      dstptr += dstrowskip;
+      GRUB_VIDEO_FB_ADVANCE_POINTER (srcptr, srcrowskip);
+      GRUB_VIDEO_FB_ADVANCE_POINTER (dstptr, dstrowskip);
     }
 }
 
@@ -1159,6 +1148,22 @@ alpha_dilute (grub_uint8_t bg, grub_uint8_t fg, grub_uint8_t alpha)
   return h;
 }
 
+/* Blend all four channels of FG over BG like alpha_dilute, with the same
+   results, but two channels per multiplication.  The channel sums fit in
+   16-bit lanes, and (s + (s >> 8) + 1) >> 8 is s / 255 for them.  */
+static inline grub_uint32_t
+alpha_dilute_32 (grub_uint32_t bg, grub_uint32_t fg, unsigned int alpha)
+{
+  grub_uint32_t rb, ga;
+
+  rb = (fg & 0x00ff00ff) * alpha + (bg & 0x00ff00ff) * (255 ^ alpha);
+  ga = ((fg >> 8) & 0x00ff00ff) * alpha
+    + ((bg >> 8) & 0x00ff00ff) * (255 ^ alpha);
+  rb = ((rb + ((rb >> 8) & 0x00ff00ff) + 0x00010001) >> 8) & 0x00ff00ff;
+  ga = (ga + ((ga >> 8) & 0x00ff00ff) + 0x00010001) & 0xff00ff00;
+  return rb | ga;
+}
+
 /* Generic blending blitter.  Works for every supported format.  */
 static void
 grub_video_fbblit_blend (struct grub_video_fbblit_info *dst,
@@ -1245,13 +1250,7 @@ grub_video_fbblit_blend_BGRA8888_RGBA8888 (struct grub_video_fbblit_info *dst,
       for (i = 0; i < width; i++)
         {
           grub_uint32_t color;
-          unsigned int sr;
-          unsigned int sg;
-          unsigned int sb;
           unsigned int a;
-          unsigned int dr;
-          unsigned int dg;
-          unsigned int db;
 
           color = *srcptr++;
 
@@ -1264,31 +1263,12 @@ grub_video_fbblit_blend_BGRA8888_RGBA8888 (struct grub_video_fbblit_info *dst,
               continue;
             }
 
-          sr = (color >> 0) & 0xFF;
-          sg = (color >> 8) & 0xFF;
-          sb = (color >> 16) & 0xFF;
+          color = swap_rb_32 (color);
 
-          if (a == 255)
-            {
-              /* Opaque pixel shortcut.  */
-              dr = sr;
-              dg = sg;
-              db = sb;
-            }
-          else
-            {
-              /* General pixel color blending.  */
-              color = *dstptr;
-
-              dr = (color >> 16) & 0xFF;
-              dr = alpha_dilute (dr, sr, a);
-              dg = (color >> 8) & 0xFF;
-              dg = alpha_dilute (dg, sg, a);
-              db = (color >> 0) & 0xFF;
-              db = alpha_dilute (db, sb, a);
-            }
-
-          color = (a << 24) | (dr << 16) | (dg << 8) | db;
+          /* General pixel color blending, opaque pixels are copied.  */
+          if (a != 255)
+            color = (alpha_dilute_32 (*dstptr, color, a) & 0x00ffffff)
+              | (a << 24);
 
           *dstptr++ = color;
         }
@@ -1359,8 +1339,6 @@ grub_video_fbblit_blend_BGR888_RGBA8888 (struct grub_video_fbblit_info *dst,
           else
             {
               /* General pixel color blending.  */
-              color = *dstptr;
-
 #ifndef GRUB_CPU_WORDS_BIGENDIAN
               db = dstptr[0];
               dg = dstptr[1];
@@ -1371,9 +1349,11 @@ grub_video_fbblit_blend_BGR888_RGBA8888 (struct grub_video_fbblit_info *dst,
               db = dstptr[2];
 #endif
 
-              db = alpha_dilute (db, sb, a);
-              dg = alpha_dilute (dg, sg, a);
-              dr = alpha_dilute (dr, sr, a);
+              color = alpha_dilute_32 (dr | (dg << 8) | (db << 16),
+                                       color, a);
+              dr = color & 0xFF;
+              dg = (color >> 8) & 0xFF;
+              db = (color >> 16) & 0xFF;
             }
 
 #ifndef GRUB_CPU_WORDS_BIGENDIAN
@@ -1405,13 +1385,7 @@ grub_video_fbblit_blend_RGBA8888_RGBA8888 (struct grub_video_fbblit_info *dst,
   int j;
   grub_uint32_t *srcptr;
   grub_uint32_t *dstptr;
-  unsigned int sr;
-  unsigned int sg;
-  unsigned int sb;
   unsigned int a;
-  unsigned int dr;
-  unsigned int dg;
-  unsigned int db;
   grub_size_t srcrowskip;
   grub_size_t dstrowskip;
 
@@ -1441,21 +1415,8 @@ grub_video_fbblit_blend_RGBA8888_RGBA8888 (struct grub_video_fbblit_info *dst,
               continue;
             }
 
-          sr = (color >> 0) & 0xFF;
-          sg = (color >> 8) & 0xFF;
-          sb = (color >> 16) & 0xFF;
-
-          color = *dstptr;
-
-          dr = (color >> 0) & 0xFF;
-          dg = (color >> 8) & 0xFF;
-          db = (color >> 16) & 0xFF;
-
-          dr = alpha_dilute (dr, sr, a);
-          dg = alpha_dilute (dg, sg, a);
-          db = alpha_dilute (db, sb, a);
-
-          color = (a << 24) | (db << 16) | (dg << 8) | dr;
+          color = (alpha_dilute_32 (*dstptr, color, a) & 0x00ffffff)
+            | (a << 24);
 
           *dstptr++ = color;
         }
@@ -1536,9 +1497,10 @@ grub_video_fbblit_blend_RGB888_RGBA8888 (struct grub_video_fbblit_info *dst,
           dr = dstptr[2];
 #endif
 
-          dr = alpha_dilute (dr, sr, a);
-          dg = alpha_dilute (dg, sg, a);
-          db = alpha_dilute (db, sb, a);
+          color = alpha_dilute_32 (dr | (dg << 8) | (db << 16), color, a);
+          dr = color & 0xFF;
+          dg = (color >> 8) & 0xFF;
+          db = (color >> 16) & 0xFF;
 
 #ifndef GRUB_CPU_WORDS_BIGENDIAN
           *dstptr++ = dr;
@@ -2017,6 +1979,18 @@ grub_video_fb_dispatch_blit (struct grub_video_fbblit_info *target,
 	      break;
 	    }
 	  break;
+	case GRUB_VIDEO_BLIT_FORMAT_BGR_888:
+	  switch (target->mode_info->blit_format)
+	    {
+	    case GRUB_VIDEO_BLIT_FORMAT_BGR_888:
+	      grub_video_fbblit_replace_directN (target, source,
+						       x, y, width, height,
+						       offset_x, offset_y);
+	      return;
+	    default:
+	      break;
+	    }
+	  break;
 	case GRUB_VIDEO_BLIT_FORMAT_INDEXCOLOR:
 	  switch (target->mode_info->blit_format)
 	    {
@@ -2094,9 +2068,38 @@ grub_video_fb_dispatch_blit (struct grub_video_fbblit_info *target,
     }
   else
     {
+      /* A source already in the target's format and known to be opaque,
+	 such as a bitmap converted for the display, is simply copied.  */
+      if (source->mode_info->blit_format == target->mode_info->blit_format
+	  && !(source->mode_info->mode_type & GRUB_VIDEO_MODE_TYPE_ALPHA)
+	  && (source->mode_info->blit_format == GRUB_VIDEO_BLIT_FORMAT_RGBA_8888
+	      || source->mode_info->blit_format == GRUB_VIDEO_BLIT_FORMAT_BGRA_8888
+	      || source->mode_info->blit_format == GRUB_VIDEO_BLIT_FORMAT_RGB_888
+	      || source->mode_info->blit_format == GRUB_VIDEO_BLIT_FORMAT_BGR_888))
+	{
+	  grub_video_fbblit_replace_directN (target, source,
+					     x, y, width, height,
+					     offset_x, offset_y);
+	  return;
+	}
+
       /* Try to figure out more optimized blend operator.  */
       switch (source->mode_info->blit_format)
 	{
+	case GRUB_VIDEO_BLIT_FORMAT_BGRA_8888:
+	  switch (target->mode_info->blit_format)
+	    {
+	    case GRUB_VIDEO_BLIT_FORMAT_BGRA_8888:
+	      /* Blending treats the colour channels alike, so the same
+		 order on both sides is all that matters.  */
+	      grub_video_fbblit_blend_RGBA8888_RGBA8888 (target, source,
+							 x, y, width, height,
+							 offset_x, offset_y);
+	      return;
+	    default:
+	      break;
+	    }
+	  break;
 	case GRUB_VIDEO_BLIT_FORMAT_RGBA_8888:
 	  switch (target->mode_info->blit_format)
 	    {
@@ -31,12 +31,6 @@ GRUB_MOD_LICENSE ("GPLv3+");
 typedef grub_err_t (*grub_video_fb_doublebuf_update_screen_t) (void);
 typedef volatile void *framebuf_t;
 
-struct dirty
-{
-  int first_line;
-  int last_line;
-};
-
 static struct
 {
   struct grub_video_fbrender_target *render_target;
@@ -46,8 +40,10 @@ static struct
 
   unsigned int palette_size;
 
-  struct dirty current_dirty;
-  struct dirty previous_dirty;
+  /* Areas of the back buffer changed since the last and the previous
+     update of the screen.  */
+  struct grub_video_damage current_dirty;
+  struct grub_video_damage previous_dirty;
 
   /* For page flipping strategy.  */
   int displayed_page;           /* The page # that is the front buffer.  */
@@ -55,6 +51,21 @@ static struct
   grub_video_fb_set_page_t set_page;
   char *offscreen_buffer;
   grub_video_fb_doublebuf_update_screen_t update_screen;
+
+  /* For shadow strategy.  */
+  const struct grub_video_fb_shadow_ops *shadow_ops;
+  /* A scroll of MOVE_RECT by MOVE_DX, MOVE_DY not yet done on screen.  */
+  int move_pending;
+  grub_video_rect_t move_rect;
+  int move_dx;
+  int move_dy;
+  /* Solid fills not yet done on screen, in order.  */
+  unsigned int fill_count;
+  struct
+  {
+    grub_video_rect_t rect;
+    grub_video_color_t color;
+  } fills[GRUB_VIDEO_FB_SHADOW_MAX_FILLS];
 } framebuffer;
 
 /* Specify "standard" VGA palette, some video cards may
@@ -335,6 +346,7 @@ grub_video_fb_init (void)
   framebuffer.palette = 0;
   framebuffer.palette_size = 0;
   framebuffer.set_page = 0;
+  framebuffer.shadow_ops = 0;
   return GRUB_ERR_NONE;
 }
 
@@ -350,6 +362,7 @@ grub_video_fb_fini (void)
   framebuffer.palette = 0;
   framebuffer.palette_size = 0;
   framebuffer.set_page = 0;
+  framebuffer.shadow_ops = 0;
   framebuffer.offscreen_buffer = 0;
   return GRUB_ERR_NONE;
 }
@@ -830,14 +843,142 @@ grub_video_fb_unmap_color_int (struct grub_video_fbblit_info * source,
 }
 
 static void
-dirty (int y, int height)
+dirty (int x, int y, unsigned int width, unsigned int height)
 {
   if (framebuffer.render_target != framebuffer.back_target)
     return;
-  if (framebuffer.current_dirty.first_line > y)
-    framebuffer.current_dirty.first_line = y;
-  if (framebuffer.current_dirty.last_line < y + height)
-    framebuffer.current_dirty.last_line = y + height;
+  grub_video_damage_add (&framebuffer.current_dirty, x, y, width, height);
+}
+
+/* Leave a large solid fill of the shadow to the driver instead of copying
+   it to the screen.  Returns 1 if it will.  */
+static int
+shadow_fill (grub_video_color_t color, int x, int y,
+	     unsigned int width, unsigned int height)
+{
+  struct grub_video_mode_info *mode_info;
+
+  if (!framebuffer.shadow_ops || !framebuffer.shadow_ops->fill
+      || framebuffer.render_target != framebuffer.back_target)
+    return 0;
+
+  /* Small fills, like the background of a character, cost more as
+     firmware calls than as part of the next copy.  */
+  mode_info = &framebuffer.back_target->mode_info;
+  if ((grub_uint64_t) width * height * 4
+      < (grub_uint64_t) mode_info->width * mode_info->height)
+    return 0;
+
+  /* Nothing drawn before matters under a fill of the whole screen.  */
+  if (x == 0 && y == 0 && width == mode_info->width
+      && height == mode_info->height)
+    {
+      grub_video_damage_clear (&framebuffer.current_dirty);
+      framebuffer.move_pending = 0;
+      framebuffer.fill_count = 0;
+    }
+
+  if (framebuffer.fill_count == GRUB_VIDEO_FB_SHADOW_MAX_FILLS)
+    return 0;
+
+  framebuffer.fills[framebuffer.fill_count].rect.x = x;
+  framebuffer.fills[framebuffer.fill_count].rect.y = y;
+  framebuffer.fills[framebuffer.fill_count].rect.width = width;
+  framebuffer.fills[framebuffer.fill_count].rect.height = height;
+  framebuffer.fills[framebuffer.fill_count].color = color;
+  framebuffer.fill_count++;
+  return 1;
+}
+
+/* Intersect R with CLIP.  Returns 0 if nothing is left.  */
+static int
+clip_rect (grub_video_rect_t *r, const grub_video_rect_t *clip)
+{
+  unsigned int x1, y1, x2, y2;
+
+  x1 = grub_max (r->x, clip->x);
+  y1 = grub_max (r->y, clip->y);
+  x2 = grub_min (r->x + r->width, clip->x + clip->width);
+  y2 = grub_min (r->y + r->height, clip->y + clip->height);
+  if (x1 >= x2 || y1 >= y2)
+    return 0;
+
+  r->x = x1;
+  r->y = y1;
+  r->width = x2 - x1;
+  r->height = y2 - y1;
+  return 1;
+}
+
+/* Leave scrolling the viewport of the shadow by DX, DY to the driver,
+   which can move what is already on screen.  Returns 0 if the viewport
+   has to be copied instead.  */
+static int
+shadow_move (int dx, int dy)
+{
+  const grub_video_rect_t *vp = &framebuffer.render_target->viewport;
+  struct grub_video_damage before;
+  unsigned int i;
+
+  if (!framebuffer.shadow_ops || !framebuffer.shadow_ops->move
+      || framebuffer.render_target != framebuffer.back_target)
+    return 0;
+
+  if (framebuffer.move_pending
+      && (framebuffer.move_rect.x != vp->x
+	  || framebuffer.move_rect.y != vp->y
+	  || framebuffer.move_rect.width != vp->width
+	  || framebuffer.move_rect.height != vp->height))
+    {
+      /* Only one move is done per update; copy both areas instead.  */
+      dirty (framebuffer.move_rect.x, framebuffer.move_rect.y,
+	     framebuffer.move_rect.width, framebuffer.move_rect.height);
+      framebuffer.move_pending = 0;
+      return 0;
+    }
+
+  /* The screen does fills after the move; earlier ones have to be
+     copied instead.  */
+  for (i = 0; i < framebuffer.fill_count; i++)
+    dirty (framebuffer.fills[i].rect.x, framebuffer.fills[i].rect.y,
+	   framebuffer.fills[i].rect.width, framebuffer.fills[i].rect.height);
+  framebuffer.fill_count = 0;
+
+  if (!framebuffer.move_pending)
+    {
+      framebuffer.move_rect = *vp;
+      framebuffer.move_dx = 0;
+      framebuffer.move_dy = 0;
+    }
+  framebuffer.move_dx += dx;
+  framebuffer.move_dy += dy;
+  if ((unsigned int) grub_abs (framebuffer.move_dx) >= vp->width
+      || (unsigned int) grub_abs (framebuffer.move_dy) >= vp->height)
+    {
+      framebuffer.move_pending = 0;
+      return 0;
+    }
+  framebuffer.move_pending = 1;
+
+  /* Changes not on screen yet move along with the rest.  */
+  before = framebuffer.current_dirty;
+  for (i = 0; i < before.count; i++)
+    {
+      grub_video_rect_t r = before.rects[i];
+      int x1, y1, x2, y2;
+
+      if (!clip_rect (&r, vp))
+	continue;
+      x1 = grub_max ((int) r.x + dx, (int) vp->x);
+      y1 = grub_max ((int) r.y + dy, (int) vp->y);
+      x2 = grub_min ((int) (r.x + r.width) + dx, (int) (vp->x + vp->width));
+      y2 = grub_min ((int) (r.y + r.height) + dy,
+		     (int) (vp->y + vp->height));
+      if (x1 < x2 && y1 < y2)
+	dirty (x1, y1, x2 - x1, y2 - y1);
+    }
+
+  return 1;
 }
 
 grub_err_t
@@ -895,7 +1036,8 @@ grub_video_fb_fill_rect (grub_video_color_t color, int x, int y,
   x += area_x;
   y += area_y;
 
-  dirty (y, height);
+  if (!shadow_fill (color, x, y, width, height))
+    dirty (x, y, width, height);
 
   /* Use fbblit_info to encapsulate rendering.  */
   target.mode_info = &framebuffer.render_target->mode_info;
@@ -1008,7 +1150,7 @@ grub_video_fb_blit_source (struct grub_video_fbblit_info *source,
   target.data = framebuffer.render_target->data;
 
   /* Do actual blitting.  */
-  dirty (y, height);
+  dirty (x, y, width, height);
   grub_video_fb_dispatch_blit (&target, source, oper, x, y, width, height,
                                offset_x, offset_y);
 
@@ -1060,8 +1202,11 @@ grub_video_fb_scroll (grub_video_color_t color, int dx, int dy)
   width = framebuffer.render_target->viewport.width - grub_abs (dx);
   height = framebuffer.render_target->viewport.height - grub_abs (dy);
 
-  dirty (framebuffer.render_target->viewport.y,
-	 framebuffer.render_target->viewport.height);
+  if (!shadow_move (dx, dy))
+    dirty (framebuffer.render_target->viewport.x,
+	   framebuffer.render_target->viewport.y,
+	   framebuffer.render_target->viewport.width,
+	   framebuffer.render_target->viewport.height);
 
   if (dx < 0)
     {
@@ -1412,23 +1557,51 @@ grub_video_fb_get_active_render_target (struct grub_video_fbrender_target **targ
   return GRUB_ERR_NONE;
 }
 
+/* Copy the damaged rectangles of the back buffer to PAGE.  */
+static void
+copy_dirty (framebuf_t page, const struct grub_video_damage *damage)
+{
+  struct grub_video_mode_info *mode_info = &framebuffer.back_target->mode_info;
+  unsigned int i;
+
+  for (i = 0; i < damage->count; i++)
+    {
+      const grub_video_rect_t *r = &damage->rects[i];
+      unsigned int height = r->height, width = r->width;
+      grub_size_t first, last, offset;
+
+      if (r->x >= mode_info->width || r->y >= mode_info->height)
+	continue;
+      if (r->x + width > mode_info->width)
+	width = mode_info->width - r->x;
+      if (r->y + height > mode_info->height)
+	height = mode_info->height - r->y;
+
+      offset = (grub_size_t) r->y * mode_info->pitch;
+
+      /* Whole lines are contiguous.  */
+      if (width == mode_info->width)
+	{
+	  grub_memcpy ((char *) page + offset,
+		       (char *) framebuffer.back_target->data + offset,
+		       (grub_size_t) height * mode_info->pitch);
+	  continue;
+	}
+
+      first = ((grub_size_t) r->x * mode_info->bpp) >> 3;
+      last = (((grub_size_t) (r->x + width) * mode_info->bpp) + 7) >> 3;
+      for (offset += first; height; height--, offset += mode_info->pitch)
+	grub_memcpy ((char *) page + offset,
+		     (char *) framebuffer.back_target->data + offset,
+		     last - first);
+    }
+}
+
 static grub_err_t
 doublebuf_blit_update_screen (void)
 {
-  if (framebuffer.current_dirty.first_line
-      <= framebuffer.current_dirty.last_line)
-    grub_memcpy ((char *) framebuffer.pages[0]
-		 + framebuffer.current_dirty.first_line
-		 * framebuffer.back_target->mode_info.pitch,
-		 (char *) framebuffer.back_target->data
-		 + framebuffer.current_dirty.first_line
-		 * framebuffer.back_target->mode_info.pitch,
-		 framebuffer.back_target->mode_info.pitch
-		 * (framebuffer.current_dirty.last_line
-		    - framebuffer.current_dirty.first_line));
-  framebuffer.current_dirty.first_line
-    = framebuffer.back_target->mode_info.height;
-  framebuffer.current_dirty.last_line = 0;
+  copy_dirty (framebuffer.pages[0], &framebuffer.current_dirty);
+  grub_video_damage_clear (&framebuffer.current_dirty);
 
   return GRUB_ERR_NONE;
 }
@@ -1461,8 +1634,7 @@ grub_video_fb_doublebuf_blit_init (struct grub_video_fbrender_target **back,
   framebuffer.pages[0] = framebuf;
   framebuffer.displayed_page = 0;
   framebuffer.render_page = 0;
-  framebuffer.current_dirty.first_line = mode_info.height;
-  framebuffer.current_dirty.last_line = 0;
+  grub_video_damage_clear (&framebuffer.current_dirty);
 
   return GRUB_ERR_NONE;
 }
@@ -1472,26 +1644,22 @@ doublebuf_pageflipping_update_screen (void)
 {
   int new_displayed_page;
   grub_err_t err;
-  int first_line, last_line;
-
-  first_line = framebuffer.current_dirty.first_line;
-  last_line = framebuffer.current_dirty.last_line;
-  if (first_line > framebuffer.previous_dirty.first_line)
-    first_line = framebuffer.previous_dirty.first_line;
-  if (last_line < framebuffer.previous_dirty.last_line)
-    last_line = framebuffer.previous_dirty.last_line;
-
-  if (first_line <= last_line)
-    grub_memcpy ((char *) framebuffer.pages[framebuffer.render_page]
-		 + first_line * framebuffer.back_target->mode_info.pitch,
-		 (char *) framebuffer.back_target->data
-		 + first_line * framebuffer.back_target->mode_info.pitch,
-		 framebuffer.back_target->mode_info.pitch
-		 * (last_line - first_line));
+  struct grub_video_damage both;
+  unsigned int i;
+
+  /* The page being drawn was last updated two swaps ago, so it misses
+     the previous frame's changes as well as the current ones.  */
+  both = framebuffer.current_dirty;
+  for (i = 0; i < framebuffer.previous_dirty.count; i++)
+    grub_video_damage_add (&both,
+			   framebuffer.previous_dirty.rects[i].x,
+			   framebuffer.previous_dirty.rects[i].y,
+			   framebuffer.previous_dirty.rects[i].width,
+			   framebuffer.previous_dirty.rects[i].height);
+
+  copy_dirty (framebuffer.pages[framebuffer.render_page], &both);
   framebuffer.previous_dirty = framebuffer.current_dirty;
-  framebuffer.current_dirty.first_line
-    = framebuffer.back_target->mode_info.height;
-  framebuffer.current_dirty.last_line = 0;
+  grub_video_damage_clear (&framebuffer.current_dirty);
 
   /* Swap the page numbers in the framebuffer struct.  */
   new_displayed_page = framebuffer.render_page;
@@ -1544,12 +1712,8 @@ doublebuf_pageflipping_init (struct grub_video_mode_info *mode_info,
   framebuffer.pages[0] = page0_ptr;
   framebuffer.pages[1] = page1_ptr;
 
-  framebuffer.current_dirty.first_line
-    = framebuffer.back_target->mode_info.height;
-  framebuffer.current_dirty.last_line = 0;
-  framebuffer.previous_dirty.first_line
-    = framebuffer.back_target->mode_info.height;
-  framebuffer.previous_dirty.last_line = 0;
+  grub_video_damage_clear (&framebuffer.current_dirty);
+  grub_video_damage_clear (&framebuffer.previous_dirty);
 
   /* Set the framebuffer memory data pointer and display the right page.  */
   err = set_page_in (framebuffer.displayed_page);
@@ -1563,6 +1727,88 @@ doublebuf_pageflipping_init (struct grub_video_mode_info *mode_info,
   return GRUB_ERR_NONE;
 }
 
+/* Bring the screen up to date through the shadow operations: first the
+   pending move, then the fills, then a copy of everything else that
+   changed.  */
+static grub_err_t
+doublebuf_shadow_update_screen (void)
+{
+  const struct grub_video_fb_shadow_ops *ops = framebuffer.shadow_ops;
+  struct grub_video_mode_info *mode_info = &framebuffer.back_target->mode_info;
+  grub_video_rect_t screen = { 0, 0, mode_info->width, mode_info->height };
+  grub_err_t err = GRUB_ERR_NONE;
+  unsigned int i;
+
+  if (framebuffer.move_pending)
+    {
+      const grub_video_rect_t *r = &framebuffer.move_rect;
+      int dx = framebuffer.move_dx, dy = framebuffer.move_dy;
+
+      err = ops->move (dx < 0 ? r->x - dx : r->x,
+		       dy < 0 ? r->y - dy : r->y,
+		       dx < 0 ? r->x : r->x + dx,
+		       dy < 0 ? r->y : r->y + dy,
+		       r->width - grub_abs (dx), r->height - grub_abs (dy));
+    }
+
+  for (i = 0; !err && i < framebuffer.fill_count; i++)
+    err = ops->fill (framebuffer.fills[i].color, &framebuffer.fills[i].rect);
+
+  if (err)
+    {
+      /* Copy the whole screen instead.  */
+      grub_errno = GRUB_ERR_NONE;
+      grub_video_damage_clear (&framebuffer.current_dirty);
+      grub_video_damage_add (&framebuffer.current_dirty, 0, 0,
+			     mode_info->width, mode_info->height);
+      err = GRUB_ERR_NONE;
+    }
+
+  for (i = 0; !err && i < framebuffer.current_dirty.count; i++)
+    {
+      grub_video_rect_t r = framebuffer.current_dirty.rects[i];
+
+      if (clip_rect (&r, &screen))
+	err = ops->update (&r);
+    }
+
+  framebuffer.move_pending = 0;
+  framebuffer.fill_count = 0;
+  grub_video_damage_clear (&framebuffer.current_dirty);
+
+  return err;
+}
+
+grub_err_t
+grub_video_fb_setup_shadow (struct grub_video_mode_info *mode_info,
+			    void *shadow,
+			    const struct grub_video_fb_shadow_ops *ops)
+{
+  grub_err_t err;
+
+  mode_info->mode_type |= (GRUB_VIDEO_MODE_TYPE_DOUBLE_BUFFERED
+			   | GRUB_VIDEO_MODE_TYPE_UPDATING_SWAP);
+
+  err = grub_video_fb_create_render_target_from_pointer (&framebuffer.back_target,
+							 mode_info, shadow);
+  if (err)
+    return err;
+
+  framebuffer.update_screen = doublebuf_shadow_update_screen;
+  framebuffer.shadow_ops = ops;
+  framebuffer.pages[0] = 0;
+  framebuffer.displayed_page = 0;
+  framebuffer.render_page = 0;
+  framebuffer.set_page = 0;
+  framebuffer.move_pending = 0;
+  framebuffer.fill_count = 0;
+  grub_video_damage_clear (&framebuffer.current_dirty);
+
+  framebuffer.render_target = framebuffer.back_target;
+
+  return GRUB_ERR_NONE;
+}
+
 /* Select the best double buffering mode available.  */
 grub_err_t
 grub_video_fb_setup (unsigned int mode_type, unsigned int mode_mask,
@@ -1573,6 +1819,8 @@ grub_video_fb_setup (unsigned int mode_type, unsigned int mode_mask,
 {
   grub_err_t err;
 
+  framebuffer.shadow_ops = 0;
+
   /* Do double buffering only if it's either requested or efficient.  */
   if (set_page_in && grub_video_check_mode_flag (mode_type, mode_mask,
 						 GRUB_VIDEO_MODE_TYPE_DOUBLE_BUFFERED,
@@ -1635,9 +1883,7 @@ grub_video_fb_setup (unsigned int mode_type, unsigned int mode_mask,
   framebuffer.displayed_page = 0;
   framebuffer.render_page = 0;
   framebuffer.set_page = 0;
-  framebuffer.current_dirty.first_line
-    = framebuffer.back_target->mode_info.height;
-  framebuffer.current_dirty.last_line = 0;
+  grub_video_damage_clear (&framebuffer.current_dirty);
 
   mode_info->mode_type &= ~GRUB_VIDEO_MODE_TYPE_DOUBLE_BUFFERED;
 
@@ -55,8 +55,20 @@ enum
 #define SHIFT_BITS		8
 #define CONST(x)		((int) ((x) * (1L << SHIFT_BITS) + 0.5))
 
+/* Extra precision kept between the two IDCT passes.  */
+#define PASS1_BITS		2
+
+/* Precision of the colour conversion tables.  */
+#define YCC_BITS		16
+#define YCC_CONST(x)		((int) ((x) * (1L << YCC_BITS) + 0.5))
+
 #define JPEG_UNIT_SIZE		8
 
+/* Huffman codes up to this long are decoded with a single table lookup.  */
+#define JPEG_HUFF_LOOKAHEAD	9
+
+#define JPEG_INPUT_SIZE		4096
+
 static const grub_uint8_t jpeg_zigzag_order[64] = {
   0, 1, 8, 16, 9, 2, 3, 10,
   17, 24, 32, 25, 18, 11, 4, 5,
@@ -68,6 +80,39 @@ static const grub_uint8_t jpeg_zigzag_order[64] = {
   53, 60, 61, 54, 47, 55, 62, 63
 };
 
+/* Scale factors of the AAN IDCT, in natural order with 14 fractional bits:
+   16384 * f(row) * f(col), where f(0) = 1 and f(k) = cos(k * PI / 16) *
+   sqrt(2).  They are folded into the quantization tables.  */
+static const grub_uint16_t jpeg_aan_scales[64] = {
+  16384, 22725, 21407, 19266, 16384, 12873, 8867, 4520,
+  22725, 31521, 29692, 26722, 22725, 17855, 12299, 6270,
+  21407, 29692, 27969, 25172, 21407, 16819, 11585, 5906,
+  19266, 26722, 25172, 22654, 19266, 15137, 10426, 5315,
+  16384, 22725, 21407, 19266, 16384, 12873, 8867, 4520,
+  12873, 17855, 16819, 15137, 12873, 10114, 6967, 3552,
+  8867, 12299, 11585, 10426, 8867, 6967, 4799, 2446,
+  4520, 6270, 5906, 5315, 4520, 3552, 2446, 1247
+};
+
+/* Chroma contributions to each colour channel, indexed by sample value.  */
+static int jpeg_cr_r[256];
+static int jpeg_cb_b[256];
+static int jpeg_cr_g[256];
+static int jpeg_cb_g[256];
+
+/* Clamps Y plus a chroma term, -256 .. 511, to 0 .. 255.  */
+static grub_uint8_t jpeg_range_limit[256 * 3];
+#define JPEG_LIMIT(v)	(jpeg_range_limit[(v) + 256])
+
+#ifdef GRUB_CPU_WORDS_BIGENDIAN
+#define JPEG_RED	2
+#define JPEG_BLUE	0
+#else
+#define JPEG_RED	0
+#define JPEG_BLUE	2
+#endif
+#define JPEG_GREEN	1
+
 #ifdef JPEG_DEBUG
 static grub_command_t cmd;
 #endif
@@ -86,8 +131,12 @@ struct grub_jpeg_data
   grub_uint8_t *huff_value[4];
   int huff_offset[4][16];
   int huff_maxval[4][16];
+  /* Length << 8 | symbol for each JPEG_HUFF_LOOKAHEAD bit prefix, or 0 if
+     the code is longer.  */
+  grub_uint16_t huff_lookup[4][1 << JPEG_HUFF_LOOKAHEAD];
 
-  grub_uint8_t quan_table[2][64];
+  /* In zigzag order, pre-multiplied by the AAN scale factors.  */
+  int quan_table[2][64];
   int comp_index[3][3];
 
   jpeg_data_unit_t ydu[4];
@@ -102,7 +151,13 @@ struct grub_jpeg_data
 
   int color_components;
 
-  int bit_mask, bit_save;
+  /* Entropy coded data is read through IN_BUF; BIT_BUF holds the next
+     BIT_CNT bits of it.  */
+  grub_uint32_t bit_buf;
+  int bit_cnt;
+  grub_uint8_t in_buf[JPEG_INPUT_SIZE];
+  grub_size_t in_pos, in_len;
+  int in_marker;
 };
 
 static grub_uint8_t
@@ -127,43 +182,85 @@ grub_jpeg_get_word (struct grub_jpeg_data *data)
   return grub_be_to_cpu16 (r);
 }
 
-static int
-grub_jpeg_get_bit (struct grub_jpeg_data *data)
+/* Get the next byte of entropy coded data, with stuffed zero bytes removed.
+   Once a marker is reached it is left unread and zero bits are supplied
+   instead, so that the final codes of a segment can be looked ahead.  */
+static grub_uint8_t
+grub_jpeg_get_data_byte (struct grub_jpeg_data *data)
 {
-  int ret;
+  grub_uint8_t r;
 
-  if (data->bit_mask == 0)
+  if (data->in_marker)
+    return 0;
+
+  if (data->in_pos + 1 >= data->in_len)
     {
-      data->bit_save = grub_jpeg_get_byte (data);
-      if (data->bit_save == JPEG_ESC_CHAR)
+      grub_size_t left = data->in_len - data->in_pos;
+      grub_ssize_t len;
+
+      if (left)
+	data->in_buf[0] = data->in_buf[data->in_pos];
+      len = grub_file_read (data->file, data->in_buf + left,
+			    sizeof (data->in_buf) - left);
+      data->in_pos = 0;
+      data->in_len = left + (len > 0 ? len : 0);
+      if (data->in_len == 0)
 	{
-	  if (grub_jpeg_get_byte (data) != 0)
-	    {
-	      grub_error (GRUB_ERR_BAD_FILE_TYPE,
-			  "jpeg: invalid 0xFF in data stream");
-	      return 0;
-	    }
+	  data->in_marker = 1;
+	  return 0;
 	}
-      data->bit_mask = 0x80;
     }
 
-  ret = ((data->bit_save & data->bit_mask) != 0);
-  data->bit_mask >>= 1;
-  return ret;
+  r = data->in_buf[data->in_pos];
+  if (r == JPEG_ESC_CHAR)
+    {
+      if (data->in_pos + 1 >= data->in_len
+	  || data->in_buf[data->in_pos + 1] != 0)
+	{
+	  data->in_marker = 1;
+	  return 0;
+	}
+      data->in_pos++;
+    }
+  data->in_pos++;
+
+  return r;
+}
+
+/* Make sure at least 25 bits are buffered.  */
+static inline void
+grub_jpeg_fill_bits (struct grub_jpeg_data *data)
+{
+  while (data->bit_cnt <= 24)
+    {
+      data->bit_buf = (data->bit_buf << 8) | grub_jpeg_get_data_byte (data);
+      data->bit_cnt += 8;
+    }
+}
+
+static inline unsigned
+grub_jpeg_peek_bits (struct grub_jpeg_data *data, int num)
+{
+  return (data->bit_buf >> (data->bit_cnt - num)) & ((1U << num) - 1);
 }
 
 static int
 grub_jpeg_get_number (struct grub_jpeg_data *data, int num)
 {
-  int value, i, msb;
+  int value;
 
   if (num == 0)
     return 0;
+  if (num > 16)
+    {
+      grub_error (GRUB_ERR_BAD_FILE_TYPE, "jpeg: invalid coefficient size");
+      return 0;
+    }
 
-  msb = value = grub_jpeg_get_bit (data);
-  for (i = 1; i < num; i++)
-    value = (value << 1) + (grub_jpeg_get_bit (data) != 0);
-  if (!msb)
+  grub_jpeg_fill_bits (data);
+  value = grub_jpeg_peek_bits (data, num);
+  data->bit_cnt -= num;
+  if (value < (1 << (num - 1)))
     value += 1 - (1 << num);
 
   return value;
@@ -172,17 +269,28 @@ grub_jpeg_get_number (struct grub_jpeg_data *data, int num)
 static int
 grub_jpeg_get_huff_code (struct grub_jpeg_data *data, int id)
 {
+  grub_uint16_t entry;
   int code;
   unsigned i;
 
-  code = 0;
-  for (i = 0; i < ARRAY_SIZE (data->huff_maxval[id]); i++)
+  grub_jpeg_fill_bits (data);
+  entry = data->huff_lookup[id][grub_jpeg_peek_bits (data,
+						     JPEG_HUFF_LOOKAHEAD)];
+  if (entry)
+    {
+      data->bit_cnt -= entry >> 8;
+      return entry & 0xff;
+    }
+
+  /* A longer code: check the remaining lengths one by one.  */
+  for (i = JPEG_HUFF_LOOKAHEAD; i < ARRAY_SIZE (data->huff_maxval[id]); i++)
     {
-      code <<= 1;
-      if (grub_jpeg_get_bit (data))
-	code++;
+      code = grub_jpeg_peek_bits (data, i + 1);
       if (code < data->huff_maxval[id][i])
-	return data->huff_value[id][code + data->huff_offset[id][i]];
+	{
+	  data->bit_cnt -= i + 1;
+	  return data->huff_value[id][code + data->huff_offset[id][i]];
+	}
     }
   grub_error (GRUB_ERR_BAD_FILE_TYPE, "jpeg: huffman decode fails");
   return 0;
@@ -194,7 +302,7 @@ grub_jpeg_decode_huff_table (struct grub_jpeg_data *data)
   int id, ac, n, base, ofs;
   grub_uint32_t next_marker;
   grub_uint8_t count[16];
-  unsigned i;
+  unsigned i, j, k, code;
 
   next_marker = data->file->offset;
   next_marker += grub_jpeg_get_word (data);
@@ -217,6 +325,7 @@ grub_jpeg_decode_huff_table (struct grub_jpeg_data *data)
 	n += count[i];
 
       id += ac * 2;
+      grub_free (data->huff_value[id]);
       data->huff_value[id] = grub_malloc (n);
       if (grub_errno)
 	return grub_errno;
@@ -236,6 +345,24 @@ grub_jpeg_decode_huff_table (struct grub_jpeg_data *data)
 
 	  base <<= 1;
 	}
+
+      /* Every prefix of a short code maps to its length and symbol.  */
+      grub_memset (data->huff_lookup[id], 0, sizeof (data->huff_lookup[id]));
+      code = 0;
+      k = 0;
+      for (i = 0; i < JPEG_HUFF_LOOKAHEAD; i++, code <<= 1)
+	for (j = 0; j < count[i]; j++, code++, k++)
+	  {
+	    unsigned shift = JPEG_HUFF_LOOKAHEAD - 1 - i;
+	    unsigned pos;
+
+	    if (code >= (1U << (i + 1)))
+	      return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+				 "jpeg: invalid huffman table");
+	    for (pos = code << shift; pos < (code + 1) << shift; pos++)
+	      data->huff_lookup[id][pos] = ((i + 1) << 8)
+		| data->huff_value[id][k];
+	  }
     }
 
   if (data->file->offset != next_marker)
@@ -249,12 +376,13 @@ grub_jpeg_decode_quan_table (struct grub_jpeg_data *data)
 {
   int id;
   grub_uint32_t next_marker;
+  grub_uint8_t table[64];
+  unsigned i;
 
   next_marker = data->file->offset;
   next_marker += grub_jpeg_get_word (data);
 
-  while (data->file->offset + sizeof (data->quan_table[id]) + 1
-	 <= next_marker)
+  while (data->file->offset + sizeof (table) + 1 <= next_marker)
     {
       id = grub_jpeg_get_byte (data);
       if (id >= 0x10)		/* Upper 4-bit is precision.  */
@@ -265,11 +393,15 @@ grub_jpeg_decode_quan_table (struct grub_jpeg_data *data)
 	return grub_error (GRUB_ERR_BAD_FILE_TYPE,
 			   "jpeg: too many quantization tables");
 
-      if (grub_file_read (data->file, &data->quan_table[id],
-			  sizeof (data->quan_table[id]))
-	  != sizeof (data->quan_table[id]))
+      if (grub_file_read (data->file, table, sizeof (table))
+	  != sizeof (table))
 	return grub_errno;
 
+      for (i = 0; i < ARRAY_SIZE (table); i++)
+	data->quan_table[id][i] = ((int) table[i]
+				   * jpeg_aan_scales[jpeg_zigzag_order[i]]
+				   + (1 << (13 - PASS1_BITS)))
+	  >> (14 - PASS1_BITS);
     }
 
   if (data->file->offset != next_marker)
@@ -328,6 +460,9 @@ grub_jpeg_decode_sof (struct grub_jpeg_data *data)
 	return grub_error (GRUB_ERR_BAD_FILE_TYPE,
 			   "jpeg: sampling method not supported");
       data->comp_index[id][0] = grub_jpeg_get_byte (data);
+      if (data->comp_index[id][0] > 1)
+	return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+			   "jpeg: invalid quantization table");
     }
 
   if (data->file->offset != next_marker)
@@ -348,150 +483,145 @@ grub_jpeg_decode_dri (struct grub_jpeg_data *data)
   return grub_errno;
 }
 
+static inline int
+grub_jpeg_clamp (int val)
+{
+  if (val < 0)
+    return 0;
+  if (val > 255)
+    return 255;
+  return val;
+}
+
+/* Multiply by a CONST and drop its fractional bits.  */
+#define AAN_MUL(v, c)	(((v) * (c)) >> SHIFT_BITS)
+
+/* Final output sample: the IDCT leaves PASS1_BITS + 3 extra bits, which are
+   rounded off before the level shift.  */
+#define AAN_OUT(v)	grub_jpeg_clamp ((((v) + (1 << (PASS1_BITS + 2))) \
+					  >> (PASS1_BITS + 3)) + 128)
+
+/* Integer version of the Arai-Agui-Nakajima IDCT: 5 multiplications per
+   8 samples, with the remaining scaling done by the quantization tables.  */
 static void
 grub_jpeg_idct_transform (jpeg_data_unit_t du)
 {
-  int *pd;
+  int ws[64];
+  int *pd, *pw;
   int i;
-  int t0, t1, t2, t3, t4, t5, t6, t7;
-  int v0, v1, v2, v3, v4;
+  int t0, t1, t2, t3, t4, t5, t6, t7, t10, t11, t12, t13;
+  int z5, z10, z11, z12, z13;
 
   pd = du;
-  for (i = 0; i < JPEG_UNIT_SIZE; i++, pd++)
+  pw = ws;
+  for (i = 0; i < JPEG_UNIT_SIZE; i++, pd++, pw++)
     {
       if ((pd[JPEG_UNIT_SIZE * 1] | pd[JPEG_UNIT_SIZE * 2] |
 	   pd[JPEG_UNIT_SIZE * 3] | pd[JPEG_UNIT_SIZE * 4] |
 	   pd[JPEG_UNIT_SIZE * 5] | pd[JPEG_UNIT_SIZE * 6] |
 	   pd[JPEG_UNIT_SIZE * 7]) == 0)
 	{
-	  pd[JPEG_UNIT_SIZE * 0] <<= SHIFT_BITS;
-
-	  pd[JPEG_UNIT_SIZE * 1] = pd[JPEG_UNIT_SIZE * 2]
-	    = pd[JPEG_UNIT_SIZE * 3] = pd[JPEG_UNIT_SIZE * 4]
-	    = pd[JPEG_UNIT_SIZE * 5] = pd[JPEG_UNIT_SIZE * 6]
-	    = pd[JPEG_UNIT_SIZE * 7] = pd[JPEG_UNIT_SIZE * 0];
-
+	  pw[JPEG_UNIT_SIZE * 0] = pw[JPEG_UNIT_SIZE * 1]
+	    = pw[JPEG_UNIT_SIZE * 2] = pw[JPEG_UNIT_SIZE * 3]
+	    = pw[JPEG_UNIT_SIZE * 4] = pw[JPEG_UNIT_SIZE * 5]
+	    = pw[JPEG_UNIT_SIZE * 6] = pw[JPEG_UNIT_SIZE * 7]
+	    = pd[JPEG_UNIT_SIZE * 0];
 	  continue;
 	}
 
+      /* Even part.  */
       t0 = pd[JPEG_UNIT_SIZE * 0];
       t1 = pd[JPEG_UNIT_SIZE * 2];
       t2 = pd[JPEG_UNIT_SIZE * 4];
       t3 = pd[JPEG_UNIT_SIZE * 6];
 
-      v4 = (t1 + t3) * CONST (0.541196100);
-
-      v0 = ((t0 + t2) << SHIFT_BITS);
-      v1 = ((t0 - t2) << SHIFT_BITS);
-      v2 = v4 - t3 * CONST (1.847759065);
-      v3 = v4 + t1 * CONST (0.765366865);
-
-      t0 = v0 + v3;
-      t3 = v0 - v3;
-      t1 = v1 + v2;
-      t2 = v1 - v2;
-
-      t4 = pd[JPEG_UNIT_SIZE * 7];
-      t5 = pd[JPEG_UNIT_SIZE * 5];
-      t6 = pd[JPEG_UNIT_SIZE * 3];
-      t7 = pd[JPEG_UNIT_SIZE * 1];
-
-      v0 = t4 + t7;
-      v1 = t5 + t6;
-      v2 = t4 + t6;
-      v3 = t5 + t7;
-
-      v4 = (v2 + v3) * CONST (1.175875602);
-
-      v0 *= CONST (0.899976223);
-      v1 *= CONST (2.562915447);
-      v2 = v2 * CONST (1.961570560) - v4;
-      v3 = v3 * CONST (0.390180644) - v4;
-
-      t4 = t4 * CONST (0.298631336) - v0 - v2;
-      t5 = t5 * CONST (2.053119869) - v1 - v3;
-      t6 = t6 * CONST (3.072711026) - v1 - v2;
-      t7 = t7 * CONST (1.501321110) - v0 - v3;
-
-      pd[JPEG_UNIT_SIZE * 0] = t0 + t7;
-      pd[JPEG_UNIT_SIZE * 7] = t0 - t7;
-      pd[JPEG_UNIT_SIZE * 1] = t1 + t6;
-      pd[JPEG_UNIT_SIZE * 6] = t1 - t6;
-      pd[JPEG_UNIT_SIZE * 2] = t2 + t5;
-      pd[JPEG_UNIT_SIZE * 5] = t2 - t5;
-      pd[JPEG_UNIT_SIZE * 3] = t3 + t4;
-      pd[JPEG_UNIT_SIZE * 4] = t3 - t4;
+      t10 = t0 + t2;
+      t11 = t0 - t2;
+      t13 = t1 + t3;
+      t12 = AAN_MUL (t1 - t3, CONST (1.414213562)) - t13;
+
+      t0 = t10 + t13;
+      t3 = t10 - t13;
+      t1 = t11 + t12;
+      t2 = t11 - t12;
+
+      /* Odd part.  */
+      t4 = pd[JPEG_UNIT_SIZE * 1];
+      t5 = pd[JPEG_UNIT_SIZE * 3];
+      t6 = pd[JPEG_UNIT_SIZE * 5];
+      t7 = pd[JPEG_UNIT_SIZE * 7];
+
+      z13 = t6 + t5;
+      z10 = t6 - t5;
+      z11 = t4 + t7;
+      z12 = t4 - t7;
+
+      t7 = z11 + z13;
+      t11 = AAN_MUL (z11 - z13, CONST (1.414213562));
+      z5 = AAN_MUL (z10 + z12, CONST (1.847759065));
+      t10 = AAN_MUL (z12, CONST (1.082392200)) - z5;
+      t12 = AAN_MUL (z10, -CONST (2.613125930)) + z5;
+
+      t6 = t12 - t7;
+      t5 = t11 - t6;
+      t4 = t10 + t5;
+
+      pw[JPEG_UNIT_SIZE * 0] = t0 + t7;
+      pw[JPEG_UNIT_SIZE * 7] = t0 - t7;
+      pw[JPEG_UNIT_SIZE * 1] = t1 + t6;
+      pw[JPEG_UNIT_SIZE * 6] = t1 - t6;
+      pw[JPEG_UNIT_SIZE * 2] = t2 + t5;
+      pw[JPEG_UNIT_SIZE * 5] = t2 - t5;
+      pw[JPEG_UNIT_SIZE * 4] = t3 + t4;
+      pw[JPEG_UNIT_SIZE * 3] = t3 - t4;
     }
 
+  /* Rows.  */
   pd = du;
-  for (i = 0; i < JPEG_UNIT_SIZE; i++, pd += JPEG_UNIT_SIZE)
-    {
-      if ((pd[1] | pd[2] | pd[3] | pd[4] | pd[5] | pd[6] | pd[7]) == 0)
-	{
-	  pd[0] >>= (SHIFT_BITS + 3);
-	  pd[1] = pd[2] = pd[3] = pd[4] = pd[5] = pd[6] = pd[7] = pd[0];
-	  continue;
-	}
-
-      v4 = (pd[2] + pd[6]) * CONST (0.541196100);
-
-      v0 = (pd[0] + pd[4]) << SHIFT_BITS;
-      v1 = (pd[0] - pd[4]) << SHIFT_BITS;
-      v2 = v4 - pd[6] * CONST (1.847759065);
-      v3 = v4 + pd[2] * CONST (0.765366865);
-
-      t0 = v0 + v3;
-      t3 = v0 - v3;
-      t1 = v1 + v2;
-      t2 = v1 - v2;
-
-      t4 = pd[7];
-      t5 = pd[5];
-      t6 = pd[3];
-      t7 = pd[1];
-
-      v0 = t4 + t7;
-      v1 = t5 + t6;
-      v2 = t4 + t6;
-      v3 = t5 + t7;
-
-      v4 = (v2 + v3) * CONST (1.175875602);
-
-      v0 *= CONST (0.899976223);
-      v1 *= CONST (2.562915447);
-      v2 = v2 * CONST (1.961570560) - v4;
-      v3 = v3 * CONST (0.390180644) - v4;
-
-      t4 = t4 * CONST (0.298631336) - v0 - v2;
-      t5 = t5 * CONST (2.053119869) - v1 - v3;
-      t6 = t6 * CONST (3.072711026) - v1 - v2;
-      t7 = t7 * CONST (1.501321110) - v0 - v3;
-
-      pd[0] = (t0 + t7) >> (SHIFT_BITS * 2 + 3);
-      pd[7] = (t0 - t7) >> (SHIFT_BITS * 2 + 3);
-      pd[1] = (t1 + t6) >> (SHIFT_BITS * 2 + 3);
-      pd[6] = (t1 - t6) >> (SHIFT_BITS * 2 + 3);
-      pd[2] = (t2 + t5) >> (SHIFT_BITS * 2 + 3);
-      pd[5] = (t2 - t5) >> (SHIFT_BITS * 2 + 3);
-      pd[3] = (t3 + t4) >> (SHIFT_BITS * 2 + 3);
-      pd[4] = (t3 - t4) >> (SHIFT_BITS * 2 + 3);
-    }
-
-  for (i = 0; i < JPEG_UNIT_SIZE * JPEG_UNIT_SIZE; i++)
+  pw = ws;
+  for (i = 0; i < JPEG_UNIT_SIZE; i++, pd += JPEG_UNIT_SIZE,
+	 pw += JPEG_UNIT_SIZE)
     {
-      du[i] += 128;
-
-      if (du[i] < 0)
-	du[i] = 0;
-      if (du[i] > 255)
-	du[i] = 255;
+      t10 = pw[0] + pw[4];
+      t11 = pw[0] - pw[4];
+      t13 = pw[2] + pw[6];
+      t12 = AAN_MUL (pw[2] - pw[6], CONST (1.414213562)) - t13;
+
+      t0 = t10 + t13;
+      t3 = t10 - t13;
+      t1 = t11 + t12;
+      t2 = t11 - t12;
+
+      z13 = pw[5] + pw[3];
+      z10 = pw[5] - pw[3];
+      z11 = pw[1] + pw[7];
+      z12 = pw[1] - pw[7];
+
+      t7 = z11 + z13;
+      t11 = AAN_MUL (z11 - z13, CONST (1.414213562));
+      z5 = AAN_MUL (z10 + z12, CONST (1.847759065));
+      t10 = AAN_MUL (z12, CONST (1.082392200)) - z5;
+      t12 = AAN_MUL (z10, -CONST (2.613125930)) + z5;
+
+      t6 = t12 - t7;
+      t5 = t11 - t6;
+      t4 = t10 + t5;
+
+      pd[0] = AAN_OUT (t0 + t7);
+      pd[7] = AAN_OUT (t0 - t7);
+      pd[1] = AAN_OUT (t1 + t6);
+      pd[6] = AAN_OUT (t1 - t6);
+      pd[2] = AAN_OUT (t2 + t5);
+      pd[5] = AAN_OUT (t2 - t5);
+      pd[4] = AAN_OUT (t3 + t4);
+      pd[3] = AAN_OUT (t3 - t4);
     }
 }
 
 static void
 grub_jpeg_decode_du (struct grub_jpeg_data *data, int id, jpeg_data_unit_t du)
 {
-  int h1, h2, qt;
+  int h1, h2, qt, ac;
   unsigned pos;
 
   grub_memset (du, 0, sizeof (jpeg_data_unit_t));
@@ -503,7 +633,8 @@ grub_jpeg_decode_du (struct grub_jpeg_data *data, int id, jpeg_data_unit_t du)
   data->dc_value[id] +=
     grub_jpeg_get_number (data, grub_jpeg_get_huff_code (data, h1));
 
-  du[0] = data->dc_value[id] * (int) data->quan_table[qt][0];
+  du[0] = data->dc_value[id] * data->quan_table[qt][0];
+  ac = 0;
   pos = 1;
   while (pos < ARRAY_SIZE (data->quan_table[qt]))
     {
@@ -516,57 +647,72 @@ grub_jpeg_decode_du (struct grub_jpeg_data *data, int id, jpeg_data_unit_t du)
       val = grub_jpeg_get_number (data, num & 0xF);
       num >>= 4;
       pos += num;
-      du[jpeg_zigzag_order[pos]] = val * (int) data->quan_table[qt][pos];
+      if (pos >= ARRAY_SIZE (data->quan_table[qt]))
+	{
+	  grub_error (GRUB_ERR_BAD_FILE_TYPE, "jpeg: invalid AC run");
+	  return;
+	}
+      du[jpeg_zigzag_order[pos]] = val * data->quan_table[qt][pos];
+      ac |= val;
       pos++;
     }
 
-  grub_jpeg_idct_transform (du);
+  if (ac)
+    grub_jpeg_idct_transform (du);
+  else
+    {
+      /* Flat block: every sample is the scaled DC value.  */
+      int val = AAN_OUT (du[0]);
+      unsigned i;
+
+      for (i = 0; i < JPEG_UNIT_SIZE * JPEG_UNIT_SIZE; i++)
+	du[i] = val;
+    }
 }
 
 static void
-grub_jpeg_ycrcb_to_rgb (int yy, int cr, int cb, grub_uint8_t * rgb)
+grub_jpeg_init_ycc_tables (void)
 {
-  int dd;
+  int i, c;
 
-  cr -= 128;
-  cb -= 128;
+  for (i = 0; i < (int) ARRAY_SIZE (jpeg_range_limit); i++)
+    jpeg_range_limit[i] = grub_jpeg_clamp (i - 256);
 
-  /* Red  */
-  dd = yy + ((cr * CONST (1.402)) >> SHIFT_BITS);
-  if (dd < 0)
-    dd = 0;
-  if (dd > 255)
-    dd = 255;
-#ifdef GRUB_CPU_WORDS_BIGENDIAN
-  rgb[2] = dd;
-#else
-  *(rgb++) = dd;
-#endif
+  for (i = 0; i < 256; i++)
+    {
+      c = i - 128;
+      jpeg_cr_r[i] = (YCC_CONST (1.402) * c + (1 << (YCC_BITS - 1)))
+	>> YCC_BITS;
+      jpeg_cb_b[i] = (YCC_CONST (1.772) * c + (1 << (YCC_BITS - 1)))
+	>> YCC_BITS;
+      /* The green terms are summed before rounding.  */
+      jpeg_cr_g[i] = -YCC_CONST (0.71414) * c;
+      jpeg_cb_g[i] = -YCC_CONST (0.34414) * c + (1 << (YCC_BITS - 1));
+    }
+}
 
-  /* Green  */
-  dd = yy - ((cb * CONST (0.34414) + cr * CONST (0.71414)) >> SHIFT_BITS);
-  if (dd < 0)
-    dd = 0;
-  if (dd > 255)
-    dd = 255;
-#ifdef GRUB_CPU_WORDS_BIGENDIAN
-  rgb[1] = dd;
-#else
-  *(rgb++) = dd;
-#endif
+/* Convert N pixels of one row of a luminance block to RGB.  Each chroma
+   sample covers 1 << LOG_HS pixels and its contributions are looked up once
+   for all of them.  */
+static void
+grub_jpeg_ycrcb_row_to_rgb (grub_uint8_t *rgb, const int *yy, const int *cb,
+			    const int *cr, unsigned n, unsigned log_hs)
+{
+  unsigned c, k, step = 1 << log_hs;
 
-  /* Blue  */
-  dd = yy + ((cb * CONST (1.772)) >> SHIFT_BITS);
-  if (dd < 0)
-    dd = 0;
-  if (dd > 255)
-    dd = 255;
-#ifdef GRUB_CPU_WORDS_BIGENDIAN
-  rgb[0] = dd;
-  rgb += 3;
-#else
-  *(rgb++) = dd;
-#endif
+  for (c = 0; c < n; c += step, cb++, cr++)
+    {
+      int red = jpeg_cr_r[*cr];
+      int green = (jpeg_cb_g[*cb] + jpeg_cr_g[*cr]) >> YCC_BITS;
+      int blue = jpeg_cb_b[*cb];
+
+      for (k = c; k < c + step && k < n; k++, rgb += 3)
+	{
+	  rgb[JPEG_RED] = JPEG_LIMIT (yy[k] + red);
+	  rgb[JPEG_GREEN] = JPEG_LIMIT (yy[k] + green);
+	  rgb[JPEG_BLUE] = JPEG_LIMIT (yy[k] + blue);
+	}
+    }
 }
 
 static grub_err_t
@@ -594,6 +740,10 @@ grub_jpeg_decode_sos (struct grub_jpeg_data *data)
 	return grub_error (GRUB_ERR_BAD_FILE_TYPE, "jpeg: invalid index");
 
       ht = grub_jpeg_get_byte (data);
+      if ((ht >> 4) > 1 || (ht & 0xF) > 1
+	  || !data->huff_value[ht >> 4] || !data->huff_value[(ht & 0xF) + 2])
+	return grub_error (GRUB_ERR_BAD_FILE_TYPE,
+			   "jpeg: invalid huffman table");
       data->comp_index[id][1] = (ht >> 4);
       data->comp_index[id][2] = (ht & 0xF) + 2;
     }
@@ -649,27 +799,28 @@ grub_jpeg_decode_data (struct grub_jpeg_data *data)
 	nc2 = (c1 == nc1 - 1) ? (data->image_width - c1 * hb) : hb;
 
 	ptr2 = data->bitmap_ptr;
-	for (r2 = 0; r2 < nr2; r2++, ptr2 += (data->image_width - nc2) * 3)
-	  for (c2 = 0; c2 < nc2; c2++, ptr2 += 3)
+	for (r2 = 0; r2 < nr2; r2++, ptr2 += data->image_width * 3)
+	  for (c2 = 0; c2 < nc2; c2 += 8)
 	    {
-	      unsigned i0;
-	      int yy;
+	      const int *yy;
+	      unsigned n, i0;
 
-	      i0 = (r2 >> data->log_vs) * 8 + (c2 >> data->log_hs);
-	      yy = data->ydu[(r2 / 8) * 2 + (c2 / 8)][(r2 % 8) * 8 + (c2 % 8)];
+	      yy = data->ydu[(r2 / 8) * 2 + (c2 / 8)] + (r2 % 8) * 8;
+	      n = (nc2 - c2 < 8) ? nc2 - c2 : 8;
 
 	      if (data->color_components >= 3)
 		{
-		  int cr, cb;
-		  cr = data->crdu[i0];
-		  cb = data->cbdu[i0];
-		  grub_jpeg_ycrcb_to_rgb (yy, cr, cb, ptr2);
+		  i0 = (r2 >> data->log_vs) * 8 + (c2 >> data->log_hs);
+		  grub_jpeg_ycrcb_row_to_rgb (ptr2 + c2 * 3, yy,
+					      data->cbdu + i0, data->crdu + i0,
+					      n, data->log_hs);
 		}
 	      else
 		{
-		  ptr2[0] = yy;
-		  ptr2[1] = yy;
-		  ptr2[2] = yy;
+		  grub_uint8_t *p = ptr2 + c2 * 3;
+
+		  for (i0 = 0; i0 < n; i0++, p += 3)
+		    p[0] = p[1] = p[2] = yy[i0];
 		}
 	    }
       }
@@ -680,7 +831,13 @@ grub_jpeg_decode_data (struct grub_jpeg_data *data)
 static void
 grub_jpeg_reset (struct grub_jpeg_data *data)
 {
-  data->bit_mask = 0x0;
+  /* Give back what was read ahead of the marker ending the segment.  */
+  if (data->in_len > data->in_pos)
+    grub_file_seek (data->file,
+		    data->file->offset - (data->in_len - data->in_pos));
+  data->in_pos = data->in_len = 0;
+  data->in_marker = 0;
+  data->bit_cnt = 0;
 
   data->dc_value[0] = 0;
   data->dc_value[1] = 0;
@@ -835,6 +992,7 @@ static struct grub_video_bitmap_reader jpeg_reader = {
 
 GRUB_MOD_INIT (jpeg)
 {
+  grub_jpeg_init_ycc_tables ();
   grub_video_bitmap_reader_register (&jpg_reader);
   grub_video_bitmap_reader_register (&jpeg_reader);
 #if defined(JPEG_DEBUG)
@@ -422,6 +422,95 @@ grub_video_get_active_render_target (struct grub_video_render_target **target)
   return grub_video_adapter_active->get_active_render_target (target);
 }
 
+static void
+damage_union (grub_video_rect_t *a, const grub_video_rect_t *b)
+{
+  unsigned int right = grub_max (a->x + a->width, b->x + b->width);
+  unsigned int bottom = grub_max (a->y + a->height, b->y + b->height);
+
+  a->x = grub_min (a->x, b->x);
+  a->y = grub_min (a->y, b->y);
+  a->width = right - a->x;
+  a->height = bottom - a->y;
+}
+
+void
+grub_video_damage_add (struct grub_video_damage *damage,
+		       int x, int y, unsigned int width, unsigned int height)
+{
+  grub_video_rect_t r;
+  unsigned int i;
+
+  if (x < 0)
+    {
+      if ((unsigned int) -x >= width)
+	return;
+      width += x;
+      x = 0;
+    }
+  if (y < 0)
+    {
+      if ((unsigned int) -y >= height)
+	return;
+      height += y;
+      y = 0;
+    }
+  if (width == 0 || height == 0)
+    return;
+
+  r.x = x;
+  r.y = y;
+  r.width = width;
+  r.height = height;
+
+ again:
+  for (i = 0; i < damage->count; i++)
+    {
+      grub_video_rect_t *cur = &damage->rects[i];
+
+      if (cur->x <= r.x && r.x + r.width <= cur->x + cur->width
+	  && cur->y <= r.y && r.y + r.height <= cur->y + cur->height)
+	return;
+
+      /* Merge with anything overlapping or adjacent and rescan, since the
+	 union may now reach other rectangles.  */
+      if (r.x <= cur->x + cur->width && cur->x <= r.x + r.width
+	  && r.y <= cur->y + cur->height && cur->y <= r.y + r.height)
+	{
+	  damage_union (&r, cur);
+	  damage->rects[i] = damage->rects[--damage->count];
+	  goto again;
+	}
+    }
+
+  if (damage->count == GRUB_VIDEO_DAMAGE_MAX_RECTS)
+    {
+      grub_uint64_t best_growth = ~(grub_uint64_t) 0;
+      unsigned int best = 0;
+
+      /* Fold the new rectangle into the one it enlarges least.  */
+      for (i = 0; i < damage->count; i++)
+	{
+	  grub_video_rect_t u = r;
+	  grub_uint64_t growth;
+
+	  damage_union (&u, &damage->rects[i]);
+	  growth = (grub_uint64_t) u.width * u.height
+	    - (grub_uint64_t) damage->rects[i].width * damage->rects[i].height;
+	  if (growth < best_growth)
+	    {
+	      best_growth = growth;
+	      best = i;
+	    }
+	}
+      damage_union (&r, &damage->rects[best]);
+      damage->rects[best] = damage->rects[--damage->count];
+      goto again;
+    }
+
+  damage->rects[damage->count++] = r;
+}
+
 grub_err_t
 grub_video_edid_checksum (struct grub_video_edid_info *edid_info)
 {
@@ -0,0 +1,45 @@
+/* arena.h - header for region allocator */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2020  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRUB_ARENA_HEADER
+#define GRUB_ARENA_HEADER 1
+
+#include <grub/types.h>
+#include <grub/symbol.h>
+
+/* An arena hands out memory from large chunks and releases all of it at
+   once.  Individual allocations cannot be freed.  Use it for data with a
+   common lifetime, such as the nodes and strings built while parsing.  */
+typedef struct grub_arena *grub_arena_t;
+
+/* Default size of the chunks an arena allocates from.  */
+#define GRUB_ARENA_CHUNK_SIZE	4096
+
+/* Create an arena allocating CHUNK_SIZE bytes at a time, or
+   GRUB_ARENA_CHUNK_SIZE if CHUNK_SIZE is 0.  */
+grub_arena_t EXPORT_FUNC(grub_arena_create) (grub_size_t chunk_size);
+void *EXPORT_FUNC(grub_arena_alloc) (grub_arena_t arena, grub_size_t size);
+void *EXPORT_FUNC(grub_arena_zalloc) (grub_arena_t arena, grub_size_t size);
+char *EXPORT_FUNC(grub_arena_strdup) (grub_arena_t arena, const char *s);
+char *EXPORT_FUNC(grub_arena_strndup) (grub_arena_t arena, const char *s,
+				       grub_size_t n);
+/* Release ARENA and everything allocated from it.  ARENA may be NULL.  */
+void EXPORT_FUNC(grub_arena_destroy) (grub_arena_t arena);
+
+#endif /* ! GRUB_ARENA_HEADER */
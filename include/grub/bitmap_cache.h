@@ -0,0 +1,56 @@
+/* bitmap_cache.h - Shared cache of decoded, scaled and converted images.  */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2020  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRUB_BITMAP_CACHE_HEADER
+#define GRUB_BITMAP_CACHE_HEADER 1
+
+#include <grub/err.h>
+#include <grub/types.h>
+#include <grub/bitmap.h>
+#include <grub/bitmap_scale.h>
+
+/* Default memory budget of the cache, in KiB.  Overridden by the
+   "bitmap_cache_size" environment variable.  */
+#define GRUB_VIDEO_BITMAP_CACHE_DEFAULT_SIZE	16384
+
+/* Get the image in FILENAME scaled to WIDTH x HEIGHT using SCALE_METHOD,
+   or at its own size if either dimension is 0.  The image is converted to
+   the pixel format of the current video mode where possible, so that
+   blitting it is a plain copy.  The bitmap is shared with other users and
+   must not be modified; give it back with grub_video_bitmap_cache_release
+   instead of destroying it.  */
+grub_err_t
+EXPORT_FUNC (grub_video_bitmap_cache_get) (struct grub_video_bitmap **bitmap,
+					   const char *filename,
+					   unsigned int width,
+					   unsigned int height,
+					   enum grub_video_bitmap_scale_method
+					   scale_method);
+
+/* Drop a reference obtained from grub_video_bitmap_cache_get.  The image
+   stays cached until memory is needed for others.  A bitmap that is not in
+   the cache, which includes one that could not be added to it, is
+   destroyed.  */
+void
+EXPORT_FUNC (grub_video_bitmap_cache_release) (struct grub_video_bitmap *bitmap);
+
+/* Free every cached image that is not in use.  */
+void EXPORT_FUNC (grub_video_bitmap_cache_flush) (void);
+
+#endif /* ! GRUB_BITMAP_CACHE_HEADER */
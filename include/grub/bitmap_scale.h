@@ -35,7 +35,12 @@ enum grub_video_bitmap_scale_method
   /* Nearest neighbor interpolation.  */
   GRUB_VIDEO_BITMAP_SCALE_METHOD_NEAREST,
   /* Bilinear interpolation.  */
-  GRUB_VIDEO_BITMAP_SCALE_METHOD_BILINEAR
+  GRUB_VIDEO_BITMAP_SCALE_METHOD_BILINEAR,
+  /* Area averaging: every source pixel contributes by how much of it an
+     output pixel covers.  */
+  GRUB_VIDEO_BITMAP_SCALE_METHOD_BOX,
+  /* Three-lobe Lanczos filter.  */
+  GRUB_VIDEO_BITMAP_SCALE_METHOD_LANCZOS
 };
 
 typedef enum grub_video_bitmap_selection_method
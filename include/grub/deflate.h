@@ -19,6 +19,8 @@
 #ifndef GRUB_DEFLATE_HEADER
 #define GRUB_DEFLATE_HEADER 1
 
+#include <grub/file.h>
+
 grub_ssize_t
 grub_zlib_decompress (char *inbuf, grub_size_t insize, grub_off_t off,
 		      char *outbuf, grub_size_t outsize);
@@ -27,4 +29,7 @@ grub_ssize_t
 grub_deflate_decompress (char *inbuf, grub_size_t insize, grub_off_t off,
 			 char *outbuf, grub_size_t outsize);
 
+grub_file_t
+grub_zlib_file_open (grub_file_t io);
+
 #endif
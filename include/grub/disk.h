@@ -178,6 +178,11 @@ typedef struct grub_disk_memberlist *grub_disk_memberlist_t;
 /* This is called from the memory manager.  */
 void grub_disk_cache_invalidate_all (void);
 
+/* Incremented by grub_disk_cache_invalidate_all, so that caches of data
+   derived from disk contents can be dropped together with the disk
+   cache.  */
+extern grub_uint32_t EXPORT_VAR(grub_disk_cache_generation);
+
 void EXPORT_FUNC(grub_disk_dev_register) (grub_disk_dev_t dev);
 void EXPORT_FUNC(grub_disk_dev_unregister) (grub_disk_dev_t dev);
 static inline int
@@ -98,6 +98,23 @@ struct grub_diskfilter_lv {
 
   /* Optional.  */
   char *internal_id;
+
+  /* Sector map built on first read, see read_lv.  */
+  struct grub_diskfilter_extent *extents;
+  unsigned int extent_map_count;
+  unsigned int extent_map_generation;
+};
+
+/* A run of sectors of a logical volume.  Linear runs on a physical volume
+   are read directly, everything else goes through its segment.  */
+struct grub_diskfilter_extent {
+  grub_disk_addr_t start;
+  grub_disk_addr_t length;
+  /* Set for a linear run; OFFSET is then relative to the PV data area.  */
+  struct grub_diskfilter_pv *pv;
+  /* Otherwise OFFSET is the sector of START within SEG.  */
+  struct grub_diskfilter_segment *seg;
+  grub_disk_addr_t offset;
 };
 
 struct grub_diskfilter_segment {
@@ -193,6 +210,13 @@ typedef grub_err_t (* raid_recover_read_t)(void *data, int disk_nr,
 					   grub_uint64_t addr, void *dest,
 					   grub_size_t size);
 
+/* Block operations in GF(2^8) used for RAID parity.  MUL is a field
+   element, not a power of the generator.  */
+void grub_raid_block_xor (void *dst, const void *src, grub_size_t size);
+void grub_raid_block_mul (grub_uint8_t mul, void *buf, grub_size_t size);
+void grub_raid_block_mul_xor (grub_uint8_t mul, void *dst, const void *src,
+			      grub_size_t size);
+
 extern grub_err_t
 grub_raid6_recover_gen (void *data, grub_uint64_t nstripes, int disknr, int p,
 			    char *buf, grub_uint64_t sector, grub_size_t size,
@@ -161,7 +161,62 @@ struct grub_dl_segment
 };
 typedef struct grub_dl_segment *grub_dl_segment_t;
 
+/* The optional .modhash section of a module holds this header followed by
+   one 32-bit hash (in target byte order) per symbol table entry.  It is
+   added at build time by genmod.sh and checked by
+   build-grub-module-verifier.  */
+#define GRUB_DL_MODHASH_MAGIC	0x48534d47	/* "GMSH" */
+
+struct grub_dl_modhash
+{
+  grub_uint32_t magic;
+  grub_uint32_t count;
+  grub_uint32_t hash[0];
+};
+
+/* Hash of a symbol name, as stored in .modhash.  */
+static inline grub_uint32_t
+grub_dl_symbol_hash (const char *s)
+{
+  grub_uint32_t key = 0;
+
+  while (*s)
+    key = key * 65599 + (grub_uint8_t) *s++;
+
+  return key + (key >> 5);
+}
+
+/* A module bundle (grub-mkimage --bundle) is a header, an index of
+   NMODULES entries, their names and the module images, all in target byte
+   order.  Modules are stored so that every module follows its
+   dependencies.  VERSION is the GRUB version the modules were built for;
+   a bundle from another version is ignored.  */
+#define GRUB_DL_BUNDLE_NAME	"modules.bundle"
+#define GRUB_DL_BUNDLE_MAGIC	"GRUBMBDL"
+#define GRUB_DL_BUNDLE_ALIGN	16
+#define GRUB_DL_BUNDLE_VERSION_SIZE	32
+
+struct grub_dl_bundle_header
+{
+  char magic[8];
+  grub_uint32_t nmodules;
+  grub_uint32_t size;
+  char version[GRUB_DL_BUNDLE_VERSION_SIZE];
+};
+
+struct grub_dl_bundle_entry
+{
+  /* Offset of the NUL-terminated module name.  */
+  grub_uint32_t name;
+  /* grub_dl_symbol_hash of the name.  */
+  grub_uint32_t hash;
+  /* Offset and size of the module image.  */
+  grub_uint32_t offset;
+  grub_uint32_t size;
+};
+
 struct grub_dl;
+struct grub_symbol;
 
 struct grub_dl_dep
 {
@@ -178,6 +233,7 @@ struct grub_dl
   int persistent;
   grub_dl_dep_t dep;
   grub_dl_segment_t segment;
+  struct grub_symbol *symbols;
   Elf_Sym *symtab;
   grub_size_t symsize;
   void (*init) (struct grub_dl *mod);
@@ -61,6 +61,31 @@ EXPORT_FUNC(grub_fshelp_find_file) (const char *path,
 				    char *(*read_symlink) (grub_fshelp_node_t node),
 				    enum grub_fshelp_filetype expect);
 
+/* Like grub_fshelp_find_file, but remember the directory entries looked up
+   on DISK, including the names that were not found, so that later lookups
+   of the same paths do not search the directories again.  If LOOKUP_FILE is
+   not NULL, it is used instead of ITERATE_DIR to look up single names;
+   ITERATE_DIR still identifies the filesystem driver.  The cache is
+   dropped together with the disk cache.  Nodes are copied in and out of
+   the cache, so they must be NODE_SIZE bytes without pointers to memory
+   they own.  Their first member must be the pointer to the mount data,
+   which is replaced by the one of ROOTNODE in nodes taken from the
+   cache.  */
+grub_err_t
+EXPORT_FUNC(grub_fshelp_find_file_cached) (const char *path,
+					   grub_fshelp_node_t rootnode,
+					   grub_fshelp_node_t *foundnode,
+					   int (*iterate_dir) (grub_fshelp_node_t dir,
+							       grub_fshelp_iterate_dir_hook_t hook,
+							       void *hook_data),
+					   grub_err_t (*lookup_file) (grub_fshelp_node_t dir,
+								      const char *name,
+								      grub_fshelp_node_t *foundnode,
+								      enum grub_fshelp_filetype *foundtype),
+					   char *(*read_symlink) (grub_fshelp_node_t node),
+					   enum grub_fshelp_filetype expect,
+					   grub_disk_t disk,
+					   grub_size_t node_size);
 
 grub_err_t
 EXPORT_FUNC(grub_fshelp_find_file_lookup) (const char *path,
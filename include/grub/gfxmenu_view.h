@@ -45,6 +45,9 @@ grub_err_t grub_gui_recreate_box (grub_gfxmenu_box_t *boxptr,
 
 void grub_gfxmenu_view_draw (grub_gfxmenu_view_t view);
 
+/* Paint the whole menu without showing it or touching the terminal.  */
+void grub_gfxmenu_view_compose (grub_gfxmenu_view_t view);
+
 void
 grub_gfxmenu_redraw_menu (grub_gfxmenu_view_t view);
 
@@ -55,6 +58,11 @@ void
 grub_gfxmenu_view_redraw (grub_gfxmenu_view_t view,
 			  const grub_video_rect_t *region);
 
+/* Mark RECT as needing a repaint on the next menu redraw.  */
+void
+grub_gfxmenu_view_invalidate (grub_gfxmenu_view_t view,
+			      const grub_video_rect_t *rect);
+
 void 
 grub_gfxmenu_clear_timeout (void *data);
 void 
@@ -72,6 +80,8 @@ grub_err_t grub_font_draw_string (const char *str,
 				  int left_x, int baseline_y);
 int grub_font_get_string_width (grub_font_t font,
 				const char *str);
+/* Free the strings grub_font_draw_string has kept rendered.  */
+void grub_font_flush_string_cache (void);
 
 
 /* Implementation details -- this should not be used outside of the
@@ -99,6 +109,7 @@ struct grub_gfxmenu_view
   grub_video_rgba_color_t title_color;
   grub_video_rgba_color_t message_color;
   grub_video_rgba_color_t message_bg_color;
+  char *desktop_image_path;
   struct grub_video_bitmap *raw_desktop_image;
   struct grub_video_bitmap *scaled_desktop_image;
   grub_video_bitmap_selection_method_t desktop_image_scale_method;
@@ -130,6 +141,11 @@ struct grub_gfxmenu_view
   int need_refresh;
   int point_x;
   int point_y;
+
+  /* Screen areas to repaint on the next redraw, as reported by the
+     components, and the selection the animations were last drawn for.  */
+  struct grub_video_damage damage;
+  int painted_selected;
 };
 
 #endif /* ! GRUB_GFXMENU_VIEW_HEADER */
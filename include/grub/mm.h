@@ -22,6 +22,7 @@
 
 #include <grub/types.h>
 #include <grub/symbol.h>
+#include <grub/err.h>
 #include <config.h>
 
 #ifndef NULL
@@ -35,6 +36,15 @@ void EXPORT_FUNC(grub_free) (void *ptr);
 void *EXPORT_FUNC(grub_realloc) (void *ptr, grub_size_t size);
 #ifndef GRUB_MACHINE_EMU
 void *EXPORT_FUNC(grub_memalign) (grub_size_t align, grub_size_t size);
+
+/* Called when no region can satisfy an allocation of SIZE bytes. The
+   function should add a region of at least that size with
+   grub_mm_init_region and return GRUB_ERR_NONE, or fail without
+   allocating from the heap.  */
+typedef grub_err_t (*grub_mm_add_region_func_t) (grub_size_t size);
+extern grub_mm_add_region_func_t grub_mm_add_region_fn;
+
+int grub_mm_remove_region (void *addr, grub_size_t size);
 #endif
 
 void grub_mm_check_real (const char *file, int line);
@@ -24,6 +24,7 @@
 /* Magic words.  */
 #define GRUB_MM_FREE_MAGIC	0x2d3c2808
 #define GRUB_MM_ALLOC_MAGIC	0x6db08fa4
+#define GRUB_MM_CACHED_MAGIC	0x5a1c3b0e
 
 typedef struct grub_mm_header
 {
@@ -57,8 +58,40 @@ typedef struct grub_mm_region
 }
 *grub_mm_region_t;
 
+/* Blocks of up to GRUB_MM_NUM_CLASSES cells (header included) are
+   served from per-size free lists before the regions are searched.  */
+#define GRUB_MM_NUM_CLASSES	16
+/* Upper bound on the number of blocks kept on one class list.  */
+#define GRUB_MM_CLASS_MAX_CACHED	64
+/* Number of blocks carved out of a region at once when a class list
+   runs empty.  */
+#define GRUB_MM_CLASS_REFILL	8
+
+struct grub_mm_class_stats
+{
+  grub_uint64_t allocs;
+  grub_uint64_t hits;
+  grub_uint64_t frees;
+  grub_size_t cached;
+};
+
+struct grub_mm_stats
+{
+  struct grub_mm_class_stats classes[GRUB_MM_NUM_CLASSES];
+  /* Allocations too big or too aligned for the class lists.  */
+  grub_uint64_t large_allocs;
+  /* Calls to the first-fit region search and free blocks visited.  */
+  grub_uint64_t scans;
+  grub_uint64_t scan_steps;
+  grub_size_t max_scan;
+  /* Number of times the class lists were given back to the regions.  */
+  grub_uint64_t flushes;
+};
+
 #ifndef GRUB_MACHINE_EMU
 extern grub_mm_region_t EXPORT_VAR (grub_mm_base);
+extern struct grub_mm_stats EXPORT_VAR (grub_mm_stats);
+int EXPORT_FUNC (grub_mm_flush_classes) (void);
 #endif
 
 #endif
@@ -84,6 +84,12 @@ enum
 #define GRUB_NTFS_MAX_MFT		(4096 >> GRUB_NTFS_BLK_SHR)
 #define GRUB_NTFS_MAX_IDX		(16384 >> GRUB_NTFS_BLK_SHR)
 
+/* Deeper $I30 indexes are searched linearly.  */
+#define GRUB_NTFS_MAX_INDEX_DEPTH	32
+
+/* $UpCase is read in pages of this many (log2) characters.  */
+#define GRUB_NTFS_UPCASE_PAGE_SHIFT	8
+
 #define GRUB_NTFS_COM_LEN		4096
 #define GRUB_NTFS_COM_LOG_LEN	12
 #define GRUB_NTFS_COM_SEC		(GRUB_NTFS_COM_LEN >> GRUB_NTFS_BLK_SHR)
@@ -158,6 +164,8 @@ struct grub_ntfs_data
   int log_spc;
   grub_uint64_t mft_start;
   grub_uint64_t uuid;
+  grub_uint16_t *upcase;
+  grub_uint32_t upcase_loaded[(0x10000 >> GRUB_NTFS_UPCASE_PAGE_SHIFT) / 32];
 };
 
 struct grub_ntfs_comp_table_element
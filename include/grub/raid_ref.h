@@ -0,0 +1,79 @@
+/* raid_ref.h - Bytewise reference for the RAID parity block operations.  */
+/*
+ *  GRUB  --  GRand Unified Bootloader
+ *  Copyright (C) 2020  Free Software Foundation, Inc.
+ *
+ *  GRUB is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GRUB is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with GRUB.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRUB_RAID_REF_HEADER
+#define GRUB_RAID_REF_HEADER 1
+
+#include <grub/types.h>
+
+/* Log/antilog tables of GF(2^8), as raid6rec used before the block
+   operations became word-wide.  The RAID self-test and the raidtest
+   benchmark both compare against them; every module including this
+   header has its own copy, filled by grub_raid_ref_init.  */
+static grub_uint8_t grub_raid_ref_powx[255 * 2];
+static unsigned grub_raid_ref_powx_inv[256];
+
+static inline void
+grub_raid_ref_init (void)
+{
+  grub_uint8_t cur = 1;
+  unsigned i;
+
+  for (i = 0; i < 255; i++)
+    {
+      grub_raid_ref_powx[i] = cur;
+      grub_raid_ref_powx[i + 255] = cur;
+      grub_raid_ref_powx_inv[cur] = i;
+      cur = (cur << 1) ^ ((cur & 0x80) ? 0x1d : 0);
+    }
+}
+
+static inline grub_uint8_t
+grub_raid_ref_mul (grub_uint8_t a, grub_uint8_t b)
+{
+  if (!a || !b)
+    return 0;
+  return grub_raid_ref_powx[grub_raid_ref_powx_inv[a]
+			    + grub_raid_ref_powx_inv[b]];
+}
+
+static inline void
+grub_raid_ref_block_mul_xor (grub_uint8_t mul, grub_uint8_t *dst,
+			     const grub_uint8_t *src, grub_size_t size)
+{
+  grub_size_t i;
+
+  for (i = 0; i < size; i++)
+    dst[i] ^= grub_raid_ref_mul (src[i], mul);
+}
+
+/* Fill BUF with pseudo-random bytes from *SEED.  */
+static inline void
+grub_raid_ref_fill (grub_uint8_t *buf, grub_size_t size, grub_uint32_t *seed)
+{
+  grub_size_t i;
+
+  for (i = 0; i < size; i++)
+    {
+      *seed = *seed * 1103515245 + 12345;
+      buf[i] = *seed >> 16;
+    }
+}
+
+#endif /* ! GRUB_RAID_REF_HEADER */
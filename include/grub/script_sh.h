@@ -24,8 +24,7 @@
 #include <grub/err.h>
 #include <grub/parser.h>
 #include <grub/command.h>
-
-struct grub_script_mem;
+#include <grub/arena.h>
 
 /* The generic header for each scripting command or structure.  */
 struct grub_script_cmd
@@ -41,7 +40,7 @@ struct grub_script_cmd
 struct grub_script
 {
   unsigned refcnt;
-  struct grub_script_mem *mem;
+  grub_arena_t mem;
   struct grub_script_cmd *cmd;
 
   /* grub_scripts from block arguments.  */
@@ -222,13 +221,13 @@ struct grub_parser_param
 {
   /* Keep track of the memory allocated for this specific
      function.  */
-  struct grub_script_mem *func_mem;
+  grub_arena_t func_mem;
 
   /* When set to 0, no errors have occurred during parsing.  */
   int err;
 
   /* The memory that was used while parsing and scanning.  */
-  struct grub_script_mem *memused;
+  grub_arena_t memused;
 
   /* The block argument scripts.  */
   struct grub_script *scripts;
@@ -242,7 +241,7 @@ struct grub_parser_param
 void grub_script_init (void);
 void grub_script_fini (void);
 
-void grub_script_mem_free (struct grub_script_mem *mem);
+void grub_script_mem_free (grub_arena_t mem);
 
 void grub_script_argv_free    (struct grub_script_argv *argv);
 int grub_script_argv_make     (struct grub_script_argv *argv, int argc, char **args);
@@ -294,7 +293,7 @@ struct grub_script *grub_script_parse (char *script,
 				       void *getline_func_data);
 void grub_script_free (struct grub_script *script);
 struct grub_script *grub_script_create (struct grub_script_cmd *cmd,
-					struct grub_script_mem *mem);
+					grub_arena_t mem);
 
 struct grub_lexer_param *grub_script_lexer_init (struct grub_parser_param *parser,
 						 char *script,
@@ -309,9 +308,9 @@ int  grub_script_lexer_yywrap (struct grub_parser_param *, const char *input);
 void grub_script_lexer_record (struct grub_parser_param *, char *);
 
 /* Functions to track allocated memory.  */
-struct grub_script_mem *grub_script_mem_record (struct grub_parser_param *state);
-struct grub_script_mem *grub_script_mem_record_stop (struct grub_parser_param *state,
-						     struct grub_script_mem *restore);
+grub_arena_t grub_script_mem_record (struct grub_parser_param *state);
+grub_arena_t grub_script_mem_record_stop (struct grub_parser_param *state,
+					  grub_arena_t restore);
 void *grub_script_malloc (struct grub_parser_param *state, grub_size_t size);
 
 /* Functions used by bison.  */
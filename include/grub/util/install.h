@@ -185,6 +185,11 @@ grub_install_generate_image (const char *dir, const char *prefix,
 			     int note,
 			     grub_compression_t comp, const char *dtb_file);
 
+void
+grub_install_generate_bundle (const char *dir, FILE *out, const char *outname,
+			      char *mods[],
+			      const struct grub_install_image_target_desc *image_target);
+
 const struct grub_install_image_target_desc *
 grub_install_get_image_target (const char *arg);
 
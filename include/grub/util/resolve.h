@@ -33,4 +33,8 @@ grub_util_resolve_dependencies (const char *prefix,
 				char *modules[]);
 void grub_util_free_path_list (struct grub_util_path_list *path_list);
 
+/* Return the module name of the module file STR in a newly allocated
+   string.  */
+char *grub_util_get_module_name (const char *str);
+
 #endif /* ! GRUB_UTIL_RESOLVE_HEADER */
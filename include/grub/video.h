@@ -198,6 +198,19 @@ struct grub_video_rect
 };
 typedef struct grub_video_rect grub_video_rect_t;
 
+/* Maximum number of rectangles tracked separately in a damage list.  */
+#define GRUB_VIDEO_DAMAGE_MAX_RECTS	8
+
+/* A list of non-overlapping rectangles that need repainting.  Adding a
+   rectangle merges it with any rectangle it overlaps or touches; once the
+   list is full the new rectangle is merged into the one whose area grows
+   least by it instead.  */
+struct grub_video_damage
+{
+  unsigned int count;
+  grub_video_rect_t rects[GRUB_VIDEO_DAMAGE_MAX_RECTS];
+};
+
 struct grub_video_signed_rect
 {
   signed x;
@@ -532,6 +545,17 @@ grub_err_t EXPORT_FUNC (grub_video_set_active_render_target) (struct grub_video_
 
 grub_err_t grub_video_get_active_render_target (struct grub_video_render_target **target);
 
+void EXPORT_FUNC (grub_video_damage_add) (struct grub_video_damage *damage,
+					  int x, int y,
+					  unsigned int width,
+					  unsigned int height);
+
+static inline void
+grub_video_damage_clear (struct grub_video_damage *damage)
+{
+  damage->count = 0;
+}
+
 grub_err_t EXPORT_FUNC (grub_video_edid_checksum) (struct grub_video_edid_info *edid_info);
 grub_err_t EXPORT_FUNC (grub_video_edid_preferred_mode) (struct grub_video_edid_info *edid_info,
 					   unsigned int *width,
@@ -591,6 +615,12 @@ grub_err_t
 grub_video_capture_start (const struct grub_video_mode_info *mode_info,
 			  struct grub_video_palette_data *palette,
 			  unsigned int palette_size);
+struct grub_video_fb_shadow_ops;
+grub_err_t
+grub_video_capture_start_shadow (const struct grub_video_mode_info *mode_info,
+				 struct grub_video_palette_data *palette,
+				 unsigned int palette_size,
+				 const struct grub_video_fb_shadow_ops *shadow_ops);
 void
 grub_video_capture_end (void);
 
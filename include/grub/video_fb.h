@@ -142,6 +142,36 @@ EXPORT_FUNC (grub_video_fb_setup) (unsigned int mode_type, unsigned int mode_mas
 		     volatile void *page0_ptr,
 		     grub_video_fb_set_page_t set_page_in,
 		     volatile void *page1_ptr);
+/* Most large fills remembered for one update of a shadow screen.  */
+#define GRUB_VIDEO_FB_SHADOW_MAX_FILLS	4
+
+/* How a driver gets the contents of a shadow buffer in RAM onto a screen
+   it can only reach through firmware, as with EFI GOP.  Coordinates are
+   in pixels, the same on the shadow and the screen.  */
+struct grub_video_fb_shadow_ops
+{
+  /* Copy RECT of the shadow to the screen.  */
+  grub_err_t (*update) (const grub_video_rect_t *rect);
+
+  /* Optional: move WIDTH x HEIGHT pixels at SRC_X, SRC_Y on the screen to
+     DST_X, DST_Y without going through the shadow.  */
+  grub_err_t (*move) (unsigned int src_x, unsigned int src_y,
+		      unsigned int dst_x, unsigned int dst_y,
+		      unsigned int width, unsigned int height);
+
+  /* Optional: fill RECT on the screen with COLOR, mapped for the
+     shadow.  */
+  grub_err_t (*fill) (grub_video_color_t color,
+		      const grub_video_rect_t *rect);
+};
+
+/* Render into SHADOW, described by MODE_INFO, and bring the screen up to
+   date with OPS on every swap, touching only what changed.  */
+grub_err_t
+EXPORT_FUNC (grub_video_fb_setup_shadow) (struct grub_video_mode_info *mode_info,
+					  void *shadow,
+					  const struct grub_video_fb_shadow_ops *ops);
+
 grub_err_t
 EXPORT_FUNC (grub_video_fb_swap_buffers) (void);
 grub_err_t
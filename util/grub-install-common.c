@@ -28,6 +28,7 @@
 #include <grub/env.h>
 #include <grub/term.h>
 #include <grub/mm.h>
+#include <grub/dl.h>
 #include <grub/lib/hexdump.h>
 #include <grub/crypto.h>
 #include <grub/command.h>
@@ -205,7 +206,9 @@ clean_grub_dir (const char *di)
 		   || strcmp (ext, ".mo") == 0)
 	   && strcmp (de->d_name, "menu.lst") != 0)
 	  || strcmp (de->d_name, "efiemu32.o") == 0
-	  || strcmp (de->d_name, "efiemu64.o") == 0)
+	  || strcmp (de->d_name, "efiemu64.o") == 0
+	  /* Built from the modules being replaced.  */
+	  || strcmp (de->d_name, GRUB_DL_BUNDLE_NAME) == 0)
 	{
 	  char *x = grub_util_path_concat (2, di, de->d_name);
 	  if (grub_util_unlink (x) < 0)
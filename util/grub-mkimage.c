@@ -81,6 +81,10 @@ static struct argp_option options[] = {
   {"output",  'o', N_("FILE"), 0, N_("output a generated image to FILE [default=stdout]"), 0},
   {"format",  'O', N_("FORMAT"), 0, 0, 0},
   {"compression",  'C', "(xz|none|auto)", 0, N_("choose the compression to use for core image"), 0},
+  {"bundle",  'B', 0, 0, N_("output a bundle of MODULES and their dependencies "
+			    "instead of a bootable image.  Place it as "
+			    GRUB_DL_BUNDLE_NAME " next to the modules to load "
+			    "them with a single read"), 0},
   {"verbose",     'v', 0,      0, N_("print verbose messages."), 0},
   { 0, 0, 0, 0, 0, 0 }
 };
@@ -124,6 +128,7 @@ struct arguments
   char *font;
   char *config;
   int note;
+  int bundle;
   const struct grub_install_image_target_desc *image_target;
   grub_compression_t comp;
 };
@@ -166,6 +171,10 @@ argp_parser (int key, char *arg, struct argp_state *state)
       arguments->note = 1;
       break;
 
+    case 'B':
+      arguments->bundle = 1;
+      break;
+
     case 'm':
       if (arguments->memdisk)
 	free (arguments->memdisk);
@@ -276,7 +285,7 @@ main (int argc, char *argv[])
       exit(1);
     }
 
-  if (!arguments.prefix)
+  if (!arguments.prefix && !arguments.bundle)
     {
       char *program = xstrdup(program_name);
       printf ("%s\n", _("Prefix not specified (use the -p option)."));
@@ -304,12 +313,16 @@ main (int argc, char *argv[])
       strcpy (ptr, dn);
     }
 
-  grub_install_generate_image (arguments.dir, arguments.prefix, fp,
-			       arguments.output, arguments.modules,
-			       arguments.memdisk, arguments.pubkeys,
-			       arguments.npubkeys, arguments.config,
-			       arguments.image_target, arguments.note,
-			       arguments.comp, arguments.dtb);
+  if (arguments.bundle)
+    grub_install_generate_bundle (arguments.dir, fp, arguments.output,
+				  arguments.modules, arguments.image_target);
+  else
+    grub_install_generate_image (arguments.dir, arguments.prefix, fp,
+				 arguments.output, arguments.modules,
+				 arguments.memdisk, arguments.pubkeys,
+				 arguments.npubkeys, arguments.config,
+				 arguments.image_target, arguments.note,
+				 arguments.comp, arguments.dtb);
 
   if (grub_util_file_sync (fp) < 0)
     grub_util_error (_("cannot sync `%s': %s"), arguments.output ? : "stdout",
@@ -206,8 +206,8 @@ main (int argc, char **argv)
   unsigned arch, whitelist;
   const char **whitelist_empty = 0;
   char *module_img;
-  if (argc != 4) {
-    fprintf (stderr, "usage: %s FILE ARCH PLATFORM\n", argv[0]);
+  if (argc != 4 && argc != 5) {
+    fprintf (stderr, "usage: %s FILE ARCH PLATFORM [HASHFILE]\n", argv[0]);
     return 1;
   }
 
@@ -227,8 +227,8 @@ main (int argc, char **argv)
   module_size = grub_util_get_image_size (argv[1]);
   module_img = grub_util_read_image (argv[1]);
   if (archs[arch].voidp_sizeof == 8)
-    grub_module_verify64(argv[1], module_img, module_size, &archs[arch], whitelist_empty);
+    grub_module_verify64(argv[1], module_img, module_size, &archs[arch], whitelist_empty, argv[4]);
   else
-    grub_module_verify32(argv[1], module_img, module_size, &archs[arch], whitelist_empty);
+    grub_module_verify32(argv[1], module_img, module_size, &archs[arch], whitelist_empty, argv[4]);
   return 0;
 }
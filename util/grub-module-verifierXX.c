@@ -1,6 +1,8 @@
 #include <string.h>
+#include <errno.h>
 
 #include <grub/elf.h>
+#include <grub/dl.h>
 #include <grub/module_verifier.h>
 #include <grub/util/misc.h>
 
@@ -385,11 +387,68 @@ check_relocations (const char * const modname,
       }
 }
 
+/* Compare the .modhash section of the module against its symbol table, and
+   write the contents it should have to HASH_FILE unless that is NULL.  */
+static void
+check_symbol_hashes (const char * const modname,
+		     const struct grub_module_verifier_arch *arch,
+		     Elf_Ehdr *e, const char *hash_file)
+{
+  Elf_Shdr *s, *strs;
+  Elf_Sym *sym;
+  Elf_Word size, entsize;
+  const char *str;
+  grub_uint32_t *buf;
+  unsigned i, n;
+
+  sym = get_symtab (arch, e, &size, &entsize);
+  if (!sym)
+    {
+      if (find_section (arch, e, ".modhash"))
+	grub_util_error ("%s: .modhash section without symbol table", modname);
+      return;
+    }
+
+  for (i = 0, s = (Elf_Shdr *) ((char *) e + grub_target_to_host (e->e_shoff));
+       i < grub_target_to_host16 (e->e_shnum);
+       i++, s = (Elf_Shdr *) ((char *) s + grub_target_to_host16 (e->e_shentsize)))
+    if (grub_target_to_host32 (s->sh_type) == SHT_SYMTAB)
+      break;
+  strs = (Elf_Shdr *) ((char *) e + grub_target_to_host (e->e_shoff)
+		       + grub_target_to_host32 (s->sh_link) * grub_target_to_host16 (e->e_shentsize));
+  str = (char *) e + grub_target_to_host (strs->sh_offset);
+
+  n = size / entsize;
+  buf = xmalloc ((n + 2) * sizeof (buf[0]));
+  buf[0] = grub_host_to_target32 (GRUB_DL_MODHASH_MAGIC);
+  buf[1] = grub_host_to_target32 (n);
+  for (i = 0; i < n; i++, sym = (Elf_Sym *) ((char *) sym + entsize))
+    buf[i + 2] = grub_host_to_target32 (grub_dl_symbol_hash (str + grub_target_to_host32 (sym->st_name)));
+
+  s = find_section (arch, e, ".modhash");
+  if (s && (grub_target_to_host (s->sh_size) != (n + 2) * sizeof (buf[0])
+	    || memcmp ((char *) e + grub_target_to_host (s->sh_offset), buf,
+		       (n + 2) * sizeof (buf[0])) != 0))
+    grub_util_error ("%s: .modhash section does not match the symbol table", modname);
+
+  if (hash_file)
+    {
+      FILE *out = grub_util_fopen (hash_file, "wb");
+      if (!out)
+	grub_util_error ("cannot open `%s': %s", hash_file, strerror (errno));
+      grub_util_write_image ((char *) buf, (n + 2) * sizeof (buf[0]), out, hash_file);
+      fclose (out);
+    }
+
+  free (buf);
+}
+
 void
 SUFFIX(grub_module_verify) (const char * const filename,
 			    void *module_img, size_t size,
 			    const struct grub_module_verifier_arch *arch,
-			    const char **whitelist_empty)
+			    const char **whitelist_empty,
+			    const char *hash_file)
 {
   Elf_Ehdr *e = module_img;
 
@@ -436,4 +495,5 @@ SUFFIX(grub_module_verify) (const char * const filename,
 
   check_symbols(arch, e, modname, whitelist_empty);
   check_relocations(modname, arch, e);
+  check_symbol_hashes (modname, arch, e, hash_file);
 }
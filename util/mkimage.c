@@ -1758,3 +1758,73 @@ grub_install_generate_image (const char *dir, const char *prefix,
 
   grub_util_free_path_list (path_list);
 }
+
+void
+grub_install_generate_bundle (const char *dir, FILE *out, const char *outname,
+			      char *mods[],
+			      const struct grub_install_image_target_desc *image_target)
+{
+  struct grub_util_path_list *path_list, *p;
+  struct grub_dl_bundle_header *header;
+  struct grub_dl_bundle_entry *entry;
+  size_t nmodules = 0, names_size = 0, total_size, name_off, mod_off;
+  char *bundle;
+
+  path_list = grub_util_resolve_dependencies (dir, "moddep.lst", mods);
+
+  for (p = path_list; p; p = p->next)
+    {
+      char *name = grub_util_get_module_name (p->name);
+
+      nmodules++;
+      names_size += strlen (name) + 1;
+      free (name);
+    }
+
+  total_size = ALIGN_UP (sizeof (*header) + nmodules * sizeof (*entry)
+			 + names_size, GRUB_DL_BUNDLE_ALIGN);
+  for (p = path_list; p; p = p->next)
+    total_size += ALIGN_UP (grub_util_get_image_size (p->name),
+			    GRUB_DL_BUNDLE_ALIGN);
+
+  if (total_size != (grub_uint32_t) total_size)
+    grub_util_error ("%s", _("module bundle is too big"));
+
+  bundle = xmalloc (total_size);
+  memset (bundle, 0, total_size);
+  header = (struct grub_dl_bundle_header *) bundle;
+  memcpy (header->magic, GRUB_DL_BUNDLE_MAGIC, sizeof (header->magic));
+  strncpy (header->version, PACKAGE_VERSION, sizeof (header->version));
+  header->nmodules = grub_host_to_target32 (nmodules);
+  header->size = grub_host_to_target32 (total_size);
+
+  entry = (struct grub_dl_bundle_entry *) (header + 1);
+  name_off = sizeof (*header) + nmodules * sizeof (*entry);
+  mod_off = ALIGN_UP (name_off + names_size, GRUB_DL_BUNDLE_ALIGN);
+
+  /* grub_util_resolve_dependencies returns every module after its
+     dependencies, which is the order the index keeps.  */
+  for (p = path_list; p; p = p->next, entry++)
+    {
+      char *name = grub_util_get_module_name (p->name);
+      size_t mod_size = grub_util_get_image_size (p->name);
+
+      grub_util_info ("adding module %s to the bundle", name);
+
+      strcpy (bundle + name_off, name);
+      entry->name = grub_host_to_target32 (name_off);
+      entry->hash = grub_host_to_target32 (grub_dl_symbol_hash (name));
+      name_off += strlen (name) + 1;
+
+      grub_util_load_image (p->name, bundle + mod_off);
+      entry->offset = grub_host_to_target32 (mod_off);
+      entry->size = grub_host_to_target32 (mod_size);
+      mod_off += ALIGN_UP (mod_size, GRUB_DL_BUNDLE_ALIGN);
+      free (name);
+    }
+
+  grub_util_write_image (bundle, total_size, out, outname);
+  free (bundle);
+
+  grub_util_free_path_list (path_list);
+}
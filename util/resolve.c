@@ -132,8 +132,8 @@ read_dep_list (FILE *fp)
   return dep_list;
 }
 
-static char *
-get_module_name (const char *str)
+char *
+grub_util_get_module_name (const char *str)
 {
   char *base;
   char *ext;
@@ -196,7 +196,7 @@ add_module (const char *dir,
   struct mod_list *mod;
   struct dep_list *dep;
 
-  mod_name = get_module_name (name);
+  mod_name = grub_util_get_module_name (name);
 
   /* Check if the module has already been added.  */
   for (mod = *mod_head; mod; mod = mod->next)